@@ -0,0 +1,539 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * Benchmark of the userspace library.
+ *
+ * Runs libethercat against the mock of the master character device (see
+ * mock.c) and measures the cost of the single cyclic library calls, of
+ * complete cycles with and without command batches, and the timing jitter
+ * of a periodic task. No kernel module or hardware is needed.
+ */
+
+/****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h> /* clock_gettime() */
+
+/****************************************************************************/
+
+#include "ecrt.h"
+#include "mock.h"
+
+/****************************************************************************/
+
+#define MAX_DOMAINS 32
+
+#define NSEC_PER_SEC (1000000000)
+
+/****************************************************************************/
+
+static unsigned int iterations = 100000;
+static unsigned int cycles = 10000;
+static unsigned int period_us = 1000;
+static unsigned int config_count = 8;
+static unsigned int domain_count = 2;
+
+static ec_master_t *master;
+static ec_domain_t *domains[MAX_DOMAINS];
+static ec_sdo_request_t *sdo;
+static ec_reg_request_t *reg;
+static uint64_t app_time;
+
+/****************************************************************************/
+
+typedef int (*bench_func_t)(void);
+
+/** Statistics of a series of samples.
+ */
+typedef struct {
+    double mean;
+    unsigned int min;
+    unsigned int median;
+    unsigned int p99;
+    unsigned int max;
+} bench_stats_t;
+
+/****************************************************************************/
+
+static long long timespec_diff_ns(const struct timespec *a,
+        const struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * (long long) NSEC_PER_SEC
+        + b->tv_nsec - a->tv_nsec;
+}
+
+/****************************************************************************/
+
+static int compare_samples(const void *a, const void *b)
+{
+    unsigned int x = *(const unsigned int *) a,
+                 y = *(const unsigned int *) b;
+    return x < y ? -1 : x > y;
+}
+
+/****************************************************************************/
+
+/** Sorts the samples and calculates their statistics.
+ */
+static void calc_stats(unsigned int *samples, unsigned int count,
+        bench_stats_t *stats)
+{
+    unsigned long long sum = 0;
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        sum += samples[i];
+    }
+
+    qsort(samples, count, sizeof(unsigned int), compare_samples);
+
+    stats->mean = (double) sum / count;
+    stats->min = samples[0];
+    stats->median = samples[count / 2];
+    stats->p99 = samples[(unsigned long long) count * 99 / 100];
+    stats->max = samples[count - 1];
+}
+
+/****************************************************************************/
+
+static void print_header(const char *title)
+{
+    printf("\n%-32s %9s %8s %8s %8s %8s %7s\n", title,
+            "Mean/ns", "Min", "Median", "99%", "Max", "ioctls");
+}
+
+/****************************************************************************/
+
+static void print_stats(const char *name, const bench_stats_t *stats,
+        double ioctls)
+{
+    printf("%-32s %9.1f %8u %8u %8u %8u %7.2f\n", name, stats->mean,
+            stats->min, stats->median, stats->p99, stats->max, ioctls);
+}
+
+/*****************************************************************************
+ * Benchmarked operations.
+ ****************************************************************************/
+
+static int bench_receive(void)
+{
+    return ecrt_master_receive(master);
+}
+
+/****************************************************************************/
+
+static int bench_send(void)
+{
+    return ecrt_master_send(master);
+}
+
+/****************************************************************************/
+
+static int bench_domain_process(void)
+{
+    return ecrt_domain_process(domains[0]);
+}
+
+/****************************************************************************/
+
+static int bench_domain_queue(void)
+{
+    return ecrt_domain_queue(domains[0]);
+}
+
+/****************************************************************************/
+
+static int bench_domain_state(void)
+{
+    ec_domain_state_t state;
+    return ecrt_domain_state(domains[0], &state);
+}
+
+/****************************************************************************/
+
+static int bench_master_state(void)
+{
+    ec_master_state_t state;
+    return ecrt_master_state(master, &state);
+}
+
+/****************************************************************************/
+
+static int bench_app_time(void)
+{
+    return ecrt_master_application_time(master, app_time++);
+}
+
+/****************************************************************************/
+
+static int bench_sdo_request(void)
+{
+    if (ecrt_sdo_request_state(sdo) != EC_REQUEST_BUSY) {
+        return ecrt_sdo_request_read(sdo);
+    }
+    return 0;
+}
+
+/****************************************************************************/
+
+static int bench_reg_request(void)
+{
+    if (ecrt_reg_request_state(reg) != EC_REQUEST_BUSY) {
+        return ecrt_reg_request_read(reg, 0x0130, 2);
+    }
+    return 0;
+}
+
+/****************************************************************************/
+
+/** A typical cycle with single calls.
+ */
+static int bench_cycle(void)
+{
+    ec_domain_state_t state;
+    unsigned int i;
+
+    ecrt_master_receive(master);
+    for (i = 0; i < domain_count; i++) {
+        ecrt_domain_process(domains[i]);
+    }
+    ecrt_domain_state(domains[0], &state);
+    for (i = 0; i < domain_count; i++) {
+        ecrt_domain_queue(domains[i]);
+    }
+    ecrt_master_application_time(master, app_time++);
+    ecrt_master_sync_slave_clocks(master);
+    return ecrt_master_send(master);
+}
+
+/****************************************************************************/
+
+/** The same cycle with two command batches.
+ */
+static int bench_cycle_batch(void)
+{
+    ec_domain_state_t state;
+    unsigned int i;
+    int ret;
+
+    ecrt_master_batch_begin(master);
+    ecrt_master_receive(master);
+    for (i = 0; i < domain_count; i++) {
+        ecrt_domain_process(domains[i]);
+    }
+    ret = ecrt_master_batch_submit(master);
+
+    ecrt_domain_state(domains[0], &state);
+
+    ecrt_master_batch_begin(master);
+    for (i = 0; i < domain_count; i++) {
+        ecrt_domain_queue(domains[i]);
+    }
+    ecrt_master_application_time(master, app_time++);
+    ecrt_master_sync_slave_clocks(master);
+    ecrt_master_send(master);
+    return ecrt_master_batch_submit(master) || ret;
+}
+
+/****************************************************************************/
+
+/** The same cycle with stored programs.
+ */
+static int bench_cycle_program(void)
+{
+    ec_domain_state_t state;
+    int ret;
+
+    ret = ecrt_master_batch_run(master, 0, app_time);
+    ecrt_domain_state(domains[0], &state);
+    return ecrt_master_batch_run(master, 1, app_time++) || ret;
+}
+
+/****************************************************************************/
+
+/** Stores the cycle of bench_cycle_batch() as programs 0 and 1.
+ */
+static int store_programs(void)
+{
+    unsigned int i;
+
+    ecrt_master_batch_begin(master);
+    ecrt_master_receive(master);
+    for (i = 0; i < domain_count; i++) {
+        ecrt_domain_process(domains[i]);
+    }
+    if (ecrt_master_batch_store(master, 0)) {
+        return -1;
+    }
+
+    ecrt_master_batch_begin(master);
+    for (i = 0; i < domain_count; i++) {
+        ecrt_domain_queue(domains[i]);
+    }
+    ecrt_master_application_time(master, 0);
+    ecrt_master_sync_slave_clocks(master);
+    ecrt_master_send(master);
+    return ecrt_master_batch_store(master, 1);
+}
+
+/*****************************************************************************
+ * Measurements.
+ ****************************************************************************/
+
+/** Measures the cost of an operation.
+ *
+ * \return 0 on success, otherwise -1.
+ */
+static int measure(const char *name, bench_func_t func,
+        unsigned int *samples)
+{
+    struct timespec start, end;
+    bench_stats_t stats;
+    unsigned long ioctls;
+    unsigned int i;
+    int err = 0;
+
+    ioctls = ec_mock_ioctl_count();
+
+    for (i = 0; i < iterations; i++) {
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        err |= func();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        samples[i] = timespec_diff_ns(&start, &end);
+    }
+
+    if (err) {
+        fprintf(stderr, "%s failed.\n", name);
+        return -1;
+    }
+
+    ioctls = ec_mock_ioctl_count() - ioctls;
+    calc_stats(samples, iterations, &stats);
+    print_stats(name, &stats, (double) ioctls / iterations);
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Runs a periodic task and measures wakeup latency and cycle time.
+ */
+static void measure_jitter(bench_func_t func, unsigned int *latency,
+        unsigned int *exec)
+{
+    struct timespec wakeup, now, end;
+    bench_stats_t stats;
+    unsigned long ioctls;
+    long long diff;
+    unsigned int i;
+
+    ioctls = ec_mock_ioctl_count();
+    clock_gettime(CLOCK_MONOTONIC, &wakeup);
+
+    for (i = 0; i < cycles; i++) {
+        wakeup.tv_nsec += period_us * 1000;
+        while (wakeup.tv_nsec >= NSEC_PER_SEC) {
+            wakeup.tv_nsec -= NSEC_PER_SEC;
+            wakeup.tv_sec++;
+        }
+
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, NULL);
+
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        func();
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        diff = timespec_diff_ns(&wakeup, &now);
+        latency[i] = diff > 0 ? diff : 0;
+        exec[i] = timespec_diff_ns(&now, &end);
+    }
+
+    ioctls = ec_mock_ioctl_count() - ioctls;
+
+    calc_stats(latency, cycles, &stats);
+    print_stats("Wakeup latency", &stats, 0.0);
+    calc_stats(exec, cycles, &stats);
+    print_stats("Cycle time", &stats, (double) ioctls / cycles);
+}
+
+/****************************************************************************/
+
+/** Creates domains, slave configurations and requests.
+ *
+ * \return 0 on success, otherwise -1.
+ */
+static int setup(void)
+{
+    ec_slave_config_t *sc;
+    unsigned int i, j;
+
+    for (i = 0; i < domain_count; i++) {
+        if (!(domains[i] = ecrt_master_create_domain(master))) {
+            return -1;
+        }
+    }
+
+    for (i = 0; i < config_count; i++) {
+        sc = ecrt_master_slave_config(master, 0, i, 0x00000002, 0x00000000);
+        if (!sc) {
+            return -1;
+        }
+
+        for (j = 0; j < domain_count; j++) {
+            if (ecrt_slave_config_reg_pdo_entry(sc, 0x7000, j + 1,
+                        domains[j], NULL) < 0) {
+                return -1;
+            }
+        }
+
+        if (!i) {
+            sdo = ecrt_slave_config_create_sdo_request(sc, 0x1018, 1, 4);
+            reg = ecrt_slave_config_create_reg_request(sc, 2);
+            if (!sdo || !reg) {
+                return -1;
+            }
+        }
+    }
+
+    return store_programs();
+}
+
+/****************************************************************************/
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS]\n"
+            "  -n <count>  Iterations per operation (default %u).\n"
+            "  -c <count>  Cycles of the periodic task (default %u).\n"
+            "  -p <us>     Period of the periodic task (default %u).\n"
+            "  -s <count>  Number of slave configurations (default %u).\n"
+            "  -d <count>  Number of domains (default %u, max. %u).\n"
+            "  -l <ns>     Emulated ioctl() latency (default 0).\n",
+            name, iterations, cycles, period_us, config_count,
+            domain_count, MAX_DOMAINS);
+}
+
+/****************************************************************************/
+
+int main(int argc, char **argv)
+{
+    static const struct {
+        const char *name;
+        bench_func_t func;
+    } benches[] = {
+        {"ecrt_master_receive()", bench_receive},
+        {"ecrt_master_send()", bench_send},
+        {"ecrt_domain_process()", bench_domain_process},
+        {"ecrt_domain_queue()", bench_domain_queue},
+        {"ecrt_domain_state()", bench_domain_state},
+        {"ecrt_master_state()", bench_master_state},
+        {"ecrt_master_application_time()", bench_app_time},
+        {"SDO request state/read", bench_sdo_request},
+        {"Register request state/read", bench_reg_request},
+        {"Cycle, single calls", bench_cycle},
+        {"Cycle, batches", bench_cycle_batch},
+        {"Cycle, stored programs", bench_cycle_program},
+        {NULL, NULL}
+    };
+    unsigned int *samples, *latency, i;
+    int c, ret = 1;
+
+    while ((c = getopt(argc, argv, "n:c:p:s:d:l:h")) != -1) {
+        switch (c) {
+            case 'n':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            case 'c':
+                cycles = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                period_us = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                config_count = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                domain_count = strtoul(optarg, NULL, 0);
+                break;
+            case 'l':
+                ec_mock_set_latency(strtoul(optarg, NULL, 0));
+                break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+
+    if (iterations < 2 || cycles < 2 || !period_us || !config_count
+            || !domain_count || domain_count > MAX_DOMAINS) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    samples = malloc(sizeof(unsigned int) * iterations);
+    latency = malloc(sizeof(unsigned int) * cycles * 2);
+    if (!samples || !latency) {
+        fprintf(stderr, "Failed to allocate memory.\n");
+        goto out_free;
+    }
+
+    master = ecrt_request_master(0);
+    if (!master) {
+        goto out_free;
+    }
+
+    if (setup() || ecrt_master_activate(master)) {
+        fprintf(stderr, "Failed to set up the master.\n");
+        goto out_release;
+    }
+
+    printf("%u slave configurations, %u domains, %u iterations.\n",
+            config_count, domain_count, iterations);
+
+    print_header("Operation");
+    for (i = 0; benches[i].name; i++) {
+        if (measure(benches[i].name, benches[i].func, samples)) {
+            goto out_release;
+        }
+    }
+
+    printf("\nPeriodic task, %u cycles with %u us:\n", cycles, period_us);
+
+    print_header("Single calls");
+    measure_jitter(bench_cycle, latency, latency + cycles);
+    print_header("Stored programs");
+    measure_jitter(bench_cycle_program, latency, latency + cycles);
+
+    ret = 0;
+
+out_release:
+    ecrt_release_master(master);
+out_free:
+    free(samples);
+    free(latency);
+    return ret;
+}
+
+/****************************************************************************/
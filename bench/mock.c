@@ -0,0 +1,583 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * Mock of the master character device.
+ *
+ * Emulates the ioctls used by libethercat for a single master: Domains and
+ * slave configurations can be created, PDO entries registered (each
+ * occupies EC_MOCK_ENTRY_SIZE bytes), the process data are mapped from
+ * anonymous memory, and SDO and register requests complete with the next
+ * ecrt_master_receive(). Master and domain states always report a working
+ * bus. Unhandled commands succeed without doing anything.
+ *
+ * Each ioctl can be delayed by a configurable latency, to emulate the cost
+ * of the system call. It is initialized from the EC_MOCK_LATENCY environment
+ * variable (in nanoseconds).
+ */
+
+/****************************************************************************/
+
+#define _GNU_SOURCE
+
+#include <dlfcn.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdarg.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+#include <unistd.h>
+
+/****************************************************************************/
+
+#include "master/ioctl.h"
+#include "mock.h"
+
+/****************************************************************************/
+
+/** Device path prefix to emulate. */
+#define EC_MOCK_DEVICE "/dev/EtherCAT"
+
+#define EC_MOCK_MAX_DOMAINS 64
+#define EC_MOCK_MAX_REQUESTS 256
+
+/** Process data size of a registered PDO entry. */
+#define EC_MOCK_ENTRY_SIZE 4
+
+#define EC_MOCK_PAGE_ALIGN(x) (((x) + 4095) & ~(size_t) 4095)
+
+/****************************************************************************/
+
+/** Emulated master.
+ */
+typedef struct {
+    int fd; /**< File descriptor, or -1. */
+    unsigned int domain_count;
+    size_t domain_size[EC_MOCK_MAX_DOMAINS];
+    unsigned int config_count;
+    unsigned int request_count;
+    ec_request_state_t request_state[EC_MOCK_MAX_REQUESTS];
+    ec_ioctl_batch_op_t
+        cycle_ops[EC_IOCTL_CYCLE_PROGRAMS][EC_IOCTL_CYCLE_MAX_OPS];
+    unsigned int cycle_count[EC_IOCTL_CYCLE_PROGRAMS];
+    unsigned int cycle_setup; /**< Cycle programs were set up. */
+    unsigned int active;
+    size_t process_data_size;
+    size_t cycle_state_offset;
+    ec_ioctl_cycle_state_t *cycle_state;
+} ec_mock_master_t;
+
+/****************************************************************************/
+
+static ec_mock_master_t mock = {.fd = -1};
+static unsigned int mock_latency;
+static unsigned long mock_ioctl_count;
+
+static int (*real_open)(const char *, int, ...);
+static int (*real_close)(int);
+static int (*real_ioctl)(int, unsigned long, ...);
+static void *(*real_mmap)(void *, size_t, int, int, int, off_t);
+
+/****************************************************************************/
+
+/** Looks up the C library functions that are replaced.
+ */
+static void ec_mock_resolve(void)
+{
+    if (real_open) {
+        return;
+    }
+
+    real_close = dlsym(RTLD_NEXT, "close");
+    real_ioctl = dlsym(RTLD_NEXT, "ioctl");
+    real_mmap = dlsym(RTLD_NEXT, "mmap");
+    real_open = dlsym(RTLD_NEXT, "open");
+}
+
+/****************************************************************************/
+
+void ec_mock_set_latency(unsigned int latency_ns)
+{
+    mock_latency = latency_ns;
+}
+
+/****************************************************************************/
+
+unsigned long ec_mock_ioctl_count(void)
+{
+    return mock_ioctl_count;
+}
+
+/****************************************************************************/
+
+/** Busy-waits for the configured latency.
+ */
+static void ec_mock_delay(void)
+{
+    struct timespec start, now;
+    long long elapsed;
+
+    if (!mock_latency) {
+        return;
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    do {
+        clock_gettime(CLOCK_MONOTONIC, &now);
+        elapsed = (now.tv_sec - start.tv_sec) * 1000000000LL
+            + now.tv_nsec - start.tv_nsec;
+    } while (elapsed < mock_latency);
+}
+
+/****************************************************************************/
+
+static int ec_mock_open(void)
+{
+    const char *latency;
+    int fd;
+
+    if (mock.fd != -1) {
+        errno = EBUSY;
+        return -1;
+    }
+
+    fd = real_open("/dev/null", O_RDWR);
+    if (fd == -1) {
+        return -1;
+    }
+
+    memset(&mock, 0, sizeof(mock));
+    mock.fd = fd;
+
+    latency = getenv("EC_MOCK_LATENCY");
+    if (latency) {
+        mock_latency = strtoul(latency, NULL, 0);
+    }
+
+    return fd;
+}
+
+/****************************************************************************/
+
+static size_t ec_mock_domain_offset(unsigned int index)
+{
+    size_t offset = 0;
+    unsigned int i;
+
+    for (i = 0; i < index; i++) {
+        offset += mock.domain_size[i];
+    }
+
+    return offset;
+}
+
+/****************************************************************************/
+
+static int ec_mock_activate(ec_ioctl_master_activate_t *io)
+{
+    io->process_data = NULL;
+    io->process_data_size = ec_mock_domain_offset(mock.domain_count);
+
+    if (mock.cycle_setup) {
+        io->cycle_state_offset = EC_MOCK_PAGE_ALIGN(io->process_data_size);
+        io->cycle_state_size = sizeof(ec_ioctl_cycle_state_t);
+        io->process_data_size = io->cycle_state_offset
+            + EC_MOCK_PAGE_ALIGN(io->cycle_state_size);
+    } else {
+        io->cycle_state_offset = 0;
+        io->cycle_state_size = 0;
+    }
+
+    mock.process_data_size = io->process_data_size;
+    mock.cycle_state_offset = io->cycle_state_offset;
+    mock.active = 1;
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Completes all pending requests, as if the answers were received.
+ */
+static int ec_mock_receive(void)
+{
+    unsigned int i;
+
+    for (i = 0; i < mock.request_count; i++) {
+        if (mock.request_state[i] == EC_REQUEST_BUSY) {
+            mock.request_state[i] = EC_REQUEST_SUCCESS;
+        }
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
+
+static int ec_mock_batch_exec(const ec_ioctl_batch_op_t *op)
+{
+    switch (op->op) {
+        case EC_BATCH_RECEIVE:
+            return ec_mock_receive();
+        case EC_BATCH_DOMAIN_PROCESS:
+        case EC_BATCH_DOMAIN_QUEUE:
+            return op->index < mock.domain_count ? 0 : -ENOENT;
+        case EC_BATCH_SEND:
+        case EC_BATCH_APP_TIME:
+        case EC_BATCH_SYNC_REF:
+        case EC_BATCH_SYNC_REF_TO:
+        case EC_BATCH_SYNC_SLAVES:
+        case EC_BATCH_SYNC_MON_QUEUE:
+            return 0;
+        default:
+            return -EINVAL;
+    }
+}
+
+/****************************************************************************/
+
+static void ec_mock_master_state(ec_master_state_t *state)
+{
+    memset(state, 0, sizeof(*state));
+    state->slaves_responding = mock.config_count;
+    state->al_states = EC_AL_STATE_OP;
+    state->link_up = 1;
+}
+
+/****************************************************************************/
+
+static void ec_mock_domain_state(ec_domain_state_t *state)
+{
+    state->working_counter = 0;
+    state->wc_state = EC_WC_COMPLETE;
+    state->redundancy_active = 0;
+}
+
+/****************************************************************************/
+
+static int ec_mock_batch(ec_ioctl_batch_t *io)
+{
+    unsigned int i;
+    int ret = 0, op_ret;
+
+    io->failed = io->count;
+
+    for (i = 0; i < io->count; i++) {
+        op_ret = ec_mock_batch_exec(&io->ops[i]);
+        if (op_ret && !ret) {
+            ret = op_ret;
+            io->failed = i;
+        }
+    }
+
+    return ret;
+}
+
+/****************************************************************************/
+
+static int ec_mock_cycle_setup(const ec_ioctl_cycle_setup_t *io)
+{
+    if (io->program >= EC_IOCTL_CYCLE_PROGRAMS
+            || io->count > EC_IOCTL_CYCLE_MAX_OPS) {
+        return -EINVAL;
+    }
+
+    if (mock.active) {
+        return -EBUSY;
+    }
+
+    memcpy(mock.cycle_ops[io->program], io->ops,
+            io->count * sizeof(ec_ioctl_batch_op_t));
+    mock.cycle_count[io->program] = io->count;
+    mock.cycle_setup = 1;
+    return 0;
+}
+
+/****************************************************************************/
+
+static int ec_mock_cycle(unsigned int program)
+{
+    ec_ioctl_cycle_state_t *state = mock.cycle_state;
+    const ec_ioctl_batch_op_t *ops;
+    unsigned int i, failed = 0;
+    int ret = 0, op_ret;
+
+    if (!state || program >= EC_IOCTL_CYCLE_PROGRAMS) {
+        return -EINVAL;
+    }
+
+    ops = mock.cycle_ops[program];
+
+    for (i = 0; i < mock.cycle_count[program]; i++) {
+        op_ret = ec_mock_batch_exec(&ops[i]);
+        if (op_ret && !ret) {
+            ret = op_ret;
+            failed = i;
+        }
+    }
+
+    __atomic_store_n(&state->sequence, state->sequence + 1,
+            __ATOMIC_RELEASE);
+
+    state->result = ret;
+    state->failed = ret ? failed : mock.cycle_count[program];
+    ec_mock_master_state(&state->master_state);
+    for (i = 0; i < mock.cycle_count[program]; i++) {
+        if (ops[i].op == EC_BATCH_DOMAIN_PROCESS
+                && ops[i].index < EC_IOCTL_CYCLE_DOMAINS) {
+            ec_mock_domain_state(&state->domain_states[ops[i].index]);
+            state->domain_mask |= 1ULL << ops[i].index;
+        }
+    }
+
+    __atomic_store_n(&state->sequence, state->sequence + 1,
+            __ATOMIC_RELEASE);
+    return ret;
+}
+
+/****************************************************************************/
+
+/** Executes an emulated ioctl.
+ *
+ * \return Non-negative result on success, otherwise a negative error code.
+ */
+static int ec_mock_ioctl(unsigned long request, unsigned long arg)
+{
+    void *data = (void *) arg;
+    unsigned int index = (unsigned int) arg;
+    int ret;
+
+    switch (request) {
+        case EC_IOCTL_MODULE:
+            {
+                ec_ioctl_module_t *io = data;
+                io->ioctl_version_magic = EC_IOCTL_VERSION_MAGIC;
+                io->master_count = 1;
+                return 0;
+            }
+        case EC_IOCTL_CREATE_DOMAIN:
+            if (mock.domain_count == EC_MOCK_MAX_DOMAINS) {
+                return -ENOMEM;
+            }
+            mock.domain_size[mock.domain_count] = 0;
+            return mock.domain_count++;
+        case EC_IOCTL_CREATE_SLAVE_CONFIG:
+            ((ec_ioctl_config_t *) data)->config_index = mock.config_count++;
+            return 0;
+        case EC_IOCTL_SC_REG_PDO_ENTRY:
+            {
+                ec_ioctl_reg_pdo_entry_t *io = data;
+                if (io->domain_index >= mock.domain_count || mock.active) {
+                    return -EINVAL;
+                }
+                io->bit_position = 0;
+                ret = mock.domain_size[io->domain_index];
+                mock.domain_size[io->domain_index] += EC_MOCK_ENTRY_SIZE;
+                return ret;
+            }
+        case EC_IOCTL_SC_SDO_REQUEST:
+        case EC_IOCTL_SC_REG_REQUEST:
+        case EC_IOCTL_SC_SOE_REQUEST:
+            if (mock.request_count == EC_MOCK_MAX_REQUESTS) {
+                return -ENOMEM;
+            }
+            index = mock.request_count++;
+            mock.request_state[index] = EC_REQUEST_UNUSED;
+            if (request == EC_IOCTL_SC_SDO_REQUEST) {
+                ((ec_ioctl_sdo_request_t *) data)->request_index = index;
+            } else if (request == EC_IOCTL_SC_REG_REQUEST) {
+                ((ec_ioctl_reg_request_t *) data)->request_index = index;
+            } else {
+                ((ec_ioctl_soe_request_t *) data)->request_index = index;
+            }
+            return 0;
+        case EC_IOCTL_SDO_REQUEST_READ:
+        case EC_IOCTL_SDO_REQUEST_WRITE:
+            index = ((ec_ioctl_sdo_request_t *) data)->request_index;
+            if (index >= mock.request_count) {
+                return -ENOENT;
+            }
+            mock.request_state[index] = EC_REQUEST_BUSY;
+            return 0;
+        case EC_IOCTL_SDO_REQUEST_STATE:
+            {
+                ec_ioctl_sdo_request_t *io = data;
+                if (io->request_index >= mock.request_count) {
+                    return -ENOENT;
+                }
+                io->state = mock.request_state[io->request_index];
+                io->size = 0;
+                return 0;
+            }
+        case EC_IOCTL_REG_REQUEST_READ:
+        case EC_IOCTL_REG_REQUEST_WRITE:
+            index = ((ec_ioctl_reg_request_t *) data)->request_index;
+            if (index >= mock.request_count) {
+                return -ENOENT;
+            }
+            mock.request_state[index] = EC_REQUEST_BUSY;
+            return 0;
+        case EC_IOCTL_REG_REQUEST_STATE:
+            {
+                ec_ioctl_reg_request_t *io = data;
+                if (io->request_index >= mock.request_count) {
+                    return -ENOENT;
+                }
+                io->state = mock.request_state[io->request_index];
+                io->new_data = 0;
+                return 0;
+            }
+        case EC_IOCTL_ACTIVATE:
+            return ec_mock_activate(data);
+        case EC_IOCTL_DEACTIVATE:
+            mock.active = 0;
+            return 0;
+        case EC_IOCTL_DOMAIN_SIZE:
+        case EC_IOCTL_DOMAIN_OFFSET:
+            if (index >= mock.domain_count) {
+                return -ENOENT;
+            }
+            if (request == EC_IOCTL_DOMAIN_SIZE) {
+                return mock.domain_size[index];
+            }
+            return ec_mock_domain_offset(index);
+        case EC_IOCTL_DOMAIN_PROCESS:
+        case EC_IOCTL_DOMAIN_QUEUE:
+            return index < mock.domain_count ? 0 : -ENOENT;
+        case EC_IOCTL_DOMAIN_STATE:
+            {
+                ec_ioctl_domain_state_t *io = data;
+                if (io->domain_index >= mock.domain_count) {
+                    return -ENOENT;
+                }
+                ec_mock_domain_state(io->state);
+                return 0;
+            }
+        case EC_IOCTL_MASTER_STATE:
+            ec_mock_master_state(data);
+            return 0;
+        case EC_IOCTL_RECEIVE:
+            return ec_mock_receive();
+        case EC_IOCTL_BATCH:
+            return ec_mock_batch(data);
+        case EC_IOCTL_CYCLE_SETUP:
+            return ec_mock_cycle_setup(data);
+        case EC_IOCTL_CYCLE:
+            return ec_mock_cycle(index);
+        default:
+            return 0;
+    }
+}
+
+/*****************************************************************************
+ * Replaced C library functions.
+ ****************************************************************************/
+
+int open(const char *path, int flags, ...)
+{
+    mode_t mode = 0;
+    va_list ap;
+
+    ec_mock_resolve();
+
+    if (!strncmp(path, EC_MOCK_DEVICE, strlen(EC_MOCK_DEVICE))) {
+        return ec_mock_open();
+    }
+
+    if (flags & (O_CREAT | O_TMPFILE)) {
+        va_start(ap, flags);
+        mode = va_arg(ap, mode_t);
+        va_end(ap);
+    }
+
+    return real_open(path, flags, mode);
+}
+
+/****************************************************************************/
+
+int close(int fd)
+{
+    ec_mock_resolve();
+
+    if (fd != -1 && fd == mock.fd) {
+        mock.fd = -1;
+    }
+
+    return real_close(fd);
+}
+
+/****************************************************************************/
+
+int ioctl(int fd, unsigned long request, ...)
+{
+    unsigned long arg;
+    va_list ap;
+    int ret;
+
+    ec_mock_resolve();
+
+    va_start(ap, request);
+    arg = va_arg(ap, unsigned long);
+    va_end(ap);
+
+    if (fd == -1 || fd != mock.fd) {
+        return real_ioctl(fd, request, arg);
+    }
+
+    mock_ioctl_count++;
+    ret = ec_mock_ioctl(request, arg);
+    ec_mock_delay();
+
+    if (ret < 0) {
+        errno = -ret;
+        return -1;
+    }
+    return ret;
+}
+
+/****************************************************************************/
+
+void *mmap(void *addr, size_t length, int prot, int flags, int fd,
+        off_t offset)
+{
+    void *mem;
+
+    ec_mock_resolve();
+
+    if (fd == -1 || fd != mock.fd) {
+        return real_mmap(addr, length, prot, flags, fd, offset);
+    }
+
+    if (offset || length > mock.process_data_size) {
+        errno = EINVAL;
+        return MAP_FAILED;
+    }
+
+    mem = real_mmap(addr, length, prot, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (mem != MAP_FAILED && mock.cycle_setup) {
+        mock.cycle_state = (ec_ioctl_cycle_state_t *)
+            ((uint8_t *) mem + mock.cycle_state_offset);
+    }
+    return mem;
+}
+
+/****************************************************************************/
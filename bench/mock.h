@@ -0,0 +1,42 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * Mock of the master character device.
+ *
+ * Linking mock.c into a program replaces open(), close(), ioctl() and mmap()
+ * for /dev/EtherCAT* devices, so that libethercat runs against an in-process
+ * emulation of the master ioctls instead of the kernel module.
+ */
+
+/****************************************************************************/
+
+#ifndef __EC_MOCK_H__
+#define __EC_MOCK_H__
+
+/****************************************************************************/
+
+void ec_mock_set_latency(unsigned int);
+unsigned long ec_mock_ioctl_count(void);
+
+/****************************************************************************/
+
+#endif
@@ -1236,6 +1236,8 @@ static int e1000_probe(struct pci_dev *pdev, const struct pci_device_id *ent)
 	adapter->ecdev_initialized = 1;
 	if (get_ecdev(adapter)) {
 		init_irq_work(&adapter->ec_watchdog_kicker, ec_kick_watchdog);
+		// the doorbell is deferred according to netdev_xmit_more()
+		ecdev_set_xmit_more(get_ecdev(adapter), 1);
 		err = ecdev_open(get_ecdev(adapter));
 		if (err) {
 			ecdev_withdraw(get_ecdev(adapter));
@@ -3362,8 +3364,10 @@ static netdev_tx_t e1000_xmit_frame(struct sk_buff *skb,
 		/* Make sure there is space in the ring for the next send. */
 		e1000_maybe_stop_tx(netdev, tx_ring, desc_needed);
 
-		if (get_ecdev(adapter) || !netdev_xmit_more() ||
-		    netif_xmit_stopped(netdev_get_tx_queue(netdev, 0))) {
+		/* EtherCAT: the master defers the doorbell until the last
+		 * frame of a cycle */
+		if (!netdev_xmit_more() || (!get_ecdev(adapter) &&
+		    netif_xmit_stopped(netdev_get_tx_queue(netdev, 0)))) {
 			writel(tx_ring->next_to_use, hw->hw_addr + tx_ring->tdt);
 		}
 	} else {
@@ -65,6 +65,7 @@ void ecdev_close(ec_device_t *device);
 void ecdev_receive(ec_device_t *device, const void *data, size_t size);
 void ecdev_set_link(ec_device_t *device, uint8_t state);
 uint8_t ecdev_get_link(const ec_device_t *device);
+void ecdev_set_xmit_more(ec_device_t *device, uint8_t enable);
 
 /****************************************************************************/
 
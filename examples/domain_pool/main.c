@@ -0,0 +1,274 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * Benchmark for parallel domain processing.
+ *
+ * Creates a number of domains filled with synthetic slave configurations
+ * and compares the time needed for processing them serially with
+ * ecrt_domain_process() and in parallel with ecrt_domain_pool_process() for
+ * increasing domain sizes. The configurations use positions that are not
+ * expected to exist on the bus, so the master can be used while the
+ * benchmark is running.
+ *
+ * As no slave answers the datagrams, the working counters stay zero and the
+ * data change detection for redundancy is not exercised. The numbers show
+ * the synchronisation overhead of the pool against the processing costs of
+ * unanswered domains; they do not tell from which size on parallel
+ * processing pays off with a real bus.
+ */
+
+/****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h> /* clock_gettime() */
+
+/****************************************************************************/
+
+#include "ecrt.h"
+
+/****************************************************************************/
+
+#define MAX_DOMAINS 32
+
+/** Number of 32 bit entries per synthetic PDO. */
+#define ENTRIES_PER_PDO 254
+
+/** First ring position used for synthetic configurations. */
+#define FIRST_POSITION 60000
+
+#define NSEC_PER_SEC (1000000000)
+
+/****************************************************************************/
+
+static unsigned int master_index = 0;
+static unsigned int domain_count = 4;
+static unsigned int worker_count = 3;
+static unsigned int iterations = 10000;
+
+static ec_pdo_entry_info_t entries[ENTRIES_PER_PDO];
+
+/****************************************************************************/
+
+static uint64_t now_ns(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * NSEC_PER_SEC + ts.tv_nsec;
+}
+
+/****************************************************************************/
+
+/** Adds synthetic configurations to a domain, until it has \a size bytes.
+ */
+static int fill_domain(ec_master_t *master, ec_domain_t *domain,
+        size_t size, unsigned int *position)
+{
+    ec_pdo_info_t pdo = {0x1600, 0, entries};
+    ec_sync_info_t syncs[] = {
+        {2, EC_DIR_OUTPUT, 1, &pdo, EC_WD_DISABLE},
+        {0xff}
+    };
+    ec_slave_config_t *sc;
+    size_t filled = 0;
+    unsigned int i;
+
+    while (filled < size) {
+        pdo.n_entries = (size - filled + 3) / 4;
+        if (pdo.n_entries > ENTRIES_PER_PDO) {
+            pdo.n_entries = ENTRIES_PER_PDO;
+        }
+
+        sc = ecrt_master_slave_config(master, 0, (*position)++, 0, 0);
+        if (!sc) {
+            return -1;
+        }
+
+        if (ecrt_slave_config_pdos(sc, EC_END, syncs)) {
+            return -1;
+        }
+
+        for (i = 0; i < pdo.n_entries; i++) {
+            if (ecrt_slave_config_reg_pdo_entry(sc, entries[i].index,
+                        entries[i].subindex, domain, NULL) < 0) {
+                return -1;
+            }
+        }
+
+        filled += pdo.n_entries * 4;
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Measures one domain size.
+ *
+ * \return 0 on success, else -1.
+ */
+static int measure(ec_master_t *master, size_t size,
+        double *serial_ns, double *pool_ns)
+{
+    ec_domain_t *domains[MAX_DOMAINS];
+    ec_domain_pool_t *pool;
+    unsigned int i, j, position = FIRST_POSITION;
+    uint64_t start, serial = 0, parallel = 0;
+
+    for (i = 0; i < domain_count; i++) {
+        domains[i] = ecrt_master_create_domain(master);
+        if (!domains[i] || fill_domain(master, domains[i], size, &position)) {
+            fprintf(stderr, "Failed to set up domain %u.\n", i);
+            return -1;
+        }
+    }
+
+    if (ecrt_master_activate(master)) {
+        return -1;
+    }
+
+    pool = ecrt_master_create_domain_pool(master, domains, domain_count,
+            worker_count, NULL);
+    if (!pool) {
+        ecrt_master_deactivate(master);
+        return -1;
+    }
+
+    for (j = 0; j < iterations; j++) {
+        ecrt_master_receive(master);
+
+        if (j % 2) {
+            start = now_ns();
+            for (i = 0; i < domain_count; i++) {
+                ecrt_domain_process(domains[i]);
+            }
+            serial += now_ns() - start;
+        } else {
+            start = now_ns();
+            ecrt_domain_pool_process(pool);
+            parallel += now_ns() - start;
+        }
+
+        for (i = 0; i < domain_count; i++) {
+            ecrt_domain_queue(domains[i]);
+        }
+        ecrt_master_send(master);
+    }
+
+    *serial_ns = (double) serial / (iterations / 2);
+    *pool_ns = (double) parallel / ((iterations + 1) / 2);
+
+    // frees the domains, the configurations and the pool
+    ecrt_master_deactivate(master);
+    return 0;
+}
+
+/****************************************************************************/
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS]\n"
+            "  -m <index>  Master index (default %u).\n"
+            "  -d <count>  Number of domains (default %u, max. %u).\n"
+            "  -w <count>  Number of worker threads (default %u).\n"
+            "  -n <count>  Iterations per domain size (default %u).\n",
+            name, master_index, domain_count, MAX_DOMAINS, worker_count,
+            iterations);
+}
+
+/****************************************************************************/
+
+int main(int argc, char **argv)
+{
+    static const size_t sizes[] = {
+        64, 256, 1024, 4096, 16384, 65536, 0
+    };
+    ec_master_t *master;
+    unsigned int i;
+    double serial_ns, pool_ns;
+    int c;
+
+    while ((c = getopt(argc, argv, "m:d:w:n:h")) != -1) {
+        switch (c) {
+            case 'm':
+                master_index = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                domain_count = strtoul(optarg, NULL, 0);
+                break;
+            case 'w':
+                worker_count = strtoul(optarg, NULL, 0);
+                break;
+            case 'n':
+                iterations = strtoul(optarg, NULL, 0);
+                break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+
+    if (!domain_count || domain_count > MAX_DOMAINS || iterations < 2) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    for (i = 0; i < ENTRIES_PER_PDO; i++) {
+        entries[i].index = 0x7000;
+        entries[i].subindex = i + 1;
+        entries[i].bit_length = 32;
+    }
+
+    master = ecrt_request_master(master_index);
+    if (!master) {
+        return 1;
+    }
+
+    printf("%u domains, %u workers, %u iterations.\n",
+            domain_count, worker_count, iterations);
+    printf("%10s %12s %12s %8s\n",
+            "Size/byte", "Serial/ns", "Pool/ns", "Speedup");
+
+    for (i = 0; sizes[i]; i++) {
+        if (measure(master, sizes[i], &serial_ns, &pool_ns)) {
+            fprintf(stderr, "Measurement failed for %zu bytes.\n",
+                    sizes[i]);
+            ecrt_release_master(master);
+            return 1;
+        }
+
+        printf("%10zu %12.0f %12.0f %8.2f\n",
+                sizes[i], serial_ns, pool_ns, serial_ns / pool_ns);
+    }
+
+    printf("Note: The domains are not matched by slaves,"
+            " so this is no measure\nfor the benefit with a real bus.\n");
+
+    ecrt_release_master(master);
+    return 0;
+}
+
+/****************************************************************************/
@@ -0,0 +1,246 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * Realtime loop and performance monitor example.
+ *
+ * Without -M, the program runs a realtime loop with the domains of the
+ * master and exports its timing statistics via shared memory. With -M, it
+ * reads the statistics of a running instance once per second and prints
+ * them.
+ */
+
+/****************************************************************************/
+
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sched.h> /* sched_setscheduler() */
+#include <sys/mman.h> /* mlockall() */
+
+/****************************************************************************/
+
+#include "ecrt.h"
+
+/****************************************************************************/
+
+static unsigned int master_index = 0;
+static unsigned int period_us = 1000;
+static unsigned int sync_ref_interval = 0;
+static const char *shm_name = "/ethercat-rt-loop";
+static int monitor = 0;
+
+static ec_rt_loop_t *loop = NULL;
+static volatile sig_atomic_t stop = 0;
+
+/****************************************************************************/
+
+static void signal_handler(int signum)
+{
+    stop = 1;
+    if (loop) {
+        ecrt_rt_loop_stop(loop);
+    }
+}
+
+/****************************************************************************/
+
+/** Application function, called once per cycle.
+ */
+static int cycle(void *data, uint64_t app_time)
+{
+    unsigned int *counter = data;
+
+    (*counter)++;
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Returns the upper limit of the bin, below which the given share of the
+ * samples lies, in microseconds.
+ */
+static unsigned int percentile(const uint32_t *hist, uint64_t count,
+        unsigned int permille)
+{
+    uint64_t sum = 0, limit = count * permille / 1000;
+    unsigned int i;
+
+    for (i = 0; i < EC_RT_LOOP_HIST_BINS; i++) {
+        sum += hist[i];
+        if (sum > limit) {
+            break;
+        }
+    }
+
+    return i + 1;
+}
+
+/****************************************************************************/
+
+static void print_row(const char *name, uint32_t min, uint32_t max,
+        const uint32_t *hist, uint64_t count)
+{
+    printf("%-10s %10u %10u %8u %8u %8u\n", name, min, max,
+            percentile(hist, count, 500), percentile(hist, count, 990),
+            percentile(hist, count, 999));
+}
+
+/****************************************************************************/
+
+static int run_monitor(void)
+{
+    ec_rt_loop_stats_t stats;
+    uint64_t count;
+    int ret;
+
+    while (!stop) {
+        ret = ecrt_rt_loop_read_stats(shm_name, &stats);
+        if (ret) {
+            fprintf(stderr, "Failed to read %s: %s\n", shm_name,
+                    strerror(-ret));
+            return 1;
+        }
+
+        count = stats.cycles ? stats.cycles : 1;
+        printf("\n%llu cycles with %u ns, %llu overruns, %llu errors.\n",
+                (unsigned long long) stats.cycles, stats.period_ns,
+                (unsigned long long) stats.overruns,
+                (unsigned long long) stats.errors);
+        printf("%-10s %10s %10s %8s %8s %8s\n",
+                "", "Min/ns", "Max/ns", "50%/us", "99%/us", "99.9%/us");
+        print_row("latency", stats.latency_min, stats.latency_max,
+                stats.latency_hist, count);
+        print_row("exec", stats.exec_min, stats.exec_max,
+                stats.exec_hist, count);
+        print_row("jitter", 0, stats.jitter_max, stats.jitter_hist,
+                count > 1 ? count - 1 : 1);
+
+        sleep(1);
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
+
+static int run_loop(void)
+{
+    struct sched_param param = {};
+    ec_master_t *master;
+    unsigned int counter = 0;
+    int ret = 1;
+
+    master = ecrt_request_master(master_index);
+    if (!master) {
+        return 1;
+    }
+
+    loop = ecrt_master_create_rt_loop(master, period_us * 1000,
+            sync_ref_interval);
+    if (!loop || ecrt_rt_loop_export(loop, shm_name)) {
+        goto out_release;
+    }
+
+    if (ecrt_master_activate(master)) {
+        goto out_release;
+    }
+
+    if (mlockall(MCL_CURRENT | MCL_FUTURE) == -1) {
+        perror("mlockall failed");
+    }
+
+    param.sched_priority = sched_get_priority_max(SCHED_FIFO);
+    if (sched_setscheduler(0, SCHED_FIFO, &param) == -1) {
+        perror("sched_setscheduler failed");
+    }
+
+    printf("Running with %u us period, statistics in %s.\n",
+            period_us, shm_name);
+
+    ret = ecrt_rt_loop_run(loop, cycle, &counter);
+    printf("Stopped after %u cycles.\n", counter);
+
+out_release:
+    ecrt_release_master(master);
+    return ret ? 1 : 0;
+}
+
+/****************************************************************************/
+
+static void usage(const char *name)
+{
+    fprintf(stderr, "Usage: %s [OPTIONS]\n"
+            "  -m <index>  Master index (default %u).\n"
+            "  -p <us>     Period (default %u).\n"
+            "  -d <count>  Cycles between reference clock synchronisations"
+            " (default %u = no DC).\n"
+            "  -s <name>   Shared memory name (default %s).\n"
+            "  -M          Monitor a running instance.\n",
+            name, master_index, period_us, sync_ref_interval, shm_name);
+}
+
+/****************************************************************************/
+
+int main(int argc, char **argv)
+{
+    struct sigaction sa = {};
+    int c;
+
+    while ((c = getopt(argc, argv, "m:p:d:s:Mh")) != -1) {
+        switch (c) {
+            case 'm':
+                master_index = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                period_us = strtoul(optarg, NULL, 0);
+                break;
+            case 'd':
+                sync_ref_interval = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                shm_name = optarg;
+                break;
+            case 'M':
+                monitor = 1;
+                break;
+            default:
+                usage(argv[0]);
+                return c == 'h' ? 0 : 1;
+        }
+    }
+
+    if (!period_us) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    sa.sa_handler = signal_handler;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+
+    return monitor ? run_monitor() : run_loop();
+}
+
+/****************************************************************************/
@@ -32,6 +32,49 @@
  * and to configure and activate the bus.
  *
  *
+ * Changes since version 1.6.0:
+ *
+ * - Added domain pools for processing multiple domains in parallel in
+ *   userspace, including the datatype ec_domain_pool_t and the methods
+ *   ecrt_master_create_domain_pool() and ecrt_domain_pool_process(). Use
+ *   EC_HAVE_DOMAIN_POOL to check for their existence.
+ * - ecrt_domain_external_memory() is now also available in userspace, where
+ *   the application memory is pinned and used by the master directly. Use
+ *   EC_HAVE_USER_DOMAIN_MEMORY to check for its existence.
+ * - Added command batches for userspace applications with
+ *   ecrt_master_batch_begin() and ecrt_master_batch_submit(), to execute
+ *   the cyclic operations with a single system call. Use EC_HAVE_BATCH to
+ *   check for their existence.
+ * - Batches can be stored in the kernel with ecrt_master_batch_store() and
+ *   run with ecrt_master_batch_run(), which publishes the master and domain
+ *   states in a shared memory area. Use EC_HAVE_BATCH_PROGRAMS to check for
+ *   their existence.
+ * - Added a realtime loop for userspace applications with timing
+ *   statistics, see ecrt_master_create_rt_loop(), ecrt_rt_loop_run() and
+ *   ecrt_rt_loop_stats(). Use EC_HAVE_RT_LOOP to check for its existence.
+ * - Added process data change tracking for userspace applications with
+ *   ecrt_domain_enable_change_tracking(), ecrt_domain_track_changes(),
+ *   ecrt_domain_export_delta() and ecrt_domain_apply_delta(). Use
+ *   EC_HAVE_DOMAIN_DELTA to check for its existence.
+ * - Added bit maps to gather single-bit PDO entries into a dense bitmap and
+ *   to scatter them back, including the datatypes ec_bit_map_t and
+ *   ec_bit_entry_t and the methods ecrt_domain_create_bit_map(),
+ *   ecrt_bit_map_gather(), ecrt_bit_map_scatter() and ecrt_bit_map_runs().
+ *   Use EC_HAVE_BIT_MAP to check for their existence.
+ * - Added ecrt_master_set_retransmission() to resend lost cyclic frames
+ *   within the same cycle. Use EC_HAVE_RETRANSMISSION to check for its
+ *   existence.
+ * - Added online reconfiguration of single slaves with
+ *   ecrt_domain_reserve(), ecrt_slave_config_release() and
+ *   ecrt_slave_config_apply(). Use EC_HAVE_ONLINE_RECONFIG to check for
+ *   their existence.
+ * - Added ecrt_slave_config_mailbox_size(), EC_MAILBOX_SIZE_MIN and
+ *   EC_MAILBOX_SIZE_MAX to enlarge the mailboxes of a slave. Use
+ *   EC_HAVE_MAILBOX_SIZE to check for their existence.
+ * - Added ecrt_sdo_request_external_memory() to transfer SDO data directly
+ *   from and to application memory. Use EC_HAVE_SDO_EXTERNAL_MEMORY to check
+ *   for its existence.
+ *
  * Changes in version 1.6.0:
  *
  * - Added the ecrt_master_scan_progress() method, the
@@ -242,6 +285,63 @@
  */
 #define EC_HAVE_STATE_TIMEOUT
 
+#ifndef __KERNEL__
+/** Defined, if the methods ecrt_master_create_domain_pool() and
+ * ecrt_domain_pool_process() and the datatype ec_domain_pool_t are
+ * available.
+ */
+#define EC_HAVE_DOMAIN_POOL
+#endif
+
+/** Defined, if ecrt_domain_external_memory() is available in userspace,
+ * too.
+ */
+#define EC_HAVE_USER_DOMAIN_MEMORY
+
+#ifndef __KERNEL__
+/** Defined, if the methods ecrt_master_batch_begin() and
+ * ecrt_master_batch_submit() are available.
+ */
+#define EC_HAVE_BATCH
+
+/** Defined, if the methods ecrt_master_batch_store() and
+ * ecrt_master_batch_run() are available.
+ */
+#define EC_HAVE_BATCH_PROGRAMS
+
+/** Defined, if the realtime loop methods and the datatypes ec_rt_loop_t and
+ * ec_rt_loop_stats_t are available.
+ */
+#define EC_HAVE_RT_LOOP
+
+/** Defined, if the process data change tracking methods are available.
+ */
+#define EC_HAVE_DOMAIN_DELTA
+
+/** Defined, if the bit map methods and the datatypes ec_bit_map_t and
+ * ec_bit_entry_t are available.
+ */
+#define EC_HAVE_BIT_MAP
+#endif
+
+/** Defined, if the methods ecrt_domain_reserve(), ecrt_slave_config_release()
+ * and ecrt_slave_config_apply() are available.
+ */
+#define EC_HAVE_ONLINE_RECONFIG
+
+/** Defined, if the method ecrt_master_set_retransmission() is available.
+ */
+#define EC_HAVE_RETRANSMISSION
+
+/** Defined, if the method ecrt_slave_config_mailbox_size(),
+ * EC_MAILBOX_SIZE_MIN and EC_MAILBOX_SIZE_MAX are available.
+ */
+#define EC_HAVE_MAILBOX_SIZE
+
+/** Defined, if the method ecrt_sdo_request_external_memory() is available.
+ */
+#define EC_HAVE_SDO_EXTERNAL_MEMORY
+
 /****************************************************************************/
 
 /** Symbol visibility control macro.
@@ -292,6 +392,21 @@
  */
 #define EC_COE_EMERGENCY_MSG_SIZE 8
 
+/** Minimum explicit mailbox size in byte.
+ *
+ * Covers the mailbox header and the largest protocol header (EoE with the
+ * Ethernet header) with some payload.
+ *
+ * \see ecrt_slave_config_mailbox_size().
+ */
+#define EC_MAILBOX_SIZE_MIN 32
+
+/** Mailbox size to request the largest safe mailbox.
+ *
+ * \see ecrt_slave_config_mailbox_size().
+ */
+#define EC_MAILBOX_SIZE_MAX 0xffff
+
 /*****************************************************************************
  * Data types
  ****************************************************************************/
@@ -305,6 +420,15 @@ typedef struct ec_slave_config ec_slave_config_t; /**< \see ec_slave_config */
 struct ec_domain;
 typedef struct ec_domain ec_domain_t; /**< \see ec_domain */
 
+struct ec_domain_pool;
+typedef struct ec_domain_pool ec_domain_pool_t; /**< \see ec_domain_pool */
+
+struct ec_rt_loop;
+typedef struct ec_rt_loop ec_rt_loop_t; /**< \see ec_rt_loop */
+
+struct ec_bit_map;
+typedef struct ec_bit_map ec_bit_map_t; /**< \see ec_bit_map */
+
 struct ec_sdo_request;
 typedef struct ec_sdo_request ec_sdo_request_t; /**< \see ec_sdo_request. */
 
@@ -619,6 +743,47 @@ typedef enum {
     EC_AL_STATE_OP = 8, /**< Operational. */
 } ec_al_state_t;
 
+/****************************************************************************/
+
+#ifndef __KERNEL__
+
+/** Number of histogram bins in ec_rt_loop_stats_t.
+ *
+ * Each bin covers one microsecond. The last bin also counts all larger
+ * values.
+ */
+#define EC_RT_LOOP_HIST_BINS 1000
+
+/** Timing statistics of a realtime loop.
+ *
+ * This is used for the output parameter of ecrt_rt_loop_stats() and
+ * ecrt_rt_loop_read_stats(). All times are in nanoseconds.
+ */
+typedef struct {
+    uint64_t cycles; /**< Number of cycles. */
+    uint64_t overruns; /**< Cycles that lasted longer than the period. */
+    uint64_t errors; /**< Cycles with a failed master or domain
+                       operation. */
+    uint32_t period_ns; /**< Nominal period. */
+    uint32_t latency_min; /**< Minimum wakeup latency. */
+    uint32_t latency_max; /**< Maximum wakeup latency. */
+    uint32_t exec_min; /**< Minimum execution time. */
+    uint32_t exec_max; /**< Maximum execution time. */
+    uint32_t jitter_max; /**< Maximum deviation from the nominal period. */
+    uint32_t latency_hist[EC_RT_LOOP_HIST_BINS]; /**< Wakeup latency. */
+    uint32_t exec_hist[EC_RT_LOOP_HIST_BINS]; /**< Execution time. */
+    uint32_t jitter_hist[EC_RT_LOOP_HIST_BINS]; /**< Period deviation. */
+} ec_rt_loop_stats_t;
+
+/** Application function of a realtime loop.
+ *
+ * Called once per cycle after the process data were received, with the
+ * application time of the cycle. A non-zero return value leaves the loop.
+ */
+typedef int (*ec_rt_loop_cycle_t)(void *data, uint64_t app_time);
+
+#endif // #ifndef __KERNEL__
+
 /*****************************************************************************
  * Global functions
  ****************************************************************************/
@@ -1070,6 +1235,14 @@ EC_PUBLIC_API int ecrt_master_activate(
  * ecrt_slave_config_create_voe_handler() are freed, so pointers to them
  * become invalid.
  *
+ * If the master module was loaded with the \a warm_restart parameter, the
+ * slaves in OP are not set back to PREOP. Instead, the master keeps
+ * exchanging the last process data with them, until the next
+ * ecrt_master_activate(). Slaves, whose configuration (including the
+ * logical addresses of their process data) is identical, are adopted by the
+ * next application without any AL state change; all others are
+ * reconfigured.
+ *
  * \apiusage{master_op,blocking}
  *
  * This method should not be called in realtime context.
@@ -1088,6 +1261,10 @@ EC_PUBLIC_API int ecrt_master_deactivate(
  * --enable-hrtimers, this is used to calculate the scheduling of the master
  * thread.
  *
+ * The value is the starting point for the measurement of the actual send
+ * interval. The amount of non-application data injected per cycle follows
+ * the measured interval and the cyclic load queued by the application.
+ *
  * \apiusage{master_idle,blocking}
  *
  * \retval 0 on success.
@@ -1098,6 +1275,38 @@ EC_PUBLIC_API int ecrt_master_set_send_interval(
         size_t send_interval /**< Send interval in us */
         );
 
+/** Configures the same-cycle retransmission of lost cyclic frames.
+ *
+ * If a process data frame gets lost (for example because of a CRC error),
+ * the domains usually report an incomplete working counter for the whole
+ * cycle. With retransmission enabled, ecrt_master_receive() resends the
+ * process data datagrams, that are still unanswered \a delay_us after they
+ * were sent, with fresh datagram indices. It then polls the devices until
+ * they are received, or until \a budget_us have elapsed. Datagrams of the
+ * master's state machines are never resent.
+ *
+ * The delay should be a bit longer than the round-trip time of the bus, so
+ * that ecrt_master_receive() has to be called at least that long after
+ * ecrt_master_send(). The budget is the time the application can spare for
+ * the recovery in its cycle. The numbers of recovered and lost datagrams are
+ * shown by the 'ethercat master' command.
+ *
+ * A budget of zero disables the retransmission (default). The settings are
+ * kept until the master is released.
+ *
+ * \apiusage{master_any,blocking}
+ *
+ * \retval 0 on success.
+ * \retval <0 Error code.
+ */
+EC_PUBLIC_API int ecrt_master_set_retransmission(
+        ec_master_t *master, /**< EtherCAT master. */
+        unsigned int delay_us, /**< Age of an unanswered datagram in us,
+                                 after which it is resent. */
+        unsigned int budget_us /**< Maximum time in us to wait for
+                                 retransmitted datagrams. */
+        );
+
 /** Sends all datagrams in the queue.
  *
  * This method takes all datagrams, that have been queued for transmission,
@@ -1132,6 +1341,93 @@ EC_PUBLIC_API int ecrt_master_receive(
         ec_master_t *master /**< EtherCAT master. */
         );
 
+#ifndef __KERNEL__
+
+/** Starts collecting cyclic operations in a command batch.
+ *
+ * Until ecrt_master_batch_submit() is called, the following methods do not
+ * call into the kernel, but only add an operation to the batch and return
+ * 0: ecrt_master_receive(), ecrt_master_send(), ecrt_domain_process(),
+ * ecrt_domain_queue(), ecrt_master_application_time(),
+ * ecrt_master_sync_reference_clock(), ecrt_master_sync_reference_clock_to(),
+ * ecrt_master_sync_slave_clocks() and ecrt_master_sync_monitor_queue().
+ *
+ * This saves one system call per operation. A typical cycle uses two
+ * batches: One with receive and domain processing before the process data
+ * are evaluated, and one with domain queueing, DC synchronisation and send
+ * afterwards.
+ *
+ * Batches must only be used from one thread at a time.
+ *
+ * \apiusage{master_op,rt_safe}
+ *
+ * \return 0 on success, -EBUSY if a batch is already being collected.
+ */
+EC_PUBLIC_API int ecrt_master_batch_begin(
+        ec_master_t *master /**< EtherCAT master. */
+        );
+
+/** Executes all operations collected since ecrt_master_batch_begin().
+ *
+ * The operations are executed in the order they were added, with a single
+ * system call. All operations are executed, even if one of them fails.
+ *
+ * \apiusage{master_op,rt_safe}
+ *
+ * \return 0 on success, otherwise the negative error code of the first
+ * failed operation.
+ */
+EC_PUBLIC_API int ecrt_master_batch_submit(
+        ec_master_t *master /**< EtherCAT master. */
+        );
+
+/** Stores the operations collected since ecrt_master_batch_begin() as a
+ * cycle program in the kernel.
+ *
+ * Instead of executing the batch, it is kept under the given program number
+ * and can be executed with ecrt_master_batch_run() in every cycle, without
+ * copying the operations again. A program can contain at most 64
+ * operations. Up to 4 programs can be stored, e. g. one for the start and
+ * one for the end of the cycle.
+ *
+ * Programs have to be stored before the master is activated. Then a cycle
+ * state area is mapped together with the process data, in which the kernel
+ * publishes the master state and the states of the processed domains after
+ * each run. While programs are run, ecrt_master_state() and
+ * ecrt_domain_state() read them from there without a system call. Be aware
+ * that they reflect the state after the last run.
+ *
+ * This is the fastest way to execute the cyclic operations, especially with
+ * RTDM, where every system call switches into the realtime driver.
+ *
+ * \apiusage{master_op,rt_unsafe}
+ *
+ * \return 0 on success, otherwise negative error code.
+ */
+EC_PUBLIC_API int ecrt_master_batch_store(
+        ec_master_t *master, /**< EtherCAT master. */
+        unsigned int program /**< Program number. */
+        );
+
+/** Runs a cycle program stored with ecrt_master_batch_store().
+ *
+ * Operations recorded from ecrt_master_application_time() and
+ * ecrt_master_sync_reference_clock_to() use \a app_time instead of the time
+ * given at recording.
+ *
+ * \apiusage{master_op,rt_safe}
+ *
+ * \return 0 on success, otherwise the negative error code of the first
+ * failed operation.
+ */
+EC_PUBLIC_API int ecrt_master_batch_run(
+        ec_master_t *master, /**< EtherCAT master. */
+        unsigned int program, /**< Program number. */
+        uint64_t app_time /**< Application time. */
+        );
+
+#endif // #ifndef __KERNEL__
+
 #ifdef __KERNEL__
 /** Sends non-application datagrams.
  *
@@ -1381,6 +1677,45 @@ EC_PUBLIC_API int ecrt_slave_config_watchdog(
                                       so the default is used. */
         );
 
+/** Configure the sizes of a slave's mailboxes.
+ *
+ * By default, the mailbox sync managers are configured with the sizes from
+ * the slave's SII. Larger mailboxes carry more payload per mailbox exchange
+ * and thus speed up segmented SDO transfers, FoE and EoE.
+ *
+ * Enlarged mailboxes are placed back to back at the default mailbox offset.
+ * If they do not fit in front of the process data sync managers and into
+ * the DPRAM of the slave, the defaults are kept. If the slave refuses the
+ * mailbox configuration when switching to PREOP, the master falls back to
+ * the defaults until the slave is scanned again.
+ *
+ * #EC_MAILBOX_SIZE_MAX requests the largest safe size: The maximum sizes
+ * from the device database (see 'ethercat esi_compile'), limited by the
+ * DPRAM layout and the maximum datagram size. Slaves without a database
+ * record keep their default sizes.
+ *
+ * Explicit sizes must be at least #EC_MAILBOX_SIZE_MIN.
+ *
+ * This method has to be called in non-realtime context before
+ * ecrt_master_activate().
+ *
+ * \apiusage{master_idle,blocking}
+ *
+ * \retval 0 Success.
+ * \retval -EINVAL A size is below #EC_MAILBOX_SIZE_MIN or exceeds the
+ *                 maximum datagram size.
+ * \retval <0 Other error code.
+ */
+EC_PUBLIC_API int ecrt_slave_config_mailbox_size(
+        ec_slave_config_t *sc, /**< Slave configuration. */
+        uint16_t rx_size, /**< Size of the receive mailbox (master to slave)
+                            in byte, zero for the default, or
+                            #EC_MAILBOX_SIZE_MAX. */
+        uint16_t tx_size /**< Size of the send mailbox (slave to master) in
+                           byte, zero for the default, or
+                           #EC_MAILBOX_SIZE_MAX. */
+        );
+
 /** Add a PDO to a sync manager's PDO assignment.
  *
  * This method has to be called in non-realtime context before
@@ -2142,6 +2477,63 @@ EC_PUBLIC_API int ecrt_slave_config_state_timeout(
         unsigned int timeout_ms /**< Timeout in [ms]. */
         );
 
+/** Releases the slave configuration of an active master.
+ *
+ * This is the first step to add, remove or replace a single slave, while
+ * all other slaves stay in OP. The slave is detached from the configuration
+ * and brought to PREOP, its FMMUs are removed from the domains and the
+ * expected working counters are adjusted. The sync manager configuration is
+ * reset to the slave's defaults and all startup SDOs and IDNs are deleted.
+ *
+ * Afterwards, the configuration can be changed with the usual methods, like
+ * ecrt_slave_config_pdos(), ecrt_slave_config_reg_pdo_entry() and
+ * ecrt_slave_config_sdo(). A registered PDO entry keeps its process data
+ * offset, as long as the data of its sync manager still fit into the former
+ * range. Otherwise it is placed in the spare process data of the domain (see
+ * ecrt_domain_reserve()), so the offsets have to be registered again. To
+ * replace the slave with one of a different type, call
+ * ecrt_master_slave_config() with the same position and the new identity
+ * and give the sync managers with ecrt_slave_config_pdos(). Finally, call
+ * ecrt_slave_config_apply().
+ *
+ * This method may be called concurrently to ecrt_domain_process() of the
+ * affected domains: It waits for a running ecrt_domain_process() call, and
+ * ecrt_domain_process() skips the data change detection for redundant
+ * links, while the FMMUs are removed.
+ *
+ * \apiusage{master_op,blocking}
+ *
+ * \retval  0 Success.
+ * \retval <0 Error code.
+ */
+EC_PUBLIC_API int ecrt_slave_config_release(
+        ec_slave_config_t *sc /**< Slave configuration. */
+        );
+
+/** Applies a changed slave configuration of an active master.
+ *
+ * The configuration is attached to the slave again, and the slave is
+ * configured and brought to OP, while all other slaves stay in OP. If the
+ * slave is not present, it is configured as soon as it appears. FMMUs, whose
+ * PDO entries were not registered again after ecrt_slave_config_release(),
+ * are dropped.
+ *
+ * Slave configurations, that are created with ecrt_master_slave_config()
+ * after the master was activated, are attached by this method, too. Before
+ * activation, this method does nothing.
+ *
+ * This method may be called concurrently to ecrt_domain_process() of the
+ * affected domains, see ecrt_slave_config_release().
+ *
+ * \apiusage{master_op,blocking}
+ *
+ * \retval  0 Success.
+ * \retval <0 Error code.
+ */
+EC_PUBLIC_API int ecrt_slave_config_apply(
+        ec_slave_config_t *sc /**< Slave configuration. */
+        );
+
 /*****************************************************************************
  * Domain methods
  ****************************************************************************/
@@ -2178,7 +2570,26 @@ EC_PUBLIC_API size_t ecrt_domain_size(
         const ec_domain_t *domain /**< Domain. */
         );
 
-#ifdef __KERNEL__
+/** Reserves spare process data in a domain.
+ *
+ * The spare process data are appended to the domain on activation and
+ * exchanged cyclically. Slave configurations, that are added or changed
+ * with ecrt_slave_config_release() and ecrt_slave_config_apply() while the
+ * master is active, map their PDOs there, so the offsets of all other slaves
+ * stay the same. The spare data are included in ecrt_domain_size().
+ *
+ * This method has to be called in non-realtime context before
+ * ecrt_master_activate().
+ *
+ * \apiusage{master_idle,blocking}
+ *
+ * \retval  0 Success.
+ * \retval <0 Error code.
+ */
+EC_PUBLIC_API int ecrt_domain_reserve(
+        ec_domain_t *domain, /**< Domain. */
+        size_t size /**< Spare process data size in bytes. */
+        );
 
 /** Provide external memory to store the domain's process data.
  *
@@ -2188,19 +2599,27 @@ EC_PUBLIC_API size_t ecrt_domain_size(
  * The size of the allocated memory must be at least ecrt_domain_size(), after
  * all PDO entries have been registered.
  *
+ * In userspace, the memory is pinned and accessed by the master directly,
+ * so the application can choose the layout of its process data, for example
+ * keep the domains in separate cache-aligned regions or in memory shared
+ * with another process. The memory must stay mapped until the master is
+ * deactivated or released. If the memory can not be used, an error is
+ * printed and the domain is placed in the process data mapping as usual, so
+ * ecrt_domain_data() shall be checked after ecrt_master_activate().
+ *
  * This method has to be called in non-realtime context before
- * ecrt_master_activate().
+ * ecrt_master_activate(). Calls after activation are rejected with an
+ * error message (in userspace, the ioctl() fails with EBUSY), and the
+ * current process data memory is kept.
  *
  * \apiusage{master_idle,blocking}
  */
-void ecrt_domain_external_memory(
+EC_PUBLIC_API void ecrt_domain_external_memory(
         ec_domain_t *domain, /**< Domain. */
         uint8_t *memory /**< Address of the memory to store the process
                           data in. */
         );
 
-#endif /* __KERNEL__ */
-
 /** Returns the domain's process data.
  *
  * - In kernel context: If external memory was provided with
@@ -2210,7 +2629,8 @@ void ecrt_domain_external_memory(
  * ecrt_master_activate().
  *
  * - In userspace context: This method has to be called after
- * ecrt_master_activate() to get the mapped domain process data memory.
+ * ecrt_master_activate() to get the mapped domain process data memory, or
+ * the memory provided with ecrt_domain_external_memory().
  *
  * \apiusage{master_op,rt_safe}
  *
@@ -2264,6 +2684,332 @@ EC_PUBLIC_API int ecrt_domain_state(
                                    information. */
         );
 
+#ifndef __KERNEL__
+
+/*****************************************************************************
+ * Domain pool methods.
+ ****************************************************************************/
+
+/** Creates a pool of worker threads for parallel domain processing.
+ *
+ * The given domains are distributed over the workers and the calling thread
+ * of ecrt_domain_pool_process(), so that each of them processes about the
+ * same amount of process data. This pays off for applications with several
+ * large domains, especially with redundancy, where ecrt_domain_process()
+ * compares the process data of both links. For small domains, the
+ * synchronisation overhead exceeds the gain; the examples/domain_pool
+ * benchmark shows this overhead for a given system.
+ *
+ * The worker threads inherit the scheduling policy and priority of the
+ * calling thread, so this should be called from the realtime thread or a
+ * thread with the same scheduling parameters.
+ *
+ * The pool is freed together with the domains, i. e. by
+ * ecrt_master_deactivate() or ecrt_release_master().
+ *
+ * This method has to be called in non-realtime context after
+ * ecrt_master_activate().
+ *
+ * \apiusage{master_op,blocking}
+ *
+ * \return Pointer to the new pool on success, else NULL.
+ */
+EC_PUBLIC_API ec_domain_pool_t *ecrt_master_create_domain_pool(
+        ec_master_t *master, /**< EtherCAT master. */
+        ec_domain_t *const *domains, /**< Domains to process, or NULL to use
+                                       all domains of the master. */
+        unsigned int domain_count, /**< Number of entries in \a domains. */
+        unsigned int worker_count, /**< Number of worker threads to create
+                                     in addition to the calling thread. */
+        const int *cpus /**< CPU to pin each worker thread to, or NULL to
+                          leave the affinity unchanged. Must have \a
+                          worker_count entries. */
+        );
+
+/** Processes all domains of a pool in parallel.
+ *
+ * Has the same effect as calling ecrt_domain_process() for each domain of
+ * the pool, but the domains are distributed over the worker threads. The
+ * method returns after all domains have been processed (completion
+ * barrier).
+ *
+ * \apiusage{master_op,rt_safe}
+ *
+ * \return 0 on success, otherwise the first negative error code returned
+ * by ecrt_domain_process().
+ */
+EC_PUBLIC_API int ecrt_domain_pool_process(
+        ec_domain_pool_t *pool /**< Domain pool. */
+        );
+
+/*****************************************************************************
+ * Process data change tracking methods.
+ ****************************************************************************/
+
+/** Size of the header of a delta record in bytes.
+ *
+ * The delta data produced by ecrt_domain_export_delta() is a sequence of
+ * records. Each record consists of the byte offset in the domain image
+ * (32 bit, little endian), the data length (16 bit, little endian) and the
+ * data itself.
+ */
+#define EC_DOMAIN_DELTA_HEADER 6
+
+/** Enables the change tracking of a domain's process data.
+ *
+ * The current image is taken as reference and all bytes are marked as
+ * changed, so that the first delta contains the whole image. Calling this
+ * again later marks all bytes as changed again, for example to send a full
+ * image to a newly connected client.
+ *
+ * This method has to be called in non-realtime context after
+ * ecrt_master_activate(). The memory is freed together with the domain.
+ *
+ * \apiusage{master_op,blocking}
+ *
+ * \return 0 on success, otherwise negative error code.
+ */
+EC_PUBLIC_API int ecrt_domain_enable_change_tracking(
+        ec_domain_t *domain /**< Domain. */
+        );
+
+/** Detects the changed bytes of a domain's process data.
+ *
+ * Compares the process data with the image of the last call and adds the
+ * changed bytes to the dirty bitmap. Call this after ecrt_domain_process()
+ * (or after ecrt_master_batch_submit(), if the domain is processed in a
+ * batch). Unchanged blocks of 64 bytes are skipped with one comparison.
+ *
+ * \apiusage{master_op,rt_safe}
+ *
+ * \return Number of bytes, that changed since the last call, otherwise
+ * negative error code.
+ */
+EC_PUBLIC_API int ecrt_domain_track_changes(
+        ec_domain_t *domain /**< Domain. */
+        );
+
+/** Exports the changed process data as delta records.
+ *
+ * Writes all bytes, that were detected as changed since the last export,
+ * to \a buffer in the format described at EC_DOMAIN_DELTA_HEADER and clears
+ * them in the dirty bitmap. Nearby changes are merged into one record, if
+ * this is shorter than a new record. If \a buffer is too small, the
+ * remaining changes are kept for the next export.
+ *
+ * The data is taken from the image of the last
+ * ecrt_domain_track_changes(), so all exported bytes belong to the same
+ * cycle. Tracking and export are not synchronised; call both from the same
+ * thread or serialise them.
+ *
+ * \apiusage{master_op,rt_safe}
+ *
+ * \return Number of bytes written to \a buffer (0 if nothing changed),
+ * otherwise negative error code.
+ */
+EC_PUBLIC_API int ecrt_domain_export_delta(
+        ec_domain_t *domain, /**< Domain. */
+        uint8_t *buffer, /**< Target buffer. */
+        size_t size /**< Size of \a buffer. */
+        );
+
+/** Applies delta records to a copy of a domain image.
+ *
+ * This is the counterpart of ecrt_domain_export_delta() for the receiving
+ * side and does not need a master.
+ *
+ * \return 0 on success, -EINVAL if the delta data is malformed or exceeds
+ * \a size.
+ */
+EC_PUBLIC_API int ecrt_domain_apply_delta(
+        uint8_t *data, /**< Domain image to update. */
+        size_t size, /**< Size of \a data. */
+        const uint8_t *delta, /**< Delta records. */
+        size_t delta_size /**< Size of \a delta. */
+        );
+
+/*****************************************************************************
+ * Bit map methods.
+ ****************************************************************************/
+
+/** Bit map entry.
+ *
+ * Position of a single-bit PDO entry in the domain image, as returned by
+ * ecrt_slave_config_reg_pdo_entry().
+ */
+typedef struct {
+    unsigned int offset; /**< Byte offset in the domain image. */
+    unsigned int bit_position; /**< Bit position (0-7) within \a offset. */
+} ec_bit_entry_t;
+
+/** Creates a bit map for single-bit PDO entries of a domain.
+ *
+ * A bit map gathers the entries into a dense bitmap, where bit \a i (bit
+ * \a i % 8 of byte \a i / 8) belongs to \a entries[i], and scatters the
+ * bitmap back into the domain image. Instead of one EC_READ_BIT() or
+ * EC_WRITE_BIT() per entry, the entries are compiled into runs of bits,
+ * that are contiguous in both the image and the bitmap. Such a run, for
+ * example the channels of adjacent digital terminals, is copied with
+ * word operations. List the entries in image order to get long runs.
+ *
+ * This method has to be called in non-realtime context after
+ * ecrt_master_activate(). The bit map is freed together with the domain.
+ *
+ * \apiusage{master_op,blocking}
+ *
+ * \return Pointer to the bit map, otherwise NULL.
+ */
+EC_PUBLIC_API ec_bit_map_t *ecrt_domain_create_bit_map(
+        ec_domain_t *domain, /**< Domain. */
+        const ec_bit_entry_t *entries, /**< Bit entries. */
+        unsigned int count /**< Number of entries. */
+        );
+
+/** Returns the number of runs, a bit map was compiled to.
+ *
+ * Each run costs roughly one bit operation per call, so this indicates the
+ * efficiency of the entry order.
+ *
+ * \apiusage{master_op,rt_safe}
+ *
+ * \return Number of runs.
+ */
+EC_PUBLIC_API unsigned int ecrt_bit_map_runs(
+        const ec_bit_map_t *map /**< Bit map. */
+        );
+
+/** Gathers the entries of a bit map into a dense bitmap.
+ *
+ * Call this after ecrt_domain_process(). Only the first \a count bits of
+ * \a bits are written.
+ *
+ * \apiusage{master_op,rt_safe}
+ */
+EC_PUBLIC_API void ecrt_bit_map_gather(
+        const ec_bit_map_t *map, /**< Bit map. */
+        uint8_t *bits /**< Bitmap with at least (count + 7) / 8 bytes. */
+        );
+
+/** Scatters a dense bitmap into the entries of a bit map.
+ *
+ * Call this before ecrt_domain_queue(). The other bits of the domain image
+ * are left untouched.
+ *
+ * \apiusage{master_op,rt_safe}
+ */
+EC_PUBLIC_API void ecrt_bit_map_scatter(
+        const ec_bit_map_t *map, /**< Bit map. */
+        const uint8_t *bits /**< Bitmap with at least (count + 7) / 8
+                              bytes. */
+        );
+
+/*****************************************************************************
+ * Realtime loop methods.
+ ****************************************************************************/
+
+/** Creates a realtime loop.
+ *
+ * The loop executes the cyclic master operations of an application with a
+ * fixed period: It sleeps until the absolute wakeup time, receives the
+ * frames, processes all domains of the master, calls the application
+ * function, queues all domains and sends the frames. With distributed
+ * clocks, it sets the application time to the wakeup time and synchronises
+ * the reference clock and the slave clocks. Cycles that last longer than
+ * the period are counted as overruns, and the missed periods are skipped.
+ *
+ * Wakeup latency, execution time and period jitter are collected in
+ * histograms, which can be read with ecrt_rt_loop_stats(), or from other
+ * processes after ecrt_rt_loop_export().
+ *
+ * The loop is freed by ecrt_release_master().
+ *
+ * \apiusage{master_op,rt_unsafe}
+ *
+ * \return Pointer to the new loop on success, else NULL.
+ */
+EC_PUBLIC_API ec_rt_loop_t *ecrt_master_create_rt_loop(
+        ec_master_t *master, /**< EtherCAT master. */
+        uint32_t period_ns, /**< Cycle period in nanoseconds. */
+        unsigned int sync_ref_interval /**< Cycles between the
+                                         synchronisations of the reference
+                                         clock, or 0 to disable the
+                                         distributed clocks handling. */
+        );
+
+/** Exports the statistics of a realtime loop via POSIX shared memory.
+ *
+ * The statistics are stored in the shared memory object \a name, which can
+ * be read by other processes with ecrt_rt_loop_read_stats(). The object is
+ * removed when the loop is freed.
+ *
+ * \apiusage{master_op,rt_unsafe}
+ *
+ * \return 0 on success, otherwise negative error code.
+ */
+EC_PUBLIC_API int ecrt_rt_loop_export(
+        ec_rt_loop_t *loop, /**< Realtime loop. */
+        const char *name /**< Shared memory name, e. g. "/ethercat-app". */
+        );
+
+/** Runs a realtime loop.
+ *
+ * Returns, when \a func returns non-zero, or after ecrt_rt_loop_stop() was
+ * called. This should be called from a thread with a realtime scheduling
+ * policy after ecrt_master_activate().
+ *
+ * Failed master and domain operations are counted in the statistics. The
+ * loop is left, if an operation fails with another error than -EAGAIN or
+ * -EINTR, e. g. because the master is no longer available.
+ *
+ * \apiusage{master_op,rt_safe}
+ *
+ * \return 0, a negative return value of \a func or the error code of a
+ * failed master or domain operation.
+ */
+EC_PUBLIC_API int ecrt_rt_loop_run(
+        ec_rt_loop_t *loop, /**< Realtime loop. */
+        ec_rt_loop_cycle_t func, /**< Application function. */
+        void *data /**< Arbitrary data passed to \a func. */
+        );
+
+/** Makes ecrt_rt_loop_run() return after the current cycle.
+ *
+ * Can be called from any thread or from a signal handler.
+ *
+ * \apiusage{master_op,rt_safe}
+ */
+EC_PUBLIC_API void ecrt_rt_loop_stop(
+        ec_rt_loop_t *loop /**< Realtime loop. */
+        );
+
+/** Reads the statistics of a realtime loop.
+ *
+ * Can be called from any thread. If \a reset is non-zero, the statistics
+ * are reset with the next cycle.
+ *
+ * \apiusage{master_op,rt_safe}
+ *
+ * \return 0 on success, otherwise negative error code.
+ */
+EC_PUBLIC_API int ecrt_rt_loop_stats(
+        ec_rt_loop_t *loop, /**< Realtime loop. */
+        ec_rt_loop_stats_t *stats, /**< Statistics. */
+        int reset /**< Reset the statistics after reading. */
+        );
+
+/** Reads the statistics of a realtime loop in another process.
+ *
+ * \see ecrt_rt_loop_export().
+ *
+ * \return 0 on success, otherwise negative error code.
+ */
+EC_PUBLIC_API int ecrt_rt_loop_read_stats(
+        const char *name, /**< Shared memory name. */
+        ec_rt_loop_stats_t *stats /**< Statistics. */
+        );
+
+#endif // #ifndef __KERNEL__
+
 /*****************************************************************************
  * SDO request methods.
  ****************************************************************************/
@@ -2309,6 +3055,35 @@ EC_PUBLIC_API int ecrt_sdo_request_timeout(
                            timeout. */
         );
 
+/** Use application memory as the SDO request's data memory.
+ *
+ * Replaces the request's internal data memory by \a size bytes at \a mem.
+ * Downloads are sent from and uploads are stored to this memory directly,
+ * so that large objects need not be copied between the master and the
+ * application. ecrt_sdo_request_data() returns \a mem afterwards, and the
+ * data size is set to \a size.
+ *
+ * In kernel space, the memory is used as it is. In userspace, the pages are
+ * pinned and accessed by the master directly.
+ *
+ * The memory has to stay valid until the request (i. e. the master) is
+ * released. Uploads exceeding \a size fail instead of re-allocating the
+ * memory, and the memory content must be considered as invalid while the
+ * request is busy.
+ *
+ * \apiusage{master_any,blocking}
+ *
+ * \retval 0 Success.
+ * \retval -EINVAL Invalid memory.
+ * \retval -EBUSY The request is being processed.
+ * \return Otherwise negative error code.
+ */
+EC_PUBLIC_API int ecrt_sdo_request_external_memory(
+        ec_sdo_request_t *req, /**< SDO request. */
+        uint8_t *mem, /**< Application memory. */
+        size_t size /**< Size of \a mem in bytes. */
+        );
+
 /** Access to the SDO request's data.
  *
  * This function returns a pointer to the request's internal SDO data memory.
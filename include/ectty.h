@@ -68,6 +68,22 @@ ec_tty_t *ectty_create(
         void *cb_data
         );
 
+/** Create a virtual TTY interface with specific buffer sizes.
+ *
+ * The sizes are rounded up to the next power of two. Zero selects the
+ * default given by the \a tx_buffer_size and \a rx_buffer_size module
+ * parameters.
+ *
+ * \return Pointer to the interface object, otherwise an ERR_PTR value.
+ */
+ec_tty_t *ectty_create_sized(
+        const ec_tty_operations_t *ops, /**< Set of callbacks. */
+        void *cb_data, /**< Arbitrary data, that is passed to any
+                         callback. */
+        unsigned int tx_size, /**< Size of the transmit buffer. */
+        unsigned int rx_size /**< Size of the receive buffer. */
+        );
+
 /*****************************************************************************
  * TTY interface methods
  ****************************************************************************/
@@ -83,6 +99,9 @@ void ectty_free(
  * If there are data to send, they are copied into the \a buffer. At maximum,
  * \a size bytes are copied. The actual number of bytes copied is returned.
  *
+ * This function is lock-free and may be called from realtime context. Writers
+ * waiting for buffer space are woken up asynchronously.
+ *
  * \return Number of bytes copied.
  */
 unsigned int ectty_tx_data(
@@ -92,6 +111,10 @@ unsigned int ectty_tx_data(
         );
 
 /** Pushes received data to the TTY interface.
+ *
+ * This function is lock-free and may be called from realtime context. The
+ * data are forwarded to the TTY layer asynchronously. Data that do not fit
+ * into the receive buffer are dropped.
  */
 void ectty_rx_data(
         ec_tty_t *tty, /**< TTY interface. */
@@ -0,0 +1,252 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT master userspace library.
+ *
+ *  The IgH EtherCAT master userspace library is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU Lesser General
+ *  Public License as published by the Free Software Foundation; version 2.1
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace library is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with the IgH EtherCAT master userspace library. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/**
+   \file
+   Gather and scatter of single-bit process data entries.
+
+   When a bit map is created, its entries are compiled into runs of bits,
+   that are contiguous both in the domain image and in the dense bitmap.
+   Byte-aligned runs are copied with memcpy(), all others in chunks of up to
+   56 bits with one 64 bit load and one read-modify-write store each.
+*/
+
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <endian.h>
+
+#include "domain.h"
+
+/****************************************************************************/
+
+/** Maximum number of bits copied at once.
+ *
+ * A chunk shifted by up to 7 bits still fits into 64 bits.
+ */
+#define EC_BIT_CHUNK 56
+
+/****************************************************************************/
+
+/** Run of contiguous bits.
+ */
+typedef struct {
+    size_t image_bit; /**< Bit offset in the domain image. */
+    size_t map_bit; /**< Bit offset in the dense bitmap. */
+    size_t length; /**< Number of bits. */
+} ec_bit_run_t;
+
+/** Bit map.
+ */
+struct ec_bit_map {
+    ec_bit_map_t *next; /**< Next bit map of the domain. */
+    ec_domain_t *domain; /**< Parent domain. */
+    unsigned int count; /**< Number of entries. */
+    unsigned int run_count; /**< Number of runs. */
+    ec_bit_run_t runs[]; /**< Compiled runs. */
+};
+
+/****************************************************************************/
+
+/** Loads up to EC_BIT_CHUNK bits from an arbitrary bit offset.
+ */
+static inline uint64_t ec_bit_load(const uint8_t *data, size_t bit,
+        unsigned int len)
+{
+    unsigned int shift = bit % 8;
+    uint64_t word = 0;
+
+    memcpy(&word, data + bit / 8, (shift + len + 7) / 8);
+    return (le64toh(word) >> shift) & ((1ULL << len) - 1);
+}
+
+/****************************************************************************/
+
+/** Stores up to EC_BIT_CHUNK bits at an arbitrary bit offset.
+ *
+ * The neighbouring bits are left untouched.
+ */
+static inline void ec_bit_store(uint8_t *data, size_t bit, unsigned int len,
+        uint64_t value)
+{
+    unsigned int shift = bit % 8, bytes = (shift + len + 7) / 8;
+    uint64_t word = 0, mask = ((1ULL << len) - 1) << shift;
+
+    memcpy(&word, data + bit / 8, bytes);
+    word = (le64toh(word) & ~mask) | (value << shift);
+    word = htole64(word);
+    memcpy(data + bit / 8, &word, bytes);
+}
+
+/****************************************************************************/
+
+/** Copies a run of bits.
+ */
+static void ec_bit_copy(uint8_t *dst, size_t dst_bit, const uint8_t *src,
+        size_t src_bit, size_t len)
+{
+    if (len == 1) {
+        uint8_t mask = 1 << (dst_bit % 8);
+
+        if (src[src_bit / 8] & (1 << (src_bit % 8))) {
+            dst[dst_bit / 8] |= mask;
+        } else {
+            dst[dst_bit / 8] &= ~mask;
+        }
+        return;
+    }
+
+    if (!(src_bit % 8) && !(dst_bit % 8) && len >= 8) {
+        size_t bytes = len / 8;
+
+        memcpy(dst + dst_bit / 8, src + src_bit / 8, bytes);
+        src_bit += bytes * 8;
+        dst_bit += bytes * 8;
+        len -= bytes * 8;
+    }
+
+    while (len) {
+        unsigned int n = len < EC_BIT_CHUNK ? len : EC_BIT_CHUNK;
+
+        ec_bit_store(dst, dst_bit, n, ec_bit_load(src, src_bit, n));
+        src_bit += n;
+        dst_bit += n;
+        len -= n;
+    }
+}
+
+/****************************************************************************/
+
+void ec_domain_clear_bit_maps(ec_domain_t *domain)
+{
+    ec_bit_map_t *map, *next;
+
+    for (map = domain->bit_maps; map; map = next) {
+        next = map->next;
+        free(map);
+    }
+    domain->bit_maps = NULL;
+}
+
+/*****************************************************************************
+ * Application interface.
+ ****************************************************************************/
+
+ec_bit_map_t *ecrt_domain_create_bit_map(ec_domain_t *domain,
+        const ec_bit_entry_t *entries, unsigned int count)
+{
+    ec_bit_map_t *map;
+    ec_bit_run_t *run = NULL;
+    unsigned int i, run_count = 0;
+    size_t size, bit, end = 0;
+
+    if (!domain->process_data) {
+        fprintf(stderr, "Bit maps need process data. Call"
+                " ecrt_master_activate() first.\n");
+        return NULL;
+    }
+
+    if (!count) {
+        fprintf(stderr, "Bit map without entries.\n");
+        return NULL;
+    }
+
+    size = ecrt_domain_size(domain);
+
+    for (i = 0; i < count; i++) {
+        if (entries[i].bit_position > 7 || entries[i].offset >= size) {
+            fprintf(stderr, "Invalid bit map entry %u: offset %u,"
+                    " bit %u.\n", i, entries[i].offset,
+                    entries[i].bit_position);
+            return NULL;
+        }
+
+        bit = (size_t) entries[i].offset * 8 + entries[i].bit_position;
+        if (!i || bit != end) {
+            run_count++;
+        }
+        end = bit + 1;
+    }
+
+    map = malloc(sizeof(ec_bit_map_t) + run_count * sizeof(ec_bit_run_t));
+    if (!map) {
+        fprintf(stderr, "Failed to allocate memory.\n");
+        return NULL;
+    }
+
+    map->domain = domain;
+    map->count = count;
+    map->run_count = 0;
+
+    for (i = 0; i < count; i++) {
+        bit = (size_t) entries[i].offset * 8 + entries[i].bit_position;
+        if (run && bit == run->image_bit + run->length) {
+            run->length++;
+            continue;
+        }
+
+        run = map->runs + map->run_count;
+        run->image_bit = bit;
+        run->map_bit = i;
+        run->length = 1;
+        map->run_count++;
+    }
+
+    map->next = domain->bit_maps;
+    domain->bit_maps = map;
+    return map;
+}
+
+/****************************************************************************/
+
+unsigned int ecrt_bit_map_runs(const ec_bit_map_t *map)
+{
+    return map->run_count;
+}
+
+/****************************************************************************/
+
+void ecrt_bit_map_gather(const ec_bit_map_t *map, uint8_t *bits)
+{
+    const uint8_t *data = map->domain->process_data;
+    const ec_bit_run_t *run;
+
+    for (run = map->runs; run < map->runs + map->run_count; run++) {
+        ec_bit_copy(bits, run->map_bit, data, run->image_bit, run->length);
+    }
+}
+
+/****************************************************************************/
+
+void ecrt_bit_map_scatter(const ec_bit_map_t *map, const uint8_t *bits)
+{
+    uint8_t *data = map->domain->process_data;
+    const ec_bit_run_t *run;
+
+    for (run = map->runs; run < map->runs + map->run_count; run++) {
+        ec_bit_copy(data, run->image_bit, bits, run->map_bit, run->length);
+    }
+}
+
+/****************************************************************************/
@@ -77,6 +77,16 @@ ec_master_t *ecrt_open_master(unsigned int master_index)
     master->process_data_size = 0;
     master->first_domain = NULL;
     master->first_config = NULL;
+    master->first_domain_pool = NULL;
+    master->first_rt_loop = NULL;
+    master->fault_check_cycles = 0;
+    master->fault_count = -1;
+    master->batching = 0;
+    master->batch_count = 0;
+    master->batch_error = 0;
+    master->batch_flushed = 0;
+    master->cycle_state = NULL;
+    master->cycle_time = 0;
 
     snprintf(path, MAX_PATH_LEN - 1,
 #if defined(USE_RTDM)
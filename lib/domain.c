@@ -28,6 +28,7 @@
 /****************************************************************************/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <string.h>
 #include <errno.h> /* ENOENT */
 
@@ -39,7 +40,9 @@
 
 void ec_domain_clear(ec_domain_t *domain)
 {
-    // nothing to do
+    free(domain->shadow);
+    free(domain->dirty);
+    ec_domain_clear_bit_maps(domain);
 }
 
 /****************************************************************************/
@@ -83,6 +86,46 @@ size_t ecrt_domain_size(const ec_domain_t *domain)
 
 /****************************************************************************/
 
+int ecrt_domain_reserve(ec_domain_t *domain, size_t size)
+{
+    ec_ioctl_domain_reserve_t io;
+    int ret;
+
+    io.domain_index = domain->index;
+    io.size = size;
+
+    ret = ioctl(domain->master->fd, EC_IOCTL_DOMAIN_RESERVE, &io);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        fprintf(stderr, "Failed to reserve spare process data: %s\n",
+                strerror(EC_IOCTL_ERRNO(ret)));
+        return -EC_IOCTL_ERRNO(ret);
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
+
+void ecrt_domain_external_memory(ec_domain_t *domain, uint8_t *mem)
+{
+    ec_ioctl_domain_memory_t io;
+    int ret;
+
+    io.domain_index = domain->index;
+    io.memory = mem;
+
+    ret = ioctl(domain->master->fd, EC_IOCTL_DOMAIN_MEMORY, &io);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        fprintf(stderr, "Failed to set external domain memory: %s\n",
+                strerror(EC_IOCTL_ERRNO(ret)));
+        return;
+    }
+
+    domain->process_data = mem;
+}
+
+/****************************************************************************/
+
 uint8_t *ecrt_domain_data(const ec_domain_t *domain)
 {
     return domain->process_data;
@@ -94,6 +137,11 @@ int ecrt_domain_process(ec_domain_t *domain)
 {
     int ret;
 
+    if (domain->master->batching) {
+        return ec_master_batch_add(domain->master, EC_BATCH_DOMAIN_PROCESS,
+                domain->index, 0);
+    }
+
     ret = ioctl(domain->master->fd, EC_IOCTL_DOMAIN_PROCESS, domain->index);
     if (EC_IOCTL_IS_ERROR(ret)) {
         return -EC_IOCTL_ERRNO(ret);
@@ -107,6 +155,11 @@ int ecrt_domain_queue(ec_domain_t *domain)
 {
     int ret;
 
+    if (domain->master->batching) {
+        return ec_master_batch_add(domain->master, EC_BATCH_DOMAIN_QUEUE,
+                domain->index, 0);
+    }
+
     ret = ioctl(domain->master->fd, EC_IOCTL_DOMAIN_QUEUE, domain->index);
     if (EC_IOCTL_IS_ERROR(ret)) {
         return -EC_IOCTL_ERRNO(ret);
@@ -121,6 +174,11 @@ int ecrt_domain_state(const ec_domain_t *domain, ec_domain_state_t *state)
     ec_ioctl_domain_state_t data;
     int ret;
 
+    if (!ec_master_cycle_state(domain->master, domain->index, NULL,
+                state)) {
+        return 0;
+    }
+
     data.domain_index = domain->index;
     data.state = state;
 
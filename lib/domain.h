@@ -29,10 +29,19 @@ struct ec_domain {
     unsigned int index;
     ec_master_t *master;
     uint8_t *process_data;
+
+    size_t tracked_size; /**< Size of the tracked image, 0 if change
+                           tracking is disabled. */
+    uint8_t *shadow; /**< Image of the last ecrt_domain_track_changes(). */
+    uint64_t *dirty; /**< One bit per byte, that changed since the last
+                       ecrt_domain_export_delta(). */
+
+    ec_bit_map_t *bit_maps; /**< Bit maps of the domain. */
 };
 
 /****************************************************************************/
 
 void ec_domain_clear(ec_domain_t *);
+void ec_domain_clear_bit_maps(ec_domain_t *);
 
 /****************************************************************************/
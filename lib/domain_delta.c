@@ -0,0 +1,271 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT master userspace library.
+ *
+ *  The IgH EtherCAT master userspace library is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU Lesser General
+ *  Public License as published by the Free Software Foundation; version 2.1
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace library is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with the IgH EtherCAT master userspace library. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/**
+   \file
+   Process data change tracking and delta export.
+
+   The dirty bitmap has one bit per process data byte. Each 64 bit word of
+   the bitmap covers one block of 64 bytes, so unchanged blocks are skipped
+   with a single (vectorized) memcmp() when tracking and with a single word
+   test when exporting.
+*/
+
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+
+#include "domain.h"
+
+/****************************************************************************/
+
+/** Number of bytes covered by one bitmap word.
+ */
+#define EC_DELTA_BLOCK 64
+
+/** Maximum length of a delta record.
+ */
+#define EC_DELTA_MAX_LENGTH 0xffff
+
+/****************************************************************************/
+
+/** Finds the next byte with the given dirty state.
+ *
+ * \return Offset of the byte, or \a size if there is none.
+ */
+static size_t ec_domain_delta_find(
+        const uint64_t *dirty, /**< Dirty bitmap. */
+        size_t size, /**< Image size. */
+        size_t pos, /**< Start offset. */
+        int state /**< Non-zero to find a dirty byte, zero for a clean
+                    one. */
+        )
+{
+    size_t word = pos / EC_DELTA_BLOCK;
+    size_t word_count = (size + EC_DELTA_BLOCK - 1) / EC_DELTA_BLOCK;
+    uint64_t bits;
+
+    if (pos >= size) {
+        return size;
+    }
+
+    bits = state ? dirty[word] : ~dirty[word];
+    bits &= ~0ULL << (pos % EC_DELTA_BLOCK);
+
+    while (!bits) {
+        if (++word >= word_count) {
+            return size;
+        }
+        bits = state ? dirty[word] : ~dirty[word];
+    }
+
+    pos = word * EC_DELTA_BLOCK + __builtin_ctzll(bits);
+    return pos < size ? pos : size;
+}
+
+/****************************************************************************/
+
+/** Marks all bytes of the image as dirty.
+ */
+static void ec_domain_delta_mark_all(ec_domain_t *domain)
+{
+    size_t size = domain->tracked_size;
+    size_t word_count = (size + EC_DELTA_BLOCK - 1) / EC_DELTA_BLOCK;
+
+    memset(domain->dirty, 0xff, word_count * sizeof(uint64_t));
+    if (size % EC_DELTA_BLOCK) {
+        domain->dirty[word_count - 1] =
+            (1ULL << (size % EC_DELTA_BLOCK)) - 1;
+    }
+}
+
+/*****************************************************************************
+ * Application interface.
+ ****************************************************************************/
+
+int ecrt_domain_enable_change_tracking(ec_domain_t *domain)
+{
+    size_t size, word_count;
+
+    if (!domain->process_data) {
+        fprintf(stderr, "Change tracking needs process data. Call"
+                " ecrt_master_activate() first.\n");
+        return -EAGAIN;
+    }
+
+    if (domain->tracked_size) {
+        // already enabled: next export shall contain the whole image
+        ec_domain_delta_mark_all(domain);
+        return 0;
+    }
+
+    size = ecrt_domain_size(domain);
+    if (!size) {
+        return -EINVAL;
+    }
+
+    word_count = (size + EC_DELTA_BLOCK - 1) / EC_DELTA_BLOCK;
+
+    domain->shadow = malloc(size);
+    domain->dirty = malloc(word_count * sizeof(uint64_t));
+    if (!domain->shadow || !domain->dirty) {
+        fprintf(stderr, "Failed to allocate memory.\n");
+        free(domain->shadow);
+        domain->shadow = NULL;
+        free(domain->dirty);
+        domain->dirty = NULL;
+        return -ENOMEM;
+    }
+
+    memcpy(domain->shadow, domain->process_data, size);
+    domain->tracked_size = size;
+    ec_domain_delta_mark_all(domain);
+    return 0;
+}
+
+/****************************************************************************/
+
+int ecrt_domain_track_changes(ec_domain_t *domain)
+{
+    const uint8_t *data = domain->process_data;
+    uint8_t *shadow = domain->shadow;
+    size_t size = domain->tracked_size, offset;
+    int changed = 0;
+
+    if (!size) {
+        return -EINVAL;
+    }
+
+    for (offset = 0; offset < size; offset += EC_DELTA_BLOCK) {
+        size_t len = size - offset, i;
+        uint64_t bits = 0;
+
+        if (len > EC_DELTA_BLOCK) {
+            len = EC_DELTA_BLOCK;
+        }
+
+        if (!memcmp(data + offset, shadow + offset, len)) {
+            continue;
+        }
+
+        for (i = 0; i < len; i++) {
+            if (data[offset + i] != shadow[offset + i]) {
+                bits |= 1ULL << i;
+            }
+        }
+
+        memcpy(shadow + offset, data + offset, len);
+        domain->dirty[offset / EC_DELTA_BLOCK] |= bits;
+        changed += __builtin_popcountll(bits);
+    }
+
+    return changed;
+}
+
+/****************************************************************************/
+
+int ecrt_domain_export_delta(ec_domain_t *domain, uint8_t *buffer,
+        size_t buffer_size)
+{
+    const uint64_t *dirty = domain->dirty;
+    size_t size = domain->tracked_size, pos, used = 0;
+
+    if (!size) {
+        return -EINVAL;
+    }
+
+    pos = ec_domain_delta_find(dirty, size, 0, 1);
+
+    while (pos < size && used + EC_DOMAIN_DELTA_HEADER < buffer_size) {
+        size_t end = ec_domain_delta_find(dirty, size, pos, 0), next, i;
+        size_t avail = buffer_size - used - EC_DOMAIN_DELTA_HEADER;
+        uint8_t *rec = buffer + used;
+
+        /* Merge the following runs, if the gap is cheaper than a new
+         * record header. */
+        while ((next = ec_domain_delta_find(dirty, size, end, 1)) < size
+                && next - end <= EC_DOMAIN_DELTA_HEADER
+                && next - pos < EC_DELTA_MAX_LENGTH) {
+            end = ec_domain_delta_find(dirty, size, next, 0);
+        }
+
+        if (end - pos > EC_DELTA_MAX_LENGTH) {
+            end = pos + EC_DELTA_MAX_LENGTH;
+        }
+        if (end - pos > avail) {
+            end = pos + avail; // the rest stays dirty
+        }
+
+        rec[0] = pos & 0xff;
+        rec[1] = (pos >> 8) & 0xff;
+        rec[2] = (pos >> 16) & 0xff;
+        rec[3] = (pos >> 24) & 0xff;
+        rec[4] = (end - pos) & 0xff;
+        rec[5] = ((end - pos) >> 8) & 0xff;
+        memcpy(rec + EC_DOMAIN_DELTA_HEADER, domain->shadow + pos, end - pos);
+        used += EC_DOMAIN_DELTA_HEADER + end - pos;
+
+        for (i = pos; i < end; i++) {
+            domain->dirty[i / EC_DELTA_BLOCK] &=
+                ~(1ULL << (i % EC_DELTA_BLOCK));
+        }
+
+        pos = ec_domain_delta_find(dirty, size, end, 1);
+    }
+
+    return used;
+}
+
+/****************************************************************************/
+
+int ecrt_domain_apply_delta(uint8_t *data, size_t size,
+        const uint8_t *delta, size_t delta_size)
+{
+    size_t pos = 0;
+
+    while (pos < delta_size) {
+        size_t offset, len;
+
+        if (delta_size - pos < EC_DOMAIN_DELTA_HEADER) {
+            return -EINVAL;
+        }
+
+        offset = delta[pos] | delta[pos + 1] << 8 | delta[pos + 2] << 16
+            | (size_t) delta[pos + 3] << 24;
+        len = delta[pos + 4] | delta[pos + 5] << 8;
+        pos += EC_DOMAIN_DELTA_HEADER;
+
+        if (len > delta_size - pos || offset > size || len > size - offset) {
+            return -EINVAL;
+        }
+
+        memcpy(data + offset, delta + pos, len);
+        pos += len;
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
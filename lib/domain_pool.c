@@ -0,0 +1,343 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT master userspace library.
+ *
+ *  The IgH EtherCAT master userspace library is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU Lesser General
+ *  Public License as published by the Free Software Foundation; version 2.1
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace library is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with the IgH EtherCAT master userspace library. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/**
+   \file
+   Parallel domain processing.
+*/
+
+/****************************************************************************/
+
+#define _GNU_SOURCE /* pthread_attr_setaffinity_np() */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+
+#include "ioctl.h"
+#include "domain_pool.h"
+#include "domain.h"
+#include "master.h"
+
+/****************************************************************************/
+
+static void ec_domain_pool_process_share(ec_domain_pool_share_t *share)
+{
+    unsigned int i;
+    int ret;
+
+    share->result = 0;
+
+    /* The ioctl() is issued directly instead of calling
+     * ecrt_domain_process(), because the workers must not add to a command
+     * batch of the calling thread. */
+    for (i = 0; i < share->domain_count; i++) {
+        ec_domain_t *domain = share->domains[i];
+        ret = ioctl(domain->master->fd, EC_IOCTL_DOMAIN_PROCESS,
+                domain->index);
+        if (EC_IOCTL_IS_ERROR(ret) && !share->result) {
+            share->result = -EC_IOCTL_ERRNO(ret);
+        }
+    }
+}
+
+/****************************************************************************/
+
+static void ec_domain_pool_wait(sem_t *sem)
+{
+    while (sem_wait(sem) && errno == EINTR) {
+        ;
+    }
+}
+
+/****************************************************************************/
+
+static void *ec_domain_pool_worker(void *arg)
+{
+    ec_domain_pool_share_t *share = arg;
+    ec_domain_pool_t *pool = share->pool;
+
+    while (1) {
+        ec_domain_pool_wait(&share->start);
+        if (pool->stop) {
+            break;
+        }
+        ec_domain_pool_process_share(share);
+        sem_post(&pool->done);
+    }
+
+    return NULL;
+}
+
+/****************************************************************************/
+
+void ec_domain_pool_clear(ec_domain_pool_t *pool)
+{
+    unsigned int i;
+
+    pool->stop = 1;
+
+    for (i = 1; i <= pool->thread_count; i++) {
+        sem_post(&pool->shares[i].start);
+        pthread_join(pool->shares[i].thread, NULL);
+    }
+
+    for (i = 0; i < pool->share_count; i++) {
+        sem_destroy(&pool->shares[i].start);
+        free(pool->shares[i].domains);
+    }
+
+    sem_destroy(&pool->done);
+    free(pool->shares);
+}
+
+/****************************************************************************/
+
+/** Distributes the domains over the shares.
+ *
+ * Greedy partitioning: Each domain, largest first, is assigned to the share
+ * with the least process data so far.
+ */
+static int ec_domain_pool_distribute(
+        ec_domain_pool_t *pool,
+        ec_domain_t *const *domains,
+        unsigned int domain_count
+        )
+{
+    size_t *sizes;
+    unsigned char *assigned;
+    unsigned int i, j, max, min;
+    ec_domain_pool_share_t *share;
+
+    sizes = malloc(domain_count * sizeof(size_t));
+    assigned = calloc(domain_count, 1);
+    if (!sizes || !assigned) {
+        free(sizes);
+        free(assigned);
+        return -ENOMEM;
+    }
+
+    for (i = 0; i < domain_count; i++) {
+        sizes[i] = ecrt_domain_size(domains[i]);
+    }
+
+    for (i = 0; i < domain_count; i++) {
+        max = domain_count;
+        for (j = 0; j < domain_count; j++) {
+            if (!assigned[j]
+                    && (max == domain_count || sizes[j] > sizes[max])) {
+                max = j;
+            }
+        }
+
+        min = 0;
+        for (j = 1; j < pool->share_count; j++) {
+            if (pool->shares[j].size < pool->shares[min].size) {
+                min = j;
+            }
+        }
+
+        share = &pool->shares[min];
+        share->domains[share->domain_count++] = domains[max];
+        share->size += sizes[max];
+        assigned[max] = 1;
+    }
+
+    free(sizes);
+    free(assigned);
+    return 0;
+}
+
+/****************************************************************************/
+
+static int ec_domain_pool_start(
+        ec_domain_pool_t *pool,
+        unsigned int index,
+        const int *cpus
+        )
+{
+    ec_domain_pool_share_t *share = &pool->shares[index];
+    pthread_attr_t attr;
+    int ret;
+
+    ret = pthread_attr_init(&attr);
+    if (ret) {
+        return -ret;
+    }
+
+    ret = pthread_attr_setinheritsched(&attr, PTHREAD_INHERIT_SCHED);
+    if (ret) {
+        goto out;
+    }
+
+    if (cpus) {
+        cpu_set_t cpuset;
+        CPU_ZERO(&cpuset);
+        CPU_SET(cpus[index - 1], &cpuset);
+        ret = pthread_attr_setaffinity_np(&attr, sizeof(cpuset), &cpuset);
+        if (ret) {
+            goto out;
+        }
+    }
+
+    ret = pthread_create(&share->thread, &attr, ec_domain_pool_worker,
+            share);
+
+out:
+    pthread_attr_destroy(&attr);
+    return -ret;
+}
+
+/****************************************************************************/
+
+ec_domain_pool_t *ecrt_master_create_domain_pool(
+        ec_master_t *master,
+        ec_domain_t *const *domains,
+        unsigned int domain_count,
+        unsigned int worker_count,
+        const int *cpus
+        )
+{
+    ec_domain_pool_t *pool, *last;
+    ec_domain_t **all = NULL, *d;
+    unsigned int i;
+    int ret;
+
+    if (!master->process_data) {
+        fprintf(stderr, "Domain pools require an activated master.\n");
+        return NULL;
+    }
+
+    if (!domains) {
+        domain_count = 0;
+        for (d = master->first_domain; d; d = d->next) {
+            domain_count++;
+        }
+        all = malloc((domain_count + 1) * sizeof(ec_domain_t *));
+        if (!all) {
+            fprintf(stderr, "Failed to allocate memory.\n");
+            return NULL;
+        }
+        i = 0;
+        for (d = master->first_domain; d; d = d->next) {
+            all[i++] = d;
+        }
+        domains = all;
+    }
+
+    pool = calloc(1, sizeof(ec_domain_pool_t));
+    if (!pool) {
+        fprintf(stderr, "Failed to allocate memory.\n");
+        free(all);
+        return NULL;
+    }
+
+    pool->master = master;
+    pool->share_count = worker_count + 1;
+    sem_init(&pool->done, 0, 0);
+
+    pool->shares = calloc(pool->share_count, sizeof(ec_domain_pool_share_t));
+    if (!pool->shares) {
+        fprintf(stderr, "Failed to allocate memory.\n");
+        sem_destroy(&pool->done);
+        free(pool);
+        free(all);
+        return NULL;
+    }
+
+    for (i = 0; i < pool->share_count; i++) {
+        pool->shares[i].pool = pool;
+        sem_init(&pool->shares[i].start, 0, 0);
+        pool->shares[i].domains =
+            malloc((domain_count + 1) * sizeof(ec_domain_t *));
+        if (!pool->shares[i].domains) {
+            fprintf(stderr, "Failed to allocate memory.\n");
+            goto out_clear;
+        }
+    }
+
+    ret = ec_domain_pool_distribute(pool, domains, domain_count);
+    if (ret) {
+        fprintf(stderr, "Failed to distribute domains: %s\n",
+                strerror(-ret));
+        goto out_clear;
+    }
+
+    for (i = 1; i < pool->share_count; i++) {
+        ret = ec_domain_pool_start(pool, i, cpus);
+        if (ret) {
+            fprintf(stderr, "Failed to start domain pool worker %u: %s\n",
+                    i - 1, strerror(-ret));
+            goto out_clear;
+        }
+        pool->thread_count++;
+    }
+
+    free(all);
+
+    if (master->first_domain_pool) {
+        last = master->first_domain_pool;
+        while (last->next) {
+            last = last->next;
+        }
+        last->next = pool;
+    } else {
+        master->first_domain_pool = pool;
+    }
+
+    return pool;
+
+out_clear:
+    ec_domain_pool_clear(pool);
+    free(pool);
+    free(all);
+    return NULL;
+}
+
+/****************************************************************************/
+
+int ecrt_domain_pool_process(ec_domain_pool_t *pool)
+{
+    unsigned int i;
+    int result;
+
+    for (i = 1; i < pool->share_count; i++) {
+        sem_post(&pool->shares[i].start);
+    }
+
+    ec_domain_pool_process_share(&pool->shares[0]);
+
+    for (i = 1; i < pool->share_count; i++) {
+        ec_domain_pool_wait(&pool->done);
+    }
+
+    result = pool->shares[0].result;
+    for (i = 1; i < pool->share_count && !result; i++) {
+        result = pool->shares[i].result;
+    }
+
+    return result;
+}
+
+/****************************************************************************/
@@ -0,0 +1,59 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT master userspace library.
+ *
+ *  The IgH EtherCAT master userspace library is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU Lesser General
+ *  Public License as published by the Free Software Foundation; version 2.1
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace library is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with the IgH EtherCAT master userspace library. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#include <pthread.h>
+#include <semaphore.h>
+
+#include "include/ecrt.h"
+
+/****************************************************************************/
+
+/** Share of a domain pool, that is processed by one thread.
+ */
+typedef struct {
+    ec_domain_pool_t *pool; /**< Parent pool. */
+    ec_domain_t **domains; /**< Domains of this share. */
+    unsigned int domain_count; /**< Number of domains. */
+    size_t size; /**< Accumulated process data size. */
+    pthread_t thread; /**< Worker thread (not used for share 0). */
+    sem_t start; /**< Posted to start processing. */
+    int result; /**< Result of the last processing. */
+} ec_domain_pool_share_t;
+
+/****************************************************************************/
+
+struct ec_domain_pool {
+    ec_domain_pool_t *next;
+    ec_master_t *master;
+    ec_domain_pool_share_t *shares; /**< Share 0 is processed by the caller
+                                      thread, the others by the workers. */
+    unsigned int share_count;
+    unsigned int thread_count; /**< Number of running worker threads. */
+    sem_t done; /**< Posted by each worker after processing. */
+    int stop;
+};
+
+/****************************************************************************/
+
+void ec_domain_pool_clear(ec_domain_pool_t *);
+
+/****************************************************************************/
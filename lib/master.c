@@ -20,20 +20,33 @@
  *
  ****************************************************************************/
 
+#define _GNU_SOURCE /* RUSAGE_THREAD */
+
 #include <unistd.h> /* close() */
 #include <stdlib.h>
 #include <stdio.h>
 #include <errno.h>
 #include <string.h>
+#include <time.h>
 #include <sys/mman.h>
+#include <sys/resource.h> /* getrusage() */
 
 #include "ioctl.h"
 #include "master.h"
 #include "domain.h"
+#include "domain_pool.h"
+#include "rt_loop.h"
 #include "slave_config.h"
 
 /****************************************************************************/
 
+/** Number of cycles after activation, in which the realtime thread is
+ * checked for page faults.
+ */
+#define EC_FAULT_CHECK_CYCLES 100
+
+/****************************************************************************/
+
 // prototypes for internal methods (avoid -Wmissing-prototype warning)
 void ec_master_clear_config(ec_master_t *);
 void ec_master_add_domain(ec_master_t *, ec_domain_t *);
@@ -56,9 +69,19 @@ int ecrt_master_reserve(ec_master_t *master)
 
 void ec_master_clear_config(ec_master_t *master)
 {
+    ec_domain_pool_t *p, *next_p;
     ec_domain_t *d, *next_d;
     ec_slave_config_t *c, *next_c;
 
+    p = master->first_domain_pool;
+    while (p) {
+        next_p = p->next;
+        ec_domain_pool_clear(p);
+        free(p);
+        p = next_p;
+    }
+    master->first_domain_pool = NULL;
+
     d = master->first_domain;
     while (d) {
         next_d = d->next;
@@ -82,14 +105,31 @@ void ec_master_clear_config(ec_master_t *master)
         master->process_data = NULL;
         master->process_data_size = 0;
     }
+    master->cycle_state = NULL;
+    master->cycle_time = 0;
+
+    master->fault_check_cycles = 0;
+    master->batching = 0;
+    master->batch_count = 0;
 }
 
 /****************************************************************************/
 
 void ec_master_clear(ec_master_t *master)
 {
+    ec_rt_loop_t *l, *next_l;
+
     ec_master_clear_config(master);
 
+    l = master->first_rt_loop;
+    while (l) {
+        next_l = l->next;
+        ec_rt_loop_clear(l);
+        free(l);
+        l = next_l;
+    }
+    master->first_rt_loop = NULL;
+
     if (master->fd != -1) {
 #if USE_RTDM
         rt_dev_close(master->fd);
@@ -140,6 +180,10 @@ ec_domain_t *ecrt_master_create_domain(ec_master_t *master)
     domain->index = (unsigned int) index;
     domain->master = master;
     domain->process_data = NULL;
+    domain->tracked_size = 0;
+    domain->shadow = NULL;
+    domain->dirty = NULL;
+    domain->bit_maps = NULL;
 
     ec_master_add_domain(master, domain);
 
@@ -556,6 +600,51 @@ int ecrt_master_read_idn(ec_master_t *master, uint16_t slave_position,
 
 /****************************************************************************/
 
+/** Returns the number of page faults of the calling thread.
+ */
+static long ec_master_thread_faults(void)
+{
+    struct rusage usage;
+
+#ifdef RUSAGE_THREAD
+    if (getrusage(RUSAGE_THREAD, &usage)) {
+#else
+    if (getrusage(RUSAGE_SELF, &usage)) {
+#endif
+        return 0;
+    }
+
+    return usage.ru_minflt + usage.ru_majflt;
+}
+
+/****************************************************************************/
+
+/** Checks, if the realtime thread takes page faults after activation.
+ *
+ * Called from ecrt_master_receive() and ecrt_master_batch_run() during the
+ * first cycles. Warns once, if the number of page faults increased between
+ * two cycles.
+ */
+static void ec_master_check_faults(ec_master_t *master)
+{
+    long faults = ec_master_thread_faults();
+
+    if (master->fault_count >= 0 && faults > master->fault_count) {
+        fprintf(stderr, "Warning: The realtime thread took %ld page faults"
+                " in cycle %u after activation. Lock the memory with"
+                " mlockall() and prefault the stack.\n",
+                faults - master->fault_count,
+                EC_FAULT_CHECK_CYCLES - master->fault_check_cycles);
+        master->fault_check_cycles = 0;
+        return;
+    }
+
+    master->fault_count = faults;
+    master->fault_check_cycles--;
+}
+
+/****************************************************************************/
+
 int ecrt_master_activate(ec_master_t *master)
 {
     ec_ioctl_master_activate_t io;
@@ -588,13 +677,42 @@ int ecrt_master_activate(ec_master_t *master)
         }
 #endif
 
-        // Access the mapped region to cause the initial page fault
-        master->process_data[0] = 0x00;
+        /* Access every page of the mapped region, in case the pages are
+         * mapped lazily, so that the realtime thread does not fault on the
+         * process data later. */
+        {
+            long page_size = sysconf(_SC_PAGESIZE);
+            volatile uint8_t *p;
+            size_t offset;
+
+            for (offset = 0; offset < master->process_data_size;
+                    offset += page_size) {
+                p = master->process_data + offset;
+                *p = *p;
+            }
+        }
+
+        if (io.cycle_state_size) {
+            master->cycle_state = (ec_ioctl_cycle_state_t *)
+                (master->process_data + io.cycle_state_offset);
+        }
     }
 
+#ifndef USE_RTDM
+    // getrusage() would cause a mode switch with a realtime co-kernel
+    master->fault_check_cycles = EC_FAULT_CHECK_CYCLES;
+    master->fault_count = -1;
+#endif
+
     // pick up process data pointers for all created domains
     ec_domain_t *domain = master->first_domain;
     while (domain) {
+        if (domain->process_data) {
+            // external memory provided by the application
+            domain = domain->next;
+            continue;
+        }
+
         int offset = ioctl(domain->master->fd, EC_IOCTL_DOMAIN_OFFSET,
                 domain->index);
         if (EC_IOCTL_IS_ERROR(offset)) {
@@ -642,10 +760,251 @@ int ecrt_master_set_send_interval(ec_master_t *master,
 
 /****************************************************************************/
 
+int ecrt_master_set_retransmission(ec_master_t *master,
+        unsigned int delay_us, unsigned int budget_us)
+{
+    ec_ioctl_retransmission_t io;
+    int ret;
+
+    io.delay = delay_us;
+    io.budget = budget_us;
+
+    ret = ioctl(master->fd, EC_IOCTL_SET_RETRANSMISSION, &io);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        fprintf(stderr, "Failed to configure retransmission: %s\n",
+                strerror(EC_IOCTL_ERRNO(ret)));
+        return -EC_IOCTL_ERRNO(ret);
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Submits the collected operations of a command batch.
+ *
+ * \return 0 on success, otherwise the negative error code of the first
+ * failed operation.
+ */
+static int ec_master_batch_flush(ec_master_t *master)
+{
+    ec_ioctl_batch_t io;
+    int ret;
+
+    if (!master->batch_count) {
+        return 0;
+    }
+
+    io.count = master->batch_count;
+    io.ops = master->batch;
+    master->batch_count = 0;
+
+    ret = ioctl(master->fd, EC_IOCTL_BATCH, &io);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        return -EC_IOCTL_ERRNO(ret);
+    }
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Adds an operation to the command batch.
+ *
+ * If the batch is full, the collected operations are submitted first.
+ *
+ * \return Always 0, errors are reported by ecrt_master_batch_submit().
+ */
+int ec_master_batch_add(ec_master_t *master, uint16_t op, uint32_t index,
+        uint64_t value)
+{
+    ec_ioctl_batch_op_t *entry;
+    int ret;
+
+    if (master->batch_count == EC_BATCH_SIZE) {
+        master->batch_flushed = 1;
+        ret = ec_master_batch_flush(master);
+        if (ret && !master->batch_error) {
+            master->batch_error = ret;
+        }
+    }
+
+    entry = &master->batch[master->batch_count++];
+    entry->op = op;
+    entry->reserved = 0;
+    entry->index = index;
+    entry->value = value;
+    return 0;
+}
+
+/****************************************************************************/
+
+int ecrt_master_batch_begin(ec_master_t *master)
+{
+    if (master->batching) {
+        return -EBUSY;
+    }
+
+    master->batching = 1;
+    master->batch_count = 0;
+    master->batch_error = 0;
+    master->batch_flushed = 0;
+    return 0;
+}
+
+/****************************************************************************/
+
+int ecrt_master_batch_submit(ec_master_t *master)
+{
+    int ret;
+
+    if (!master->batching) {
+        return -EINVAL;
+    }
+
+    ret = ec_master_batch_flush(master);
+    if (master->batch_error) {
+        ret = master->batch_error;
+    }
+
+    master->batching = 0;
+    master->batch_error = 0;
+    return ret;
+}
+
+/****************************************************************************/
+
+int ecrt_master_batch_store(ec_master_t *master, unsigned int program)
+{
+    ec_ioctl_cycle_setup_t io;
+    int ret;
+
+    if (!master->batching) {
+        return -EINVAL;
+    }
+
+    master->batching = 0;
+
+    if (master->batch_flushed) {
+        fprintf(stderr, "Failed to store batch: More than %u operations.\n",
+                EC_BATCH_SIZE);
+        return -EOVERFLOW;
+    }
+
+    io.program = program;
+    io.count = master->batch_count;
+    io.ops = master->batch;
+    master->batch_count = 0;
+
+    ret = ioctl(master->fd, EC_IOCTL_CYCLE_SETUP, &io);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        fprintf(stderr, "Failed to store batch: %s\n",
+                strerror(EC_IOCTL_ERRNO(ret)));
+        return -EC_IOCTL_ERRNO(ret);
+    }
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Reads the monotonic clock.
+ *
+ * \return Time in nanoseconds.
+ */
+static uint64_t ec_master_monotonic_time(void)
+{
+    struct timespec ts;
+
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t) ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+/****************************************************************************/
+
+int ecrt_master_batch_run(ec_master_t *master, unsigned int program,
+        uint64_t app_time)
+{
+    int ret;
+
+    if (master->fault_check_cycles) {
+        ec_master_check_faults(master);
+    }
+
+    if (master->cycle_state) {
+        master->cycle_state->app_time = app_time;
+    }
+
+    ret = ioctl(master->fd, EC_IOCTL_CYCLE, program);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        return -EC_IOCTL_ERRNO(ret);
+    }
+
+    if (master->cycle_state) {
+        master->cycle_time = ec_master_monotonic_time();
+    }
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Reads states from the cycle state area.
+ *
+ * Does not wait for the kernel, if it is just updating the area. The states
+ * are only used, if the last cycle program succeeded and ran less than
+ * #EC_CYCLE_STATE_MAX_AGE ago, so that an application, that stopped cycling,
+ * does not read outdated states.
+ *
+ * \return 0 on success, -EAGAIN if the states are not available and have to
+ * be queried via ioctl().
+ */
+int ec_master_cycle_state(
+        const ec_master_t *master, /**< EtherCAT master. */
+        unsigned int domain_index, /**< Index of the domain to read. */
+        ec_master_state_t *master_state, /**< Master state, or NULL. */
+        ec_domain_state_t *domain_state /**< Domain state, or NULL. */
+        )
+{
+    ec_ioctl_cycle_state_t *s = master->cycle_state;
+    uint32_t sequence;
+
+    if (!s || !master->cycle_time || ec_master_monotonic_time()
+            - master->cycle_time > EC_CYCLE_STATE_MAX_AGE) {
+        return -EAGAIN;
+    }
+
+    sequence = __atomic_load_n(&s->sequence, __ATOMIC_ACQUIRE);
+    if (!sequence || sequence & 1 || s->result) {
+        return -EAGAIN;
+    }
+
+    if (master_state) {
+        *master_state = s->master_state;
+    }
+
+    if (domain_state) {
+        if (domain_index >= EC_IOCTL_CYCLE_DOMAINS
+                || !(s->domain_mask & (1ULL << domain_index))) {
+            return -EAGAIN;
+        }
+        *domain_state = s->domain_states[domain_index];
+    }
+
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+    if (__atomic_load_n(&s->sequence, __ATOMIC_RELAXED) != sequence) {
+        return -EAGAIN;
+    }
+    return 0;
+}
+
+/****************************************************************************/
+
 int ecrt_master_send(ec_master_t *master)
 {
     int ret;
 
+    if (master->batching) {
+        return ec_master_batch_add(master, EC_BATCH_SEND, 0, 0);
+    }
+
     ret = ioctl(master->fd, EC_IOCTL_SEND, NULL);
     if (EC_IOCTL_IS_ERROR(ret)) {
         return -EC_IOCTL_ERRNO(ret);
@@ -659,6 +1018,14 @@ int ecrt_master_receive(ec_master_t *master)
 {
     int ret;
 
+    if (master->fault_check_cycles) {
+        ec_master_check_faults(master);
+    }
+
+    if (master->batching) {
+        return ec_master_batch_add(master, EC_BATCH_RECEIVE, 0, 0);
+    }
+
     ret = ioctl(master->fd, EC_IOCTL_RECEIVE, NULL);
     if (EC_IOCTL_IS_ERROR(ret)) {
         return -EC_IOCTL_ERRNO(ret);
@@ -672,6 +1039,10 @@ int ecrt_master_state(const ec_master_t *master, ec_master_state_t *state)
 {
     int ret;
 
+    if (!ec_master_cycle_state(master, 0, state, NULL)) {
+        return 0;
+    }
+
     ret = ioctl(master->fd, EC_IOCTL_MASTER_STATE, state);
     if (EC_IOCTL_IS_ERROR(ret)) {
         return -EC_IOCTL_ERRNO(ret);
@@ -707,6 +1078,10 @@ int ecrt_master_application_time(ec_master_t *master, uint64_t app_time)
     uint64_t time;
     int ret;
 
+    if (master->batching) {
+        return ec_master_batch_add(master, EC_BATCH_APP_TIME, 0, app_time);
+    }
+
     time = app_time;
 
     ret = ioctl(master->fd, EC_IOCTL_APP_TIME, &time);
@@ -722,6 +1097,10 @@ int ecrt_master_sync_reference_clock(ec_master_t *master)
 {
     int ret;
 
+    if (master->batching) {
+        return ec_master_batch_add(master, EC_BATCH_SYNC_REF, 0, 0);
+    }
+
     ret = ioctl(master->fd, EC_IOCTL_SYNC_REF, NULL);
     if (EC_IOCTL_IS_ERROR(ret)) {
         return -EC_IOCTL_ERRNO(ret);
@@ -737,6 +1116,11 @@ int ecrt_master_sync_reference_clock_to(ec_master_t *master,
     uint64_t time;
     int ret;
 
+    if (master->batching) {
+        return ec_master_batch_add(master, EC_BATCH_SYNC_REF_TO, 0,
+                sync_time);
+    }
+
     time = sync_time;
 
     ret = ioctl(master->fd, EC_IOCTL_SYNC_REF_TO, &time);
@@ -752,6 +1136,10 @@ int ecrt_master_sync_slave_clocks(ec_master_t *master)
 {
     int ret;
 
+    if (master->batching) {
+        return ec_master_batch_add(master, EC_BATCH_SYNC_SLAVES, 0, 0);
+    }
+
     ret = ioctl(master->fd, EC_IOCTL_SYNC_SLAVES, NULL);
     if (EC_IOCTL_IS_ERROR(ret)) {
         return -EC_IOCTL_ERRNO(ret);
@@ -782,6 +1170,10 @@ int ecrt_master_sync_monitor_queue(ec_master_t *master)
 {
     int ret;
 
+    if (master->batching) {
+        return ec_master_batch_add(master, EC_BATCH_SYNC_MON_QUEUE, 0, 0);
+    }
+
     ret = ioctl(master->fd, EC_IOCTL_SYNC_MON_QUEUE, NULL);
     if (EC_IOCTL_IS_ERROR(ret)) {
         return -EC_IOCTL_ERRNO(ret);
@@ -20,7 +20,22 @@
  *
  ****************************************************************************/
 
+#include <stdint.h>
+
 #include "include/ecrt.h"
+#include "ioctl.h"
+
+/****************************************************************************/
+
+/** Maximum number of operations in a command batch, before it is submitted
+ * automatically. This is also the limit for stored batches.
+ */
+#define EC_BATCH_SIZE EC_IOCTL_CYCLE_MAX_OPS
+
+/** Maximum age of the states in the cycle state area in nanoseconds. Older
+ * states are queried via ioctl().
+ */
+#define EC_CYCLE_STATE_MAX_AGE 10000000
 
 /****************************************************************************/
 
@@ -31,10 +46,29 @@ struct ec_master {
 
     ec_domain_t *first_domain;
     ec_slave_config_t *first_config;
+    ec_domain_pool_t *first_domain_pool;
+    ec_rt_loop_t *first_rt_loop;
+
+    unsigned int fault_check_cycles; /**< Remaining cycles to check for
+                                       page faults. */
+    long fault_count; /**< Page faults of the realtime thread. */
+
+    int batching; /**< Cyclic operations are collected in \a batch. */
+    ec_ioctl_batch_op_t batch[EC_BATCH_SIZE]; /**< Command batch. */
+    unsigned int batch_count; /**< Number of operations in \a batch. */
+    int batch_error; /**< Error of an automatic submission. */
+    int batch_flushed; /**< The batch was submitted automatically. */
+
+    ec_ioctl_cycle_state_t *cycle_state; /**< Cycle state area, or NULL. */
+    uint64_t cycle_time; /**< Monotonic time of the last successful cycle
+                           program run in nanoseconds. */
 };
 
 /****************************************************************************/
 
 void ec_master_clear(ec_master_t *);
+int ec_master_batch_add(ec_master_t *, uint16_t, uint32_t, uint64_t);
+int ec_master_cycle_state(const ec_master_t *, unsigned int,
+        ec_master_state_t *, ec_domain_state_t *);
 
 /****************************************************************************/
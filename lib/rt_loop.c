@@ -0,0 +1,456 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT master userspace library.
+ *
+ *  The IgH EtherCAT master userspace library is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU Lesser General
+ *  Public License as published by the Free Software Foundation; version 2.1
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace library is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with the IgH EtherCAT master userspace library. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+/**
+   \file
+   Realtime loop with timing statistics.
+*/
+
+/****************************************************************************/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "rt_loop.h"
+#include "domain.h"
+#include "master.h"
+
+/****************************************************************************/
+
+#define NSEC_PER_SEC 1000000000LL
+
+#define TIMESPEC2NS(T) ((uint64_t) (T).tv_sec * NSEC_PER_SEC + (T).tv_nsec)
+
+/** Maximum attempts to read consistent statistics. */
+#define EC_RT_LOOP_READ_RETRIES 1000
+
+/****************************************************************************/
+
+void ec_rt_loop_clear(ec_rt_loop_t *loop)
+{
+    if (loop->shm_name) {
+        munmap(loop->shared, sizeof(ec_rt_loop_shared_t));
+        shm_unlink(loop->shm_name);
+        free(loop->shm_name);
+    } else {
+        free(loop->shared);
+    }
+}
+
+/****************************************************************************/
+
+static void ec_rt_loop_reset(ec_rt_loop_stats_t *stats, uint32_t period_ns)
+{
+    memset(stats, 0, sizeof(*stats));
+    stats->period_ns = period_ns;
+    stats->latency_min = 0xffffffff;
+    stats->exec_min = 0xffffffff;
+}
+
+/****************************************************************************/
+
+/** Adds a sample to a histogram with 1 us bins.
+ */
+static void ec_rt_loop_hist_add(uint32_t *hist, uint32_t ns)
+{
+    uint32_t bin = ns / 1000;
+
+    hist[bin < EC_RT_LOOP_HIST_BINS ? bin : EC_RT_LOOP_HIST_BINS - 1]++;
+}
+
+/****************************************************************************/
+
+/** Copies statistics consistently.
+ *
+ * \return 0 on success, -EAGAIN if the statistics are permanently updated.
+ */
+static int ec_rt_loop_copy(const ec_rt_loop_shared_t *shared,
+        ec_rt_loop_stats_t *stats)
+{
+    uint32_t sequence;
+    unsigned int i;
+
+    for (i = 0; i < EC_RT_LOOP_READ_RETRIES; i++) {
+        sequence = __atomic_load_n(&shared->sequence, __ATOMIC_ACQUIRE);
+        if (sequence & 1) {
+            continue;
+        }
+
+        memcpy(stats, &shared->stats, sizeof(*stats));
+
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+        if (__atomic_load_n(&shared->sequence, __ATOMIC_RELAXED)
+                == sequence) {
+            return 0;
+        }
+    }
+
+    return -EAGAIN;
+}
+
+/****************************************************************************/
+
+/** Checks, if a failed operation ends the loop.
+ *
+ * -EAGAIN and -EINTR only affect the current cycle. Other errors mean, that
+ * the master can not be used any more.
+ */
+static int ec_rt_loop_fatal(int error)
+{
+    return error && error != -EAGAIN && error != -EINTR;
+}
+
+/****************************************************************************/
+
+/** Executes the cyclic master operations around the application callback.
+ *
+ * The first error of the master and domain operations is stored in \a
+ * error. The callback is not called, if receiving the process data failed
+ * fatally.
+ *
+ * \return Return value of the callback.
+ */
+static int ec_rt_loop_cycle(ec_rt_loop_t *loop, unsigned int cycle,
+        uint64_t app_time, ec_rt_loop_cycle_t func, void *data, int *error)
+{
+    ec_master_t *master = loop->master;
+    ec_domain_t *domain;
+    struct timespec now;
+    int ret, err;
+
+    if (loop->sync_ref_interval) {
+        ecrt_master_application_time(master, app_time);
+    }
+
+    *error = ecrt_master_receive(master);
+    for (domain = master->first_domain; domain; domain = domain->next) {
+        err = ecrt_domain_process(domain);
+        if (!*error) {
+            *error = err;
+        }
+    }
+
+    if (ec_rt_loop_fatal(*error)) {
+        return 0;
+    }
+
+    ret = func(data, app_time);
+
+    if (loop->sync_ref_interval) {
+        if (cycle % loop->sync_ref_interval == 0) {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            ecrt_master_sync_reference_clock_to(master, TIMESPEC2NS(now));
+        }
+        ecrt_master_sync_slave_clocks(master);
+    }
+
+    for (domain = master->first_domain; domain; domain = domain->next) {
+        ecrt_domain_queue(domain);
+    }
+    err = ecrt_master_send(master);
+    if (!*error) {
+        *error = err;
+    }
+
+    return ret;
+}
+
+/****************************************************************************/
+
+/** Adds the timing of a cycle to the statistics.
+ */
+static void ec_rt_loop_account(ec_rt_loop_t *loop, uint32_t latency,
+        uint32_t exec, int64_t period, int overrun, int error)
+{
+    ec_rt_loop_shared_t *shared = loop->shared;
+    ec_rt_loop_stats_t *stats = &shared->stats;
+    uint32_t jitter;
+
+    __atomic_store_n(&shared->sequence, shared->sequence + 1,
+            __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    if (__atomic_exchange_n(&loop->reset, 0, __ATOMIC_ACQUIRE)) {
+        ec_rt_loop_reset(stats, loop->period_ns);
+    }
+
+    if (latency < stats->latency_min) {
+        stats->latency_min = latency;
+    }
+    if (latency > stats->latency_max) {
+        stats->latency_max = latency;
+    }
+    ec_rt_loop_hist_add(stats->latency_hist, latency);
+
+    if (exec < stats->exec_min) {
+        stats->exec_min = exec;
+    }
+    if (exec > stats->exec_max) {
+        stats->exec_max = exec;
+    }
+    ec_rt_loop_hist_add(stats->exec_hist, exec);
+
+    if (period >= 0) {
+        period -= loop->period_ns;
+        jitter = period < 0 ? -period : period;
+        if (jitter > stats->jitter_max) {
+            stats->jitter_max = jitter;
+        }
+        ec_rt_loop_hist_add(stats->jitter_hist, jitter);
+    }
+
+    stats->cycles++;
+    if (overrun) {
+        stats->overruns++;
+    }
+    if (error) {
+        stats->errors++;
+    }
+
+    __atomic_store_n(&shared->sequence, shared->sequence + 1,
+            __ATOMIC_RELEASE);
+}
+
+/*****************************************************************************
+ * Application interface.
+ ****************************************************************************/
+
+ec_rt_loop_t *ecrt_master_create_rt_loop(ec_master_t *master,
+        uint32_t period_ns, unsigned int sync_ref_interval)
+{
+    ec_rt_loop_t *loop, *last;
+
+    if (!period_ns) {
+        fprintf(stderr, "Invalid realtime loop period.\n");
+        return NULL;
+    }
+
+    loop = calloc(1, sizeof(ec_rt_loop_t));
+    if (!loop) {
+        fprintf(stderr, "Failed to allocate memory.\n");
+        return NULL;
+    }
+
+    loop->shared = calloc(1, sizeof(ec_rt_loop_shared_t));
+    if (!loop->shared) {
+        fprintf(stderr, "Failed to allocate memory.\n");
+        free(loop);
+        return NULL;
+    }
+
+    loop->master = master;
+    loop->period_ns = period_ns;
+    loop->sync_ref_interval = sync_ref_interval;
+    loop->shared->magic = EC_RT_LOOP_MAGIC;
+    ec_rt_loop_reset(&loop->shared->stats, period_ns);
+
+    if (master->first_rt_loop) {
+        last = master->first_rt_loop;
+        while (last->next) {
+            last = last->next;
+        }
+        last->next = loop;
+    } else {
+        master->first_rt_loop = loop;
+    }
+
+    return loop;
+}
+
+/****************************************************************************/
+
+int ecrt_rt_loop_export(ec_rt_loop_t *loop, const char *name)
+{
+    ec_rt_loop_shared_t *shared;
+    int fd, ret;
+
+    if (loop->shm_name) {
+        return -EBUSY;
+    }
+
+    fd = shm_open(name, O_RDWR | O_CREAT | O_TRUNC, 0644);
+    if (fd == -1) {
+        ret = -errno;
+        fprintf(stderr, "Failed to create shared memory %s: %s\n",
+                name, strerror(errno));
+        return ret;
+    }
+
+    if (ftruncate(fd, sizeof(ec_rt_loop_shared_t))) {
+        ret = -errno;
+        fprintf(stderr, "Failed to size shared memory %s: %s\n",
+                name, strerror(errno));
+        goto out_unlink;
+    }
+
+    shared = mmap(NULL, sizeof(ec_rt_loop_shared_t),
+            PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (shared == MAP_FAILED) {
+        ret = -errno;
+        fprintf(stderr, "Failed to map shared memory %s: %s\n",
+                name, strerror(errno));
+        goto out_unlink;
+    }
+
+    loop->shm_name = strdup(name);
+    if (!loop->shm_name) {
+        ret = -ENOMEM;
+        munmap(shared, sizeof(ec_rt_loop_shared_t));
+        goto out_unlink;
+    }
+
+    close(fd);
+
+    // take over the statistics collected so far
+    memcpy(shared, loop->shared, sizeof(ec_rt_loop_shared_t));
+    free(loop->shared);
+    loop->shared = shared;
+    return 0;
+
+out_unlink:
+    close(fd);
+    shm_unlink(name);
+    return ret;
+}
+
+/****************************************************************************/
+
+int ecrt_rt_loop_run(ec_rt_loop_t *loop, ec_rt_loop_cycle_t func,
+        void *data)
+{
+    struct timespec wakeup, start, end;
+    uint64_t wakeup_ns, start_ns, end_ns, last_start_ns = 0;
+    unsigned int cycle = 0;
+    uint32_t latency;
+    int ret = 0, overrun, error;
+
+    __atomic_store_n(&loop->stop, 0, __ATOMIC_RELAXED);
+
+    clock_gettime(CLOCK_MONOTONIC, &wakeup);
+    wakeup_ns = TIMESPEC2NS(wakeup);
+
+    while (!__atomic_load_n(&loop->stop, __ATOMIC_RELAXED)) {
+        wakeup_ns += loop->period_ns;
+        wakeup.tv_sec = wakeup_ns / NSEC_PER_SEC;
+        wakeup.tv_nsec = wakeup_ns % NSEC_PER_SEC;
+        do {
+            // the wakeup time is absolute, so a signal only needs a retry
+            ret = clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup,
+                    NULL);
+        } while (ret == EINTR
+                && !__atomic_load_n(&loop->stop, __ATOMIC_RELAXED));
+
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        start_ns = TIMESPEC2NS(start);
+        latency = start_ns > wakeup_ns ? start_ns - wakeup_ns : 0;
+
+        // use the target time as application time, it is more stable
+        ret = ec_rt_loop_cycle(loop, cycle++, wakeup_ns, func, data,
+                &error);
+
+        clock_gettime(CLOCK_MONOTONIC, &end);
+        end_ns = TIMESPEC2NS(end);
+
+        // skip the periods that were missed completely
+        overrun = end_ns > wakeup_ns + loop->period_ns;
+        while (end_ns > wakeup_ns + loop->period_ns) {
+            wakeup_ns += loop->period_ns;
+        }
+
+        ec_rt_loop_account(loop, latency, end_ns - start_ns,
+                last_start_ns ? (int64_t) (start_ns - last_start_ns) : -1,
+                overrun, error != 0);
+        last_start_ns = start_ns;
+
+        if (ec_rt_loop_fatal(error)) {
+            fprintf(stderr, "Realtime loop stopped: %s\n", strerror(-error));
+            ret = error;
+            break;
+        }
+
+        if (ret) {
+            break;
+        }
+    }
+
+    return ret > 0 ? 0 : ret;
+}
+
+/****************************************************************************/
+
+void ecrt_rt_loop_stop(ec_rt_loop_t *loop)
+{
+    __atomic_store_n(&loop->stop, 1, __ATOMIC_RELAXED);
+}
+
+/****************************************************************************/
+
+int ecrt_rt_loop_stats(ec_rt_loop_t *loop, ec_rt_loop_stats_t *stats,
+        int reset)
+{
+    int ret;
+
+    ret = ec_rt_loop_copy(loop->shared, stats);
+    if (!ret && reset) {
+        // the realtime thread resets the statistics with the next cycle
+        __atomic_store_n(&loop->reset, 1, __ATOMIC_RELEASE);
+    }
+    return ret;
+}
+
+/****************************************************************************/
+
+int ecrt_rt_loop_read_stats(const char *name, ec_rt_loop_stats_t *stats)
+{
+    const ec_rt_loop_shared_t *shared;
+    int fd, ret;
+
+    fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) {
+        return -errno;
+    }
+
+    shared = mmap(NULL, sizeof(ec_rt_loop_shared_t), PROT_READ, MAP_SHARED,
+            fd, 0);
+    ret = shared == MAP_FAILED ? -errno : 0;
+    close(fd);
+    if (ret) {
+        return ret;
+    }
+
+    if (shared->magic != EC_RT_LOOP_MAGIC) {
+        ret = -EPROTO;
+    } else {
+        ret = ec_rt_loop_copy(shared, stats);
+    }
+
+    munmap((void *) shared, sizeof(ec_rt_loop_shared_t));
+    return ret;
+}
+
+/****************************************************************************/
@@ -0,0 +1,56 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT master userspace library.
+ *
+ *  The IgH EtherCAT master userspace library is free software; you can
+ *  redistribute it and/or modify it under the terms of the GNU Lesser General
+ *  Public License as published by the Free Software Foundation; version 2.1
+ *  of the License.
+ *
+ *  The IgH EtherCAT master userspace library is distributed in the hope that
+ *  it will be useful, but WITHOUT ANY WARRANTY; without even the implied
+ *  warranty of MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *  GNU Lesser General Public License for more details.
+ *
+ *  You should have received a copy of the GNU Lesser General Public License
+ *  along with the IgH EtherCAT master userspace library. If not, see
+ *  <http://www.gnu.org/licenses/>.
+ *
+ ****************************************************************************/
+
+#include "include/ecrt.h"
+
+/****************************************************************************/
+
+/** Magic number of an exported statistics area ("ECRL"). */
+#define EC_RT_LOOP_MAGIC 0x4c524345
+
+/** Statistics area, either private or exported via shared memory.
+ */
+typedef struct {
+    uint32_t magic; /**< EC_RT_LOOP_MAGIC. */
+    uint32_t sequence; /**< Odd while the statistics are updated. */
+    ec_rt_loop_stats_t stats; /**< Statistics. */
+} ec_rt_loop_shared_t;
+
+/****************************************************************************/
+
+struct ec_rt_loop {
+    ec_rt_loop_t *next;
+    ec_master_t *master;
+    uint32_t period_ns; /**< Cycle period. */
+    unsigned int sync_ref_interval; /**< Cycles between reference clock
+                                      synchronisations, 0 without DC. */
+    int stop; /**< Set to leave ecrt_rt_loop_run(). */
+    int reset; /**< Set to reset the statistics with the next cycle. */
+    ec_rt_loop_shared_t *shared; /**< Statistics. */
+    char *shm_name; /**< Name of the shared memory object, or NULL. */
+};
+
+/****************************************************************************/
+
+void ec_rt_loop_clear(ec_rt_loop_t *);
+
+/****************************************************************************/
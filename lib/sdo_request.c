@@ -26,6 +26,7 @@
 
 /****************************************************************************/
 
+#include <errno.h>
 #include <stdio.h>
 #include <string.h>
 
@@ -38,10 +39,10 @@
 
 void ec_sdo_request_clear(ec_sdo_request_t *req)
 {
-    if (req->data) {
+    if (req->data && !req->external) {
         free(req->data);
-        req->data = NULL;
     }
+    req->data = NULL;
 }
 
 /*****************************************************************************
@@ -86,6 +87,38 @@ int ecrt_sdo_request_timeout(ec_sdo_request_t *req, uint32_t timeout)
 
 /****************************************************************************/
 
+int ecrt_sdo_request_external_memory(ec_sdo_request_t *req, uint8_t *mem,
+        size_t size)
+{
+    ec_ioctl_sdo_request_t data;
+    int ret;
+
+    if (!mem || !size) {
+        return -EINVAL;
+    }
+
+    data.config_index = req->config->index;
+    data.request_index = req->index;
+    data.data = mem;
+    data.size = size;
+
+    ret = ioctl(req->config->master->fd, EC_IOCTL_SDO_REQUEST_MEMORY, &data);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        fprintf(stderr, "Failed to set external SDO memory: %s\n",
+                strerror(EC_IOCTL_ERRNO(ret)));
+        return -EC_IOCTL_ERRNO(ret);
+    }
+
+    ec_sdo_request_clear(req);
+    req->data = mem;
+    req->mem_size = size;
+    req->data_size = size;
+    req->external = 1;
+    return 0;
+}
+
+/****************************************************************************/
+
 uint8_t *ecrt_sdo_request_data(const ec_sdo_request_t *req)
 {
     return req->data;
@@ -115,7 +148,10 @@ ec_request_state_t ecrt_sdo_request_state(ec_sdo_request_t *req)
         return EC_REQUEST_ERROR;
     }
 
-    if (data.size) { // new data waiting to be copied
+    if (data.size && req->external) {
+        // uploaded directly into the pinned application memory
+        req->data_size = data.size;
+    } else if (data.size) { // new data waiting to be copied
         if (req->mem_size < data.size) {
             fprintf(stderr, "Received %zu bytes do not fit info SDO data"
                     " memory (%zu bytes)!\n", data.size, req->mem_size);
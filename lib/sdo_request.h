@@ -33,6 +33,7 @@ struct ec_sdo_request {
     uint8_t *data; /**< Pointer to SDO data. */
     size_t mem_size; /**< Size of SDO data memory. */
     size_t data_size; /**< Size of SDO data. */
+    uint8_t external; /**< \a data is application memory. */
 };
 
 /****************************************************************************/
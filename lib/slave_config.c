@@ -138,6 +138,28 @@ int ecrt_slave_config_watchdog(ec_slave_config_t *sc,
 
 /****************************************************************************/
 
+int ecrt_slave_config_mailbox_size(ec_slave_config_t *sc,
+        uint16_t rx_size, uint16_t tx_size)
+{
+    ec_ioctl_config_t data;
+    int ret;
+
+    memset(&data, 0x00, sizeof(ec_ioctl_config_t));
+    data.config_index = sc->index;
+    data.mbox_rx_size = rx_size;
+    data.mbox_tx_size = tx_size;
+
+    ret = ioctl(sc->master->fd, EC_IOCTL_SC_MAILBOX_SIZE, &data);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        fprintf(stderr, "Failed to config mailbox size: %s\n",
+                strerror(EC_IOCTL_ERRNO(ret)));
+        return -EC_IOCTL_ERRNO(ret);
+    }
+    return 0;
+}
+
+/****************************************************************************/
+
 int ecrt_slave_config_pdo_assign_add(ec_slave_config_t *sc,
         uint8_t sync_index, uint16_t pdo_index)
 {
@@ -595,6 +617,7 @@ ec_sdo_request_t *ecrt_slave_config_create_sdo_request(ec_slave_config_t *sc,
     } else {
         req->data = NULL;
     }
+    req->external = 0;
 
     data.config_index = sc->index;
     data.sdo_index = index;
@@ -1062,3 +1085,35 @@ int ecrt_slave_config_state_timeout(ec_slave_config_t *sc,
 }
 
 /****************************************************************************/
+
+int ecrt_slave_config_release(ec_slave_config_t *sc)
+{
+    int ret;
+
+    ret = ioctl(sc->master->fd, EC_IOCTL_SC_RELEASE, sc->index);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        fprintf(stderr, "Failed to release slave configuration: %s\n",
+                strerror(EC_IOCTL_ERRNO(ret)));
+        return -EC_IOCTL_ERRNO(ret);
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
+
+int ecrt_slave_config_apply(ec_slave_config_t *sc)
+{
+    int ret;
+
+    ret = ioctl(sc->master->fd, EC_IOCTL_SC_APPLY, sc->index);
+    if (EC_IOCTL_IS_ERROR(ret)) {
+        fprintf(stderr, "Failed to apply slave configuration: %s\n",
+                strerror(EC_IOCTL_ERRNO(ret)));
+        return -EC_IOCTL_ERRNO(ret);
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
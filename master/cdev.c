@@ -151,6 +151,8 @@ int eccdev_open(struct inode *inode, struct file *filp)
     priv->ctx.requested = 0;
     priv->ctx.process_data = NULL;
     priv->ctx.process_data_size = 0;
+    priv->ctx.cycle = NULL;
+    priv->ctx.cycle_state = NULL;
 
     filp->private_data = priv;
 
@@ -177,6 +179,10 @@ int eccdev_release(struct inode *inode, struct file *filp)
         vfree(priv->ctx.process_data);
     }
 
+    if (priv->ctx.cycle) {
+        kfree(priv->ctx.cycle);
+    }
+
 #if DEBUG
     EC_MASTER_DBG(master, 0, "File closed.\n");
 #endif
@@ -212,10 +218,12 @@ long eccdev_ioctl(struct file *filp, unsigned int cmd, unsigned long arg)
 
 /** Memory-map callback for the EtherCAT character device.
  *
- * The actual mapping will be done in the eccdev_vma_nopage() callback of the
- * virtual memory area.
+ * If the process data has already been allocated (i. e. the master is
+ * activated), all pages are mapped immediately, so that the realtime task
+ * does not take page faults in its first cycles. Otherwise, the mapping is
+ * done in the eccdev_vma_fault() callback of the virtual memory area.
  *
- * \return Always zero (success).
+ * \return Zero on success, otherwise a negative error code.
  */
 int eccdev_mmap(
         struct file *filp,
@@ -223,17 +231,38 @@ int eccdev_mmap(
         )
 {
     ec_cdev_priv_t *priv = (ec_cdev_priv_t *) filp->private_data;
+    unsigned long addr, offset = vma->vm_pgoff << PAGE_SHIFT;
+    int ret;
 
     EC_MASTER_DBG(priv->cdev->master, 1, "mmap()\n");
 
     vma->vm_ops = &eccdev_vm_ops;
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(6, 3, 0)
-    vm_flags_set(vma, VM_DONTDUMP);
+    vm_flags_set(vma, VM_DONTDUMP | VM_DONTEXPAND);
 #else
-    vma->vm_flags |= VM_DONTDUMP; /* Pages will not be swapped out */
+    /* Pages will not be swapped out */
+    vma->vm_flags |= VM_DONTDUMP | VM_DONTEXPAND;
 #endif
     vma->vm_private_data = priv;
 
+    if (!priv->ctx.process_data) {
+        return 0;
+    }
+
+    for (addr = vma->vm_start; addr < vma->vm_end
+            && offset < priv->ctx.process_data_size;
+            addr += PAGE_SIZE, offset += PAGE_SIZE) {
+        ret = vm_insert_page(vma, addr,
+                vmalloc_to_page(priv->ctx.process_data + offset));
+        if (ret) {
+            EC_MASTER_ERR(priv->cdev->master, "Failed to map process"
+                    " data page at offset %lu: %i\n", offset, ret);
+            return ret;
+        }
+    }
+
+    EC_MASTER_DBG(priv->cdev->master, 1, "Mapped %lu bytes of process"
+            " data.\n", addr - vma->vm_start);
     return 0;
 }
 
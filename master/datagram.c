@@ -27,6 +27,9 @@
 /****************************************************************************/
 
 #include <linux/slab.h>
+#include <linux/atomic.h>
+#include <linux/cache.h>
+#include <linux/numa.h>
 
 #include "datagram.h"
 #include "master.h"
@@ -39,6 +42,7 @@
     ret = ec_datagram_prealloc(datagram, data_size); \
     if (unlikely(ret)) \
         return ret; \
+    datagram->frozen = 0; \
     datagram->index = 0; \
     datagram->working_counter = 0; \
     datagram->state = EC_DATAGRAM_INIT;
@@ -51,6 +55,11 @@
 
 /****************************************************************************/
 
+/** Source of freeze identifiers, see ec_datagram_freeze(). */
+static atomic_t ec_datagram_freeze_count = ATOMIC_INIT(0);
+
+/****************************************************************************/
+
 /** Array of datagram type strings used in ec_datagram_type_string().
  *
  * \attention This is indexed by ec_datagram_type_t.
@@ -87,11 +96,14 @@ void ec_datagram_init(ec_datagram_t *datagram /**< EtherCAT datagram. */)
     datagram->data_origin = EC_ORIG_INTERNAL;
     datagram->mem_size = 0;
     datagram->data_size = 0;
+    datagram->frozen = 0;
     datagram->index = 0x00;
     datagram->working_counter = 0x0000;
     datagram->state = EC_DATAGRAM_INIT;
 #ifdef EC_HAVE_CYCLES
     datagram->cycles_sent = 0;
+#else
+    datagram->ns_sent = 0;
 #endif
     datagram->jiffies_sent = 0;
 #ifdef EC_HAVE_CYCLES
@@ -143,6 +155,25 @@ int ec_datagram_prealloc(
         ec_datagram_t *datagram, /**< EtherCAT datagram. */
         size_t size /**< New payload size in bytes. */
         )
+{
+    return ec_datagram_prealloc_node(datagram, size, NUMA_NO_NODE);
+}
+
+/****************************************************************************/
+
+/** Allocates internal payload memory on a specific NUMA node.
+ *
+ * Like ec_datagram_prealloc(), but the memory is taken from \a node and
+ * rounded up to full cache lines, so that the payload does not share a
+ * cache line with other data.
+ *
+ * \return 0 in case of success, otherwise \a -ENOMEM.
+ */
+int ec_datagram_prealloc_node(
+        ec_datagram_t *datagram, /**< EtherCAT datagram. */
+        size_t size, /**< New payload size in bytes. */
+        int node /**< NUMA node, or NUMA_NO_NODE. */
+        )
 {
     if (datagram->data_origin == EC_ORIG_EXTERNAL
             || size <= datagram->mem_size)
@@ -154,7 +185,9 @@ int ec_datagram_prealloc(
         datagram->mem_size = 0;
     }
 
-    if (!(datagram->data = kmalloc(size, GFP_KERNEL))) {
+    size = ALIGN(size, L1_CACHE_BYTES);
+
+    if (!(datagram->data = kmalloc_node(size, GFP_KERNEL, node))) {
         EC_ERR("Failed to allocate %zu bytes of datagram memory!\n", size);
         return -ENOMEM;
     }
@@ -174,6 +207,30 @@ void ec_datagram_zero(ec_datagram_t *datagram /**< EtherCAT datagram. */)
 
 /****************************************************************************/
 
+/** Marks the datagram header as constant.
+ *
+ * Promises, that type, address and size of the datagram will not change
+ * until it is re-initialized with one of the ec_datagram_xxx() methods
+ * below, which unfreeze it again. This allows the master to leave the
+ * header in the transmit buffer untouched, if the datagram is sent at the
+ * same frame position as before (see ec_device_tx_cache()).
+ *
+ * Each call assigns a new freeze identifier, so that headers written before
+ * the datagram was re-initialized are never taken for valid.
+ */
+void ec_datagram_freeze(ec_datagram_t *datagram /**< EtherCAT datagram. */)
+{
+    unsigned int id;
+
+    do {
+        id = atomic_inc_return(&ec_datagram_freeze_count);
+    } while (!id);
+
+    datagram->frozen = id;
+}
+
+/****************************************************************************/
+
 /** Initializes an EtherCAT APRD datagram.
  *
  * \return Return value of ec_datagram_prealloc().
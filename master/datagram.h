@@ -89,11 +89,16 @@ typedef struct {
     ec_origin_t data_origin; /**< Origin of the \a data memory. */
     size_t mem_size; /**< Datagram \a data memory size. */
     size_t data_size; /**< Size of the data in \a data. */
+    unsigned int frozen; /**< Non-zero, if the header (type, address and
+                           size) is frozen. See ec_datagram_freeze(). */
     uint8_t index; /**< Index (set by master). */
     uint16_t working_counter; /**< Working counter. */
     ec_datagram_state_t state; /**< State. */
 #ifdef EC_HAVE_CYCLES
     cycles_t cycles_sent; /**< Time, when the datagram was sent. */
+#else
+    u64 ns_sent; /**< Time in ns (ktime_get()), when the datagram was sent.
+                   Jiffies are too coarse for retransmissions. */
 #endif
     unsigned long jiffies_sent; /**< Jiffies, when the datagram was sent. */
 #ifdef EC_HAVE_CYCLES
@@ -112,7 +117,9 @@ void ec_datagram_init(ec_datagram_t *);
 void ec_datagram_clear(ec_datagram_t *);
 void ec_datagram_unqueue(ec_datagram_t *);
 int ec_datagram_prealloc(ec_datagram_t *, size_t);
+int ec_datagram_prealloc_node(ec_datagram_t *, size_t, int);
 void ec_datagram_zero(ec_datagram_t *);
+void ec_datagram_freeze(ec_datagram_t *);
 
 int ec_datagram_aprd(ec_datagram_t *, uint16_t, uint16_t, size_t);
 int ec_datagram_apwr(ec_datagram_t *, uint16_t, uint16_t, size_t);
@@ -47,6 +47,7 @@ int ec_datagram_pair_init(
         )
 {
     ec_device_index_t dev_idx;
+    int node = ec_master_numa_node(domain->master);
     int ret;
 
     INIT_LIST_HEAD(&pair->list);
@@ -66,14 +67,15 @@ int ec_datagram_pair_init(
     for (dev_idx = EC_DEVICE_BACKUP;
             dev_idx < ec_master_num_devices(domain->master); dev_idx++) {
         /* backup datagrams have their own memory */
-        ret = ec_datagram_prealloc(&pair->datagrams[dev_idx], data_size);
+        ret = ec_datagram_prealloc_node(&pair->datagrams[dev_idx],
+                data_size, node);
         if (ret) {
             goto out_datagrams;
         }
     }
 
 #if EC_MAX_NUM_DEVICES > 1
-    if (!(pair->send_buffer = kmalloc(data_size, GFP_KERNEL))) {
+    if (!(pair->send_buffer = kmalloc_node(data_size, GFP_KERNEL, node))) {
         EC_MASTER_ERR(domain->master,
                 "Failed to allocate domain send buffer!\n");
         ret = -ENOMEM;
@@ -123,6 +125,7 @@ int ec_datagram_pair_init(
     for (dev_idx = EC_DEVICE_MAIN;
             dev_idx < ec_master_num_devices(domain->master); dev_idx++) {
         ec_datagram_zero(&pair->datagrams[dev_idx]);
+        ec_datagram_freeze(&pair->datagrams[dev_idx]);
     }
 
     return 0;
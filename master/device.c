@@ -27,6 +27,7 @@
 /****************************************************************************/
 
 #include <linux/module.h>
+#include <linux/version.h>
 #include <linux/skbuff.h>
 #include <linux/if_ether.h>
 #include <linux/netdevice.h>
@@ -53,6 +54,65 @@ enum {
     EXTRA_HEADROOM = 64,
 };
 
+/****************************************************************************/
+
+/** Allocates a transmit socket buffer with an Ethernet-II header.
+ *
+ * \return Socket buffer, or NULL.
+ */
+static struct sk_buff *ec_device_alloc_tx_skb(
+        ec_device_t *device /**< EtherCAT device */
+        )
+{
+    struct sk_buff *skb;
+    struct ethhdr *eth;
+
+    if (!(skb = dev_alloc_skb(ETH_FRAME_LEN + EXTRA_HEADROOM))) {
+        return NULL;
+    }
+
+    // add Ethernet-II-header
+    skb_reserve(skb, ETH_HLEN + EXTRA_HEADROOM);
+    eth = (struct ethhdr *) skb_push(skb, ETH_HLEN);
+    eth->h_proto = htons(0x88A4);
+    memset(eth->h_dest, 0xFF, ETH_ALEN);
+
+    if (device->dev) {
+        skb->dev = device->dev;
+        memcpy(eth->h_source, device->dev->dev_addr, ETH_ALEN);
+    }
+
+    return skb;
+}
+
+/****************************************************************************/
+
+/** Allocates the transmit ring arrays.
+ *
+ * \return 0 in case of success, else < 0
+ */
+static int ec_device_alloc_tx_ring(
+        ec_device_t *device, /**< EtherCAT device */
+        unsigned int size, /**< Ring size. */
+        struct sk_buff ***skbs, /**< Socket buffer array. */
+        ec_tx_cache_t **caches, /**< Frame layout array. */
+        ec_tx_state_t **states /**< Transmission state array. */
+        )
+{
+    *skbs = kcalloc(size, sizeof(**skbs), GFP_KERNEL);
+    *caches = kcalloc(size, sizeof(**caches), GFP_KERNEL);
+    *states = kcalloc(size, sizeof(**states), GFP_KERNEL);
+    if (!*skbs || !*caches || !*states) {
+        kfree(*skbs);
+        kfree(*caches);
+        kfree(*states);
+        EC_MASTER_ERR(device->master, "Failed to allocate transmit ring!\n");
+        return -ENOMEM;
+    }
+
+    return 0;
+}
+
 /** Constructor.
  *
  * \return 0 in case of success, else < 0
@@ -64,7 +124,6 @@ int ec_device_init(
 {
     int ret;
     unsigned int i;
-    struct ethhdr *eth;
 #ifdef EC_DEBUG_IF
     char ifname[10];
     char mb = 'x';
@@ -76,10 +135,14 @@ int ec_device_init(
     device->module = NULL;
     device->open = 0;
     device->link_state = 0;
-    for (i = 0; i < EC_TX_RING_SIZE; i++) {
-        device->tx_skb[i] = NULL;
-    }
+    device->xmit_more = 0;
+    device->tx_ring_size = master->tx_ring_size;
     device->tx_ring_index = 0;
+    ret = ec_device_alloc_tx_ring(device, device->tx_ring_size,
+            &device->tx_skb, &device->tx_cache, &device->tx_state);
+    if (ret < 0) {
+        return ret;
+    }
 #ifdef EC_HAVE_CYCLES
     device->cycles_poll = 0;
 #endif
@@ -123,24 +186,18 @@ int ec_device_init(
     }
 #endif
 
-    for (i = 0; i < EC_TX_RING_SIZE; i++) {
-        if (!(device->tx_skb[i] = dev_alloc_skb(ETH_FRAME_LEN + EXTRA_HEADROOM))) {
+    for (i = 0; i < device->tx_ring_size; i++) {
+        if (!(device->tx_skb[i] = ec_device_alloc_tx_skb(device))) {
             EC_MASTER_ERR(master, "Error allocating device socket buffer!\n");
             ret = -ENOMEM;
             goto out_tx_ring;
         }
-
-        // add Ethernet-II-header
-        skb_reserve(device->tx_skb[i], ETH_HLEN + EXTRA_HEADROOM);
-        eth = (struct ethhdr *) skb_push(device->tx_skb[i], ETH_HLEN);
-        eth->h_proto = htons(0x88A4);
-        memset(eth->h_dest, 0xFF, ETH_ALEN);
     }
 
     return 0;
 
 out_tx_ring:
-    for (i = 0; i < EC_TX_RING_SIZE; i++) {
+    for (i = 0; i < device->tx_ring_size; i++) {
         if (device->tx_skb[i]) {
             dev_kfree_skb(device->tx_skb[i]);
         }
@@ -149,6 +206,9 @@ out_tx_ring:
     ec_debug_clear(&device->dbg);
 out_return:
 #endif
+    kfree(device->tx_skb);
+    kfree(device->tx_cache);
+    kfree(device->tx_state);
     return ret;
 }
 
@@ -165,8 +225,11 @@ void ec_device_clear(
     if (device->open) {
         ec_device_close(device);
     }
-    for (i = 0; i < EC_TX_RING_SIZE; i++)
+    for (i = 0; i < device->tx_ring_size; i++)
         dev_kfree_skb(device->tx_skb[i]);
+    kfree(device->tx_skb);
+    kfree(device->tx_cache);
+    kfree(device->tx_state);
 #ifdef EC_DEBUG_IF
     ec_debug_clear(&device->dbg);
 #endif
@@ -174,6 +237,69 @@ void ec_device_clear(
 
 /****************************************************************************/
 
+/** Enlarges the transmit ring.
+ *
+ * Must not be called while frames are sent, e. g. between stopping and
+ * restarting the master thread. The ring never shrinks.
+ *
+ * \return 0 in case of success, else < 0
+ */
+int ec_device_resize_tx_ring(
+        ec_device_t *device, /**< EtherCAT device */
+        unsigned int size /**< New ring size. */
+        )
+{
+    struct sk_buff **skbs;
+    ec_tx_cache_t *caches;
+    ec_tx_state_t *states;
+    unsigned int i;
+    int ret;
+
+    size = min(size, (unsigned int) EC_TX_RING_MAX_SIZE);
+    if (size <= device->tx_ring_size) {
+        return 0;
+    }
+
+    ret = ec_device_alloc_tx_ring(device, size, &skbs, &caches, &states);
+    if (ret < 0) {
+        return ret;
+    }
+
+    for (i = device->tx_ring_size; i < size; i++) {
+        if (!(skbs[i] = ec_device_alloc_tx_skb(device))) {
+            EC_MASTER_ERR(device->master,
+                    "Error allocating device socket buffer!\n");
+            while (i-- > device->tx_ring_size) {
+                dev_kfree_skb(skbs[i]);
+            }
+            kfree(skbs);
+            kfree(caches);
+            kfree(states);
+            return -ENOMEM;
+        }
+    }
+
+    for (i = 0; i < device->tx_ring_size; i++) {
+        skbs[i] = device->tx_skb[i];
+        caches[i] = device->tx_cache[i];
+        states[i] = device->tx_state[i];
+    }
+
+    kfree(device->tx_skb);
+    kfree(device->tx_cache);
+    kfree(device->tx_state);
+    device->tx_skb = skbs;
+    device->tx_cache = caches;
+    device->tx_state = states;
+    device->tx_ring_size = size;
+
+    EC_MASTER_DBG(device->master, 1, "Transmit ring enlarged to %u"
+            " socket buffers.\n", size);
+    return 0;
+}
+
+/****************************************************************************/
+
 /** Associate with net_device.
  */
 void ec_device_attach(
@@ -192,7 +318,7 @@ void ec_device_attach(
     device->poll = poll;
     device->module = module;
 
-    for (i = 0; i < EC_TX_RING_SIZE; i++) {
+    for (i = 0; i < device->tx_ring_size; i++) {
         device->tx_skb[i]->dev = net_dev;
         eth = (struct ethhdr *) (device->tx_skb[i]->data);
         memcpy(eth->h_source, net_dev->dev_addr, ETH_ALEN);
@@ -222,11 +348,14 @@ void ec_device_detach(
     device->module = NULL;
     device->open = 0;
     device->link_state = 0; // down
+    device->xmit_more = 0;
 
     ec_device_clear_stats(device);
 
-    for (i = 0; i < EC_TX_RING_SIZE; i++) {
+    for (i = 0; i < device->tx_ring_size; i++) {
         device->tx_skb[i]->dev = NULL;
+        device->tx_cache[i].count = 0;
+        device->tx_state[i].pending = 0;
     }
 }
 
@@ -302,12 +431,51 @@ uint8_t *ec_device_tx_data(
         ec_device_t *device /**< EtherCAT device */
         )
 {
+    unsigned int i, index = device->tx_ring_index;
+
     /* cycle through socket buffers, because otherwise there is a race
      * condition, if multiple frames are sent and the DMA is not scheduled in
-     * between. */
-    device->tx_ring_index++;
-    device->tx_ring_index %= EC_TX_RING_SIZE;
-    return device->tx_skb[device->tx_ring_index]->data + ETH_HLEN;
+     * between. Buffers, whose frames did not return yet, are skipped. */
+    for (i = 0; i < device->tx_ring_size; i++) {
+        const ec_tx_state_t *state;
+
+        index = (index + 1) % device->tx_ring_size;
+        state = &device->tx_state[index];
+        if (!state->pending) {
+            break;
+        }
+#ifdef EC_HAVE_CYCLES
+        if (get_cycles() - state->cycles_sent >
+                (cycles_t) EC_IO_TIMEOUT * (cpu_khz / 1000)) {
+#else
+        if (jiffies - state->jiffies_sent >
+                max(EC_IO_TIMEOUT * HZ / 1000000, 1)) {
+#endif
+            break; // frame lost
+        }
+    }
+
+    if (unlikely(i == device->tx_ring_size)) {
+        // all frames in flight: reuse the oldest buffer anyway
+        index = (device->tx_ring_index + 1) % device->tx_ring_size;
+        device->tx_ring_overruns++;
+    }
+
+    device->tx_ring_index = index;
+    return device->tx_skb[index]->data + ETH_HLEN;
+}
+
+/****************************************************************************/
+
+/** Returns the frame layout cache of the current transmit socket buffer.
+ *
+ * Has to be called after ec_device_tx_data().
+ */
+ec_tx_cache_t *ec_device_tx_cache(
+        ec_device_t *device /**< EtherCAT device */
+        )
+{
+    return &device->tx_cache[device->tx_ring_index];
 }
 
 /****************************************************************************/
@@ -316,13 +484,22 @@ uint8_t *ec_device_tx_data(
  *
  * Cuts the socket buffer content to the (now known) size, and calls the
  * start_xmit() function of the assigned net_device.
+ *
+ * If \a more is set and the driver opted in with ecdev_set_xmit_more(), it
+ * may defer the doorbell (see netdev_xmit_more()) until the last frame of
+ * the cycle is sent, so that multiple frames go out back-to-back with a
+ * single register write. Other drivers, like the generic one, always get
+ * the flag cleared. The caller has to keep the CPU for the whole burst.
  */
 void ec_device_send(
         ec_device_t *device, /**< EtherCAT device */
-        size_t size /**< number of bytes to send */
+        size_t size, /**< number of bytes to send */
+        int more /**< More frames follow immediately. */
         )
 {
     struct sk_buff *skb = device->tx_skb[device->tx_ring_index];
+    ec_tx_state_t *state = &device->tx_state[device->tx_ring_index];
+    netdev_tx_t ret;
 
     // set the right length for the data
     skb->len = ETH_HLEN + size;
@@ -333,9 +510,20 @@ void ec_device_send(
     }
 
     // start sending
-    if (device->dev->netdev_ops->ndo_start_xmit(skb, device->dev) ==
-            NETDEV_TX_OK)
-    {
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 18, 0)
+    ret = __netdev_start_xmit(device->dev->netdev_ops, skb, device->dev,
+            more && device->xmit_more);
+#else
+    ret = device->dev->netdev_ops->ndo_start_xmit(skb, device->dev);
+#endif
+    if (ret == NETDEV_TX_OK) {
+        state->index = skb->data[ETH_HLEN + EC_FRAME_HEADER_SIZE + 1];
+        state->pending = 1;
+#ifdef EC_HAVE_CYCLES
+        state->cycles_sent = get_cycles();
+#endif
+        state->jiffies_sent = jiffies;
+
         device->tx_count++;
         device->master->device_stats.tx_count++;
         device->tx_bytes += ETH_HLEN + size;
@@ -354,6 +542,29 @@ void ec_device_send(
 
 /****************************************************************************/
 
+/** Marks the transmit socket buffer of a returned frame as free.
+ *
+ * Called for every received frame with the index of its first datagram.
+ */
+void ec_device_tx_complete(
+        ec_device_t *device, /**< EtherCAT device */
+        uint8_t index /**< Index of the first datagram in the frame. */
+        )
+{
+    unsigned int i;
+
+    for (i = 0; i < device->tx_ring_size; i++) {
+        ec_tx_state_t *state = &device->tx_state[i];
+
+        if (state->pending && state->index == index) {
+            state->pending = 0;
+            return;
+        }
+    }
+}
+
+/****************************************************************************/
+
 /** Clears the frame statistics.
  */
 void ec_device_clear_stats(
@@ -372,6 +583,7 @@ void ec_device_clear_stats(
     device->rx_bytes = 0;
     device->last_rx_bytes = 0;
     device->tx_errors = 0;
+    device->tx_ring_overruns = 0;
 
     for (i = 0; i < EC_RATE_COUNT; i++) {
         device->tx_frame_rates[i] = 0;
@@ -682,6 +894,29 @@ void ecdev_set_link(
 
 /****************************************************************************/
 
+/** Announces, that the driver honours netdev_xmit_more().
+ *
+ * The master then sets the flag for all but the last frame of a cycle, so
+ * that the driver can defer the doorbell. The frames of a cycle are sent on
+ * the same CPU then, so the driver's start_xmit() must not sleep.
+ *
+ * \ingroup DeviceInterface
+ */
+void ecdev_set_xmit_more(
+        ec_device_t *device, /**< EtherCAT device */
+        uint8_t enable /**< Non-zero, if netdev_xmit_more() is honoured. */
+        )
+{
+    if (unlikely(!device)) {
+        EC_WARN("ecdev_set_xmit_more() called with null device!\n");
+        return;
+    }
+
+    device->xmit_more = enable;
+}
+
+/****************************************************************************/
+
 /** Reads the link state.
  *
  * \ingroup DeviceInterface
@@ -710,6 +945,7 @@ EXPORT_SYMBOL(ecdev_close);
 EXPORT_SYMBOL(ecdev_receive);
 EXPORT_SYMBOL(ecdev_get_link);
 EXPORT_SYMBOL(ecdev_set_link);
+EXPORT_SYMBOL(ecdev_set_xmit_more);
 
 /** \endcond */
 
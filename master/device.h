@@ -33,15 +33,27 @@
 
 #include "../devices/ecdev.h"
 #include "globals.h"
+#include "datagram.h"
 
 /**
- * Size of the transmit ring.
+ * Default size of the transmit ring.
  * This memory ring is used to transmit frames. It is necessary to use
  * different memory regions, because otherwise the network device DMA could
  * send the same data twice, if it is called twice.
  */
 #define EC_TX_RING_SIZE 2
 
+/** Maximum size of the transmit ring.
+ *
+ * The ring is enlarged on activation to the number of frames needed per
+ * cycle (see ec_device_resize_tx_ring()).
+ */
+#define EC_TX_RING_MAX_SIZE 64
+
+/** Maximum number of datagrams per frame remembered in the transmit cache.
+ */
+#define EC_TX_CACHE_DATAGRAMS 32
+
 #ifdef EC_DEBUG_IF
 #include "debug.h"
 #endif
@@ -64,6 +76,39 @@ typedef struct {
 
 /****************************************************************************/
 
+/** Layout of the frame last written to a transmit socket buffer.
+ *
+ * Used to skip rewriting datagram headers, that are already in place. Only
+ * frozen datagrams are recorded (see ec_datagram_freeze()).
+ */
+typedef struct {
+    const ec_datagram_t *datagrams[EC_TX_CACHE_DATAGRAMS]; /**< Datagrams in
+                                                            frame order, or
+                                                            NULL if not
+                                                            frozen. */
+    unsigned int frozen[EC_TX_CACHE_DATAGRAMS]; /**< Freeze identifiers of
+                                                  the datagrams at the time
+                                                  of writing. */
+    unsigned int count; /**< Number of datagrams in the frame. */
+} ec_tx_cache_t;
+
+/** Transmission state of a transmit socket buffer.
+ *
+ * EtherCAT frames return to the master, so a socket buffer is known to be
+ * transmitted, when its frame was received again. A buffer, whose frame is
+ * lost, is free again after the datagram timeout.
+ */
+typedef struct {
+    uint8_t index; /**< Index of the first datagram in the frame. */
+    uint8_t pending; /**< The frame was sent, but not received yet. */
+#ifdef EC_HAVE_CYCLES
+    cycles_t cycles_sent; /**< Time, when the frame was sent. */
+#endif
+    unsigned long jiffies_sent; /**< Jiffies, when the frame was sent. */
+} ec_tx_state_t;
+
+/****************************************************************************/
+
 /**
    EtherCAT device.
    An EtherCAT device is a network interface card, that is owned by an
@@ -78,8 +123,14 @@ struct ec_device
     struct module *module; /**< pointer to the device's owning module */
     uint8_t open; /**< true, if the net_device has been opened */
     uint8_t link_state; /**< device link state */
-    struct sk_buff *tx_skb[EC_TX_RING_SIZE]; /**< transmit skb ring */
+    uint8_t xmit_more; /**< The driver defers the doorbell according to
+                         netdev_xmit_more() (see ecdev_set_xmit_more()). */
+    struct sk_buff **tx_skb; /**< transmit skb ring */
+    unsigned int tx_ring_size; /**< Number of transmit socket buffers. */
     unsigned int tx_ring_index; /**< last ring entry used to transmit */
+    ec_tx_cache_t *tx_cache; /**< Frame layouts of the transmit skb ring. */
+    ec_tx_state_t *tx_state; /**< Transmission states of the transmit skb
+                               ring. */
 #ifdef EC_HAVE_CYCLES
     cycles_t cycles_poll; /**< cycles of last poll */
 #endif
@@ -100,6 +151,8 @@ struct ec_device
     u64 last_rx_bytes; /**< Number of bytes received of last statistics cycle.
                         */
     u64 tx_errors; /**< Number of transmit errors. */
+    u64 tx_ring_overruns; /**< Number of transmit socket buffers, that were
+                            reused before their frame returned. */
     s32 tx_frame_rates[EC_RATE_COUNT]; /**< Transmit rates in frames/s for
                                          different statistics cycle periods.
                                         */
@@ -125,6 +178,7 @@ struct ec_device
 
 int ec_device_init(ec_device_t *, ec_master_t *);
 void ec_device_clear(ec_device_t *);
+int ec_device_resize_tx_ring(ec_device_t *, unsigned int);
 
 void ec_device_attach(ec_device_t *, struct net_device *, ec_pollfunc_t,
         struct module *);
@@ -135,7 +189,9 @@ int ec_device_close(ec_device_t *);
 
 void ec_device_poll(ec_device_t *);
 uint8_t *ec_device_tx_data(ec_device_t *);
-void ec_device_send(ec_device_t *, size_t);
+ec_tx_cache_t *ec_device_tx_cache(ec_device_t *);
+void ec_device_send(ec_device_t *, size_t, int);
+void ec_device_tx_complete(ec_device_t *, uint8_t);
 void ec_device_clear_stats(ec_device_t *);
 void ec_device_update_stats(ec_device_t *);
 
@@ -27,6 +27,12 @@
 /****************************************************************************/
 
 #include <linux/module.h>
+#include <linux/cache.h>
+#include <linux/mm.h>
+#include <linux/slab.h>
+#include <linux/sched.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
 
 #include "globals.h"
 #include "master.h"
@@ -65,10 +71,19 @@ void ec_domain_init(
     domain->master = master;
     domain->index = index;
     INIT_LIST_HEAD(&domain->fmmu_configs);
+    domain->fmmus_locked = 0;
+    domain->processing = 0;
     domain->data_size = 0;
     domain->data = NULL;
     domain->data_origin = EC_ORIG_INTERNAL;
+    domain->user_pages = NULL;
+    domain->user_page_count = 0;
+    domain->user_mapping = NULL;
+    domain->user_size = 0;
     domain->logical_base_address = 0x00000000;
+    domain->spare_size = 0;
+    domain->spare_start = 0;
+    domain->spare_offset = 0;
     INIT_LIST_HEAD(&domain->datagram_pairs);
     for (dev_idx = EC_DEVICE_MAIN; dev_idx < ec_master_num_devices(master);
             dev_idx++) {
@@ -100,6 +115,50 @@ void ec_domain_clear(ec_domain_t *domain /**< EtherCAT domain */)
 
 /****************************************************************************/
 
+/** Unpins userspace pages and frees the page array.
+ */
+static void ec_domain_unpin_pages(
+        struct page **pages, /**< Pinned pages. */
+        unsigned int count /**< Number of pages. */
+        )
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+    unpin_user_pages_dirty_lock(pages, count, true);
+#else
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        set_page_dirty_lock(pages[i]);
+        put_page(pages[i]);
+    }
+#endif
+
+    kfree(pages);
+}
+
+/****************************************************************************/
+
+/** Releases pinned userspace memory.
+ */
+static void ec_domain_release_user_memory(
+        ec_domain_t *domain /**< EtherCAT domain. */
+        )
+{
+    if (!domain->user_pages) {
+        return;
+    }
+
+    vunmap(domain->user_mapping);
+    ec_domain_unpin_pages(domain->user_pages, domain->user_page_count);
+
+    domain->user_mapping = NULL;
+    domain->user_pages = NULL;
+    domain->user_page_count = 0;
+    domain->user_size = 0;
+}
+
+/****************************************************************************/
+
 /** Frees internally allocated memory.
  */
 void ec_domain_clear_data(
@@ -110,12 +169,101 @@ void ec_domain_clear_data(
         kfree(domain->data);
     }
 
+    ec_domain_release_user_memory(domain);
+
     domain->data = NULL;
     domain->data_origin = EC_ORIG_INTERNAL;
 }
 
 /****************************************************************************/
 
+/** Uses memory of the calling userspace process as external memory.
+ *
+ * The pages covering the current domain size are pinned and mapped into the
+ * kernel address space, so that the process data can be exchanged directly
+ * with the application's buffer. They are released together with the
+ * domain.
+ *
+ * Has to be called in process context after all PDO entries have been
+ * registered and before the master is activated, with the master_sem held.
+ * Afterwards, the datagrams of the domain point into the process data.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+int ec_domain_user_memory(
+        ec_domain_t *domain, /**< EtherCAT domain. */
+        unsigned long address /**< Userspace address. */
+        )
+{
+    unsigned long first = address & PAGE_MASK;
+    unsigned int count;
+    struct page **pages;
+    void *mapping;
+    int ret;
+
+    if (domain->master->active) {
+        EC_MASTER_ERR(domain->master, "Domain %u: External memory can not"
+                " be set after activation.\n", domain->index);
+        return -EBUSY;
+    }
+
+    if (!ecrt_domain_size(domain)) {
+        EC_MASTER_ERR(domain->master, "Domain %u is empty.\n",
+                domain->index);
+        return -EINVAL;
+    }
+
+    count = (PAGE_ALIGN(address + ecrt_domain_size(domain)) - first)
+        >> PAGE_SHIFT;
+
+    pages = kmalloc_array(count, sizeof(struct page *), GFP_KERNEL);
+    if (!pages) {
+        return -ENOMEM;
+    }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+    ret = pin_user_pages_fast(first, count, FOLL_WRITE | FOLL_LONGTERM,
+            pages);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+    ret = get_user_pages_fast(first, count, FOLL_WRITE, pages);
+#else
+    ret = get_user_pages_fast(first, count, 1, pages);
+#endif
+    if (ret < 0) {
+        kfree(pages);
+        return ret;
+    }
+
+    if (ret < count) {
+        EC_MASTER_ERR(domain->master, "Failed to pin userspace memory"
+                " for domain %u (%i of %u pages).\n",
+                domain->index, ret, count);
+        ec_domain_unpin_pages(pages, ret);
+        return -EFAULT;
+    }
+
+    mapping = vmap(pages, count, VM_MAP, PAGE_KERNEL);
+    if (!mapping) {
+        ec_domain_unpin_pages(pages, count);
+        return -ENOMEM;
+    }
+
+    ec_domain_clear_data(domain);
+    domain->user_pages = pages;
+    domain->user_page_count = count;
+    domain->user_mapping = mapping;
+    domain->user_size = ecrt_domain_size(domain);
+    domain->data = mapping + (address & ~PAGE_MASK);
+    domain->data_origin = EC_ORIG_EXTERNAL;
+
+    EC_MASTER_DBG(domain->master, 1, "Domain %u uses %zu bytes of"
+            " userspace memory at 0x%lx.\n",
+            domain->index, domain->user_size, address);
+    return 0;
+}
+
+/****************************************************************************/
+
 /** Adds an FMMU configuration to the domain.
  */
 void ec_domain_add_fmmu_config(
@@ -154,7 +302,9 @@ int ec_domain_add_datagram_pair(
     ec_datagram_pair_t *datagram_pair;
     int ret;
 
-    if (!(datagram_pair = kmalloc(sizeof(ec_datagram_pair_t), GFP_KERNEL))) {
+    datagram_pair = kmalloc_node(sizeof(ec_datagram_pair_t), GFP_KERNEL,
+            ec_master_numa_node(domain->master));
+    if (!datagram_pair) {
         EC_MASTER_ERR(domain->master,
                 "Failed to allocate domain datagram pair!\n");
         return -ENOMEM;
@@ -238,9 +388,24 @@ int ec_domain_finish(
 
     domain->logical_base_address = base_address;
 
+    // append the spare area
+    domain->spare_start = domain->data_size;
+    domain->spare_offset = domain->data_size;
+    domain->data_size += domain->spare_size;
+    domain->spare_size = 0;
+
+    if (domain->user_pages && domain->data_size > domain->user_size) {
+        EC_MASTER_ERR(domain->master, "Domain %u grew to %zu bytes after"
+                " providing %zu bytes of userspace memory!\n",
+                domain->index, domain->data_size, domain->user_size);
+        return -EOVERFLOW;
+    }
+
     if (domain->data_size && domain->data_origin == EC_ORIG_INTERNAL) {
-        if (!(domain->data =
-                    (uint8_t *) kmalloc(domain->data_size, GFP_KERNEL))) {
+        domain->data = (uint8_t *) kmalloc_node(
+                ALIGN(domain->data_size, L1_CACHE_BYTES), GFP_KERNEL,
+                ec_master_numa_node(domain->master));
+        if (!domain->data) {
             EC_MASTER_ERR(domain->master, "Failed to allocate %zu bytes"
                     " internal memory for domain %u!\n",
                     domain->data_size, domain->index);
@@ -307,6 +472,32 @@ int ec_domain_finish(
         datagram_count++;
     }
 
+    /* Cover the spare area with LRW datagram pairs, so that FMMUs of both
+     * directions can be mapped into it later. */
+    datagram_used[EC_DIR_OUTPUT] = 1;
+    datagram_used[EC_DIR_INPUT] = 1;
+    for (datagram_offset = domain->spare_start;
+            datagram_offset < domain->data_size;
+            datagram_offset += datagram_size) {
+        datagram_size = min_t(size_t, domain->data_size - datagram_offset,
+                EC_MAX_DATA_SIZE);
+        ret = ec_domain_add_datagram_pair(domain,
+                domain->logical_base_address + datagram_offset,
+                datagram_size, domain->data + datagram_offset,
+                datagram_used);
+        if (ret < 0)
+            return ret;
+        datagram_count++;
+    }
+
+    if (domain->spare_start < domain->data_size) {
+        ec_domain_update_working_counters(domain);
+        EC_MASTER_INFO(domain->master, "Domain%u: %zu byte spare"
+                " process data at offset %zu.\n", domain->index,
+                domain->data_size - domain->spare_start,
+                domain->spare_start);
+    }
+
     EC_MASTER_INFO(domain->master, "Domain%u: Logical address 0x%08x,"
             " %zu byte, expected working counter %u.\n", domain->index,
             domain->logical_base_address, domain->data_size,
@@ -326,6 +517,199 @@ int ec_domain_finish(
 
 /****************************************************************************/
 
+/** Checks, if the datagram at a logical address can carry an FMMU.
+ *
+ * \return Non-zero, if the datagram type fits the direction.
+ */
+static int ec_domain_area_usable(
+        const ec_domain_t *domain, /**< EtherCAT domain. */
+        uint32_t address, /**< Logical address. */
+        ec_direction_t dir /**< FMMU direction. */
+        )
+{
+    const ec_datagram_pair_t *pair;
+
+    list_for_each_entry(pair, &domain->datagram_pairs, list) {
+        const ec_datagram_t *datagram = &pair->datagrams[EC_DEVICE_MAIN];
+        uint32_t start = EC_READ_U32(datagram->address);
+
+        if (address < start || address >= start + datagram->data_size) {
+            continue;
+        }
+
+        return datagram->type == EC_DATAGRAM_LRW
+            || (datagram->type == EC_DATAGRAM_LRD && dir == EC_DIR_INPUT)
+            || (datagram->type == EC_DATAGRAM_LWR && dir == EC_DIR_OUTPUT);
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Maps an FMMU configuration into an active domain.
+ *
+ * The FMMU keeps its logical address range, if its data still fit into it.
+ * Otherwise it is moved into the spare area, so that the process data
+ * offsets of all other slaves stay untouched.
+ *
+ * \retval  0 Success.
+ * \retval <0 Error code.
+ */
+int ec_domain_map_fmmu_config(
+        ec_domain_t *domain, /**< EtherCAT domain. */
+        ec_fmmu_config_t *fmmu /**< FMMU configuration. */
+        )
+{
+    ec_fmmu_config_t *entry;
+    size_t offset, end;
+
+    if (!fmmu->area_size || fmmu->data_size > fmmu->area_size
+            || !ec_domain_area_usable(domain,
+                fmmu->logical_start_address, fmmu->dir)) {
+        offset = domain->spare_offset;
+
+        // FMMUs must not cross datagram boundaries
+        end = domain->spare_start + EC_MAX_DATA_SIZE *
+            ((offset - domain->spare_start) / EC_MAX_DATA_SIZE + 1);
+        if (offset + fmmu->data_size > end) {
+            offset = end;
+        }
+
+        if (fmmu->data_size > EC_MAX_DATA_SIZE
+                || offset + fmmu->data_size > domain->data_size) {
+            EC_MASTER_ERR(domain->master, "Domain %u: No spare process"
+                    " data left for %u bytes!\n",
+                    domain->index, fmmu->data_size);
+            return -ENOSPC;
+        }
+
+        domain->spare_offset = offset + fmmu->data_size;
+        fmmu->logical_start_address =
+            domain->logical_base_address + offset;
+        fmmu->area_size = fmmu->data_size;
+    }
+
+    fmmu->domain = domain;
+
+    ec_domain_lock_fmmus(domain);
+
+    // keep the list sorted by address (needed for redundancy)
+    list_for_each_entry(entry, &domain->fmmu_configs, list) {
+        if (entry->logical_start_address > fmmu->logical_start_address) {
+            break;
+        }
+    }
+    list_add_tail(&fmmu->list, &entry->list);
+
+    ec_domain_update_working_counters(domain);
+
+    ec_domain_unlock_fmmus(domain);
+
+    EC_MASTER_DBG(domain->master, 1, "Domain %u: Mapped %u bytes"
+            " at 0x%08x, expected working counter %u.\n", domain->index,
+            fmmu->data_size, fmmu->logical_start_address,
+            domain->expected_working_counter);
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Recalculates the expected working counters of all datagram pairs.
+ *
+ * Like in ec_domain_finish(), every slave configuration counts once per
+ * direction and datagram pair.
+ */
+void ec_domain_update_working_counters(
+        ec_domain_t *domain /**< EtherCAT domain. */
+        )
+{
+    ec_datagram_pair_t *pair;
+    const ec_fmmu_config_t *fmmu, *other;
+    uint16_t expected = 0;
+
+    list_for_each_entry(pair, &domain->datagram_pairs, list) {
+        const ec_datagram_t *datagram = &pair->datagrams[EC_DEVICE_MAIN];
+        uint32_t start = EC_READ_U32(datagram->address);
+        uint32_t end = start + datagram->data_size;
+        unsigned int used[EC_DIR_COUNT] = {0};
+
+        list_for_each_entry(fmmu, &domain->fmmu_configs, list) {
+            if (fmmu->logical_start_address < start
+                    || fmmu->logical_start_address >= end) {
+                continue;
+            }
+
+            list_for_each_entry(other, &domain->fmmu_configs, list) {
+                if (other == fmmu) {
+                    used[fmmu->dir]++;
+                    break;
+                }
+                if (other->sc == fmmu->sc && other->dir == fmmu->dir
+                        && other->logical_start_address >= start
+                        && other->logical_start_address < end) {
+                    break; // was already counted
+                }
+            }
+        }
+
+        switch (datagram->type) {
+            case EC_DATAGRAM_LRW:
+                pair->expected_working_counter =
+                    used[EC_DIR_OUTPUT] * 2 + used[EC_DIR_INPUT];
+                break;
+            case EC_DATAGRAM_LWR:
+                pair->expected_working_counter = used[EC_DIR_OUTPUT];
+                break;
+            default:
+                pair->expected_working_counter = used[EC_DIR_INPUT];
+                break;
+        }
+
+        expected += pair->expected_working_counter;
+    }
+
+    // assign at once, ecrt_domain_state() may be called concurrently
+    domain->expected_working_counter = expected;
+}
+
+/****************************************************************************/
+
+/** Prepares a change of the FMMU list of an active domain.
+ *
+ * ecrt_domain_process() runs in the application's realtime context without
+ * the master_sem. After this call, it no longer evaluates the FMMU list,
+ * until ec_domain_unlock_fmmus() is called. If it is just walking the list,
+ * the call waits until it has finished.
+ *
+ * The master_sem has to be held.
+ */
+void ec_domain_lock_fmmus(
+        ec_domain_t *domain /**< EtherCAT domain. */
+        )
+{
+    WRITE_ONCE(domain->fmmus_locked, 1);
+    smp_mb(); // pairs with the barrier in ecrt_domain_process()
+
+    while (READ_ONCE(domain->processing)) {
+        schedule();
+    }
+}
+
+/****************************************************************************/
+
+/** Publishes the changed FMMU list to ecrt_domain_process().
+ */
+void ec_domain_unlock_fmmus(
+        ec_domain_t *domain /**< EtherCAT domain. */
+        )
+{
+    smp_mb();
+    WRITE_ONCE(domain->fmmus_locked, 0);
+}
+
+/****************************************************************************/
+
 /** Get the number of FMMU configurations of the domain.
  */
 unsigned int ec_domain_fmmu_count(const ec_domain_t *domain)
@@ -425,7 +809,24 @@ int ecrt_domain_reg_pdo_entry_list(ec_domain_t *domain,
 
 size_t ecrt_domain_size(const ec_domain_t *domain)
 {
-    return domain->data_size;
+    return domain->data_size + domain->spare_size;
+}
+
+/****************************************************************************/
+
+int ecrt_domain_reserve(ec_domain_t *domain, size_t size)
+{
+    EC_MASTER_DBG(domain->master, 1, "ecrt_domain_reserve(domain = 0x%p,"
+            " size = %zu)\n", domain, size);
+
+    if (domain->master->active) {
+        EC_MASTER_ERR(domain->master, "Spare process data can only be"
+                " reserved before activation!\n");
+        return -EBUSY;
+    }
+
+    domain->spare_size = size;
+    return 0;
 }
 
 /****************************************************************************/
@@ -437,6 +838,14 @@ void ecrt_domain_external_memory(ec_domain_t *domain, uint8_t *mem)
 
     down(&domain->master->master_sem);
 
+    if (domain->master->active) {
+        // the datagrams point into the current memory
+        EC_MASTER_ERR(domain->master, "Domain %u: External memory can not"
+                " be set after activation.\n", domain->index);
+        up(&domain->master->master_sem);
+        return;
+    }
+
     ec_domain_clear_data(domain);
 
     domain->data = mem;
@@ -461,9 +870,8 @@ int ecrt_domain_process(ec_domain_t *domain)
 #if EC_MAX_NUM_DEVICES > 1
     uint16_t datagram_pair_wc, redundant_wc;
     unsigned int datagram_offset;
-    ec_fmmu_config_t *fmmu = list_first_entry(&domain->fmmu_configs,
-            ec_fmmu_config_t, list);
-    unsigned int redundancy;
+    ec_fmmu_config_t *fmmu;
+    unsigned int redundancy, fmmus_usable;
 #endif
     unsigned int dev_idx;
 #ifdef EC_RT_SYSLOG
@@ -474,6 +882,16 @@ int ecrt_domain_process(ec_domain_t *domain)
     EC_MASTER_DBG(domain->master, 1, "domain %u process\n", domain->index);
 #endif
 
+#if EC_MAX_NUM_DEVICES > 1
+    /* The FMMU list may be changed by ecrt_slave_config_release() or
+     * ecrt_slave_config_apply(). In this case, the data change detection is
+     * skipped for one cycle (see ec_domain_lock_fmmus()). */
+    WRITE_ONCE(domain->processing, 1);
+    smp_mb();
+    fmmus_usable = !READ_ONCE(domain->fmmus_locked);
+    fmmu = list_first_entry(&domain->fmmu_configs, ec_fmmu_config_t, list);
+#endif
+
     list_for_each_entry(pair, &domain->datagram_pairs, list) {
 #if EC_MAX_NUM_DEVICES > 1
         datagram_pair_wc = ec_datagram_pair_process(pair, wc_sum);
@@ -482,7 +900,7 @@ int ecrt_domain_process(ec_domain_t *domain)
 #endif
 
 #if EC_MAX_NUM_DEVICES > 1
-        if (ec_master_num_devices(domain->master) > 1) {
+        if (ec_master_num_devices(domain->master) > 1 && fmmus_usable) {
             ec_datagram_t *main_datagram = &pair->datagrams[EC_DEVICE_MAIN];
             uint32_t logical_datagram_address =
                 EC_READ_U32(main_datagram->address);
@@ -563,6 +981,9 @@ int ecrt_domain_process(ec_domain_t *domain)
     }
 
 #if EC_MAX_NUM_DEVICES > 1
+    smp_mb();
+    WRITE_ONCE(domain->processing, 0);
+
     redundant_wc = 0;
     for (dev_idx = EC_DEVICE_BACKUP;
             dev_idx < ec_master_num_devices(domain->master); dev_idx++) {
@@ -708,6 +1129,7 @@ int ecrt_domain_state(const ec_domain_t *domain, ec_domain_state_t *state)
 
 EXPORT_SYMBOL(ecrt_domain_reg_pdo_entry_list);
 EXPORT_SYMBOL(ecrt_domain_size);
+EXPORT_SYMBOL(ecrt_domain_reserve);
 EXPORT_SYMBOL(ecrt_domain_external_memory);
 EXPORT_SYMBOL(ecrt_domain_data);
 EXPORT_SYMBOL(ecrt_domain_process);
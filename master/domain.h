@@ -50,11 +50,26 @@ struct ec_domain
     unsigned int index; /**< Index (just a number). */
 
     struct list_head fmmu_configs; /**< FMMU configurations contained. */
+    unsigned int fmmus_locked; /**< Non-zero, while \a fmmu_configs is
+                                 changed after activation (see
+                                 ec_domain_lock_fmmus()). */
+    unsigned int processing; /**< Non-zero, while ecrt_domain_process()
+                               evaluates \a fmmu_configs. */
     size_t data_size; /**< Size of the process data. */
     uint8_t *data; /**< Memory for the process data. */
     ec_origin_t data_origin; /**< Origin of the \a data memory. */
+    struct page **user_pages; /**< Pinned pages of userspace memory, that
+                                is used as external memory. */
+    unsigned int user_page_count; /**< Number of \a user_pages. */
+    void *user_mapping; /**< Kernel mapping of \a user_pages. */
+    size_t user_size; /**< Usable size of the userspace memory. */
     uint32_t logical_base_address; /**< Logical offset address of the
                                      process data. */
+    size_t spare_size; /**< Spare process data size, that is appended on
+                         activation (see ecrt_domain_reserve()). */
+    size_t spare_start; /**< Offset of the spare area. */
+    size_t spare_offset; /**< Offset of the unused part of the spare
+                           area. */
     struct list_head datagram_pairs; /**< Datagrams pairs (main/backup) for
                                        process data exchange. */
     uint16_t working_counter[EC_MAX_NUM_DEVICES]; /**< Last working counter
@@ -73,6 +88,11 @@ void ec_domain_clear(ec_domain_t *);
 
 void ec_domain_add_fmmu_config(ec_domain_t *, ec_fmmu_config_t *);
 int ec_domain_finish(ec_domain_t *, uint32_t);
+int ec_domain_user_memory(ec_domain_t *, unsigned long);
+int ec_domain_map_fmmu_config(ec_domain_t *, ec_fmmu_config_t *);
+void ec_domain_update_working_counters(ec_domain_t *);
+void ec_domain_lock_fmmus(ec_domain_t *);
+void ec_domain_unlock_fmmus(ec_domain_t *);
 
 unsigned int ec_domain_fmmu_count(const ec_domain_t *);
 const ec_fmmu_config_t *ec_domain_find_fmmu(const ec_domain_t *, unsigned int);
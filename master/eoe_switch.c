@@ -0,0 +1,601 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * EoE switch.
+ *
+ * The switch learns the source MAC addresses of the frames received from the
+ * EoE slaves and from the aggregated host interface. Frames for a known
+ * address are forwarded to that port only, broadcast, multicast and unknown
+ * unicast frames are flooded to all other ports.
+ */
+
+/****************************************************************************/
+
+#include <linux/version.h>
+#include <linux/netdevice.h>
+#include <linux/etherdevice.h>
+#include <linux/jhash.h>
+#include <linux/skbuff.h>
+#include <linux/slab.h>
+
+#include "globals.h"
+#include "master.h"
+#include "slave.h"
+#include "ethernet.h"
+#include "eoe_switch.h"
+
+#if defined(CONFIG_SUSE_KERNEL) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 14, 0)
+#include <linux/suse_version.h>
+#else
+#  ifndef SUSE_VERSION
+#    define SUSE_VERSION 0
+#  endif
+#  ifndef SUSE_PATCHLEVEL
+#    define SUSE_PATCHLEVEL 0
+#  endif
+#endif
+
+/****************************************************************************/
+
+/** Time after which a learned address is forgotten.
+ */
+#define EC_EOE_SWITCH_AGEING_TIME (300 * HZ)
+
+/** Maximum number of frames in the switch queue of a port.
+ */
+#define EC_EOE_SWITCH_QUEUE_SIZE 100
+
+/****************************************************************************/
+
+// net_device functions
+int ec_eoe_switch_dev_open(struct net_device *);
+int ec_eoe_switch_dev_stop(struct net_device *);
+int ec_eoe_switch_dev_tx(struct sk_buff *, struct net_device *);
+struct net_device_stats *ec_eoe_switch_dev_stats(struct net_device *);
+
+/****************************************************************************/
+
+/** Device operations for the aggregated EoE interface.
+ */
+static const struct net_device_ops ec_eoe_switch_dev_ops = {
+    .ndo_open = ec_eoe_switch_dev_open,
+    .ndo_stop = ec_eoe_switch_dev_stop,
+    .ndo_start_xmit = ec_eoe_switch_dev_tx,
+    .ndo_get_stats = ec_eoe_switch_dev_stats,
+};
+
+/****************************************************************************/
+
+/** EoE switch constructor.
+ *
+ * Creates and registers the aggregated host interface eoe\<MASTER\>.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+int ec_eoe_switch_init(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        ec_master_t *master /**< EtherCAT master. */
+        )
+{
+    ec_eoe_switch_t **priv;
+    char name[EC_DATAGRAM_NAME_SIZE];
+    u8 mac_addr[ETH_ALEN] = {0x02, 0x11, 0x22, 0x33, 0x44, 0x00};
+    int ret;
+
+    sw->master = master;
+    memset(&sw->stats, 0, sizeof(struct net_device_stats));
+    sw->opened = 0;
+    spin_lock_init(&sw->lock);
+    INIT_LIST_HEAD(&sw->ports);
+    memset(sw->fdb, 0, sizeof(sw->fdb));
+    sw->forwarded = 0;
+
+    snprintf(name, EC_DATAGRAM_NAME_SIZE, "eoe%u", master->index);
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 17, 0)
+    sw->dev = alloc_netdev(sizeof(ec_eoe_switch_t *), name,
+            NET_NAME_UNKNOWN, ether_setup);
+#else
+    sw->dev = alloc_netdev(sizeof(ec_eoe_switch_t *), name, ether_setup);
+#endif
+    if (!sw->dev) {
+        EC_MASTER_ERR(master, "Unable to allocate net_device %s"
+                " for EoE switch!\n", name);
+        return -ENODEV;
+    }
+
+    sw->dev->netdev_ops = &ec_eoe_switch_dev_ops;
+
+    priv = netdev_priv(sw->dev);
+    *priv = sw;
+
+    ret = register_netdev(sw->dev);
+    if (ret) {
+        EC_MASTER_ERR(master, "Unable to register net_device:"
+                " error %i\n", ret);
+        free_netdev(sw->dev);
+        sw->dev = NULL;
+        return ret;
+    }
+
+    // make the last address octet unique
+    mac_addr[ETH_ALEN - 1] = (uint8_t) sw->dev->ifindex;
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 15, 0) || (SUSE_VERSION == 15 && SUSE_PATCHLEVEL >= 5)
+    eth_hw_addr_set(sw->dev, mac_addr);
+#else
+    memcpy(sw->dev->dev_addr, mac_addr, sizeof(mac_addr));
+#endif
+
+    EC_MASTER_INFO(master, "EoE switch %s created.\n", name);
+    return 0;
+}
+
+/****************************************************************************/
+
+/** EoE switch destructor.
+ *
+ * All handlers have to be detached before.
+ */
+void ec_eoe_switch_clear(
+        ec_eoe_switch_t *sw /**< EoE switch. */
+        )
+{
+    unregister_netdev(sw->dev); // possibly calls close callback
+    free_netdev(sw->dev);
+}
+
+/****************************************************************************/
+
+/** Frees all frames in the switch queue of a port.
+ *
+ * The switch lock has to be held.
+ */
+static void ec_eoe_switch_flush_port(
+        ec_eoe_t *port /**< EoE handler. */
+        )
+{
+    ec_eoe_frame_t *frame, *next;
+
+    list_for_each_entry_safe(frame, next, &port->sw_queue, queue) {
+        list_del(&frame->queue);
+        dev_kfree_skb_any(frame->skb);
+        kfree(frame);
+    }
+    port->sw_queued_frames = 0;
+}
+
+/****************************************************************************/
+
+/** Attaches an EoE handler to the switch.
+ */
+void ec_eoe_switch_attach(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        ec_eoe_t *port /**< EoE handler. */
+        )
+{
+    spin_lock_bh(&sw->lock);
+    list_add_tail(&port->sw_list, &sw->ports);
+    port->sw = sw;
+    spin_unlock_bh(&sw->lock);
+
+    if (sw->opened) {
+        port->rx_idle = 0;
+        port->tx_idle = 0;
+        ec_slave_request_state(port->slave, EC_SLAVE_STATE_OP);
+    }
+}
+
+/****************************************************************************/
+
+/** Detaches an EoE handler from the switch.
+ *
+ * Frees the frames queued for the handler and removes its addresses from
+ * the learning table.
+ */
+void ec_eoe_switch_detach(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        ec_eoe_t *port /**< EoE handler. */
+        )
+{
+    unsigned int i;
+
+    spin_lock_bh(&sw->lock);
+    list_del(&port->sw_list);
+    ec_eoe_switch_flush_port(port);
+    for (i = 0; i < EC_EOE_SWITCH_FDB_SIZE; i++) {
+        if (sw->fdb[i].used && sw->fdb[i].port == port) {
+            sw->fdb[i].used = 0;
+        }
+    }
+    port->sw = NULL;
+    spin_unlock_bh(&sw->lock);
+}
+
+/****************************************************************************/
+
+/** Returns the learning table entry for a MAC address.
+ */
+static ec_eoe_switch_fdb_t *ec_eoe_switch_fdb(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        const uint8_t *mac /**< MAC address. */
+        )
+{
+    return &sw->fdb[jhash(mac, ETH_ALEN, 0) % EC_EOE_SWITCH_FDB_SIZE];
+}
+
+/****************************************************************************/
+
+/** Learns the port of a source MAC address.
+ *
+ * The switch lock has to be held.
+ */
+static void ec_eoe_switch_learn(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        const uint8_t *mac, /**< Source MAC address. */
+        ec_eoe_t *port /**< Input port, or NULL for the host. */
+        )
+{
+    ec_eoe_switch_fdb_t *entry;
+
+    if (!is_valid_ether_addr(mac)) {
+        return;
+    }
+
+    entry = ec_eoe_switch_fdb(sw, mac);
+    memcpy(entry->mac, mac, ETH_ALEN);
+    entry->port = port;
+    entry->jiffies = jiffies;
+    entry->used = 1;
+}
+
+/****************************************************************************/
+
+/** Looks up the port of a destination MAC address.
+ *
+ * The switch lock has to be held.
+ *
+ * \return Non-zero, if the address is known.
+ */
+static int ec_eoe_switch_lookup(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        const uint8_t *mac, /**< Destination MAC address. */
+        ec_eoe_t **port /**< Output port, or NULL for the host. */
+        )
+{
+    ec_eoe_switch_fdb_t *entry;
+
+    if (ether_addr_equal(mac, sw->dev->dev_addr)) {
+        *port = NULL;
+        return 1;
+    }
+
+    entry = ec_eoe_switch_fdb(sw, mac);
+    if (!entry->used || !ether_addr_equal(entry->mac, mac)) {
+        return 0;
+    }
+
+    if (time_after(jiffies, entry->jiffies + EC_EOE_SWITCH_AGEING_TIME)) {
+        entry->used = 0;
+        return 0;
+    }
+
+    *port = entry->port;
+    return 1;
+}
+
+/****************************************************************************/
+
+/** Appends a frame to the switch queue of a port.
+ *
+ * The frame is dropped, if the port is not open or its queue is full. This
+ * limits the share of each port, so that a busy slave can not block the
+ * others. The switch lock has to be held.
+ */
+static void ec_eoe_switch_enqueue(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        ec_eoe_t *port, /**< Output port. */
+        struct sk_buff *skb /**< Frame. */
+        )
+{
+    ec_eoe_frame_t *frame;
+
+    if (!ec_eoe_is_open(port)
+            || port->sw_queued_frames >= EC_EOE_SWITCH_QUEUE_SIZE) {
+        port->stats.tx_dropped++;
+        dev_kfree_skb_any(skb);
+        return;
+    }
+
+    frame = kmalloc(sizeof(ec_eoe_frame_t), GFP_ATOMIC);
+    if (!frame) {
+        port->stats.tx_dropped++;
+        dev_kfree_skb_any(skb);
+        return;
+    }
+
+    frame->skb = skb;
+    list_add_tail(&frame->queue, &port->sw_queue);
+    port->sw_queued_frames++;
+}
+
+/****************************************************************************/
+
+/** Floods a frame to all ports except the input port.
+ *
+ * The switch lock has to be held.
+ *
+ * \return Copy of the frame for the host, or NULL.
+ */
+static struct sk_buff *ec_eoe_switch_flood(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        ec_eoe_t *in, /**< Input port, or NULL for the host. */
+        struct sk_buff *skb /**< Frame. It is consumed. */
+        )
+{
+    ec_eoe_t *port;
+    struct sk_buff *copy;
+
+    list_for_each_entry(port, &sw->ports, sw_list) {
+        if (port == in || !ec_eoe_is_open(port)) {
+            continue;
+        }
+        copy = skb_clone(skb, GFP_ATOMIC);
+        if (copy) {
+            ec_eoe_switch_enqueue(sw, port, copy);
+        }
+        else {
+            port->stats.tx_dropped++;
+        }
+    }
+
+    if (in && sw->opened) {
+        return skb;
+    }
+
+    dev_kfree_skb_any(skb);
+    return NULL;
+}
+
+/****************************************************************************/
+
+/** Passes a frame received from a slave to the switch.
+ *
+ * The frame is forwarded to other slaves directly, or handed to the network
+ * stack via the aggregated host interface. Frames, that are not forwarded to
+ * another slave, are also returned for the slave's own interface, if it is
+ * opened, so that it keeps working in switch mode.
+ *
+ * \return Frame for the interface of the input port, or NULL.
+ */
+struct sk_buff *ec_eoe_switch_rx(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        ec_eoe_t *in, /**< Input port. */
+        struct sk_buff *skb /**< Received frame. It is consumed. */
+        )
+{
+    const struct ethhdr *eth;
+    struct sk_buff *host_skb = NULL, *local_skb = NULL;
+    ec_eoe_t *port;
+
+    if (skb->len < ETH_HLEN) {
+        in->stats.rx_errors++;
+        dev_kfree_skb_any(skb);
+        return NULL;
+    }
+
+    eth = (const struct ethhdr *) skb->data;
+
+    spin_lock_bh(&sw->lock);
+
+    ec_eoe_switch_learn(sw, eth->h_source, in);
+
+    if (is_multicast_ether_addr(eth->h_dest)
+            || !ec_eoe_switch_lookup(sw, eth->h_dest, &port)) {
+        if (in->opened) {
+            local_skb = skb_clone(skb, GFP_ATOMIC);
+            if (!local_skb) {
+                in->stats.rx_dropped++;
+            }
+        }
+        host_skb = ec_eoe_switch_flood(sw, in, skb);
+    }
+    else if (!port) {
+        if (sw->opened) {
+            host_skb = skb;
+        }
+        else if (in->opened) {
+            local_skb = skb;
+        }
+        else {
+            dev_kfree_skb_any(skb);
+        }
+    }
+    else if (port == in) {
+        // destination is on the same segment
+        dev_kfree_skb_any(skb);
+    }
+    else {
+        ec_eoe_switch_enqueue(sw, port, skb);
+        sw->forwarded++;
+    }
+
+    spin_unlock_bh(&sw->lock);
+
+    if (!host_skb) {
+        return local_skb;
+    }
+
+    sw->stats.rx_packets++;
+    sw->stats.rx_bytes += host_skb->len;
+
+    host_skb->dev = sw->dev;
+    host_skb->protocol = eth_type_trans(host_skb, sw->dev);
+    host_skb->ip_summed = CHECKSUM_UNNECESSARY;
+    if (netif_rx(host_skb)) {
+        EC_MASTER_WARN(sw->master, "EoE switch RX netif_rx failed.\n");
+    }
+
+    return local_skb;
+}
+
+/****************************************************************************/
+
+/** Takes the next frame out of the switch queue of a port.
+ *
+ * \return Frame, or NULL if the queue is empty.
+ */
+ec_eoe_frame_t *ec_eoe_switch_dequeue(
+        ec_eoe_switch_t *sw, /**< EoE switch. */
+        ec_eoe_t *port /**< EoE handler. */
+        )
+{
+    ec_eoe_frame_t *frame = NULL;
+
+    spin_lock_bh(&sw->lock);
+    if (!list_empty(&port->sw_queue)) {
+        frame = list_first_entry(&port->sw_queue, ec_eoe_frame_t, queue);
+        list_del(&frame->queue);
+        port->sw_queued_frames--;
+    }
+    spin_unlock_bh(&sw->lock);
+
+    return frame;
+}
+
+/*****************************************************************************
+ *  NET_DEVICE functions
+ ****************************************************************************/
+
+/** Opens the aggregated interface.
+ *
+ * All attached slaves are requested to go to OP.
+ *
+ * \return Always zero (success).
+ */
+int ec_eoe_switch_dev_open(struct net_device *dev /**< Host interface. */)
+{
+    ec_eoe_switch_t *sw = *((ec_eoe_switch_t **) netdev_priv(dev));
+    ec_eoe_t *port;
+
+    spin_lock_bh(&sw->lock);
+    sw->opened = 1;
+    list_for_each_entry(port, &sw->ports, sw_list) {
+        port->rx_idle = 0;
+        port->tx_idle = 0;
+        ec_slave_request_state(port->slave, EC_SLAVE_STATE_OP);
+    }
+    spin_unlock_bh(&sw->lock);
+
+    netif_start_queue(dev);
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Stops the aggregated interface.
+ *
+ * Slaves, whose own interface is not opened, are requested to go to PREOP.
+ *
+ * \return Always zero (success).
+ */
+int ec_eoe_switch_dev_stop(struct net_device *dev /**< Host interface. */)
+{
+    ec_eoe_switch_t *sw = *((ec_eoe_switch_t **) netdev_priv(dev));
+    ec_eoe_t *port;
+
+    netif_stop_queue(dev);
+
+    spin_lock_bh(&sw->lock);
+    sw->opened = 0;
+    list_for_each_entry(port, &sw->ports, sw_list) {
+        if (!port->opened) {
+            ec_eoe_switch_flush_port(port);
+            port->rx_idle = 1;
+            port->tx_idle = 1;
+            ec_slave_request_state(port->slave, EC_SLAVE_STATE_PREOP);
+        }
+    }
+    spin_unlock_bh(&sw->lock);
+
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Transmits a frame from the host to the slaves.
+ *
+ * \return Always zero (success).
+ */
+int ec_eoe_switch_dev_tx(
+        struct sk_buff *skb, /**< Transmit socket buffer. */
+        struct net_device *dev /**< Host interface. */
+        )
+{
+    ec_eoe_switch_t *sw = *((ec_eoe_switch_t **) netdev_priv(dev));
+    const struct ethhdr *eth;
+    ec_eoe_t *port;
+
+    if (skb->len < ETH_HLEN) {
+        sw->stats.tx_errors++;
+        dev_kfree_skb_any(skb);
+        return 0;
+    }
+
+    sw->stats.tx_packets++;
+    sw->stats.tx_bytes += skb->len;
+
+    eth = (const struct ethhdr *) skb->data;
+
+    spin_lock_bh(&sw->lock);
+
+    ec_eoe_switch_learn(sw, eth->h_source, NULL);
+
+    if (is_multicast_ether_addr(eth->h_dest)
+            || !ec_eoe_switch_lookup(sw, eth->h_dest, &port)) {
+        ec_eoe_switch_flood(sw, NULL, skb);
+    }
+    else if (!port) {
+        dev_kfree_skb_any(skb);
+    }
+    else {
+        ec_eoe_switch_enqueue(sw, port, skb);
+    }
+
+    spin_unlock_bh(&sw->lock);
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Gets statistics about the aggregated interface.
+ *
+ * \return Statistics.
+ */
+struct net_device_stats *ec_eoe_switch_dev_stats(
+        struct net_device *dev /**< Host interface. */
+        )
+{
+    ec_eoe_switch_t *sw = *((ec_eoe_switch_t **) netdev_priv(dev));
+    return &sw->stats;
+}
+
+/****************************************************************************/
@@ -0,0 +1,89 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * EoE switch.
+ */
+
+/****************************************************************************/
+
+#ifndef __EC_EOE_SWITCH_H__
+#define __EC_EOE_SWITCH_H__
+
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/spinlock.h>
+
+#include "globals.h"
+#include "ethernet.h"
+
+/****************************************************************************/
+
+/** Number of entries in the MAC learning table.
+ */
+#define EC_EOE_SWITCH_FDB_SIZE 256
+
+/** Entry of the MAC learning table.
+ */
+typedef struct {
+    uint8_t mac[ETH_ALEN]; /**< MAC address. */
+    unsigned int used; /**< The entry is in use. */
+    ec_eoe_t *port; /**< EoE handler the address was learned on, or NULL
+                      for the host interface. */
+    unsigned long jiffies; /**< Time of the last frame from the address. */
+} ec_eoe_switch_fdb_t;
+
+/****************************************************************************/
+
+/** EoE switch.
+ *
+ * The switch connects the EoE handlers of a master with each other and with
+ * one aggregated network interface for the host. Frames between slaves are
+ * forwarded inside the master, without passing the network stack.
+ */
+struct ec_eoe_switch {
+    ec_master_t *master; /**< Master owning the switch. */
+    struct net_device *dev; /**< Aggregated host interface. */
+    struct net_device_stats stats; /**< Statistics of the host interface. */
+    unsigned int opened; /**< Host interface is opened. */
+    spinlock_t lock; /**< Protects the ports, the table and the switch
+                       queues of the ports. */
+    struct list_head ports; /**< EoE handlers attached to the switch. */
+    ec_eoe_switch_fdb_t fdb[EC_EOE_SWITCH_FDB_SIZE]; /**< MAC learning
+                                                       table. */
+    unsigned long forwarded; /**< Frames forwarded between slaves. */
+};
+
+/****************************************************************************/
+
+int ec_eoe_switch_init(ec_eoe_switch_t *, ec_master_t *);
+void ec_eoe_switch_clear(ec_eoe_switch_t *);
+void ec_eoe_switch_attach(ec_eoe_switch_t *, ec_eoe_t *);
+void ec_eoe_switch_detach(ec_eoe_switch_t *, ec_eoe_t *);
+struct sk_buff *ec_eoe_switch_rx(ec_eoe_switch_t *, ec_eoe_t *,
+        struct sk_buff *);
+ec_eoe_frame_t *ec_eoe_switch_dequeue(ec_eoe_switch_t *, ec_eoe_t *);
+
+/****************************************************************************/
+
+#endif
+
+/****************************************************************************/
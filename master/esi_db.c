@@ -0,0 +1,323 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * EtherCAT device description database methods.
+ */
+
+/****************************************************************************/
+
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/err.h>
+
+#include "slave.h"
+#include "pdo.h"
+#include "esi_db.h"
+
+/****************************************************************************/
+
+/** Constructor.
+ */
+void ec_esi_db_init(
+        ec_esi_db_t *db /**< Device database. */
+        )
+{
+    db->data = NULL;
+    db->size = 0;
+    db->record_count = 0;
+}
+
+/****************************************************************************/
+
+/** Destructor.
+ */
+void ec_esi_db_clear(
+        ec_esi_db_t *db /**< Device database. */
+        )
+{
+    if (db->data) {
+        vfree(db->data);
+    }
+
+    ec_esi_db_init(db);
+}
+
+/****************************************************************************/
+
+/** Checks a single device record for consistency.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static int ec_esi_db_check_record(
+        const uint8_t *rec, /**< Record data. */
+        size_t rec_size /**< Record size. */
+        )
+{
+    const uint8_t *p = rec + EC_ESI_DB_RECORD_SIZE,
+          *end = rec + rec_size;
+    unsigned int i, pdo_count, dc_count, cmd_count, entry_count;
+    uint16_t data_size;
+    uint8_t sync_index;
+
+    pdo_count = EC_READ_U8(rec + 21);
+    dc_count = EC_READ_U8(rec + 22);
+    cmd_count = EC_READ_U8(rec + 23);
+
+    for (i = 0; i < pdo_count; i++) {
+        if (p + EC_ESI_DB_PDO_SIZE > end) {
+            return -EINVAL;
+        }
+        sync_index = EC_READ_U8(p + 2);
+        if (sync_index != EC_ESI_DB_NO_SYNC
+                && sync_index >= EC_MAX_SYNC_MANAGERS) {
+            return -EINVAL;
+        }
+        entry_count = EC_READ_U8(p + 3);
+        p += EC_ESI_DB_PDO_SIZE + entry_count * EC_ESI_DB_ENTRY_SIZE;
+        if (p > end) {
+            return -EINVAL;
+        }
+    }
+
+    p += dc_count * EC_ESI_DB_DC_SIZE;
+    if (p > end) {
+        return -EINVAL;
+    }
+
+    for (i = 0; i < cmd_count; i++) {
+        if (p + EC_ESI_DB_INIT_CMD_SIZE > end) {
+            return -EINVAL;
+        }
+        data_size = EC_READ_U16(p + 4);
+        p += EC_ESI_DB_INIT_CMD_SIZE + data_size;
+        if (p > end) {
+            return -EINVAL;
+        }
+    }
+
+    return p == end ? 0 : -EINVAL;
+}
+
+/****************************************************************************/
+
+/** Replaces the database contents with a new image.
+ *
+ * The image is validated first. On success, the database takes ownership of
+ * \a data, which must have been allocated with vmalloc(). On failure, the
+ * previous contents are kept and the caller still owns \a data.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+int ec_esi_db_load(
+        ec_esi_db_t *db, /**< Device database. */
+        uint8_t *data, /**< Database image. */
+        size_t size /**< Size of \a data in bytes. */
+        )
+{
+    const uint8_t *rec;
+    unsigned int i, record_count;
+    size_t offset = EC_ESI_DB_HEADER_SIZE;
+    uint32_t rec_size;
+
+    if (size < EC_ESI_DB_HEADER_SIZE
+            || EC_READ_U32(data) != EC_ESI_DB_MAGIC) {
+        EC_ERR("Invalid device database image.\n");
+        return -EINVAL;
+    }
+
+    if (EC_READ_U16(data + 4) != EC_ESI_DB_VERSION) {
+        EC_ERR("Unsupported device database version %u.\n",
+                EC_READ_U16(data + 4));
+        return -EPROTO;
+    }
+
+    record_count = EC_READ_U16(data + 6);
+
+    for (i = 0; i < record_count; i++) {
+        if (offset + EC_ESI_DB_RECORD_SIZE > size) {
+            EC_ERR("Device database truncated at record %u.\n", i);
+            return -EINVAL;
+        }
+        rec = data + offset;
+        rec_size = EC_READ_U32(rec);
+        if (rec_size < EC_ESI_DB_RECORD_SIZE || rec_size > size - offset
+                || ec_esi_db_check_record(rec, rec_size)) {
+            EC_ERR("Device database record %u is corrupted.\n", i);
+            return -EINVAL;
+        }
+        offset += rec_size;
+    }
+
+    if (offset != size) {
+        EC_ERR("Device database has %zu bytes of trailing garbage.\n",
+                size - offset);
+        return -EINVAL;
+    }
+
+    ec_esi_db_clear(db);
+    db->data = data;
+    db->size = size;
+    db->record_count = record_count;
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Looks up the record of a device.
+ *
+ * \return Pointer to the record data, or NULL if the device is unknown.
+ */
+const uint8_t *ec_esi_db_find(
+        const ec_esi_db_t *db, /**< Device database. */
+        uint32_t vendor_id, /**< Vendor ID. */
+        uint32_t product_code, /**< Product code. */
+        uint32_t revision_number /**< Revision number. */
+        )
+{
+    const uint8_t *rec;
+    unsigned int i;
+
+    if (!db->data) {
+        return NULL;
+    }
+
+    rec = db->data + EC_ESI_DB_HEADER_SIZE;
+    for (i = 0; i < db->record_count; i++) {
+        if (EC_READ_U32(rec + 4) == vendor_id
+                && EC_READ_U32(rec + 8) == product_code
+                && EC_READ_U32(rec + 12) == revision_number) {
+            return rec;
+        }
+        rec += EC_READ_U32(rec);
+    }
+
+    return NULL;
+}
+
+/****************************************************************************/
+
+/** Returns the flags of a device record.
+ *
+ * \return Bitwise combination of EC_ESI_DB_FLAG_* values.
+ */
+uint8_t ec_esi_db_record_flags(
+        const uint8_t *rec /**< Record data. */
+        )
+{
+    return EC_READ_U8(rec + 20);
+}
+
+/****************************************************************************/
+
+/** Returns the maximum mailbox sizes of a device record.
+ *
+ * The sizes are zero, if the ESI does not specify them.
+ */
+void ec_esi_db_mailbox_max(
+        const uint8_t *rec, /**< Record data. */
+        uint16_t *rx_size, /**< Maximum receive mailbox size. */
+        uint16_t *tx_size /**< Maximum send mailbox size. */
+        )
+{
+    *rx_size = EC_READ_U16(rec + 24);
+    *tx_size = EC_READ_U16(rec + 26);
+}
+
+/****************************************************************************/
+
+/** Sets the PDO assignment and mapping of a slave from a device record.
+ *
+ * Replaces the PDOs of all sync managers that the record assigns PDOs to.
+ * This makes the slave appear as if its PDO configuration was read via CoE.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+int ec_esi_db_apply_pdos(
+        const uint8_t *rec, /**< Record data. */
+        ec_slave_t *slave /**< EtherCAT slave. */
+        )
+{
+    const uint8_t *p = rec + EC_ESI_DB_RECORD_SIZE;
+    unsigned int i, j, pdo_count, entry_count;
+    uint32_t cleared = 0;
+    uint8_t sync_index;
+    ec_sync_t *sync;
+    ec_pdo_t pdo;
+    ec_pdo_entry_t *entry;
+    int ret = 0;
+
+    if (EC_READ_U16(rec + 16) != slave->sii.std_rx_mailbox_size
+            || EC_READ_U16(rec + 18) != slave->sii.std_tx_mailbox_size) {
+        EC_SLAVE_DBG(slave, 1, "Mailbox sizes differ from ESI"
+                " (SII %u/%u, ESI %u/%u).\n",
+                slave->sii.std_rx_mailbox_size,
+                slave->sii.std_tx_mailbox_size,
+                EC_READ_U16(rec + 16), EC_READ_U16(rec + 18));
+    }
+
+    pdo_count = EC_READ_U8(rec + 21);
+
+    for (i = 0; i < pdo_count; i++) {
+        sync_index = EC_READ_U8(p + 2);
+        entry_count = EC_READ_U8(p + 3);
+
+        if (sync_index >= EC_MAX_SYNC_MANAGERS
+                || !(sync = ec_slave_get_sync(slave, sync_index))) {
+            p += EC_ESI_DB_PDO_SIZE + entry_count * EC_ESI_DB_ENTRY_SIZE;
+            continue;
+        }
+
+        if (!(cleared & (1 << sync_index))) {
+            ec_pdo_list_clear_pdos(&sync->pdos);
+            cleared |= 1 << sync_index;
+        }
+
+        ec_pdo_init(&pdo);
+        pdo.index = EC_READ_U16(p);
+        pdo.sync_index = sync_index;
+        p += EC_ESI_DB_PDO_SIZE;
+
+        for (j = 0; j < entry_count; j++) {
+            entry = ec_pdo_add_entry(&pdo, EC_READ_U16(p),
+                    EC_READ_U8(p + 2), EC_READ_U8(p + 3));
+            if (IS_ERR(entry)) {
+                ec_pdo_clear(&pdo);
+                return PTR_ERR(entry);
+            }
+            p += EC_ESI_DB_ENTRY_SIZE;
+        }
+
+        ret = ec_sync_add_pdo(sync, &pdo);
+        ec_pdo_clear(&pdo);
+        if (ret) {
+            return ret;
+        }
+    }
+
+    EC_SLAVE_DBG(slave, 1, "Took PDO configuration of %u PDOs,"
+            " %u DC modes and %u init commands from device database.\n",
+            pdo_count, EC_READ_U8(rec + 22), EC_READ_U8(rec + 23));
+    return 0;
+}
+
+/****************************************************************************/
@@ -0,0 +1,121 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/**
+   \file
+   EtherCAT device description database.
+
+   The database is a binary image compiled from EtherCAT Slave Information
+   (ESI) files by the command-line tool (see 'ethercat esi_compile'). All
+   numbers are stored in little-endian byte order. The image is laid out as
+   follows:
+
+   - Header (#EC_ESI_DB_HEADER_SIZE bytes): magic (uint32), format version
+     (uint16), number of device records (uint16).
+   - Device records, each starting with a record header
+     (#EC_ESI_DB_RECORD_SIZE bytes): record size including the header
+     (uint32), vendor ID (uint32), product code (uint32), revision number
+     (uint32), default receive mailbox size (uint16), default send mailbox
+     size (uint16), flags (uint8), number of PDOs (uint8), number of DC
+     operation modes (uint8), number of CoE init commands (uint8), maximum
+     receive mailbox size (uint16) and maximum send mailbox size (uint16).
+     The maximum sizes are zero, if the ESI does not specify them.
+   - Per PDO (#EC_ESI_DB_PDO_SIZE bytes): PDO index (uint16), sync manager
+     the PDO is assigned to by default or #EC_ESI_DB_NO_SYNC (uint8), number
+     of entries (uint8), followed by the entries (#EC_ESI_DB_ENTRY_SIZE
+     bytes each): index (uint16), subindex (uint8), bit length (uint8).
+   - Per DC operation mode (#EC_ESI_DB_DC_SIZE bytes): AssignActivate word
+     (uint16), SYNC0 cycle time factor (int16), SYNC1 cycle time factor
+     (int16), reserved (uint16).
+   - Per init command (#EC_ESI_DB_INIT_CMD_SIZE bytes): SDO index (uint16),
+     subindex (uint8), transition mask (uint8, see #EC_ESI_DB_TRANSITION_IP
+     and following), data size (uint16), followed by the data.
+*/
+
+/****************************************************************************/
+
+#ifndef __EC_ESI_DB_H__
+#define __EC_ESI_DB_H__
+
+#include "globals.h"
+
+/****************************************************************************/
+
+/** Magic number of a device database image ("ECDB"). */
+#define EC_ESI_DB_MAGIC 0x42444345
+
+/** Current device database format version. */
+#define EC_ESI_DB_VERSION 2
+
+/** Maximum size of a device database image in bytes. */
+#define EC_ESI_DB_MAX_SIZE (4 * 1024 * 1024)
+
+#define EC_ESI_DB_HEADER_SIZE 8 /**< Size of the image header. */
+#define EC_ESI_DB_RECORD_SIZE 28 /**< Size of a device record header. */
+#define EC_ESI_DB_PDO_SIZE 4 /**< Size of a PDO description. */
+#define EC_ESI_DB_ENTRY_SIZE 4 /**< Size of a PDO entry description. */
+#define EC_ESI_DB_DC_SIZE 8 /**< Size of a DC operation mode. */
+#define EC_ESI_DB_INIT_CMD_SIZE 6 /**< Size of an init command header. */
+
+/** Sync manager index of PDOs that are not assigned by default. */
+#define EC_ESI_DB_NO_SYNC 0xff
+
+/** Record flag: Use the record instead of reading the PDO assignment and
+ * mapping via CoE during the bus scan. */
+#define EC_ESI_DB_FLAG_PDOS 0x01
+
+/** Record flag: Do not upload the SDO dictionary of matching slaves. */
+#define EC_ESI_DB_FLAG_NO_DICT 0x02
+
+#define EC_ESI_DB_TRANSITION_IP 0x01 /**< Init command for INIT->PREOP. */
+#define EC_ESI_DB_TRANSITION_PS 0x02 /**< Init command for PREOP->SAFEOP. */
+#define EC_ESI_DB_TRANSITION_SO 0x04 /**< Init command for SAFEOP->OP. */
+#define EC_ESI_DB_TRANSITION_SP 0x08 /**< Init command for SAFEOP->PREOP. */
+#define EC_ESI_DB_TRANSITION_OS 0x10 /**< Init command for OP->SAFEOP. */
+
+/****************************************************************************/
+
+#ifdef __KERNEL__
+
+/** Device description database.
+ */
+typedef struct {
+    uint8_t *data; /**< Validated database image. */
+    size_t size; /**< Size of \a data in bytes. */
+    unsigned int record_count; /**< Number of device records. */
+} ec_esi_db_t;
+
+/****************************************************************************/
+
+void ec_esi_db_init(ec_esi_db_t *);
+void ec_esi_db_clear(ec_esi_db_t *);
+int ec_esi_db_load(ec_esi_db_t *, uint8_t *, size_t);
+const uint8_t *ec_esi_db_find(const ec_esi_db_t *, uint32_t, uint32_t,
+        uint32_t);
+uint8_t ec_esi_db_record_flags(const uint8_t *);
+void ec_esi_db_mailbox_max(const uint8_t *, uint16_t *, uint16_t *);
+int ec_esi_db_apply_pdos(const uint8_t *, ec_slave_t *);
+
+#endif
+
+/****************************************************************************/
+
+#endif
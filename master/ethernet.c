@@ -37,6 +37,7 @@
 #include "slave.h"
 #include "mailbox.h"
 #include "ethernet.h"
+#include "eoe_switch.h"
 
 #if defined(CONFIG_SUSE_KERNEL) && LINUX_VERSION_CODE >= KERNEL_VERSION(5, 14, 0)
 #include <linux/suse_version.h>
@@ -122,6 +123,7 @@ int ec_eoe_init(
 
     ec_datagram_init(&eoe->datagram);
     eoe->queue_datagram = 0;
+    ec_mbox_repeat_init(&eoe->repeat);
     eoe->state = ec_eoe_state_rx_start;
     eoe->opened = 0;
     eoe->rx_skb = NULL;
@@ -143,6 +145,11 @@ int ec_eoe_init(
     eoe->rx_idle = 1;
     eoe->tx_idle = 1;
 
+    eoe->sw = NULL;
+    INIT_LIST_HEAD(&eoe->sw_queue);
+    eoe->sw_queued_frames = 0;
+    eoe->tx_from_switch = 0;
+
     /* device name eoe<MASTER>[as]<SLAVE>, because networking scripts don't
      * like hyphens etc. in interface names. */
     if (slave->effective_alias) {
@@ -205,6 +212,10 @@ int ec_eoe_init(
     memcpy(eoe->dev->dev_addr, mac_addr, sizeof(mac_addr));
 #endif
 
+    if (slave->master->eoe_switch) {
+        ec_eoe_switch_attach(slave->master->eoe_switch, eoe);
+    }
+
     return 0;
 
  out_free:
@@ -222,6 +233,10 @@ int ec_eoe_init(
  */
 void ec_eoe_clear(ec_eoe_t *eoe /**< EoE handler */)
 {
+    if (eoe->sw) {
+        ec_eoe_switch_detach(eoe->sw, eoe);
+    }
+
     unregister_netdev(eoe->dev); // possibly calls close callback
 
     // empty transmit queue
@@ -342,11 +357,12 @@ int ec_eoe_send(ec_eoe_t *eoe /**< EoE handler */)
  */
 void ec_eoe_run(ec_eoe_t *eoe /**< EoE handler */)
 {
-    if (!eoe->opened)
+    if (!ec_eoe_is_open(eoe))
         return;
 
     // if the datagram was not sent, or is not yet received, skip this cycle
-    if (eoe->queue_datagram || eoe->datagram.state == EC_DATAGRAM_SENT)
+    if (eoe->queue_datagram || eoe->datagram.state == EC_DATAGRAM_QUEUED
+            || eoe->datagram.state == EC_DATAGRAM_SENT)
         return;
 
     // call state function
@@ -379,12 +395,15 @@ void ec_eoe_queue(ec_eoe_t *eoe /**< EoE handler */)
 /****************************************************************************/
 
 /** Returns the state of the device.
+ *
+ * A handler attached to the EoE switch is also open, if the aggregated
+ * interface is "up".
  *
  * \return 1 if the device is "up", 0 if it is "down"
  */
 int ec_eoe_is_open(const ec_eoe_t *eoe /**< EoE handler */)
 {
-    return eoe->opened;
+    return eoe->opened || (eoe->sw && eoe->sw->opened);
 }
 
 /****************************************************************************/
@@ -475,6 +494,12 @@ void ec_eoe_state_rx_fetch(ec_eoe_t *eoe /**< EoE handler */)
     unsigned int i;
 #endif
 
+    if (ec_slave_mbox_repeat(eoe->slave, &eoe->repeat, &eoe->datagram,
+                &eoe->datagram)) {
+        eoe->queue_datagram = 1;
+        return;
+    }
+
     if (eoe->datagram.state != EC_DATAGRAM_RECEIVED) {
         eoe->stats.rx_errors++;
 #if EOE_DEBUG_LEVEL >= 1
@@ -609,12 +634,19 @@ void ec_eoe_state_rx_fetch(ec_eoe_t *eoe /**< EoE handler */)
                 " with %u octets.\n", eoe->dev->name, eoe->rx_skb->len);
 #endif
 
-        // pass socket buffer to network stack
-        eoe->rx_skb->dev = eoe->dev;
-        eoe->rx_skb->protocol = eth_type_trans(eoe->rx_skb, eoe->dev);
-        eoe->rx_skb->ip_summed = CHECKSUM_UNNECESSARY;
-        if (netif_rx(eoe->rx_skb)) {
-            EC_SLAVE_WARN(eoe->slave, "EoE RX netif_rx failed.\n");
+        if (eoe->sw) {
+            // forward to other slaves or to the aggregated interface
+            eoe->rx_skb = ec_eoe_switch_rx(eoe->sw, eoe, eoe->rx_skb);
+        }
+
+        if (eoe->rx_skb) {
+            // pass socket buffer to network stack
+            eoe->rx_skb->dev = eoe->dev;
+            eoe->rx_skb->protocol = eth_type_trans(eoe->rx_skb, eoe->dev);
+            eoe->rx_skb->ip_summed = CHECKSUM_UNNECESSARY;
+            if (netif_rx(eoe->rx_skb)) {
+                EC_SLAVE_WARN(eoe->slave, "EoE RX netif_rx failed.\n");
+            }
         }
         eoe->rx_skb = NULL;
 
@@ -652,10 +684,44 @@ void ec_eoe_state_tx_start(ec_eoe_t *eoe /**< EoE handler */)
         return;
     }
 
-    netif_tx_lock_bh(eoe->dev);
+    eoe->tx_frame = NULL;
+
+    // frames forwarded by the switch and frames of the own interface are
+    // served alternately
+    if (eoe->sw && eoe->tx_from_switch) {
+        eoe->tx_frame = ec_eoe_switch_dequeue(eoe->sw, eoe);
+    }
+
+    if (!eoe->tx_frame) {
+        netif_tx_lock_bh(eoe->dev);
+
+        if (eoe->tx_queued_frames && !list_empty(&eoe->tx_queue)) {
+            // take the first frame out of the queue
+            eoe->tx_frame =
+                list_entry(eoe->tx_queue.next, ec_eoe_frame_t, queue);
+            list_del(&eoe->tx_frame->queue);
+            if (!eoe->tx_queue_active &&
+                eoe->tx_queued_frames == eoe->tx_queue_size / 2) {
+                netif_wake_queue(eoe->dev);
+                eoe->tx_queue_active = 1;
+#if EOE_DEBUG_LEVEL >= 2
+                wakeup = 1;
+#endif
+            }
+
+            eoe->tx_queued_frames--;
+        }
 
-    if (!eoe->tx_queued_frames || list_empty(&eoe->tx_queue)) {
         netif_tx_unlock_bh(eoe->dev);
+    }
+
+    if (!eoe->tx_frame && eoe->sw && !eoe->tx_from_switch) {
+        eoe->tx_frame = ec_eoe_switch_dequeue(eoe->sw, eoe);
+    }
+
+    eoe->tx_from_switch = !eoe->tx_from_switch;
+
+    if (!eoe->tx_frame) {
         eoe->tx_idle = 1;
         // no data available.
         // start a new receive immediately.
@@ -663,21 +729,6 @@ void ec_eoe_state_tx_start(ec_eoe_t *eoe /**< EoE handler */)
         return;
     }
 
-    // take the first frame out of the queue
-    eoe->tx_frame = list_entry(eoe->tx_queue.next, ec_eoe_frame_t, queue);
-    list_del(&eoe->tx_frame->queue);
-    if (!eoe->tx_queue_active &&
-        eoe->tx_queued_frames == eoe->tx_queue_size / 2) {
-        netif_wake_queue(eoe->dev);
-        eoe->tx_queue_active = 1;
-#if EOE_DEBUG_LEVEL >= 2
-        wakeup = 1;
-#endif
-    }
-
-    eoe->tx_queued_frames--;
-    netif_tx_unlock_bh(eoe->dev);
-
     eoe->tx_idle = 0;
 
     eoe->tx_frame_number++;
@@ -806,15 +857,18 @@ int ec_eoedev_stop(struct net_device *dev /**< EoE net_device */)
 {
     ec_eoe_t *eoe = *((ec_eoe_t **) netdev_priv(dev));
     netif_stop_queue(dev);
-    eoe->rx_idle = 1;
-    eoe->tx_idle = 1;
     eoe->tx_queue_active = 0;
     eoe->opened = 0;
     ec_eoe_flush(eoe);
 #if EOE_DEBUG_LEVEL >= 2
     EC_SLAVE_DBG(eoe->slave, 0, "%s stopped.\n", dev->name);
 #endif
-    ec_slave_request_state(eoe->slave, EC_SLAVE_STATE_PREOP);
+    if (!ec_eoe_is_open(eoe)) {
+        // the aggregated interface of the switch is not using the slave
+        eoe->rx_idle = 1;
+        eoe->tx_idle = 1;
+        ec_slave_request_state(eoe->slave, EC_SLAVE_STATE_PREOP);
+    }
     return 0;
 }
 
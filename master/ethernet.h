@@ -35,6 +35,7 @@
 #include "globals.h"
 #include "slave.h"
 #include "datagram.h"
+#include "mailbox.h"
 
 /****************************************************************************/
 
@@ -65,6 +66,8 @@ ec_eoe_frame_t;
 
 typedef struct ec_eoe ec_eoe_t; /**< \see ec_eoe */
 
+typedef struct ec_eoe_switch ec_eoe_switch_t; /**< \see ec_eoe_switch */
+
 /**
    Ethernet over EtherCAT (EoE) handler.
    The master creates one of these objects for each slave that supports the
@@ -77,6 +80,7 @@ struct ec_eoe
     ec_slave_t *slave; /**< pointer to the corresponding slave */
     ec_datagram_t datagram; /**< datagram */
     unsigned int queue_datagram; /**< the datagram is ready for queuing */
+    ec_mbox_repeat_t repeat; /**< repeat of lost mailbox responses */
     void (*state)(ec_eoe_t *); /**< state function for the state machine */
     struct net_device *dev; /**< net_device for virtual ethernet device */
     struct net_device_stats stats; /**< device statistics */
@@ -103,6 +107,14 @@ struct ec_eoe
     uint32_t tx_rate; /**< transmit rate (bps) */
     unsigned int tx_idle; /**< Idle flag. */
 
+    ec_eoe_switch_t *sw; /**< Switch the handler is attached to, or NULL. */
+    struct list_head sw_list; /**< Item in the port list of the switch. */
+    struct list_head sw_queue; /**< Frames forwarded by the switch,
+                                 protected by the switch lock. */
+    unsigned int sw_queued_frames; /**< Number of frames in \a sw_queue. */
+    unsigned int tx_from_switch; /**< Serve \a sw_queue before \a tx_queue
+                                   in the next transmit sequence. */
+
     unsigned int tries; /**< Tries. */
 };
 
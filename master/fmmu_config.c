@@ -37,9 +37,13 @@
  *
  * Inits an FMMU configuration, sets the logical start address and adds the
  * process data size for the mapped PDOs of the given direction to the domain
- * data size.
+ * data size. If the master is already active, the FMMU is mapped into the
+ * spare area of the domain instead.
+ *
+ * \retval  0 Success.
+ * \retval <0 Error code.
  */
-void ec_fmmu_config_init(
+int ec_fmmu_config_init(
         ec_fmmu_config_t *fmmu, /**< EtherCAT FMMU configuration. */
         ec_slave_config_t *sc, /**< EtherCAT slave configuration. */
         ec_domain_t *domain, /**< EtherCAT domain. */
@@ -52,11 +56,19 @@ void ec_fmmu_config_init(
     fmmu->sync_index = sync_index;
     fmmu->dir = dir;
 
-    fmmu->logical_start_address = domain->data_size;
     fmmu->data_size = ec_pdo_list_total_size(
             &sc->sync_configs[sync_index].pdos);
 
+    if (domain->master->active) {
+        fmmu->area_size = 0;
+        return ec_domain_map_fmmu_config(domain, fmmu);
+    }
+
+    fmmu->logical_start_address = domain->data_size;
+    fmmu->area_size = fmmu->data_size;
+
     ec_domain_add_fmmu_config(domain, fmmu);
+    return 0;
 }
 
 /****************************************************************************/
@@ -84,7 +96,8 @@ void ec_fmmu_config_page(
     EC_WRITE_U16(data + 8,  sync->physical_start_address);
     EC_WRITE_U8 (data + 10, 0x00); // physical start bit
     EC_WRITE_U8 (data + 11, fmmu->dir == EC_DIR_INPUT ? 0x01 : 0x02);
-    EC_WRITE_U16(data + 12, 0x0001); // enable
+    // a released FMMU without data stays disabled
+    EC_WRITE_U16(data + 12, fmmu->data_size ? 0x0001 : 0x0000); // enable
     EC_WRITE_U16(data + 14, 0x0000); // reserved
 }
 
@@ -43,11 +43,13 @@ typedef struct {
     ec_direction_t dir; /**< FMMU direction. */
     uint32_t logical_start_address; /**< Logical start address. */
     unsigned int data_size; /**< Covered PDO size. */
+    unsigned int area_size; /**< Size of the logical address range, that is
+                              reserved for the FMMU. */
 } ec_fmmu_config_t;
 
 /****************************************************************************/
 
-void ec_fmmu_config_init(ec_fmmu_config_t *, ec_slave_config_t *,
+int ec_fmmu_config_init(ec_fmmu_config_t *, ec_slave_config_t *,
         ec_domain_t *, uint8_t, ec_direction_t);
 
 void ec_fmmu_config_page(const ec_fmmu_config_t *, const ec_sync_t *,
@@ -58,6 +58,7 @@ void ec_fsm_change_init(ec_fsm_change_t *fsm, /**< finite state machine */
     fsm->state = NULL;
     fsm->datagram = datagram;
     fsm->spontaneous_change = 0;
+    fsm->al_status_code = 0;
 }
 
 /****************************************************************************/
@@ -128,6 +129,7 @@ void ec_fsm_change_start(ec_fsm_change_t *fsm, /**< finite state machine */
     fsm->mode = EC_FSM_CHANGE_MODE_FULL;
     fsm->slave = slave;
     fsm->requested_state = state;
+    fsm->al_status_code = 0;
     fsm->state = ec_fsm_change_state_start;
 }
 
@@ -144,6 +146,7 @@ void ec_fsm_change_ack(ec_fsm_change_t *fsm, /**< finite state machine */
     fsm->mode = EC_FSM_CHANGE_MODE_ACK_ONLY;
     fsm->slave = slave;
     fsm->requested_state = EC_SLAVE_STATE_UNKNOWN;
+    fsm->al_status_code = 0;
     fsm->state = ec_fsm_change_state_start_code;
 }
 
@@ -463,6 +466,7 @@ void ec_fsm_change_state_code(ec_fsm_change_t *fsm
         ec_datagram_print_wc_error(datagram);
     } else {
         code = EC_READ_U16(datagram->data);
+        fsm->al_status_code = code;
         for (al_msg = al_status_messages; al_msg->code != 0xffff; al_msg++) {
             if (al_msg->code != code) {
                 continue;
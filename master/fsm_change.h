@@ -66,6 +66,8 @@ struct ec_fsm_change
     unsigned long jiffies_start; /**< change timer */
     uint8_t take_time; /**< take sending timestamp */
     uint8_t spontaneous_change; /**< spontaneous state change detected */
+    uint16_t al_status_code; /**< AL status code of a refused state change,
+                               or zero */
 };
 
 /****************************************************************************/
@@ -178,6 +178,7 @@ void ec_fsm_coe_init(
 {
     fsm->state = NULL;
     fsm->datagram = NULL;
+    ec_mbox_repeat_init(&fsm->repeat);
 }
 
 /****************************************************************************/
@@ -513,8 +514,7 @@ void ec_fsm_coe_dict_response(
     bool first_segment;
     size_t index_list_offset;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
         return;
     }
 
@@ -794,8 +794,7 @@ void ec_fsm_coe_dict_desc_response(
     uint8_t *data, mbox_prot;
     size_t rec_size, name_size;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
         return;
     }
 
@@ -1030,8 +1029,7 @@ void ec_fsm_coe_dict_entry_response(
     ec_sdo_entry_t *entry;
     u16 word;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
         return;
     }
 
@@ -1545,8 +1543,7 @@ void ec_fsm_coe_down_response(
     size_t rec_size;
     ec_sdo_request_t *request = fsm->request;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
         return;
     }
 
@@ -1723,8 +1720,7 @@ void ec_fsm_coe_down_seg_response(
     size_t rec_size;
     ec_sdo_request_t *request = fsm->request;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
         return;
     }
 
@@ -2085,8 +2081,7 @@ void ec_fsm_coe_up_response(
     unsigned int expedited, size_specified;
     int ret;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
         return;
     }
 
@@ -2381,8 +2376,7 @@ void ec_fsm_coe_up_seg_response(
     ec_sdo_request_t *request = fsm->request;
     unsigned int last_segment;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
         return;
     }
 
@@ -32,6 +32,7 @@
 #include "globals.h"
 #include "datagram.h"
 #include "slave.h"
+#include "mailbox.h"
 #include "sdo.h"
 #include "sdo_request.h"
 
@@ -44,6 +45,7 @@ typedef struct ec_fsm_coe ec_fsm_coe_t; /**< \see ec_fsm_coe */
 struct ec_fsm_coe {
     ec_slave_t *slave; /**< slave the FSM runs on */
     unsigned int retries; /**< retries upon datagram timeout */
+    ec_mbox_repeat_t repeat; /**< Repeat of lost mailbox responses. */
 
     void (*state)(ec_fsm_coe_t *, ec_datagram_t *); /**< CoE state function */
     ec_datagram_t *datagram; /**< Datagram used in last step. */
@@ -82,6 +82,7 @@ void ec_fsm_eoe_init(
     fsm->retries = 0;
     fsm->state = NULL;
     fsm->datagram = NULL;
+    ec_mbox_repeat_init(&fsm->repeat);
     fsm->jiffies_start = 0;
     fsm->request = NULL;
     fsm->frame_type_retries = 0;
@@ -404,8 +405,7 @@ void ec_fsm_eoe_set_ip_response(
     size_t rec_size;
     ec_eoe_request_t *req = fsm->request;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
         return;
     }
 
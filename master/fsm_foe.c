@@ -98,6 +98,7 @@ void ec_fsm_foe_init(
 {
     fsm->state = NULL;
     fsm->datagram = NULL;
+    ec_mbox_repeat_init(&fsm->repeat);
 }
 
 /****************************************************************************/
@@ -395,6 +396,10 @@ void ec_fsm_foe_state_ack_read(
     EC_SLAVE_DBG(fsm->slave, 0, "%s()\n", __func__);
 #endif
 
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
+        return;
+    }
+
     if (fsm->datagram->state != EC_DATAGRAM_RECEIVED) {
         ec_foe_set_rx_error(fsm, FOE_RECEIVE_ERROR);
         EC_SLAVE_ERR(slave, "Failed to receive FoE ack response datagram: ");
@@ -734,6 +739,10 @@ void ec_fsm_foe_state_data_read(
     EC_SLAVE_DBG(fsm->slave, 0, "%s()\n", __func__);
 #endif
 
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
+        return;
+    }
+
     if (fsm->datagram->state != EC_DATAGRAM_RECEIVED) {
         ec_foe_set_rx_error(fsm, FOE_RECEIVE_ERROR);
         EC_SLAVE_ERR(slave, "Failed to receive FoE DATA READ datagram: ");
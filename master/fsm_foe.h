@@ -34,6 +34,7 @@
 #include "../include/ecrt.h"
 #include "datagram.h"
 #include "slave.h"
+#include "mailbox.h"
 #include "foe_request.h"
 
 /****************************************************************************/
@@ -45,6 +46,7 @@ typedef struct ec_fsm_foe ec_fsm_foe_t; /**< \see ec_fsm_foe */
 struct ec_fsm_foe {
     ec_slave_t *slave; /**< Slave the FSM runs on. */
     unsigned int retries; /**< Retries upon datagram timeout */
+    ec_mbox_repeat_t repeat; /**< Repeat of lost mailbox responses. */
 
     void (*state)(ec_fsm_foe_t *, ec_datagram_t *); /**< FoE state function.
                                                      */
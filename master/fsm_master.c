@@ -629,6 +629,7 @@ void ec_fsm_master_action_idle(
                 || (slave->sii.has_general
                     && !slave->sii.coe_details.enable_sdo_info)
                 || slave->sdo_dictionary_fetched
+                || slave->esi_db_flags & EC_ESI_DB_FLAG_NO_DICT
                 || slave->current_state == EC_SLAVE_STATE_INIT
                 || slave->current_state == EC_SLAVE_STATE_UNKNOWN
                 || jiffies - slave->jiffies_preop < EC_WAIT_SDO_DICT * HZ
@@ -709,6 +710,13 @@ void ec_fsm_master_action_configure(
         return;
     }
 
+    if (slave->warm_hold && slave->current_state != EC_SLAVE_STATE_OP) {
+        EC_SLAVE_WARN(slave, "Left OP during warm restart.\n");
+        slave->warm_hold = 0;
+        slave->force_config = 1;
+        ec_slave_request_state(slave, EC_SLAVE_STATE_PREOP);
+    }
+
     // Does the slave have to be configured?
     if ((slave->current_state != slave->requested_state
                 || slave->force_config) && !slave->error_flag) {
@@ -54,10 +54,15 @@
 
 // prototypes for private methods
 int ec_fsm_slave_config_running(const ec_fsm_slave_config_t *);
+void ec_fsm_slave_config_mbox_pages(ec_slave_t *, uint8_t *);
+void ec_fsm_slave_config_pdo_sync_page(const ec_slave_t *, uint8_t,
+        uint8_t *);
 
 /****************************************************************************/
 
 void ec_fsm_slave_config_state_start(ec_fsm_slave_config_t *);
+void ec_fsm_slave_config_state_fast_read(ec_fsm_slave_config_t *);
+void ec_fsm_slave_config_state_fast_write(ec_fsm_slave_config_t *);
 void ec_fsm_slave_config_state_init(ec_fsm_slave_config_t *);
 void ec_fsm_slave_config_state_clear_fmmus(ec_fsm_slave_config_t *);
 void ec_fsm_slave_config_state_clear_sync(ec_fsm_slave_config_t *);
@@ -87,6 +92,8 @@ void ec_fsm_slave_config_state_safeop(ec_fsm_slave_config_t *);
 void ec_fsm_slave_config_state_soe_conf_safeop(ec_fsm_slave_config_t *);
 void ec_fsm_slave_config_state_op(ec_fsm_slave_config_t *);
 
+void ec_fsm_slave_config_enter_fast_read(ec_fsm_slave_config_t *);
+void ec_fsm_slave_config_enter_fast_write(ec_fsm_slave_config_t *);
 void ec_fsm_slave_config_enter_init(ec_fsm_slave_config_t *);
 void ec_fsm_slave_config_enter_clear_sync(ec_fsm_slave_config_t *);
 void ec_fsm_slave_config_enter_dc_clear_assign(ec_fsm_slave_config_t *);
@@ -224,7 +231,26 @@ void ec_fsm_slave_config_state_start(
         ec_fsm_slave_config_t *fsm /**< slave state machine */
         )
 {
-    EC_SLAVE_DBG(fsm->slave, 1, "Configuring...\n");
+    ec_slave_t *slave = fsm->slave;
+
+    EC_SLAVE_DBG(slave, 1, "Configuring...\n");
+
+    /* A configured slave, that is still in PREOP, keeps its mailbox. Only
+     * the registers that differ from the configuration have to be written
+     * then, instead of going through INIT. */
+    if (slave->config
+            && slave->current_state == EC_SLAVE_STATE_PREOP
+            && slave->requested_state != EC_SLAVE_STATE_INIT
+            && slave->requested_state != EC_SLAVE_STATE_BOOT
+            && slave->base_fmmu_count <= EC_MAX_FMMUS
+            && slave->base_sync_count <= EC_MAX_SYNC_MANAGERS
+            && slave->config->used_fmmus <= slave->base_fmmu_count
+            && (!slave->sii.mailbox_protocols
+                || slave->base_sync_count >= 2)) {
+        ec_fsm_slave_config_enter_fast_read(fsm);
+        return;
+    }
+
     ec_fsm_slave_config_enter_init(fsm);
 }
 
@@ -236,6 +262,7 @@ void ec_fsm_slave_config_enter_init(
         ec_fsm_slave_config_t *fsm /**< slave state machine */
         )
 {
+    fsm->fast = 0;
     ec_fsm_change_start(fsm->fsm_change, fsm->slave, EC_SLAVE_STATE_INIT);
     ec_fsm_change_exec(fsm->fsm_change);
     fsm->state = ec_fsm_slave_config_state_init;
@@ -424,44 +451,134 @@ void ec_fsm_slave_config_state_dc_clear_assign(
 
 /****************************************************************************/
 
-/** Check for mailbox sync managers to be configured.
+/** Returns the mailbox size requested by the slave configuration.
+ *
+ * \return Mailbox size in byte.
  */
-void ec_fsm_slave_config_enter_mbox_sync(
-        ec_fsm_slave_config_t *fsm /**< slave state machine */
+static uint16_t ec_fsm_slave_config_mbox_size(
+        uint16_t requested, /**< Requested size, zero for the default, or
+                              #EC_MAILBOX_SIZE_MAX. */
+        uint16_t default_size, /**< Default size from the SII. */
+        uint16_t esi_max /**< Maximum size from the device database, or
+                           zero. */
         )
 {
-    ec_slave_t *slave = fsm->slave;
-    ec_datagram_t *datagram = fsm->datagram;
-    unsigned int i;
+    if (!requested) {
+        return default_size;
+    }
 
-    // slave is now in INIT
-    if (slave->current_state == slave->requested_state) {
-        fsm->state = ec_fsm_slave_config_state_end; // successful
-        EC_SLAVE_DBG(slave, 1, "Finished configuration.\n");
+    if (requested != EC_MAILBOX_SIZE_MAX) {
+        return requested;
+    }
+
+    if (esi_max > EC_MAX_DATA_SIZE) {
+        return EC_MAX_DATA_SIZE;
+    }
+
+    return esi_max > default_size ? esi_max : default_size;
+}
+
+/****************************************************************************/
+
+/** Applies the mailbox sizes requested by the slave configuration.
+ *
+ * Resized mailboxes are placed back to back at the lower of the default
+ * offsets. They have to end before the next process data sync manager and
+ * before the end of the process data RAM, otherwise the defaults are kept.
+ * Sizes requested with #EC_MAILBOX_SIZE_MAX are reduced to fit.
+ */
+static void ec_fsm_slave_config_mbox_resize(
+        ec_slave_t *slave, /**< EtherCAT slave. */
+        uint16_t *rx_offset, /**< Receive mailbox offset. */
+        uint16_t *rx_size, /**< Receive mailbox size. */
+        uint16_t *tx_offset, /**< Send mailbox offset. */
+        uint16_t *tx_size /**< Send mailbox size. */
+        )
+{
+    const ec_slave_config_t *sc = slave->config;
+    unsigned int i, start, end, space, rx, tx;
+    int rx_auto, tx_auto;
+
+    if (!sc || (!sc->mbox_rx_size && !sc->mbox_tx_size)
+            || slave->mbox_size_fallback) {
         return;
     }
 
-    if (!slave->sii.mailbox_protocols) {
-        // no mailbox protocols supported
-        EC_SLAVE_DBG(slave, 1, "Slave does not support"
-                " mailbox communication.\n");
-#ifdef EC_SII_ASSIGN
-        ec_fsm_slave_config_enter_assign_pdi(fsm);
-#else
-        ec_fsm_slave_config_enter_boot_preop(fsm);
-#endif
+    rx = ec_fsm_slave_config_mbox_size(sc->mbox_rx_size, *rx_size,
+            slave->esi_rx_mailbox_max);
+    tx = ec_fsm_slave_config_mbox_size(sc->mbox_tx_size, *tx_size,
+            slave->esi_tx_mailbox_max);
+    if (rx == *rx_size && tx == *tx_size) {
         return;
     }
 
-    EC_SLAVE_DBG(slave, 1, "Configuring mailbox sync managers...\n");
+    // the process data RAM starts at 0x1000
+    start = min(*rx_offset, *tx_offset);
+    end = 0x1000 + slave->base_ram_size * 1024;
+    for (i = 2; i < slave->sii.sync_count; i++) {
+        unsigned int address = slave->sii.syncs[i].physical_start_address;
+        if (address > start && address < end) {
+            end = address;
+        }
+    }
+    space = end > start ? end - start : 0;
+
+    rx_auto = sc->mbox_rx_size == EC_MAILBOX_SIZE_MAX;
+    tx_auto = sc->mbox_tx_size == EC_MAILBOX_SIZE_MAX;
+
+    if (rx + tx > space) {
+        if (rx_auto && tx_auto) {
+            // share the space, but keep a smaller mailbox as it is
+            rx = min(rx, space - min(tx, space / 2));
+            tx = min(tx, space - rx);
+        } else if (rx_auto && tx < space) {
+            rx = space - tx;
+        } else if (tx_auto && rx < space) {
+            tx = space - rx;
+        }
+    }
+
+    if (rx + tx > space || (rx_auto && rx < *rx_size)
+            || (tx_auto && tx < *tx_size)) {
+        EC_SLAVE_WARN(slave, "Mailboxes with %u/%u bytes do not fit into"
+                " the %u bytes at 0x%04X. Using the default sizes.\n",
+                rx, tx, space, start);
+        return;
+    }
+
+    EC_SLAVE_DBG(slave, 1, "Resizing mailboxes from %u/%u to %u/%u bytes.\n",
+            *rx_size, *tx_size, rx, tx);
+
+    if (*rx_offset <= *tx_offset) {
+        *rx_offset = start;
+        *tx_offset = start + rx;
+    } else {
+        *tx_offset = start;
+        *rx_offset = start + tx;
+    }
+    *rx_size = rx;
+    *tx_size = tx;
+    slave->mbox_resized = 1;
+}
+
+/****************************************************************************/
+
+/** Fills in the mailbox sync manager configuration pages.
+ *
+ * Also stores the configured mailbox offsets and sizes.
+ */
+void ec_fsm_slave_config_mbox_pages(
+        ec_slave_t *slave, /**< EtherCAT slave. */
+        uint8_t *data /**< Memory for two sync manager pages. */
+        )
+{
+    unsigned int i;
+
+    slave->mbox_resized = 0;
 
     if (slave->requested_state == EC_SLAVE_STATE_BOOT) {
         ec_sync_t sync;
 
-        ec_datagram_fpwr(datagram, slave->station_address, 0x0800,
-                EC_SYNC_PAGE_SIZE * 2);
-        ec_datagram_zero(datagram);
-
         ec_sync_init(&sync, slave);
         sync.physical_start_address = slave->sii.boot_rx_mailbox_offset;
         sync.control_register = 0x26;
@@ -469,7 +586,7 @@ void ec_fsm_slave_config_enter_mbox_sync(
         ec_sync_page(&sync, 0, slave->sii.boot_rx_mailbox_size,
                 EC_DIR_INVALID, // use default direction
                 0, // no PDO xfer
-                datagram->data);
+                data);
         slave->configured_rx_mailbox_offset =
             slave->sii.boot_rx_mailbox_offset;
         slave->configured_rx_mailbox_size =
@@ -482,70 +599,111 @@ void ec_fsm_slave_config_enter_mbox_sync(
         ec_sync_page(&sync, 1, slave->sii.boot_tx_mailbox_size,
                 EC_DIR_INVALID, // use default direction
                 0, // no PDO xfer
-                datagram->data + EC_SYNC_PAGE_SIZE);
+                data + EC_SYNC_PAGE_SIZE);
         slave->configured_tx_mailbox_offset =
             slave->sii.boot_tx_mailbox_offset;
         slave->configured_tx_mailbox_size =
             slave->sii.boot_tx_mailbox_size;
 
-    } else if (slave->sii.sync_count >= 2) { // mailbox configuration provided
-        ec_datagram_fpwr(datagram, slave->station_address, 0x0800,
-                EC_SYNC_PAGE_SIZE * slave->sii.sync_count);
-        ec_datagram_zero(datagram);
+    } else {
+        ec_sync_t sync[2];
+        uint16_t rx_size, tx_size;
+
+        for (i = 0; i < 2; i++) {
+            ec_sync_init(&sync[i], slave);
+        }
+
+        if (slave->sii.sync_count >= 2) { // mailbox configuration provided
+            for (i = 0; i < 2; i++) {
+                sync[i].physical_start_address =
+                    slave->sii.syncs[i].physical_start_address;
+                sync[i].control_register =
+                    slave->sii.syncs[i].control_register;
+                sync[i].enable = slave->sii.syncs[i].enable;
+            }
+            rx_size = slave->sii.syncs[0].default_length;
+            tx_size = slave->sii.syncs[1].default_length;
+        } else { // no mailbox sync manager configurations provided
+            EC_SLAVE_DBG(slave, 1, "Slave does not provide"
+                    " mailbox sync manager configurations.\n");
+
+            sync[0].physical_start_address =
+                slave->sii.std_rx_mailbox_offset;
+            sync[0].control_register = 0x26;
+            sync[0].enable = 1;
+            sync[1].physical_start_address =
+                slave->sii.std_tx_mailbox_offset;
+            sync[1].control_register = 0x22;
+            sync[1].enable = 1;
+            rx_size = slave->sii.std_rx_mailbox_size;
+            tx_size = slave->sii.std_tx_mailbox_size;
+        }
+
+        ec_fsm_slave_config_mbox_resize(slave,
+                &sync[0].physical_start_address, &rx_size,
+                &sync[1].physical_start_address, &tx_size);
 
         for (i = 0; i < 2; i++) {
-            ec_sync_page(&slave->sii.syncs[i], i,
-                    slave->sii.syncs[i].default_length,
+            ec_sync_page(&sync[i], i, i ? tx_size : rx_size,
                     NULL, // use default sync manager configuration
                     0, // no PDO xfer
-                    datagram->data + EC_SYNC_PAGE_SIZE * i);
+                    data + EC_SYNC_PAGE_SIZE * i);
         }
 
         slave->configured_rx_mailbox_offset =
-            slave->sii.syncs[0].physical_start_address;
-        slave->configured_rx_mailbox_size =
-            slave->sii.syncs[0].default_length;
+            sync[0].physical_start_address;
+        slave->configured_rx_mailbox_size = rx_size;
         slave->configured_tx_mailbox_offset =
-            slave->sii.syncs[1].physical_start_address;
-        slave->configured_tx_mailbox_size =
-            slave->sii.syncs[1].default_length;
-    } else { // no mailbox sync manager configurations provided
-        ec_sync_t sync;
+            sync[1].physical_start_address;
+        slave->configured_tx_mailbox_size = tx_size;
+    }
+}
 
-        EC_SLAVE_DBG(slave, 1, "Slave does not provide"
-                " mailbox sync manager configurations.\n");
+/****************************************************************************/
 
-        ec_datagram_fpwr(datagram, slave->station_address, 0x0800,
-                EC_SYNC_PAGE_SIZE * 2);
-        ec_datagram_zero(datagram);
+/** Check for mailbox sync managers to be configured.
+ */
+void ec_fsm_slave_config_enter_mbox_sync(
+        ec_fsm_slave_config_t *fsm /**< slave state machine */
+        )
+{
+    ec_slave_t *slave = fsm->slave;
+    ec_datagram_t *datagram = fsm->datagram;
+    unsigned int sync_count;
 
-        ec_sync_init(&sync, slave);
-        sync.physical_start_address = slave->sii.std_rx_mailbox_offset;
-        sync.control_register = 0x26;
-        sync.enable = 1;
-        ec_sync_page(&sync, 0, slave->sii.std_rx_mailbox_size,
-                NULL, // use default sync manager configuration
-                0, // no PDO xfer
-                datagram->data);
-        slave->configured_rx_mailbox_offset =
-            slave->sii.std_rx_mailbox_offset;
-        slave->configured_rx_mailbox_size =
-            slave->sii.std_rx_mailbox_size;
+    // slave is now in INIT
+    if (slave->current_state == slave->requested_state) {
+        fsm->state = ec_fsm_slave_config_state_end; // successful
+        EC_SLAVE_DBG(slave, 1, "Finished configuration.\n");
+        return;
+    }
 
-        ec_sync_init(&sync, slave);
-        sync.physical_start_address = slave->sii.std_tx_mailbox_offset;
-        sync.control_register = 0x22;
-        sync.enable = 1;
-        ec_sync_page(&sync, 1, slave->sii.std_tx_mailbox_size,
-                NULL, // use default sync manager configuration
-                0, // no PDO xfer
-                datagram->data + EC_SYNC_PAGE_SIZE);
-        slave->configured_tx_mailbox_offset =
-            slave->sii.std_tx_mailbox_offset;
-        slave->configured_tx_mailbox_size =
-            slave->sii.std_tx_mailbox_size;
+    if (!slave->sii.mailbox_protocols) {
+        // no mailbox protocols supported
+        EC_SLAVE_DBG(slave, 1, "Slave does not support"
+                " mailbox communication.\n");
+#ifdef EC_SII_ASSIGN
+        ec_fsm_slave_config_enter_assign_pdi(fsm);
+#else
+        ec_fsm_slave_config_enter_boot_preop(fsm);
+#endif
+        return;
     }
 
+    EC_SLAVE_DBG(slave, 1, "Configuring mailbox sync managers...\n");
+
+    if (slave->requested_state != EC_SLAVE_STATE_BOOT
+            && slave->sii.sync_count >= 2) { // mailbox configuration provided
+        sync_count = slave->sii.sync_count;
+    } else {
+        sync_count = 2;
+    }
+
+    ec_datagram_fpwr(datagram, slave->station_address, 0x0800,
+            EC_SYNC_PAGE_SIZE * sync_count);
+    ec_datagram_zero(datagram);
+    ec_fsm_slave_config_mbox_pages(slave, datagram->data);
+
     fsm->take_time = 1;
 
     fsm->retries = EC_FSM_RETRIES;
@@ -718,7 +876,13 @@ void ec_fsm_slave_config_state_boot_preop(
     }
 
     if (!ec_fsm_change_success(fsm->fsm_change)) {
-        if (!fsm->fsm_change->spontaneous_change)
+        if (slave->mbox_resized) {
+            // configure again with the default sizes
+            EC_SLAVE_WARN(slave, "Slave refused the resized mailboxes"
+                    " (AL status code 0x%04X). Falling back to the"
+                    " default sizes.\n", fsm->fsm_change->al_status_code);
+            slave->mbox_size_fallback = 1;
+        } else if (!fsm->fsm_change->spontaneous_change)
             slave->error_flag = 1;
         fsm->state = ec_fsm_slave_config_state_error;
         return;
@@ -1045,7 +1209,11 @@ void ec_fsm_slave_config_state_pdo_conf(
         EC_SLAVE_WARN(fsm->slave, "PDO configuration failed.\n");
     }
 
-    ec_fsm_slave_config_enter_watchdog_divider(fsm);
+    if (fsm->fast) {
+        ec_fsm_slave_config_enter_fast_write(fsm);
+    } else {
+        ec_fsm_slave_config_enter_watchdog_divider(fsm);
+    }
 }
 
 /****************************************************************************/
@@ -1173,10 +1341,7 @@ void ec_fsm_slave_config_enter_pdo_sync(
 {
     ec_slave_t *slave = fsm->slave;
     ec_datagram_t *datagram = fsm->datagram;
-    unsigned int i, j, offset, num_pdo_syncs;
-    uint8_t sync_index;
-    const ec_sync_t *sync;
-    uint16_t size;
+    unsigned int i, offset, num_pdo_syncs;
 
     if (slave->sii.mailbox_protocols) {
         offset = 2; // slave has mailboxes
@@ -1199,31 +1364,7 @@ void ec_fsm_slave_config_enter_pdo_sync(
     ec_datagram_zero(datagram);
 
     for (i = 0; i < num_pdo_syncs; i++) {
-        const ec_sync_config_t *sync_config;
-        uint8_t pdo_xfer = 0;
-        sync_index = i + offset;
-        sync = &slave->sii.syncs[sync_index];
-
-        if (slave->config) {
-            const ec_slave_config_t *sc = slave->config;
-            sync_config = &sc->sync_configs[sync_index];
-            size = ec_pdo_list_total_size(&sync_config->pdos);
-
-            // determine, if PDOs shall be transferred via this SM
-            // inthat case, enable sync manager in every case
-            for (j = 0; j < sc->used_fmmus; j++) {
-                if (sc->fmmu_configs[j].sync_index == sync_index) {
-                    pdo_xfer = 1;
-                    break;
-                }
-            }
-
-        } else {
-            sync_config = NULL;
-            size = sync->default_length;
-        }
-
-        ec_sync_page(sync, sync_index, size, sync_config, pdo_xfer,
+        ec_fsm_slave_config_pdo_sync_page(slave, i + offset,
                 datagram->data + EC_SYNC_PAGE_SIZE * i);
     }
 
@@ -1233,6 +1374,45 @@ void ec_fsm_slave_config_enter_pdo_sync(
 
 /****************************************************************************/
 
+/** Fills in the configuration page of a process data sync manager.
+ */
+void ec_fsm_slave_config_pdo_sync_page(
+        const ec_slave_t *slave, /**< EtherCAT slave. */
+        uint8_t sync_index, /**< Sync manager index (less than the SII sync
+                              manager count). */
+        uint8_t *data /**< Memory for the sync manager page. */
+        )
+{
+    const ec_sync_t *sync = &slave->sii.syncs[sync_index];
+    const ec_sync_config_t *sync_config;
+    uint8_t pdo_xfer = 0;
+    uint16_t size;
+    unsigned int j;
+
+    if (slave->config) {
+        const ec_slave_config_t *sc = slave->config;
+        sync_config = &sc->sync_configs[sync_index];
+        size = ec_pdo_list_total_size(&sync_config->pdos);
+
+        // determine, if PDOs shall be transferred via this SM
+        // inthat case, enable sync manager in every case
+        for (j = 0; j < sc->used_fmmus; j++) {
+            if (sc->fmmu_configs[j].sync_index == sync_index) {
+                pdo_xfer = 1;
+                break;
+            }
+        }
+
+    } else {
+        sync_config = NULL;
+        size = sync->default_length;
+    }
+
+    ec_sync_page(sync, sync_index, size, sync_config, pdo_xfer, data);
+}
+
+/****************************************************************************/
+
 /** Configure PDO sync managers.
  */
 void ec_fsm_slave_config_state_pdo_sync(
@@ -1825,6 +2005,457 @@ void ec_fsm_slave_config_state_op(
     fsm->state = ec_fsm_slave_config_state_end; // successful
 }
 
+/*****************************************************************************
+ *  Fast reconfiguration
+ ****************************************************************************/
+
+/** Fast path item: Watchdog divider. */
+#define EC_FAST_ITEM_WD_DIVIDER 0
+
+/** Fast path item: Process data watchdog intervals. */
+#define EC_FAST_ITEM_WD_INTERVALS 1
+
+/** Fast path items: Sync manager pages. */
+#define EC_FAST_ITEM_SYNC 2
+
+/** Fast path items: FMMU pages. */
+#define EC_FAST_ITEM_FMMU (EC_FAST_ITEM_SYNC + EC_MAX_SYNC_MANAGERS)
+
+/** Fast path item: DC activation. */
+#define EC_FAST_ITEM_DC (EC_FAST_ITEM_FMMU + EC_MAX_FMMUS)
+
+/** Number of fast path items. */
+#define EC_FAST_ITEM_COUNT (EC_FAST_ITEM_DC + 1)
+
+/****************************************************************************/
+
+/** Returns the mirror of an ESC register.
+ */
+static inline uint8_t *ec_fsm_slave_config_reg(
+        ec_fsm_slave_config_t *fsm, /**< slave state machine */
+        uint16_t address /**< Register address. */
+        )
+{
+    return fsm->regs + (address - EC_FSM_SLAVE_CONFIG_REG_START);
+}
+
+/****************************************************************************/
+
+/** Compares a sync manager page with the desired configuration.
+ *
+ * The status byte and the PDI control byte are not compared. The settings of
+ * a disabled sync manager do not matter.
+ *
+ * \return Non-zero, if the sync manager needs no write.
+ */
+static int ec_fsm_slave_config_sync_equal(
+        const uint8_t *have, /**< Current page. */
+        const uint8_t *want /**< Desired page. */
+        )
+{
+    if (!(want[6] & 0x01)) {
+        return !(have[6] & 0x01);
+    }
+
+    return (have[6] & 0x01) && !memcmp(have, want, 5);
+}
+
+/****************************************************************************/
+
+/** Compares an FMMU page with the desired configuration.
+ *
+ * The settings of a disabled FMMU do not matter.
+ *
+ * \return Non-zero, if the FMMU needs no write.
+ */
+static int ec_fsm_slave_config_fmmu_equal(
+        const uint8_t *have, /**< Current page. */
+        const uint8_t *want /**< Desired page. */
+        )
+{
+    if (!(want[12] & 0x01)) {
+        return !(have[12] & 0x01);
+    }
+
+    return !memcmp(have, want, 13);
+}
+
+/****************************************************************************/
+
+/** Determines a register block to read for the fast reconfiguration.
+ *
+ * \return Zero, if there are no more blocks.
+ */
+static int ec_fsm_slave_config_fast_block(
+        const ec_slave_t *slave, /**< EtherCAT slave. */
+        unsigned int block, /**< Block index. */
+        uint16_t *address, /**< Start address. */
+        size_t *size /**< Size of the block (may be zero). */
+        )
+{
+    switch (block) {
+        case 0: // watchdog divider and process data watchdog
+            *address = 0x0400;
+            *size = 0x22;
+            return 1;
+        case 1:
+            *address = 0x0600;
+            *size = EC_FMMU_PAGE_SIZE * slave->base_fmmu_count;
+            return 1;
+        case 2:
+            *address = 0x0800;
+            *size = EC_SYNC_PAGE_SIZE * slave->base_sync_count;
+            return 1;
+        case 3: // DC activation, start time and cycle times
+            *address = 0x0980;
+            *size = slave->base_dc_supported && slave->has_dc_system_time ?
+                0x28 : 0;
+            return 1;
+        default:
+            return 0;
+    }
+}
+
+/****************************************************************************/
+
+/** Prepares a register write for the fast reconfiguration.
+ */
+static void ec_fsm_slave_config_fast_fpwr(
+        ec_fsm_slave_config_t *fsm, /**< slave state machine */
+        uint16_t address, /**< Register address. */
+        const uint8_t *data, /**< Data to write. */
+        size_t size /**< Number of bytes. */
+        )
+{
+    ec_datagram_fpwr(fsm->datagram, fsm->slave->station_address,
+            address, size);
+    memcpy(fsm->datagram->data, data, size);
+    fsm->fast_address = address;
+    fsm->retries = EC_FSM_RETRIES;
+    fsm->state = ec_fsm_slave_config_state_fast_write;
+}
+
+/****************************************************************************/
+
+/** Searches for the next register item, that differs from the configuration,
+ * and prepares a write for it.
+ *
+ * \return 1, if a write was prepared, 0 if all items are up to date, or a
+ *         negative value on error.
+ */
+static int ec_fsm_slave_config_fast_next(
+        ec_fsm_slave_config_t *fsm /**< slave state machine */
+        )
+{
+    ec_slave_t *slave = fsm->slave;
+    const ec_slave_config_t *config = slave->config;
+    unsigned int pdo_offset = slave->sii.mailbox_protocols ? 2 : 0;
+    uint8_t want[EC_FMMU_PAGE_SIZE];
+    const uint8_t *have;
+    uint16_t address;
+    unsigned int i;
+
+    for (; fsm->fast_item < EC_FAST_ITEM_COUNT; fsm->fast_item++) {
+        unsigned int item = fsm->fast_item;
+
+        if (item == EC_FAST_ITEM_WD_DIVIDER) {
+            have = ec_fsm_slave_config_reg(fsm, 0x0400);
+            if (!config->watchdog_divider
+                    || EC_READ_U16(have) == config->watchdog_divider) {
+                continue;
+            }
+            EC_SLAVE_DBG(slave, 1, "Setting watchdog divider to %u.\n",
+                    config->watchdog_divider);
+            EC_WRITE_U16(want, config->watchdog_divider);
+            ec_fsm_slave_config_fast_fpwr(fsm, 0x0400, want, 2);
+            return 1;
+        }
+
+        if (item == EC_FAST_ITEM_WD_INTERVALS) {
+            have = ec_fsm_slave_config_reg(fsm, 0x0420);
+            if (!config->watchdog_intervals
+                    || EC_READ_U16(have) == config->watchdog_intervals) {
+                continue;
+            }
+            EC_SLAVE_DBG(slave, 1, "Setting process data"
+                    " watchdog intervals to %u.\n",
+                    config->watchdog_intervals);
+            EC_WRITE_U16(want, config->watchdog_intervals);
+            ec_fsm_slave_config_fast_fpwr(fsm, 0x0420, want, 2);
+            return 1;
+        }
+
+        if (item < EC_FAST_ITEM_FMMU) {
+            i = item - EC_FAST_ITEM_SYNC;
+            if (i < pdo_offset || i >= slave->base_sync_count) {
+                continue;
+            }
+
+            memset(want, 0x00, EC_SYNC_PAGE_SIZE);
+            if (i < slave->sii.sync_count) {
+                ec_fsm_slave_config_pdo_sync_page(slave, i, want);
+            }
+
+            address = 0x0800 + EC_SYNC_PAGE_SIZE * i;
+            have = ec_fsm_slave_config_reg(fsm, address);
+            if (ec_fsm_slave_config_sync_equal(have, want)) {
+                continue;
+            }
+
+            if (have[6] & 0x01) {
+                // an active sync manager ignores configuration changes
+                EC_SLAVE_DBG(slave, 1, "Disabling SM%u.\n", i);
+                want[0] = 0x00;
+                ec_fsm_slave_config_fast_fpwr(fsm, address + 6, want, 1);
+            } else {
+                ec_fsm_slave_config_fast_fpwr(fsm, address, want,
+                        EC_SYNC_PAGE_SIZE);
+            }
+            return 1;
+        }
+
+        if (item < EC_FAST_ITEM_DC) {
+            const ec_fmmu_config_t *fmmu;
+            const ec_sync_t *sync;
+
+            i = item - EC_FAST_ITEM_FMMU;
+            if (i >= slave->base_fmmu_count) {
+                continue;
+            }
+
+            memset(want, 0x00, EC_FMMU_PAGE_SIZE);
+            if (i < config->used_fmmus) {
+                fmmu = &config->fmmu_configs[i];
+                if (!(sync = ec_slave_get_sync(slave, fmmu->sync_index))) {
+                    EC_SLAVE_ERR(slave, "Failed to determine PDO sync"
+                            " manager for FMMU!\n");
+                    return -1;
+                }
+                ec_fmmu_config_page(fmmu, sync, want);
+            }
+
+            address = 0x0600 + EC_FMMU_PAGE_SIZE * i;
+            have = ec_fsm_slave_config_reg(fsm, address);
+            if (ec_fsm_slave_config_fmmu_equal(have, want)) {
+                continue;
+            }
+
+            EC_SLAVE_DBG(slave, 1, "Setting FMMU%u.\n", i);
+            ec_fsm_slave_config_fast_fpwr(fsm, address, want,
+                    EC_FMMU_PAGE_SIZE);
+            return 1;
+        }
+
+        // DC activation: the cyclic unit is re-armed with a new start time
+        // below, so an active one has to be stopped first.
+        if (!slave->base_dc_supported || !slave->has_dc_system_time) {
+            continue;
+        }
+        have = ec_fsm_slave_config_reg(fsm, 0x0980);
+        if (!EC_READ_U16(have)) {
+            continue;
+        }
+        EC_SLAVE_DBG(slave, 1, "Clearing DC assignment...\n");
+        memset(want, 0x00, 2);
+        ec_fsm_slave_config_fast_fpwr(fsm, 0x0980, want, 2);
+        return 1;
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Reads the next register block or, if all blocks are read, checks the
+ * mailbox configuration.
+ */
+static void ec_fsm_slave_config_fast_read_block(
+        ec_fsm_slave_config_t *fsm /**< slave state machine */
+        )
+{
+    ec_datagram_t *datagram = fsm->datagram;
+    ec_slave_t *slave = fsm->slave;
+    uint8_t mbox[EC_SYNC_PAGE_SIZE * 2];
+    uint16_t address;
+    size_t size;
+
+    while (ec_fsm_slave_config_fast_block(slave, fsm->fast_item,
+                &address, &size)) {
+        if (size) {
+            ec_datagram_fprd(datagram, slave->station_address, address,
+                    size);
+            ec_datagram_zero(datagram);
+            fsm->fast_address = address;
+            fsm->retries = EC_FSM_RETRIES;
+            fsm->state = ec_fsm_slave_config_state_fast_read;
+            return;
+        }
+        fsm->fast_item++;
+    }
+
+    if (slave->sii.mailbox_protocols) {
+        ec_fsm_slave_config_mbox_pages(slave, mbox);
+
+        if (!ec_fsm_slave_config_sync_equal(
+                    ec_fsm_slave_config_reg(fsm, 0x0800), mbox)
+                || !ec_fsm_slave_config_sync_equal(
+                    ec_fsm_slave_config_reg(fsm, 0x0808),
+                    mbox + EC_SYNC_PAGE_SIZE)) {
+            EC_SLAVE_DBG(slave, 1, "Mailbox sync managers differ."
+                    " Configuring from INIT.\n");
+            ec_fsm_slave_config_enter_init(fsm);
+            return;
+        }
+    }
+
+#ifdef EC_SII_ASSIGN
+    ec_fsm_slave_config_enter_assign_pdi(fsm);
+#else
+    ec_fsm_slave_config_enter_boot_preop(fsm);
+#endif
+}
+
+/****************************************************************************/
+
+/** Start reading the ESC configuration registers.
+ */
+void ec_fsm_slave_config_enter_fast_read(
+        ec_fsm_slave_config_t *fsm /**< slave state machine */
+        )
+{
+    EC_SLAVE_DBG(fsm->slave, 1, "Reading register configuration...\n");
+
+    fsm->fast = 1;
+    fsm->fast_item = 0;
+    fsm->fast_writes = 0;
+    memset(fsm->regs, 0x00, sizeof(fsm->regs));
+    ec_fsm_slave_config_fast_read_block(fsm);
+}
+
+/****************************************************************************/
+
+/** Slave configuration state: FAST READ.
+ */
+void ec_fsm_slave_config_state_fast_read(
+        ec_fsm_slave_config_t *fsm /**< slave state machine */
+        )
+{
+    ec_datagram_t *datagram = fsm->datagram;
+
+    if (datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--)
+        return;
+
+    if (datagram->state != EC_DATAGRAM_RECEIVED
+            || datagram->working_counter != 1) {
+        EC_SLAVE_DBG(fsm->slave, 1, "Failed to read registers at 0x%04X."
+                " Configuring from INIT.\n", fsm->fast_address);
+        ec_fsm_slave_config_enter_init(fsm);
+        return;
+    }
+
+    memcpy(ec_fsm_slave_config_reg(fsm, fsm->fast_address),
+            datagram->data, datagram->data_size);
+    fsm->fast_item++;
+    ec_fsm_slave_config_fast_read_block(fsm);
+}
+
+/****************************************************************************/
+
+/** Writes the next register item, that differs from the configuration, or
+ * continues with the DC configuration.
+ */
+static void ec_fsm_slave_config_fast_write_next(
+        ec_fsm_slave_config_t *fsm /**< slave state machine */
+        )
+{
+    ec_slave_t *slave = fsm->slave;
+    int ret;
+
+    if (!slave->config) { // config removed in the meantime
+        ec_fsm_slave_config_reconfigure(fsm);
+        return;
+    }
+
+    if (slave->base_fmmu_count < slave->config->used_fmmus) {
+        slave->error_flag = 1;
+        fsm->state = ec_fsm_slave_config_state_error;
+        EC_SLAVE_ERR(slave, "Slave has less FMMUs (%u)"
+                " than requested (%u).\n", slave->base_fmmu_count,
+                slave->config->used_fmmus);
+        return;
+    }
+
+    ret = ec_fsm_slave_config_fast_next(fsm);
+    if (ret < 0) {
+        slave->error_flag = 1;
+        fsm->state = ec_fsm_slave_config_state_error;
+        return;
+    }
+
+    if (ret) { // write prepared
+        return;
+    }
+
+    EC_SLAVE_DBG(slave, 1, "Register configuration updated with"
+            " %u write(s).\n", fsm->fast_writes);
+    ec_fsm_slave_config_enter_dc_cycle(fsm);
+}
+
+/****************************************************************************/
+
+/** Write the ESC registers that differ from the configuration.
+ */
+void ec_fsm_slave_config_enter_fast_write(
+        ec_fsm_slave_config_t *fsm /**< slave state machine */
+        )
+{
+    fsm->fast_item = 0;
+    ec_fsm_slave_config_fast_write_next(fsm);
+}
+
+/****************************************************************************/
+
+/** Slave configuration state: FAST WRITE.
+ */
+void ec_fsm_slave_config_state_fast_write(
+        ec_fsm_slave_config_t *fsm /**< slave state machine */
+        )
+{
+    ec_datagram_t *datagram = fsm->datagram;
+    ec_slave_t *slave = fsm->slave;
+
+    if (datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--)
+        return;
+
+    if (datagram->state != EC_DATAGRAM_RECEIVED) {
+        fsm->state = ec_fsm_slave_config_state_error;
+        EC_SLAVE_ERR(slave, "Failed to receive register"
+                " configuration datagram: ");
+        ec_datagram_print_state(datagram);
+        return;
+    }
+
+    if (datagram->working_counter == 1) {
+        memcpy(ec_fsm_slave_config_reg(fsm, fsm->fast_address),
+                datagram->data, datagram->data_size);
+        fsm->fast_writes++;
+    } else if (fsm->fast_address == 0x0980) {
+        // clearing the DC assignment does not succeed on simple slaves
+        EC_SLAVE_DBG(slave, 1, "Failed to clear DC assignment: ");
+        ec_datagram_print_wc_error(datagram);
+        fsm->fast_item++;
+    } else {
+        slave->error_flag = 1;
+        fsm->state = ec_fsm_slave_config_state_error;
+        EC_SLAVE_ERR(slave, "Failed to write register 0x%04X: ",
+                fsm->fast_address);
+        ec_datagram_print_wc_error(datagram);
+        return;
+    }
+
+    ec_fsm_slave_config_fast_write_next(fsm);
+}
+
 /****************************************************************************/
 
 /** Reconfigure the slave starting at INIT.
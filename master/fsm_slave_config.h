@@ -38,6 +38,16 @@
 
 /****************************************************************************/
 
+/** First ESC register mirrored for the fast reconfiguration.
+ */
+#define EC_FSM_SLAVE_CONFIG_REG_START 0x0400
+
+/** Size of the mirrored ESC register range (0x0400 to 0x09A7).
+ */
+#define EC_FSM_SLAVE_CONFIG_REG_SIZE (0x09A8 - EC_FSM_SLAVE_CONFIG_REG_START)
+
+/****************************************************************************/
+
 /** \see ec_fsm_slave_config */
 typedef struct ec_fsm_slave_config ec_fsm_slave_config_t;
 
@@ -62,6 +72,13 @@ struct ec_fsm_slave_config
     unsigned long jiffies_start; /**< For timeout calculations. */
     unsigned int take_time; /**< Store jiffies after datagram reception. */
     unsigned long wait_ms; /**< Wait time (used to wait before SAFEOP). */
+    unsigned int fast; /**< Non-zero, if the ESC registers are only written,
+                         where they differ from the configuration. */
+    unsigned int fast_item; /**< Current register block or item. */
+    unsigned int fast_writes; /**< Number of register writes. */
+    uint16_t fast_address; /**< Address of the pending register write. */
+    uint8_t regs[EC_FSM_SLAVE_CONFIG_REG_SIZE]; /**< Mirror of the ESC
+                                                  registers. */
 };
 
 /****************************************************************************/
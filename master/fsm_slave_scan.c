@@ -112,6 +112,7 @@ void ec_fsm_slave_scan_start(
         )
 {
     fsm->slave = slave;
+    fsm->pdos_from_db = 0;
     fsm->state = ec_fsm_slave_scan_state_start;
 }
 
@@ -314,6 +315,8 @@ void ec_fsm_slave_scan_state_base(
         slave->base_sync_count = EC_MAX_SYNC_MANAGERS;
     }
 
+    slave->base_ram_size = EC_READ_U8(datagram->data + 6);
+
     octet = EC_READ_U8(datagram->data + 7);
     for (i = 0; i < EC_MAX_PORTS; i++) {
         slave->ports[i].desc = (octet >> (2 * i)) & 0x03;
@@ -937,6 +940,10 @@ void ec_fsm_slave_scan_state_regalias(
 /****************************************************************************/
 
 /** Enter slave scan state PREOP.
+ *
+ * If the device database contains the PDO configuration of the slave, this
+ * is taken instead and only the PDO scan is skipped. The mailbox
+ * configuration is read in any case.
  */
 void ec_fsm_slave_scan_enter_preop(
         ec_fsm_slave_scan_t *fsm /**< slave state machine */
@@ -944,6 +951,24 @@ void ec_fsm_slave_scan_enter_preop(
 {
     ec_slave_t *slave = fsm->slave;
     uint8_t current_state = slave->current_state & EC_SLAVE_STATE_MASK;
+    const uint8_t *rec;
+
+    rec = ec_esi_db_find(&slave->master->esi_db, slave->sii.vendor_id,
+            slave->sii.product_code, slave->sii.revision_number);
+    if (rec) {
+        slave->esi_db_flags = ec_esi_db_record_flags(rec);
+        ec_esi_db_mailbox_max(rec, &slave->esi_rx_mailbox_max,
+                &slave->esi_tx_mailbox_max);
+        if (slave->esi_db_flags & EC_ESI_DB_FLAG_PDOS) {
+            if (!ec_esi_db_apply_pdos(rec, slave)) {
+                fsm->pdos_from_db = 1;
+            } else {
+                EC_SLAVE_WARN(slave, "Failed to apply PDO configuration from"
+                        " device database. Reading it from the"
+                        " slave.\n");
+            }
+        }
+    }
 
     if (current_state != EC_SLAVE_STATE_PREOP
             && current_state != EC_SLAVE_STATE_SAFEOP
@@ -1069,6 +1094,12 @@ void ec_fsm_slave_scan_enter_pdos(
 {
     ec_slave_t *slave = fsm->slave;
 
+    if (fsm->pdos_from_db) {
+        EC_SLAVE_DBG(slave, 1, "Skipping PDO scan.\n");
+        fsm->state = ec_fsm_slave_scan_state_end;
+        return;
+    }
+
     EC_SLAVE_DBG(slave, 1, "Scanning PDO assignment and mapping.\n");
     fsm->state = ec_fsm_slave_scan_state_pdos;
     ec_fsm_pdo_start_reading(fsm->fsm_pdo, slave);
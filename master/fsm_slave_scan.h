@@ -55,6 +55,8 @@ struct ec_fsm_slave_scan
 
     void (*state)(ec_fsm_slave_scan_t *); /**< State function. */
     uint16_t sii_offset; /**< SII offset in words. */
+    uint8_t pdos_from_db; /**< The PDO configuration was taken from the
+                            device database. */
 
     ec_fsm_sii_t fsm_sii; /**< SII state machine. */
 };
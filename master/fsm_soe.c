@@ -110,6 +110,7 @@ void ec_fsm_soe_init(
 {
     fsm->state = NULL;
     fsm->datagram = NULL;
+    ec_mbox_repeat_init(&fsm->repeat);
     fsm->fragment_size = 0;
 }
 
@@ -405,8 +406,7 @@ void ec_fsm_soe_read_response(
     size_t rec_size, data_size;
     ec_soe_request_t *req = fsm->request;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
         return;
     }
 
@@ -728,9 +728,8 @@ void ec_fsm_soe_write_response(
     uint16_t idn;
     size_t rec_size;
 
-    if (fsm->datagram->state == EC_DATAGRAM_TIMED_OUT && fsm->retries--) {
-        ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
-        return; // FIXME: request again?
+    if (ec_slave_mbox_repeat(slave, &fsm->repeat, fsm->datagram, datagram)) {
+        return;
     }
 
     if (fsm->datagram->state != EC_DATAGRAM_RECEIVED) {
@@ -27,6 +27,8 @@
 
 #include <linux/module.h>
 #include <linux/vmalloc.h>
+#include <linux/cache.h>
+#include <linux/numa.h>
 
 #include "master.h"
 #include "slave_config.h"
@@ -168,6 +170,8 @@ static ATTRIBUTES int ec_ioctl_master(
         io.devices[dev_idx].tx_bytes = device->tx_bytes;
         io.devices[dev_idx].rx_bytes = device->rx_bytes;
         io.devices[dev_idx].tx_errors = device->tx_errors;
+        io.devices[dev_idx].tx_ring_size = device->tx_ring_size;
+        io.devices[dev_idx].tx_ring_overruns = device->tx_ring_overruns;
         for (j = 0; j < EC_RATE_COUNT; j++) {
             io.devices[dev_idx].tx_frame_rates[j] =
                 device->tx_frame_rates[j];
@@ -198,8 +202,29 @@ static ATTRIBUTES int ec_ioctl_master(
             master->device_stats.loss_rates[j];
     }
 
+    io.numa_node = ec_master_numa_node(master);
+    io.numa_node_configured = master->numa_node != NUMA_NO_NODE;
+
     up(&master->device_sem);
 
+    io.send_interval = master->send_interval;
+    io.inject_interval = master->inject_stats.interval;
+    io.inject_cyclic_load = master->inject_stats.cyclic_load;
+    io.inject_budget = master->inject_stats.budget;
+    io.inject_max_delay = master->inject_stats.max_delay;
+    io.injected_master_fsm =
+        master->inject_stats.injected[EC_INJECT_MASTER_FSM];
+    io.injected_slave_fsm =
+        master->inject_stats.injected[EC_INJECT_SLAVE_FSM];
+    io.injected_ext = master->inject_stats.injected[EC_INJECT_EXT];
+    io.inject_deferred = master->inject_stats.deferred;
+    io.inject_dropped = master->inject_stats.dropped;
+    io.retransmit_delay = master->retransmit_delay;
+    io.retransmit_budget = master->retransmit_budget;
+    io.retransmitted = master->retransmit_stats.retransmitted;
+    io.retransmit_recovered = master->retransmit_stats.recovered;
+    io.retransmit_lost = master->retransmit_stats.lost;
+
     io.app_time = master->app_time;
     io.dc_ref_time = master->dc_ref_time;
     io.ref_clock =
@@ -256,6 +281,13 @@ static ATTRIBUTES int ec_ioctl_slave(
     data.std_tx_mailbox_offset = slave->sii.std_tx_mailbox_offset;
     data.std_tx_mailbox_size = slave->sii.std_tx_mailbox_size;
     data.mailbox_protocols = slave->sii.mailbox_protocols;
+    data.configured_rx_mailbox_offset = slave->configured_rx_mailbox_offset;
+    data.configured_rx_mailbox_size = slave->configured_rx_mailbox_size;
+    data.configured_tx_mailbox_offset = slave->configured_tx_mailbox_offset;
+    data.configured_tx_mailbox_size = slave->configured_tx_mailbox_size;
+    data.mbox_size_fallback = slave->mbox_size_fallback;
+    data.mbox_repeats = slave->mbox_repeats;
+    data.mbox_repeat_failures = slave->mbox_repeat_failures;
     data.has_general_category = slave->sii.has_general;
     data.coe_details = slave->sii.coe_details;
     data.general_flags = slave->sii.general_flags;
@@ -301,6 +333,91 @@ static ATTRIBUTES int ec_ioctl_slave(
 
 /****************************************************************************/
 
+/** Get the bus topology.
+ *
+ * All slaves are captured at once while holding the master semaphore, so
+ * that the result is consistent even if a bus scan is pending. If \a
+ * max_slaves is smaller than the number of slaves, only the slave count is
+ * returned and the caller has to retry with a larger buffer.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_topology(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg /**< Userspace address to store the results. */
+        )
+{
+    ec_ioctl_topology_t data;
+    ec_ioctl_topology_slave_t *buf = NULL, *entry;
+    const ec_slave_t *slave;
+    unsigned int i, count = 0;
+    int ret = 0;
+
+    if (copy_from_user(&data, (void __user *) arg, sizeof(data))) {
+        return -EFAULT;
+    }
+
+    if (data.max_slaves) {
+        if (data.max_slaves > 0xffff) {
+            return -EINVAL;
+        }
+        if (!(buf = vmalloc(data.max_slaves * sizeof(*buf)))) {
+            return -ENOMEM;
+        }
+    }
+
+    if (down_interruptible(&master->master_sem)) {
+        vfree(buf);
+        return -EINTR;
+    }
+
+    data.slave_count = master->slave_count;
+    data.scan_index = master->scan_index;
+
+    if (buf && master->slave_count <= data.max_slaves) {
+        count = master->slave_count;
+        for (slave = master->slaves, entry = buf;
+                slave < master->slaves + master->slave_count;
+                slave++, entry++) {
+            memset(entry, 0, sizeof(*entry));
+            entry->position = slave->ring_position;
+            entry->alias = slave->effective_alias;
+            entry->vendor_id = slave->sii.vendor_id;
+            entry->product_code = slave->sii.product_code;
+            entry->al_state = slave->current_state;
+            entry->dc_supported = slave->base_dc_supported;
+            entry->dc_range = slave->base_dc_range;
+            entry->has_dc_system_time = slave->has_dc_system_time;
+            entry->transmission_delay = slave->transmission_delay;
+            for (i = 0; i < EC_MAX_PORTS; i++) {
+                entry->ports[i].desc = slave->ports[i].desc;
+                entry->ports[i].link_up = slave->ports[i].link.link_up;
+                entry->ports[i].next_slave = slave->ports[i].next_slave ?
+                    slave->ports[i].next_slave->ring_position : 0xffff;
+                entry->ports[i].delay_to_next_dc =
+                    slave->ports[i].delay_to_next_dc;
+            }
+            ec_ioctl_strcpy(entry->order, slave->sii.order);
+        }
+    }
+
+    up(&master->master_sem);
+
+    if (count && copy_to_user((void __user *) data.slaves, buf,
+                count * sizeof(*buf))) {
+        ret = -EFAULT;
+    }
+    vfree(buf);
+
+    if (!ret && copy_to_user((void __user *) arg, &data, sizeof(data))) {
+        ret = -EFAULT;
+    }
+
+    return ret;
+}
+
+/****************************************************************************/
+
 /** Get slave sync manager information.
  *
  * \return Zero on success, otherwise a negative error code.
@@ -653,6 +770,73 @@ static ATTRIBUTES int ec_ioctl_master_rescan(
 
 /****************************************************************************/
 
+/** Load the device description database.
+ *
+ * An empty image clears the database. The database is consulted on the next
+ * bus scan.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_esi_db(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg /**< ioctl() argument. */
+        )
+{
+    ec_ioctl_esi_db_t io;
+    uint8_t *data;
+    int ret;
+
+    if (copy_from_user(&io, (void __user *) arg, sizeof(io))) {
+        return -EFAULT;
+    }
+
+    if (!io.size) {
+        if (down_interruptible(&master->master_sem)) {
+            return -EINTR;
+        }
+        ec_esi_db_clear(&master->esi_db);
+        up(&master->master_sem);
+        EC_MASTER_INFO(master, "Cleared device database.\n");
+        return 0;
+    }
+
+    if (io.size > EC_ESI_DB_MAX_SIZE) {
+        EC_MASTER_ERR(master, "Device database too large (%u bytes).\n",
+                io.size);
+        return -EFBIG;
+    }
+
+    if (!(data = vmalloc(io.size))) {
+        EC_MASTER_ERR(master, "Failed to allocate %u bytes"
+                " for device database.\n", io.size);
+        return -ENOMEM;
+    }
+
+    if (copy_from_user(data, (void __user *) io.data, io.size)) {
+        vfree(data);
+        return -EFAULT;
+    }
+
+    if (down_interruptible(&master->master_sem)) {
+        vfree(data);
+        return -EINTR;
+    }
+
+    ret = ec_esi_db_load(&master->esi_db, data, io.size);
+    if (ret) {
+        up(&master->master_sem);
+        vfree(data);
+        return ret;
+    }
+
+    EC_MASTER_INFO(master, "Loaded device database with %u records.\n",
+            master->esi_db.record_count);
+    up(&master->master_sem);
+    return 0;
+}
+
+/****************************************************************************/
+
 /** Set slave state.
  *
  * \return Zero on success, otherwise a negative error code.
@@ -1257,6 +1441,8 @@ static ATTRIBUTES int ec_ioctl_config(
     }
     data.watchdog_divider = sc->watchdog_divider;
     data.watchdog_intervals = sc->watchdog_intervals;
+    data.mbox_rx_size = sc->mbox_rx_size;
+    data.mbox_tx_size = sc->mbox_tx_size;
     data.sdo_count = ec_slave_config_sdo_count(sc);
     data.idn_count = ec_slave_config_idn_count(sc);
     data.flag_count = ec_slave_config_flag_count(sc);
@@ -1931,6 +2117,27 @@ out_return:
 
 /****************************************************************************/
 
+/** Size of a domain in the process image of a userspace application.
+ *
+ * Each domain starts at a cache line boundary, so that domains processed by
+ * different CPUs do not share cache lines. Domains using application memory
+ * (see ec_ioctl_domain_memory()) do not occupy space in the process image.
+ *
+ * \return Size of the domain including the padding.
+ */
+static size_t ec_ioctl_domain_stride(
+        const ec_domain_t *domain /**< Domain. */
+        )
+{
+    if (domain->user_pages) {
+        return 0;
+    }
+
+    return ALIGN(ecrt_domain_size(domain), L1_CACHE_BYTES);
+}
+
+/****************************************************************************/
+
 /** Activates the master.
  *
  * \return Zero on success, otherwise a negative error code.
@@ -1959,13 +2166,25 @@ static ATTRIBUTES int ec_ioctl_activate(
         return -EINTR;
 
     list_for_each_entry(domain, &master->domains, list) {
-        ctx->process_data_size += ecrt_domain_size(domain);
+        ctx->process_data_size += ec_ioctl_domain_stride(domain);
     }
 
     up(&master->master_sem);
 
+    if (ctx->cycle) {
+        /* The cycle state area gets its own page behind the domains. */
+        io.cycle_state_offset = PAGE_ALIGN(ctx->process_data_size);
+        io.cycle_state_size = sizeof(ec_ioctl_cycle_state_t);
+        ctx->process_data_size =
+            io.cycle_state_offset + PAGE_ALIGN(io.cycle_state_size);
+    } else {
+        io.cycle_state_offset = 0;
+        io.cycle_state_size = 0;
+    }
+
     if (ctx->process_data_size) {
-        ctx->process_data = vmalloc(ctx->process_data_size);
+        ctx->process_data = vmalloc_node(ctx->process_data_size,
+                ec_master_numa_node(master));
         if (!ctx->process_data) {
             ctx->process_data_size = 0;
             return -ENOMEM;
@@ -1976,9 +2195,18 @@ static ATTRIBUTES int ec_ioctl_activate(
          */
         offset = 0;
         list_for_each_entry(domain, &master->domains, list) {
+            if (domain->user_pages) {
+                continue;
+            }
             ecrt_domain_external_memory(domain,
                     ctx->process_data + offset);
-            offset += ecrt_domain_size(domain);
+            offset += ec_ioctl_domain_stride(domain);
+        }
+
+        if (io.cycle_state_size) {
+            ctx->cycle_state = (ec_ioctl_cycle_state_t *)
+                (ctx->process_data + io.cycle_state_offset);
+            memset(ctx->cycle_state, 0, io.cycle_state_size);
         }
 
 #if defined(EC_IOCTL_RTDM) && !defined(EC_RTDM_XENOMAI_V3)
@@ -2065,6 +2293,38 @@ static ATTRIBUTES int ec_ioctl_set_send_interval(
 
 /****************************************************************************/
 
+/** Configures the same-cycle retransmission of cyclic datagrams.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_set_retransmission(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    ec_ioctl_retransmission_t io;
+    int ret;
+
+    if (unlikely(!ctx->requested)) {
+        return -EPERM;
+    }
+
+    if (copy_from_user(&io, (void __user *) arg, sizeof(io))) {
+        return -EFAULT;
+    }
+
+    if (down_interruptible(&master->master_sem))
+        return -EINTR;
+
+    ret = ecrt_master_set_retransmission(master, io.delay, io.budget);
+
+    up(&master->master_sem);
+    return ret;
+}
+
+/****************************************************************************/
+
 /** Send frames.
  *
  * \return Zero on success, otherwise a negative error code.
@@ -2483,6 +2743,51 @@ out_return:
 
 /****************************************************************************/
 
+/** Configure a slave's mailbox sizes.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_sc_mailbox_size(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    ec_ioctl_config_t data;
+    ec_slave_config_t *sc;
+    int ret = 0;
+
+    if (unlikely(!ctx->requested)) {
+        ret = -EPERM;
+        goto out_return;
+    }
+
+    if (copy_from_user(&data, (void __user *) arg, sizeof(data))) {
+        ret = -EFAULT;
+        goto out_return;
+    }
+
+    if (down_interruptible(&master->master_sem)) {
+        ret = -EINTR;
+        goto out_return;
+    }
+
+    if (!(sc = ec_master_get_config(master, data.config_index))) {
+        ret = -ENOENT;
+        goto out_up;
+    }
+
+    ret = ecrt_slave_config_mailbox_size(sc,
+            data.mbox_rx_size, data.mbox_tx_size);
+
+out_up:
+    up(&master->master_sem);
+out_return:
+    return ret;
+}
+
+/****************************************************************************/
+
 /** Add a PDO to the assignment.
  *
  * \return Zero on success, otherwise a negative error code.
@@ -3473,115 +3778,538 @@ static ATTRIBUTES int ec_ioctl_domain_size(
 
 /****************************************************************************/
 
-/** Gets the domain's offset in the total process data.
+/** Uses application memory as process data memory of a domain.
  *
- * \return Domain offset, or a negative error code.
+ * \return Zero on success, otherwise a negative error code.
  */
-static ATTRIBUTES int ec_ioctl_domain_offset(
+static ATTRIBUTES int ec_ioctl_domain_memory(
         ec_master_t *master, /**< EtherCAT master. */
         void *arg, /**< ioctl() argument. */
         ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
         )
 {
-    int offset = 0;
-    const ec_domain_t *domain;
+    ec_ioctl_domain_memory_t io;
+    ec_domain_t *domain;
+    int ret;
 
-    if (unlikely(!ctx->requested))
+    if (unlikely(!ctx->requested)) {
         return -EPERM;
+    }
+
+    if (copy_from_user(&io, (void __user *) arg, sizeof(io))) {
+        return -EFAULT;
+    }
 
     if (down_interruptible(&master->master_sem)) {
         return -EINTR;
     }
 
-    list_for_each_entry(domain, &master->domains, list) {
-        if (domain->index == (unsigned long) arg) {
-            up(&master->master_sem);
-            return offset;
-        }
-        offset += ecrt_domain_size(domain);
+    if (!(domain = ec_master_find_domain(master, io.domain_index))) {
+        up(&master->master_sem);
+        return -ENOENT;
     }
 
+    ret = ec_domain_user_memory(domain, (unsigned long) io.memory);
+
     up(&master->master_sem);
-    return -ENOENT;
+    return ret;
 }
 
 /****************************************************************************/
 
-/** Process the domain.
+/** Reserves spare process data in a domain.
  *
  * \return Zero on success, otherwise a negative error code.
  */
-static ATTRIBUTES int ec_ioctl_domain_process(
+static ATTRIBUTES int ec_ioctl_domain_reserve(
         ec_master_t *master, /**< EtherCAT master. */
         void *arg, /**< ioctl() argument. */
         ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
         )
 {
+    ec_ioctl_domain_reserve_t io;
     ec_domain_t *domain;
+    int ret;
 
-    if (unlikely(!ctx->requested))
+    if (unlikely(!ctx->requested)) {
         return -EPERM;
+    }
 
-    /* no locking of master_sem needed, because domain will not be deleted in
-     * the meantime. */
+    if (copy_from_user(&io, (void __user *) arg, sizeof(io))) {
+        return -EFAULT;
+    }
 
-    if (!(domain = ec_master_find_domain(master, (unsigned long) arg))) {
+    if (down_interruptible(&master->master_sem)) {
+        return -EINTR;
+    }
+
+    if (!(domain = ec_master_find_domain(master, io.domain_index))) {
+        up(&master->master_sem);
         return -ENOENT;
     }
 
-    return ecrt_domain_process(domain);
+    ret = ecrt_domain_reserve(domain, io.size);
+
+    up(&master->master_sem);
+    return ret;
 }
 
 /****************************************************************************/
 
-/** Queue the domain.
+/** Releases a slave configuration of an active master.
  *
  * \return Zero on success, otherwise a negative error code.
  */
-static ATTRIBUTES int ec_ioctl_domain_queue(
+static ATTRIBUTES int ec_ioctl_sc_release(
         ec_master_t *master, /**< EtherCAT master. */
         void *arg, /**< ioctl() argument. */
         ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
         )
 {
-    ec_domain_t *domain;
-    int ret;
+    unsigned long config_index = (unsigned long) arg;
+    ec_slave_config_t *sc;
 
-    if (unlikely(!ctx->requested))
+    if (unlikely(!ctx->requested)) {
         return -EPERM;
+    }
 
-    /* no locking of master_sem needed, because domain will not be deleted in
-     * the meantime. */
+    if (down_interruptible(&master->master_sem)) {
+        return -EINTR;
+    }
 
-    if (!(domain = ec_master_find_domain(master, (unsigned long) arg))) {
+    sc = ec_master_get_config(master, config_index);
+
+    up(&master->master_sem);
+
+    if (!sc) {
         return -ENOENT;
     }
 
-    if (ec_ioctl_lock_interruptible(&master->io_mutex))
-        return -EINTR;
-
-    ret = ecrt_domain_queue(domain);
-    ec_ioctl_unlock(&master->io_mutex);
-    return ret;
+    // configurations are only deleted on deactivation
+    return ecrt_slave_config_release(sc);
 }
 
 /****************************************************************************/
 
-/** Get the domain state.
+/** Applies a released slave configuration.
  *
  * \return Zero on success, otherwise a negative error code.
  */
-static ATTRIBUTES int ec_ioctl_domain_state(
+static ATTRIBUTES int ec_ioctl_sc_apply(
         ec_master_t *master, /**< EtherCAT master. */
         void *arg, /**< ioctl() argument. */
         ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
         )
 {
-    ec_ioctl_domain_state_t data;
-    const ec_domain_t *domain;
-    ec_domain_state_t state;
-    int ret;
-
+    unsigned long config_index = (unsigned long) arg;
+    ec_slave_config_t *sc;
+
+    if (unlikely(!ctx->requested)) {
+        return -EPERM;
+    }
+
+    if (down_interruptible(&master->master_sem)) {
+        return -EINTR;
+    }
+
+    sc = ec_master_get_config(master, config_index);
+
+    up(&master->master_sem);
+
+    if (!sc) {
+        return -ENOENT;
+    }
+
+    return ecrt_slave_config_apply(sc);
+}
+
+/****************************************************************************/
+
+/** Gets the domain's offset in the total process data.
+ *
+ * \return Domain offset, or a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_domain_offset(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    int offset = 0;
+    const ec_domain_t *domain;
+
+    if (unlikely(!ctx->requested))
+        return -EPERM;
+
+    if (down_interruptible(&master->master_sem)) {
+        return -EINTR;
+    }
+
+    list_for_each_entry(domain, &master->domains, list) {
+        if (domain->index == (unsigned long) arg) {
+            up(&master->master_sem);
+            return offset;
+        }
+        offset += ec_ioctl_domain_stride(domain);
+    }
+
+    up(&master->master_sem);
+    return -ENOENT;
+}
+
+/****************************************************************************/
+
+/** Process the domain.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_domain_process(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    ec_domain_t *domain;
+
+    if (unlikely(!ctx->requested))
+        return -EPERM;
+
+    /* no locking of master_sem needed, because domain will not be deleted in
+     * the meantime. */
+
+    if (!(domain = ec_master_find_domain(master, (unsigned long) arg))) {
+        return -ENOENT;
+    }
+
+    return ecrt_domain_process(domain);
+}
+
+/****************************************************************************/
+
+/** Queue the domain.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_domain_queue(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    ec_domain_t *domain;
+    int ret;
+
+    if (unlikely(!ctx->requested))
+        return -EPERM;
+
+    /* no locking of master_sem needed, because domain will not be deleted in
+     * the meantime. */
+
+    if (!(domain = ec_master_find_domain(master, (unsigned long) arg))) {
+        return -ENOENT;
+    }
+
+    if (ec_ioctl_lock_interruptible(&master->io_mutex))
+        return -EINTR;
+
+    ret = ecrt_domain_queue(domain);
+    ec_ioctl_unlock(&master->io_mutex);
+    return ret;
+}
+
+/****************************************************************************/
+
+/** Executes a single operation of a command batch.
+ *
+ * Has to be called with the io_mutex held.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_batch_exec(
+        ec_master_t *master, /**< EtherCAT master. */
+        const ec_ioctl_batch_op_t *op /**< Operation. */
+        )
+{
+    ec_domain_t *domain;
+
+    switch (op->op) {
+        case EC_BATCH_RECEIVE:
+            return ecrt_master_receive(master);
+        case EC_BATCH_SEND:
+            return ecrt_master_send(master);
+        case EC_BATCH_DOMAIN_PROCESS:
+        case EC_BATCH_DOMAIN_QUEUE:
+            /* no locking of master_sem needed, because domain will not be
+             * deleted in the meantime. */
+            if (!(domain = ec_master_find_domain(master, op->index))) {
+                return -ENOENT;
+            }
+            if (op->op == EC_BATCH_DOMAIN_PROCESS) {
+                return ecrt_domain_process(domain);
+            }
+            return ecrt_domain_queue(domain);
+        case EC_BATCH_APP_TIME:
+            return ecrt_master_application_time(master, op->value);
+        case EC_BATCH_SYNC_REF:
+            return ecrt_master_sync_reference_clock(master);
+        case EC_BATCH_SYNC_REF_TO:
+            return ecrt_master_sync_reference_clock_to(master, op->value);
+        case EC_BATCH_SYNC_SLAVES:
+            return ecrt_master_sync_slave_clocks(master);
+        case EC_BATCH_SYNC_MON_QUEUE:
+            return ecrt_master_sync_monitor_queue(master);
+        default:
+            return -EINVAL;
+    }
+}
+
+/****************************************************************************/
+
+/** Executes a batch of cyclic operations.
+ *
+ * Replaces a sequence of cyclic ioctl() calls (receive, domain processing,
+ * DC synchronisation, send, etc.) by a single one. All operations are
+ * executed, even if one of them fails, so that e. g. the frames are still
+ * sent.
+ *
+ * \return Zero on success, otherwise the error code of the first failed
+ * operation.
+ */
+static ATTRIBUTES int ec_ioctl_batch(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    ec_ioctl_batch_t io;
+    ec_ioctl_batch_op_t ops[EC_IOCTL_BATCH_CHUNK];
+    unsigned int done, i, count;
+    int ret = 0, op_ret;
+
+    if (unlikely(!ctx->requested)) {
+        return -EPERM;
+    }
+
+    if (ec_copy_from_user(&io, (void __user *) arg, sizeof(io), ctx)) {
+        return -EFAULT;
+    }
+
+    io.failed = io.count;
+
+    for (done = 0; done < io.count; done += count) {
+        count = min_t(unsigned int, io.count - done, EC_IOCTL_BATCH_CHUNK);
+
+        if (ec_copy_from_user(ops, (void __user *) (io.ops + done),
+                    count * sizeof(ec_ioctl_batch_op_t), ctx)) {
+            return -EFAULT;
+        }
+
+        if (ec_ioctl_lock_interruptible(&master->io_mutex)) {
+            return -EINTR;
+        }
+
+        for (i = 0; i < count; i++) {
+            op_ret = ec_ioctl_batch_exec(master, &ops[i]);
+            if (unlikely(op_ret) && !ret) {
+                ret = op_ret;
+                io.failed = done + i;
+            }
+        }
+
+        ec_ioctl_unlock(&master->io_mutex);
+    }
+
+    if (ret && ec_copy_to_user((void __user *) arg, &io, sizeof(io), ctx)) {
+        return -EFAULT;
+    }
+
+    return ret;
+}
+
+/****************************************************************************/
+
+/** Sets up a cycle program.
+ *
+ * Stores a batch of cyclic operations in the file handle, so that it can
+ * be executed with EC_IOCTL_CYCLE later without copying anything from user
+ * space. Programs have to be set up before activation, because the cycle
+ * state area is allocated together with the process data.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_cycle_setup(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    ec_ioctl_cycle_setup_t io;
+    ec_ioctl_batch_op_t *ops;
+    unsigned int i;
+    int ret = 0;
+
+    if (unlikely(!ctx->requested)) {
+        return -EPERM;
+    }
+
+    if (copy_from_user(&io, (void __user *) arg, sizeof(io))) {
+        return -EFAULT;
+    }
+
+    if (io.program >= EC_IOCTL_CYCLE_PROGRAMS
+            || io.count > EC_IOCTL_CYCLE_MAX_OPS) {
+        return -EINVAL;
+    }
+
+    if (master->active) {
+        return -EBUSY;
+    }
+
+    if (!ctx->cycle) {
+        ctx->cycle = kzalloc(sizeof(ec_ioctl_cycle_t), GFP_KERNEL);
+        if (!ctx->cycle) {
+            return -ENOMEM;
+        }
+    }
+
+    ops = ctx->cycle->ops[io.program];
+    ctx->cycle->count[io.program] = 0;
+
+    if (copy_from_user(ops, (void __user *) io.ops,
+                io.count * sizeof(ec_ioctl_batch_op_t))) {
+        return -EFAULT;
+    }
+
+    if (down_interruptible(&master->master_sem)) {
+        return -EINTR;
+    }
+
+    for (i = 0; i < io.count; i++) {
+        if (ops[i].op < EC_BATCH_RECEIVE
+                || ops[i].op > EC_BATCH_SYNC_MON_QUEUE) {
+            ret = -EINVAL;
+            break;
+        }
+        if ((ops[i].op == EC_BATCH_DOMAIN_PROCESS
+                    || ops[i].op == EC_BATCH_DOMAIN_QUEUE)
+                && !ec_master_find_domain(master, ops[i].index)) {
+            ret = -ENOENT;
+            break;
+        }
+    }
+
+    up(&master->master_sem);
+
+    if (ret) {
+        return ret;
+    }
+
+    ctx->cycle->count[io.program] = io.count;
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Runs a cycle program.
+ *
+ * The program number is passed as the ioctl() argument. Operations with a
+ * time value take it from the cycle state area. After the run, the result,
+ * the master state and the states of the processed domains are published
+ * in the cycle state area.
+ *
+ * \return Zero on success, otherwise the error code of the first failed
+ * operation.
+ */
+static ATTRIBUTES int ec_ioctl_cycle(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    unsigned long program = (unsigned long) arg;
+    ec_ioctl_cycle_state_t *state = ctx->cycle_state;
+    const ec_ioctl_batch_op_t *ops;
+    ec_ioctl_batch_op_t timed_op;
+    const ec_domain_t *domain;
+    unsigned int i, count, failed = 0;
+    uint64_t domain_mask = 0;
+    int ret = 0, op_ret;
+
+    if (unlikely(!ctx->requested)) {
+        return -EPERM;
+    }
+
+    if (unlikely(!state || program >= EC_IOCTL_CYCLE_PROGRAMS)) {
+        return -EINVAL;
+    }
+
+    ops = ctx->cycle->ops[program];
+    count = ctx->cycle->count[program];
+
+    if (ec_ioctl_lock_interruptible(&master->io_mutex)) {
+        return -EINTR;
+    }
+
+    for (i = 0; i < count; i++) {
+        if (ops[i].op == EC_BATCH_APP_TIME
+                || ops[i].op == EC_BATCH_SYNC_REF_TO) {
+            timed_op = ops[i];
+            timed_op.value = READ_ONCE(state->app_time);
+            op_ret = ec_ioctl_batch_exec(master, &timed_op);
+        } else {
+            op_ret = ec_ioctl_batch_exec(master, &ops[i]);
+        }
+
+        if (unlikely(op_ret) && !ret) {
+            ret = op_ret;
+            failed = i;
+        }
+
+        if (ops[i].op == EC_BATCH_DOMAIN_PROCESS
+                && ops[i].index < EC_IOCTL_CYCLE_DOMAINS) {
+            domain_mask |= 1ULL << ops[i].index;
+        }
+    }
+
+    ec_ioctl_unlock(&master->io_mutex);
+
+    state->sequence++;
+    smp_wmb();
+
+    state->result = ret;
+    state->failed = ret ? failed : count;
+    ecrt_master_state(master, &state->master_state);
+    for (i = 0; i < EC_IOCTL_CYCLE_DOMAINS; i++) {
+        if ((domain_mask & (1ULL << i))
+                && (domain = ec_master_find_domain_const(master, i))) {
+            ecrt_domain_state(domain, &state->domain_states[i]);
+        }
+    }
+    state->domain_mask |= domain_mask;
+
+    smp_wmb();
+    state->sequence++;
+
+    return ret;
+}
+
+/****************************************************************************/
+
+/** Get the domain state.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_domain_state(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    ec_ioctl_domain_state_t data;
+    const ec_domain_t *domain;
+    ec_domain_state_t state;
+    int ret;
+
     if (unlikely(!ctx->requested))
         return -EPERM;
 
@@ -3803,8 +4531,9 @@ static ATTRIBUTES int ec_ioctl_sdo_request_write(
     if (data.size > req->mem_size)
         return -ENOBUFS;
 
-    if (ec_copy_from_user(req->data, (void __user *) data.data,
-                          data.size, ctx))
+    /* Pinned application memory already contains the data. */
+    if (!req->user_pages && ec_copy_from_user(req->data,
+                (void __user *) data.data, data.size, ctx))
         return -EFAULT;
 
     req->data_size = data.size;
@@ -3853,6 +4582,45 @@ static ATTRIBUTES int ec_ioctl_sdo_request_data(
 
 /****************************************************************************/
 
+/** Uses application memory as data memory of an SDO request.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static ATTRIBUTES int ec_ioctl_sdo_request_memory(
+        ec_master_t *master, /**< EtherCAT master. */
+        void *arg, /**< ioctl() argument. */
+        ec_ioctl_context_t *ctx /**< Private data structure of file handle. */
+        )
+{
+    ec_ioctl_sdo_request_t data;
+    ec_slave_config_t *sc;
+    ec_sdo_request_t *req;
+
+    if (unlikely(!ctx->requested)) {
+        return -EPERM;
+    }
+
+    if (copy_from_user(&data, (void __user *) arg, sizeof(data))) {
+        return -EFAULT;
+    }
+
+    /* no locking of master_sem needed, because neither sc nor req will not be
+     * deleted in the meantime. */
+
+    if (!(sc = ec_master_get_config(master, data.config_index))) {
+        return -ENOENT;
+    }
+
+    if (!(req = ec_slave_config_find_sdo_request(sc, data.request_index))) {
+        return -ENOENT;
+    }
+
+    return ec_sdo_request_user_memory(req, (unsigned long) data.data,
+            data.size);
+}
+
+/****************************************************************************/
+
 /** Sets an SoE request's drive number and IDN.
  *
  * \return Zero on success, otherwise a negative error code.
@@ -5088,6 +5856,20 @@ long ec_ioctl
         case EC_IOCTL_DOMAIN_STATE:
             ret = ec_ioctl_domain_state(master, arg, ctx);
             break;
+        case EC_IOCTL_BATCH:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_batch(master, arg, ctx);
+            break;
+        case EC_IOCTL_CYCLE:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_cycle(master, arg, ctx);
+            break;
         case EC_IOCTL_SDO_REQUEST_INDEX:
             if (!ctx->writable) {
                 ret = -EPERM;
@@ -5233,6 +6015,9 @@ static long ec_ioctl_nrt
         case EC_IOCTL_SLAVE:
             ret = ec_ioctl_slave(master, arg);
             break;
+        case EC_IOCTL_TOPOLOGY:
+            ret = ec_ioctl_topology(master, arg);
+            break;
         case EC_IOCTL_SLAVE_SYNC:
             ret = ec_ioctl_slave_sync(master, arg);
             break;
@@ -5431,6 +6216,13 @@ static long ec_ioctl_nrt
             }
             ret = ec_ioctl_sc_watchdog(master, arg, ctx);
             break;
+        case EC_IOCTL_SC_MAILBOX_SIZE:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_sc_mailbox_size(master, arg, ctx);
+            break;
         case EC_IOCTL_SC_ADD_PDO:
             if (!ctx->writable) {
                 ret = -EPERM;
@@ -5558,6 +6350,41 @@ static long ec_ioctl_nrt
         case EC_IOCTL_DOMAIN_OFFSET:
             ret = ec_ioctl_domain_offset(master, arg, ctx);
             break;
+        case EC_IOCTL_DOMAIN_MEMORY:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_domain_memory(master, arg, ctx);
+            break;
+        case EC_IOCTL_SDO_REQUEST_MEMORY:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_sdo_request_memory(master, arg, ctx);
+            break;
+        case EC_IOCTL_DOMAIN_RESERVE:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_domain_reserve(master, arg, ctx);
+            break;
+        case EC_IOCTL_SC_RELEASE:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_sc_release(master, arg, ctx);
+            break;
+        case EC_IOCTL_SC_APPLY:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_sc_apply(master, arg, ctx);
+            break;
         case EC_IOCTL_SET_SEND_INTERVAL:
             if (!ctx->writable) {
                 ret = -EPERM;
@@ -5565,6 +6392,27 @@ static long ec_ioctl_nrt
             }
             ret = ec_ioctl_set_send_interval(master, arg, ctx);
             break;
+        case EC_IOCTL_SET_RETRANSMISSION:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_set_retransmission(master, arg, ctx);
+            break;
+        case EC_IOCTL_ESI_DB:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_esi_db(master, arg);
+            break;
+        case EC_IOCTL_CYCLE_SETUP:
+            if (!ctx->writable) {
+                ret = -EPERM;
+                break;
+            }
+            ret = ec_ioctl_cycle_setup(master, arg, ctx);
+            break;
         default:
 #ifdef EC_IOCTL_RTDM
             ret = ec_ioctl_both(master, ctx, cmd, arg);
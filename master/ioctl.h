@@ -47,7 +47,7 @@
  *
  * Increment this when changing the ioctl interface!
  */
-#define EC_IOCTL_VERSION_MAGIC 37
+#define EC_IOCTL_VERSION_MAGIC 40
 
 // Command-line tool
 #define EC_IOCTL_MODULE                EC_IOR(0x00, ec_ioctl_module_t)
@@ -161,6 +161,18 @@
 #define EC_IOCTL_VOE_EXEC             EC_IOWR(0x64, ec_ioctl_voe_t)
 #define EC_IOCTL_VOE_DATA             EC_IOWR(0x65, ec_ioctl_voe_t)
 #define EC_IOCTL_SET_SEND_INTERVAL     EC_IOW(0x66, size_t)
+#define EC_IOCTL_ESI_DB                EC_IOW(0x67, ec_ioctl_esi_db_t)
+#define EC_IOCTL_TOPOLOGY             EC_IOWR(0x68, ec_ioctl_topology_t)
+#define EC_IOCTL_DOMAIN_MEMORY         EC_IOW(0x69, ec_ioctl_domain_memory_t)
+#define EC_IOCTL_BATCH                EC_IOWR(0x6a, ec_ioctl_batch_t)
+#define EC_IOCTL_CYCLE_SETUP           EC_IOW(0x6b, ec_ioctl_cycle_setup_t)
+#define EC_IOCTL_CYCLE                  EC_IO(0x6c)
+#define EC_IOCTL_DOMAIN_RESERVE        EC_IOW(0x6d, ec_ioctl_domain_reserve_t)
+#define EC_IOCTL_SC_RELEASE            EC_IOW(0x6e, uint32_t)
+#define EC_IOCTL_SC_APPLY              EC_IOW(0x6f, uint32_t)
+#define EC_IOCTL_SET_RETRANSMISSION    EC_IOW(0x70, ec_ioctl_retransmission_t)
+#define EC_IOCTL_SC_MAILBOX_SIZE       EC_IOW(0x71, ec_ioctl_config_t)
+#define EC_IOCTL_SDO_REQUEST_MEMORY   EC_IOW(0x72, ec_ioctl_sdo_request_t)
 
 /****************************************************************************/
 
@@ -193,6 +205,8 @@ typedef struct {
         uint64_t tx_bytes;
         uint64_t rx_bytes;
         uint64_t tx_errors;
+        uint32_t tx_ring_size;
+        uint64_t tx_ring_overruns;
         int32_t tx_frame_rates[EC_RATE_COUNT];
         int32_t rx_frame_rates[EC_RATE_COUNT];
         int32_t tx_byte_rates[EC_RATE_COUNT];
@@ -211,6 +225,23 @@ typedef struct {
     uint64_t app_time;
     uint64_t dc_ref_time;
     uint16_t ref_clock;
+    int32_t numa_node;
+    uint8_t numa_node_configured;
+    uint32_t send_interval;
+    uint32_t inject_interval;
+    uint32_t inject_cyclic_load;
+    uint32_t inject_budget;
+    uint32_t inject_max_delay;
+    uint64_t injected_master_fsm;
+    uint64_t injected_slave_fsm;
+    uint64_t injected_ext;
+    uint64_t inject_deferred;
+    uint64_t inject_dropped;
+    uint32_t retransmit_delay;
+    uint32_t retransmit_budget;
+    uint64_t retransmitted;
+    uint64_t retransmit_recovered;
+    uint64_t retransmit_lost;
 } ec_ioctl_master_t;
 
 /****************************************************************************/
@@ -235,6 +266,13 @@ typedef struct {
     uint16_t std_tx_mailbox_offset;
     uint16_t std_tx_mailbox_size;
     uint16_t mailbox_protocols;
+    uint16_t configured_rx_mailbox_offset;
+    uint16_t configured_rx_mailbox_size;
+    uint16_t configured_tx_mailbox_offset;
+    uint16_t configured_tx_mailbox_size;
+    uint8_t mbox_size_fallback;
+    uint32_t mbox_repeats;
+    uint32_t mbox_repeat_failures;
     uint8_t has_general_category;
     ec_sii_coe_details_t coe_details;
     ec_sii_general_flags_t general_flags;
@@ -264,6 +302,37 @@ typedef struct {
 
 /****************************************************************************/
 
+typedef struct {
+    uint16_t position;
+    uint16_t alias;
+    uint32_t vendor_id;
+    uint32_t product_code;
+    uint8_t al_state;
+    uint8_t dc_supported;
+    ec_slave_dc_range_t dc_range;
+    uint8_t has_dc_system_time;
+    uint32_t transmission_delay;
+    struct {
+        ec_slave_port_desc_t desc;
+        uint8_t link_up;
+        uint16_t next_slave;
+        uint32_t delay_to_next_dc;
+    } ports[EC_MAX_PORTS];
+    char order[EC_IOCTL_STRING_SIZE];
+} ec_ioctl_topology_slave_t;
+
+typedef struct {
+    // inputs
+    uint32_t max_slaves;
+    ec_ioctl_topology_slave_t *slaves;
+
+    // outputs
+    uint32_t slave_count;
+    uint32_t scan_index;
+} ec_ioctl_topology_t;
+
+/****************************************************************************/
+
 typedef struct {
     // inputs
     uint16_t slave_position;
@@ -498,6 +567,8 @@ typedef struct {
     } syncs[EC_MAX_SYNC_MANAGERS];
     uint16_t watchdog_divider;
     uint16_t watchdog_intervals;
+    uint16_t mbox_rx_size;
+    uint16_t mbox_tx_size;
     uint32_t sdo_count;
     uint32_t idn_count;
     uint32_t flag_count;
@@ -652,6 +723,8 @@ typedef struct {
     // outputs
     void *process_data;
     size_t process_data_size;
+    size_t cycle_state_offset; /**< Offset of the cycle state area. */
+    size_t cycle_state_size; /**< Size of the cycle state area, or zero. */
 } ec_ioctl_master_activate_t;
 
 /****************************************************************************/
@@ -843,8 +916,121 @@ typedef struct {
 
 /****************************************************************************/
 
+typedef struct {
+    // inputs
+    uint32_t size;
+    const uint8_t *data;
+} ec_ioctl_esi_db_t;
+
+/****************************************************************************/
+
+typedef struct {
+    // inputs
+    uint32_t domain_index;
+    uint8_t *memory;
+} ec_ioctl_domain_memory_t;
+
+/****************************************************************************/
+
+typedef struct {
+    // inputs
+    uint32_t domain_index;
+    uint32_t size;
+} ec_ioctl_domain_reserve_t;
+
+/****************************************************************************/
+
+typedef struct {
+    // inputs
+    uint32_t delay;
+    uint32_t budget;
+} ec_ioctl_retransmission_t;
+
+/****************************************************************************/
+
+/** Operations of a command batch (see EC_IOCTL_BATCH).
+ */
+enum {
+    EC_BATCH_RECEIVE = 1,
+    EC_BATCH_SEND,
+    EC_BATCH_DOMAIN_PROCESS, /**< \a index is the domain index. */
+    EC_BATCH_DOMAIN_QUEUE, /**< \a index is the domain index. */
+    EC_BATCH_APP_TIME, /**< \a value is the application time. */
+    EC_BATCH_SYNC_REF,
+    EC_BATCH_SYNC_REF_TO, /**< \a value is the reference time. */
+    EC_BATCH_SYNC_SLAVES,
+    EC_BATCH_SYNC_MON_QUEUE
+};
+
+typedef struct {
+    uint16_t op;
+    uint16_t reserved;
+    uint32_t index;
+    uint64_t value;
+} ec_ioctl_batch_op_t;
+
+/** Maximum number of operations copied at once. */
+#define EC_IOCTL_BATCH_CHUNK 16
+
+typedef struct {
+    // inputs
+    uint32_t count;
+    const ec_ioctl_batch_op_t *ops;
+
+    // outputs
+    uint32_t failed; /**< Index of the first failed operation. */
+} ec_ioctl_batch_t;
+
+/****************************************************************************/
+
+/** Maximum number of cycle programs per file handle. */
+#define EC_IOCTL_CYCLE_PROGRAMS 4
+
+/** Maximum number of operations of a cycle program. */
+#define EC_IOCTL_CYCLE_MAX_OPS 64
+
+/** Number of domains, whose states are published in the cycle state area.
+ */
+#define EC_IOCTL_CYCLE_DOMAINS 64
+
+typedef struct {
+    // inputs
+    uint32_t program;
+    uint32_t count;
+    const ec_ioctl_batch_op_t *ops;
+} ec_ioctl_cycle_setup_t;
+
+/** Cycle state area.
+ *
+ * Mapped behind the process data, if cycle programs were set up before
+ * activation. The kernel increments \a sequence before and after each
+ * update, so readers have to retry while it is odd or has changed.
+ */
+typedef struct {
+    // inputs
+    uint64_t app_time; /**< Time for EC_BATCH_APP_TIME/SYNC_REF_TO ops. */
+
+    // outputs
+    uint32_t sequence; /**< Update sequence counter. */
+    int32_t result; /**< Result of the last program run. */
+    uint32_t failed; /**< Index of the first failed operation. */
+    uint32_t reserved;
+    uint64_t domain_mask; /**< Domains with valid states. */
+    ec_master_state_t master_state;
+    ec_domain_state_t domain_states[EC_IOCTL_CYCLE_DOMAINS];
+} ec_ioctl_cycle_state_t;
+
+/****************************************************************************/
+
 #ifdef __KERNEL__
 
+/** Cycle programs of a file handle (see EC_IOCTL_CYCLE_SETUP).
+ */
+typedef struct {
+    ec_ioctl_batch_op_t ops[EC_IOCTL_CYCLE_PROGRAMS][EC_IOCTL_CYCLE_MAX_OPS];
+    unsigned int count[EC_IOCTL_CYCLE_PROGRAMS]; /**< Operation counts. */
+} ec_ioctl_cycle_t;
+
 /** Context data structure for file handles.
  */
 typedef struct {
@@ -852,6 +1038,8 @@ typedef struct {
     unsigned int requested; /**< Master was requested via this file handle. */
     uint8_t *process_data; /**< Total process data area. */
     size_t process_data_size; /**< Size of the \a process_data. */
+    ec_ioctl_cycle_t *cycle; /**< Cycle programs, or NULL. */
+    ec_ioctl_cycle_state_t *cycle_state; /**< Cycle state area. */
 } ec_ioctl_context_t;
 
 long ec_ioctl(ec_master_t *, ec_ioctl_context_t *, unsigned int,
@@ -201,3 +201,188 @@ uint8_t *ec_slave_mbox_fetch(const ec_slave_t *slave, /**< slave */
 }
 
 /****************************************************************************/
+
+/** Constructor of a mailbox repeat.
+ */
+void ec_mbox_repeat_init(
+        ec_mbox_repeat_t *repeat /**< Mailbox repeat. */
+        )
+{
+    repeat->state = EC_MBOX_REPEAT_IDLE;
+    repeat->retries = 0;
+    repeat->repeats = 0;
+    repeat->activate = 0x00;
+    repeat->jiffies_start = 0;
+}
+
+/****************************************************************************/
+
+/** Prepares a datagram to read the state of the send mailbox.
+ *
+ * Reads the sync manager status (0x080D), activation (0x080E) and PDI
+ * control (0x080F) registers.
+ */
+static void ec_mbox_repeat_prepare_read(
+        const ec_slave_t *slave, /**< Slave. */
+        ec_datagram_t *datagram /**< Datagram. */
+        )
+{
+    ec_datagram_fprd(datagram, slave->station_address, 0x80D, 3);
+    ec_datagram_zero(datagram);
+}
+
+/****************************************************************************/
+
+/** Gives up repeating and fetches the mailbox a last time.
+ *
+ * The result of this fetch is handed to the calling state machine, which
+ * reports the error, if the mailbox is still empty.
+ */
+static void ec_mbox_repeat_fail(
+        ec_slave_t *slave, /**< Slave. */
+        ec_mbox_repeat_t *repeat, /**< Mailbox repeat. */
+        ec_datagram_t *datagram /**< Datagram to use. */
+        )
+{
+    slave->mbox_repeat_failures++;
+    ec_slave_mbox_prepare_fetch(slave, datagram); // can not fail.
+    repeat->state = EC_MBOX_REPEAT_IDLE;
+    repeat->repeats = EC_MBOX_REPEATS;
+}
+
+/****************************************************************************/
+
+/** Recovers a lost mailbox response.
+ *
+ * Has to be called by a mailbox state machine with each datagram, that
+ * shall contain a fetched mailbox response, instead of re-fetching upon a
+ * datagram timeout. If the response was lost (datagram timed out or empty
+ * mailbox read), the repeat request of the send mailbox is toggled, the
+ * repeat acknowledge of the slave is awaited and the mailbox is fetched
+ * again. The datagrams of this sequence pass the calling state, too.
+ *
+ * If the slave does not acknowledge, the mailbox is fetched a last time and
+ * the result is handed to the calling state machine.
+ *
+ * \return Non-zero, if \a next was prepared and the calling state has to
+ *         return, zero if \a received contains the fetched response.
+ */
+int ec_slave_mbox_repeat(
+        ec_slave_t *slave, /**< Slave. */
+        ec_mbox_repeat_t *repeat, /**< Mailbox repeat. */
+        const ec_datagram_t *received, /**< Datagram of the last cycle. */
+        ec_datagram_t *next /**< Datagram to use. May be \a received. */
+        )
+{
+    uint16_t offset = EC_READ_U16(received->address + 2);
+    uint8_t status, pdi_control;
+    unsigned long diff_ms;
+
+    switch (repeat->state) {
+        case EC_MBOX_REPEAT_READ:
+        case EC_MBOX_REPEAT_ACK:
+            if (received->type != EC_DATAGRAM_FPRD || offset != 0x80D) {
+                repeat->state = EC_MBOX_REPEAT_IDLE; // abandoned sequence
+            }
+            break;
+        case EC_MBOX_REPEAT_WRITE:
+            if (received->type != EC_DATAGRAM_FPWR || offset != 0x80E) {
+                repeat->state = EC_MBOX_REPEAT_IDLE;
+            }
+            break;
+        default:
+            break;
+    }
+
+    if (repeat->state != EC_MBOX_REPEAT_IDLE) {
+        if (received->state == EC_DATAGRAM_TIMED_OUT && repeat->retries--) {
+            if (repeat->state == EC_MBOX_REPEAT_WRITE) {
+                ec_datagram_fpwr(next, slave->station_address, 0x80E, 1);
+                EC_WRITE_U8(next->data, repeat->activate);
+            } else {
+                ec_mbox_repeat_prepare_read(slave, next);
+            }
+            return 1;
+        }
+
+        if (received->state != EC_DATAGRAM_RECEIVED) {
+            EC_SLAVE_WARN(slave, "Failed to receive mailbox repeat"
+                    " datagram: ");
+            ec_datagram_print_state(received);
+            ec_mbox_repeat_fail(slave, repeat, next);
+            return 1;
+        }
+
+        if (received->working_counter != 1) {
+            EC_SLAVE_WARN(slave, "Mailbox repeat datagram failed: ");
+            ec_datagram_print_wc_error(received);
+            ec_mbox_repeat_fail(slave, repeat, next);
+            return 1;
+        }
+    }
+
+    switch (repeat->state) {
+        case EC_MBOX_REPEAT_READ:
+            repeat->activate = EC_READ_U8(received->data + 1) ^ 0x02;
+            ec_datagram_fpwr(next, slave->station_address, 0x80E, 1);
+            EC_WRITE_U8(next->data, repeat->activate);
+            repeat->retries = EC_FSM_RETRIES;
+            repeat->state = EC_MBOX_REPEAT_WRITE;
+            return 1;
+
+        case EC_MBOX_REPEAT_WRITE:
+            slave->mbox_repeats++;
+            repeat->jiffies_start = received->jiffies_received;
+            ec_mbox_repeat_prepare_read(slave, next);
+            repeat->retries = EC_FSM_RETRIES;
+            repeat->state = EC_MBOX_REPEAT_ACK;
+            return 1;
+
+        case EC_MBOX_REPEAT_ACK:
+            status = EC_READ_U8(received->data);
+            pdi_control = EC_READ_U8(received->data + 2);
+
+            if ((pdi_control & 0x02) == (repeat->activate & 0x02)
+                    && (status & 0x08)) {
+                // response written again
+                ec_slave_mbox_prepare_fetch(slave, next); // can not fail.
+                repeat->state = EC_MBOX_REPEAT_IDLE;
+                return 1;
+            }
+
+            diff_ms = (received->jiffies_received - repeat->jiffies_start)
+                * 1000 / HZ;
+            if (diff_ms >= EC_MBOX_REPEAT_TIMEOUT) {
+                EC_SLAVE_WARN(slave, "Slave did not acknowledge"
+                        " the mailbox repeat request.\n");
+                ec_mbox_repeat_fail(slave, repeat, next);
+                return 1;
+            }
+
+            ec_mbox_repeat_prepare_read(slave, next);
+            repeat->retries = EC_FSM_RETRIES;
+            return 1;
+
+        default:
+            break;
+    }
+
+    // idle: received contains a fetched mailbox
+    if ((received->state == EC_DATAGRAM_TIMED_OUT
+                || (received->state == EC_DATAGRAM_RECEIVED
+                    && received->working_counter == 0))
+            && repeat->repeats < EC_MBOX_REPEATS) {
+        EC_SLAVE_DBG(slave, 1, "Mailbox response lost."
+                " Requesting repeat.\n");
+        repeat->repeats++;
+        ec_mbox_repeat_prepare_read(slave, next);
+        repeat->retries = EC_FSM_RETRIES;
+        repeat->state = EC_MBOX_REPEAT_READ;
+        return 1;
+    }
+
+    repeat->repeats = 0;
+    return 0;
+}
+
+/****************************************************************************/
@@ -29,7 +29,8 @@
 #ifndef __EC_MAILBOX_H__
 #define __EC_MAILBOX_H__
 
-#include "slave.h"
+#include "globals.h"
+#include "datagram.h"
 
 /****************************************************************************/
 
@@ -49,6 +50,41 @@ enum {
     EC_MBOX_TYPE_VOE = 0x0f,
 };
 
+/** Maximum number of repeat requests per mailbox response.
+ */
+#define EC_MBOX_REPEATS 3
+
+/** Time to wait for the repeat acknowledge of a slave in ms.
+ */
+#define EC_MBOX_REPEAT_TIMEOUT 100
+
+/****************************************************************************/
+
+/** Mailbox repeat states.
+ */
+typedef enum {
+    EC_MBOX_REPEAT_IDLE, /**< Waiting for a fetched response. */
+    EC_MBOX_REPEAT_READ, /**< Reading the sync manager activation. */
+    EC_MBOX_REPEAT_WRITE, /**< Toggling the repeat request. */
+    EC_MBOX_REPEAT_ACK /**< Waiting for the repeat acknowledge. */
+} ec_mbox_repeat_state_t;
+
+/** Mailbox repeat.
+ *
+ * Recovers a mailbox response, that was lost on the way back to the master,
+ * by toggling the repeat request bit of the send mailbox sync manager. The
+ * slave then writes its last response to the mailbox again and
+ * acknowledges with the repeat acknowledge bit.
+ */
+typedef struct {
+    ec_mbox_repeat_state_t state; /**< Repeat state. */
+    unsigned int retries; /**< Retries upon datagram timeout. */
+    unsigned int repeats; /**< Repeat requests for the current response. */
+    uint8_t activate; /**< Sync manager activation with toggled repeat
+                        request. */
+    unsigned long jiffies_start; /**< Start of the acknowledge wait. */
+} ec_mbox_repeat_t;
+
 /****************************************************************************/
 
 uint8_t *ec_slave_mbox_prepare_send(const ec_slave_t *, ec_datagram_t *,
@@ -59,6 +95,10 @@ int      ec_slave_mbox_prepare_fetch(const ec_slave_t *, ec_datagram_t *);
 uint8_t *ec_slave_mbox_fetch(const ec_slave_t *, const ec_datagram_t *,
                              uint8_t *, size_t *);
 
+void     ec_mbox_repeat_init(ec_mbox_repeat_t *);
+int      ec_slave_mbox_repeat(ec_slave_t *, ec_mbox_repeat_t *,
+                              const ec_datagram_t *, ec_datagram_t *);
+
 /****************************************************************************/
 
 #endif
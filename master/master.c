@@ -37,6 +37,10 @@
 #include <linux/version.h>
 #include <linux/hrtimer.h>
 #include <linux/kthread.h>
+#include <linux/math64.h>
+#include <linux/jhash.h>
+#include <linux/numa.h>
+#include <linux/topology.h>
 
 #include "globals.h"
 #include "slave.h"
@@ -76,6 +80,18 @@
 /** SDO injection timeout in microseconds. */
 #define EC_SDO_INJECTION_TIMEOUT 10000
 
+/** Minimum measured send interval in microseconds. */
+#define EC_INJECT_MIN_INTERVAL 8
+
+/** Maximum measured send interval in microseconds. */
+#define EC_INJECT_MAX_INTERVAL 1000000
+
+/** Bus time per frame in bytes, that is not available for datagrams
+ * (preamble, Ethernet header, EtherCAT frame header, FCS and inter-frame
+ * gap).
+ */
+#define EC_FRAME_OVERHEAD (8 + ETH_HLEN + EC_FRAME_HEADER_SIZE + 4 + 12)
+
 #ifdef EC_HAVE_CYCLES
 
 /** Frame timeout in cycles.
@@ -106,12 +122,22 @@ const unsigned int rate_intervals[] = {
 
 /****************************************************************************/
 
+/** Process data datagram, that is sent in IDLE phase during a warm restart.
+ */
+typedef struct {
+    struct list_head list; /**< List item. */
+    ec_datagram_t datagram; /**< Copy of a domain datagram. */
+} ec_warm_datagram_t;
+
+/****************************************************************************/
+
 void ec_master_clear_config(ec_master_t *);
+static void ec_master_warm_release(ec_master_t *);
 void ec_master_clear_slave_configs(ec_master_t *);
 void ec_master_clear_domains(ec_master_t *);
 int ec_master_thread_start(ec_master_t *, int (*)(void *), const char *);
 void ec_master_thread_stop(ec_master_t *);
-void ec_master_inject_external_datagrams(ec_master_t *);
+void ec_master_inject_datagrams(ec_master_t *, int);
 ec_datagram_t *ec_master_get_external_datagram(ec_master_t *);
 void ec_master_exec_slave_fsms(ec_master_t *);
 void ec_master_send_datagrams(ec_master_t *, ec_device_index_t);
@@ -161,7 +187,12 @@ int ec_master_init(ec_master_t *master, /**< EtherCAT master */
         dev_t device_number, /**< Character device number. */
         struct class *class, /**< Device class. */
         unsigned int debug_level, /**< Debug level (module parameter). */
-        unsigned int run_on_cpu /**< bind created kernel threads to a cpu */
+        unsigned int run_on_cpu, /**< bind created kernel threads to a cpu */
+        int numa_node, /**< Preferred NUMA node, or NUMA_NO_NODE. */
+        unsigned int eoe_switch, /**< Create an EoE switch. */
+        unsigned int warm_restart, /**< Enable warm restarts. */
+        unsigned int warm_hold_timeout, /**< Warm hold timeout in s. */
+        unsigned int tx_ring_size /**< Minimum transmit ring size. */
         )
 {
     int ret;
@@ -194,6 +225,13 @@ int ec_master_init(ec_master_t *master, /**< EtherCAT master */
     master->phase = EC_ORPHANED;
     master->active = 0;
     master->config_changed = 0;
+    master->warm_restart = warm_restart;
+    master->warm_hold_timeout = warm_hold_timeout;
+    master->warm_hold_jiffies = 0;
+    master->tx_ring_size = clamp(tx_ring_size,
+            (unsigned int) EC_TX_RING_SIZE,
+            (unsigned int) EC_TX_RING_MAX_SIZE);
+    INIT_LIST_HEAD(&master->warm_datagrams);
     master->injection_seq_fsm = 0;
     master->injection_seq_rt = 0;
 
@@ -203,6 +241,8 @@ int ec_master_init(ec_master_t *master, /**< EtherCAT master */
     INIT_LIST_HEAD(&master->configs);
     INIT_LIST_HEAD(&master->domains);
 
+    ec_esi_db_init(&master->esi_db);
+
     master->app_time = 0ULL;
     master->dc_ref_time = 0ULL;
 
@@ -232,6 +272,16 @@ int ec_master_init(ec_master_t *master, /**< EtherCAT master */
         snprintf(datagram->name, EC_DATAGRAM_NAME_SIZE, "ext-%u", i);
     }
 
+    master->inject_next = 0;
+    for (i = 0; i < EC_INJECT_COUNT; i++) {
+        master->inject_deferred[i] = NULL;
+    }
+    memset(&master->inject_stats, 0, sizeof(master->inject_stats));
+
+    master->retransmit_delay = 0;
+    master->retransmit_budget = 0;
+    memset(&master->retransmit_stats, 0, sizeof(master->retransmit_stats));
+
     // send interval in IDLE phase
     ec_master_set_send_interval(master, 1000000 / HZ);
 
@@ -241,9 +291,18 @@ int ec_master_init(ec_master_t *master, /**< EtherCAT master */
 
     master->debug_level = debug_level;
     master->run_on_cpu = run_on_cpu;
+    if (numa_node != NUMA_NO_NODE
+            && (numa_node < 0 || numa_node >= MAX_NUMNODES
+                || !node_online(numa_node))) {
+        EC_MASTER_WARN(master, "NUMA node %i is not online."
+                " Using automatic placement.\n", numa_node);
+        numa_node = NUMA_NO_NODE;
+    }
+    master->numa_node = numa_node;
     master->stats.timeouts = 0;
     master->stats.corrupted = 0;
     master->stats.unmatched = 0;
+    master->stats.dropped = 0;
     master->stats.output_jiffies = 0;
 
     master->thread = NULL;
@@ -251,6 +310,8 @@ int ec_master_init(ec_master_t *master, /**< EtherCAT master */
 #ifdef EC_EOE
     master->eoe_thread = NULL;
     INIT_LIST_HEAD(&master->eoe_handlers);
+    master->eoe_next = 0;
+    master->eoe_switch = NULL;
 #endif
 
     rt_mutex_init(&master->io_mutex);
@@ -333,6 +394,7 @@ int ec_master_init(ec_master_t *master, /**< EtherCAT master */
                 " monitoring datagram.\n");
         goto out_clear_sync;
     }
+    ec_datagram_freeze(&master->sync_mon_datagram);
 
     master->dc_ref_config = NULL;
     master->dc_ref_clock = NULL;
@@ -340,10 +402,27 @@ int ec_master_init(ec_master_t *master, /**< EtherCAT master */
     INIT_WORK(&master->sc_reset_work, sc_reset_task);
     init_irq_work(&master->sc_reset_work_kicker, sc_reset_task_kicker);
 
+#ifdef EC_EOE
+    if (eoe_switch) {
+        master->eoe_switch = kmalloc(sizeof(ec_eoe_switch_t), GFP_KERNEL);
+        if (!master->eoe_switch) {
+            EC_MASTER_ERR(master, "Failed to allocate EoE switch.\n");
+            ret = -ENOMEM;
+            goto out_clear_sync_mon;
+        }
+        ret = ec_eoe_switch_init(master->eoe_switch, master);
+        if (ret) {
+            kfree(master->eoe_switch);
+            master->eoe_switch = NULL;
+            goto out_clear_sync_mon;
+        }
+    }
+#endif
+
     // init character device
     ret = ec_cdev_init(&master->cdev, master, device_number);
     if (ret)
-        goto out_clear_sync_mon;
+        goto out_clear_eoe_switch;
 
     master->class_device = device_create(class, NULL,
             MKDEV(MAJOR(device_number), master->index), NULL,
@@ -370,6 +449,13 @@ out_unregister_class_device:
 #endif
 out_clear_cdev:
     ec_cdev_clear(&master->cdev);
+out_clear_eoe_switch:
+#ifdef EC_EOE
+    if (master->eoe_switch) {
+        ec_eoe_switch_clear(master->eoe_switch);
+        kfree(master->eoe_switch);
+    }
+#endif
 out_clear_sync_mon:
     ec_datagram_clear(&master->sync_mon_datagram);
 out_clear_sync:
@@ -412,11 +498,18 @@ void ec_master_clear(
 
 #ifdef EC_EOE
     ec_master_clear_eoe_handlers(master);
+    if (master->eoe_switch) {
+        ec_eoe_switch_clear(master->eoe_switch);
+        kfree(master->eoe_switch);
+        master->eoe_switch = NULL;
+    }
 #endif
     ec_master_clear_domains(master);
     ec_master_clear_slave_configs(master);
     ec_master_clear_slaves(master);
 
+    ec_esi_db_clear(&master->esi_db);
+
     ec_datagram_clear(&master->sync_mon_datagram);
     ec_datagram_clear(&master->sync_datagram);
     ec_datagram_clear(&master->ref_sync_datagram);
@@ -479,6 +572,7 @@ void ec_master_clear_slaves(ec_master_t *master)
 {
     ec_slave_t *slave;
 
+    ec_master_warm_release(master);
     master->dc_ref_clock = NULL;
 
     // External requests are obsolete, so we wake pending waiters and remove
@@ -530,6 +624,312 @@ void ec_master_clear_domains(ec_master_t *master)
 
 /****************************************************************************/
 
+/** Releases the datagrams and configurations held for a warm restart.
+ */
+static void ec_master_warm_release(
+        ec_master_t *master /**< EtherCAT master. */
+        )
+{
+    ec_warm_datagram_t *warm, *next;
+    ec_slave_t *slave;
+
+    list_for_each_entry_safe(warm, next, &master->warm_datagrams, list) {
+        list_del(&warm->list);
+        ec_datagram_clear(&warm->datagram);
+        kfree(warm);
+    }
+
+    for (slave = master->slaves;
+            slave < master->slaves + master->slave_count;
+            slave++) {
+        kfree(slave->warm_config);
+        slave->warm_config = NULL;
+        slave->warm_config_size = 0;
+    }
+}
+
+/****************************************************************************/
+
+/** Stores the serialised configuration of a slave for a warm restart.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static int ec_master_warm_store_config(
+        ec_slave_t *slave /**< EtherCAT slave. */
+        )
+{
+    size_t size = ec_slave_config_serialize(slave->config, NULL, 0);
+
+    slave->warm_config = kmalloc(size, GFP_KERNEL);
+    if (!slave->warm_config) {
+        return -ENOMEM;
+    }
+
+    ec_slave_config_serialize(slave->config, slave->warm_config, size);
+    slave->warm_config_size = size;
+    slave->warm_fingerprint = jhash(slave->warm_config, size, 0);
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Checks, if the configuration of a held slave is unchanged.
+ *
+ * The fingerprint is only a pre-check. The configurations are compared byte
+ * for byte, so that a hash collision never adopts a slave with a different
+ * configuration.
+ *
+ * \return Non-zero, if the configuration is unchanged.
+ */
+static int ec_master_warm_config_unchanged(
+        ec_slave_t *slave /**< EtherCAT slave. */
+        )
+{
+    size_t size = ec_slave_config_serialize(slave->config, NULL, 0);
+    uint8_t *data;
+    int unchanged;
+
+    if (size != slave->warm_config_size) {
+        return 0;
+    }
+
+    data = kmalloc(size, GFP_KERNEL);
+    if (!data) {
+        return 0; // reconfigure to be safe
+    }
+
+    ec_slave_config_serialize(slave->config, data, size);
+    unchanged = jhash(data, size, 0) == slave->warm_fingerprint
+        && !memcmp(data, slave->warm_config, size);
+    kfree(data);
+    return unchanged;
+}
+
+/****************************************************************************/
+
+/** Copies a domain datagram for a warm restart.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static int ec_master_warm_copy(
+        ec_master_t *master, /**< EtherCAT master. */
+        const ec_datagram_t *src /**< Domain datagram. */
+        )
+{
+    ec_warm_datagram_t *warm;
+    uint32_t address = EC_READ_U32(src->address);
+    int ret;
+
+    warm = kmalloc(sizeof(ec_warm_datagram_t), GFP_KERNEL);
+    if (!warm) {
+        return -ENOMEM;
+    }
+
+    ec_datagram_init(&warm->datagram);
+
+    switch (src->type) {
+        case EC_DATAGRAM_LRW:
+            ret = ec_datagram_lrw(&warm->datagram, address, src->data_size);
+            break;
+        case EC_DATAGRAM_LWR:
+            ret = ec_datagram_lwr(&warm->datagram, address, src->data_size);
+            break;
+        default:
+            ret = ec_datagram_lrd(&warm->datagram, address, src->data_size);
+            break;
+    }
+
+    if (ret) {
+        ec_datagram_clear(&warm->datagram);
+        kfree(warm);
+        return ret;
+    }
+
+    memcpy(warm->datagram.data, src->data, src->data_size);
+    snprintf(warm->datagram.name, EC_DATAGRAM_NAME_SIZE, "%s", src->name);
+    list_add_tail(&warm->list, &master->warm_datagrams);
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Prepares a warm restart, before the configuration is cleared.
+ *
+ * Slaves in OP keep their state and remember their serialised
+ * configuration. The domain datagrams are copied, so that the idle thread
+ * keeps exchanging the last process data and the watchdogs of the slaves do
+ * not expire.
+ */
+static void ec_master_warm_hold(
+        ec_master_t *master /**< EtherCAT master. */
+        )
+{
+    ec_slave_t *slave;
+    ec_domain_t *domain;
+    const ec_datagram_pair_t *pair;
+    unsigned int held = 0;
+    int ret;
+
+    for (slave = master->slaves;
+            slave < master->slaves + master->slave_count;
+            slave++) {
+        slave->warm_hold = slave->config
+            && slave->current_state == EC_SLAVE_STATE_OP
+            && !slave->force_config && !slave->error_flag;
+        if (slave->warm_hold) {
+            held++;
+        }
+    }
+
+    if (!held) {
+        return;
+    }
+
+    for (slave = master->slaves;
+            slave < master->slaves + master->slave_count;
+            slave++) {
+        if (slave->warm_hold) {
+            ret = ec_master_warm_store_config(slave);
+            if (ret) {
+                EC_SLAVE_ERR(slave, "Failed to store configuration for"
+                        " warm restart (error %i)!\n", ret);
+                goto out_cold;
+            }
+        }
+    }
+
+    list_for_each_entry(domain, &master->domains, list) {
+        list_for_each_entry(pair, &domain->datagram_pairs, list) {
+            ret = ec_master_warm_copy(master,
+                    &pair->datagrams[EC_DEVICE_MAIN]);
+            if (ret) {
+                EC_MASTER_ERR(master, "Failed to copy process data for"
+                        " warm restart (error %i)!\n", ret);
+                goto out_cold;
+            }
+        }
+    }
+
+    master->warm_hold_jiffies = jiffies;
+    EC_MASTER_INFO(master, "Keeping %u slaves in OP for a warm restart.\n",
+            held);
+    return;
+
+out_cold:
+    ec_master_warm_release(master);
+    for (slave = master->slaves;
+            slave < master->slaves + master->slave_count;
+            slave++) {
+        slave->warm_hold = 0;
+    }
+}
+
+/****************************************************************************/
+
+/** Ends a warm hold, that was not adopted within the hold timeout.
+ *
+ * The held slaves are brought to PREOP and the last process data are no
+ * longer sent. Has to be called in IDLE phase with the master_sem held.
+ */
+static void ec_master_warm_expire(
+        ec_master_t *master /**< EtherCAT master. */
+        )
+{
+    ec_slave_t *slave;
+
+    if (list_empty(&master->warm_datagrams) || !master->warm_hold_timeout
+            || time_before(jiffies, master->warm_hold_jiffies
+                + master->warm_hold_timeout * HZ)) {
+        return;
+    }
+
+    EC_MASTER_WARN(master, "No application adopted the slaves within %u s."
+            " Ending warm restart.\n", master->warm_hold_timeout);
+
+    ec_master_warm_release(master);
+
+    for (slave = master->slaves;
+            slave < master->slaves + master->slave_count;
+            slave++) {
+        if (slave->warm_hold) {
+            slave->warm_hold = 0;
+            slave->force_config = 1;
+            ec_slave_request_state(slave, EC_SLAVE_STATE_PREOP);
+        }
+    }
+}
+
+/****************************************************************************/
+
+/** Adopts the slaves held by a warm restart.
+ *
+ * Slaves with an unchanged configuration stay in OP, all others are
+ * reconfigured. The new domains are initialized with the held process data.
+ * Has to be called after finishing the domains, with the master thread
+ * stopped.
+ */
+static void ec_master_warm_adopt(
+        ec_master_t *master /**< EtherCAT master. */
+        )
+{
+    ec_slave_t *slave;
+    ec_domain_t *domain;
+    ec_datagram_pair_t *pair;
+    const ec_warm_datagram_t *warm;
+    unsigned int held = 0, adopted = 0;
+
+    down(&master->master_sem);
+
+    for (slave = master->slaves;
+            slave < master->slaves + master->slave_count;
+            slave++) {
+        if (!slave->warm_hold) {
+            continue;
+        }
+
+        slave->warm_hold = 0;
+        held++;
+
+        if (slave->config && slave->current_state == EC_SLAVE_STATE_OP
+                && ec_master_warm_config_unchanged(slave)) {
+            adopted++;
+            continue;
+        }
+
+        EC_SLAVE_INFO(slave, "Configuration changed. Reconfiguring.\n");
+        ec_slave_request_state(slave, EC_SLAVE_STATE_PREOP);
+        slave->force_config = 1;
+    }
+
+    list_for_each_entry(domain, &master->domains, list) {
+        list_for_each_entry(pair, &domain->datagram_pairs, list) {
+            ec_datagram_t *datagram = &pair->datagrams[EC_DEVICE_MAIN];
+
+            list_for_each_entry(warm, &master->warm_datagrams, list) {
+                if (warm->datagram.type == datagram->type
+                        && warm->datagram.data_size == datagram->data_size
+                        && !memcmp(warm->datagram.address,
+                            datagram->address, EC_ADDR_LEN)) {
+                    memcpy(datagram->data, warm->datagram.data,
+                            datagram->data_size);
+                    break;
+                }
+            }
+        }
+    }
+
+    ec_master_warm_release(master);
+
+    up(&master->master_sem);
+
+    if (held) {
+        EC_MASTER_INFO(master, "Warm restart: Adopted %u of %u slaves.\n",
+                adopted, held);
+    }
+}
+
+/****************************************************************************/
+
 /** Clear the configuration applied by the application.
  */
 void ec_master_clear_config(
@@ -792,6 +1192,9 @@ void ec_master_leave_operation_phase(
     /* Re-allow scanning for IDLE phase. */
     master->allow_scan = 1;
 
+    master->retransmit_delay = 0;
+    master->retransmit_budget = 0;
+
     EC_MASTER_DBG(master, 1, "OPERATION -> IDLE.\n");
 
     master->phase = EC_IDLE;
@@ -799,121 +1202,324 @@ void ec_master_leave_operation_phase(
 
 /****************************************************************************/
 
-/** Injects external datagrams that fit into the datagram queue.
+/** Measures the interval between two calls to ecrt_master_send().
+ *
+ * The measured interval is low-pass filtered. A single sample may at most
+ * double the filtered value, so that a stall does not open up the budget at
+ * once.
  */
-void ec_master_inject_external_datagrams(
+static void ec_master_measure_send_interval(
         ec_master_t *master /**< EtherCAT master */
         )
 {
-    ec_datagram_t *datagram;
-    size_t queue_size = 0, new_queue_size = 0;
-#if DEBUG_INJECT
-    unsigned int datagram_count = 0;
+    ec_inject_stats_t *stats = &master->inject_stats;
+    unsigned int interval;
+#ifdef EC_HAVE_CYCLES
+    cycles_t now = get_cycles();
+
+    interval = (unsigned int)
+        div_u64((u64) (now - master->inject_cycles) * 1000, cpu_khz);
+    master->inject_cycles = now;
+#else
+    unsigned long now = jiffies;
+
+    interval = (unsigned int)
+        ((now - master->inject_jiffies) * 1000000 / HZ);
+    master->inject_jiffies = now;
 #endif
 
-    if (master->ext_ring_idx_rt == master->ext_ring_idx_fsm) {
-        // nothing to inject
-        return;
+    if (interval > 2 * stats->interval) {
+        interval = 2 * stats->interval;
+    }
+
+    stats->interval = (stats->interval * 7 + interval) / 8;
+    if (stats->interval < EC_INJECT_MIN_INTERVAL) {
+        stats->interval = EC_INJECT_MIN_INTERVAL;
+    }
+    else if (stats->interval > EC_INJECT_MAX_INTERVAL) {
+        stats->interval = EC_INJECT_MAX_INTERVAL;
+    }
+}
+
+/****************************************************************************/
+
+/** Calculates the amount of non-application data for the current cycle.
+ *
+ * The capacity of the bus within the measured send interval (minus a 10%
+ * reserve) is reduced by the cyclic load, that the application has already
+ * queued.
+ *
+ * \return Budget in bytes.
+ */
+static size_t ec_master_inject_budget(
+        ec_master_t *master /**< EtherCAT master */
+        )
+{
+    ec_inject_stats_t *stats = &master->inject_stats;
+    ec_datagram_t *datagram;
+    size_t capacity, load = 0;
+
+    capacity = stats->interval * 1000 / EC_BYTE_TRANSMISSION_TIME_NS;
+    capacity -= capacity / 10;
+    if (!master->active && capacity < ETH_DATA_LEN) {
+        /* The idle thread sends as fast as it can, so at least one frame per
+         * call is always free. */
+        capacity = ETH_DATA_LEN;
     }
+    master->max_queue_size = capacity;
 
     list_for_each_entry(datagram, &master->datagram_queue, queue) {
         if (datagram->state == EC_DATAGRAM_QUEUED) {
-            queue_size += datagram->data_size;
+            load += EC_DATAGRAM_HEADER_SIZE + datagram->data_size
+                + EC_DATAGRAM_FOOTER_SIZE;
         }
     }
+    load += (load / ETH_DATA_LEN + 1) * EC_FRAME_OVERHEAD;
 
-#if DEBUG_INJECT
-    EC_MASTER_DBG(master, 1, "Injecting datagrams, queue_size=%zu\n",
-            queue_size);
-#endif
+    stats->cyclic_load = load;
+    stats->budget = capacity > load ? capacity - load : 0;
+    return stats->budget;
+}
 
-    while (master->ext_ring_idx_rt != master->ext_ring_idx_fsm) {
-        datagram = &master->ext_datagram_ring[master->ext_ring_idx_rt];
+/****************************************************************************/
 
-        if (datagram->state != EC_DATAGRAM_INIT) {
-            // skip datagram
-            master->ext_ring_idx_rt =
-                (master->ext_ring_idx_rt + 1) % EC_EXT_RING_SIZE;
-            continue;
-        }
+/** Decides, if the next datagram of an injection class is injected.
+ *
+ * If the datagram does not fit into the budget, it is deferred. After
+ * EC_SDO_INJECTION_TIMEOUT, it is dropped. The datagram of the master state
+ * machine is never dropped, but injected regardless of the budget instead.
+ *
+ * \retval 1 Inject the datagram.
+ * \retval 0 Defer the datagram.
+ * \retval -1 Drop the datagram.
+ */
+static int ec_master_inject_check(
+        ec_master_t *master, /**< EtherCAT master */
+        ec_inject_class_t cls, /**< Injection class. */
+        ec_datagram_t *datagram, /**< Next datagram of the class. */
+        size_t *budget /**< Remaining budget. */
+        )
+{
+    ec_inject_stats_t *stats = &master->inject_stats;
+    size_t size = EC_DATAGRAM_HEADER_SIZE + datagram->data_size
+        + EC_DATAGRAM_FOOTER_SIZE;
+    unsigned int delay = 0;
+    int timeout = 0;
 
-        new_queue_size = queue_size + datagram->data_size;
-        if (new_queue_size <= master->max_queue_size) {
-#if DEBUG_INJECT
-            EC_MASTER_DBG(master, 1, "Injecting datagram %s"
-                    " size=%zu, queue_size=%zu\n", datagram->name,
-                    datagram->data_size, new_queue_size);
-            datagram_count++;
-#endif
+    if (master->inject_deferred[cls] == datagram) {
 #ifdef EC_HAVE_CYCLES
-            datagram->cycles_sent = 0;
+        cycles_t diff = get_cycles() - master->inject_since[cls];
+
+        delay = (unsigned int) div_u64((u64) diff * 1000, cpu_khz);
+        timeout = diff > ext_injection_timeout_cycles;
+#else
+        unsigned long diff = jiffies - master->inject_since[cls];
+
+        delay = (unsigned int) (diff * 1000000 / HZ);
+        timeout = diff > ext_injection_timeout_jiffies;
 #endif
-            datagram->jiffies_sent = 0;
-            ec_master_queue_datagram(master, datagram);
-            queue_size = new_queue_size;
-        }
-        else if (datagram->data_size > master->max_queue_size) {
-            datagram->state = EC_DATAGRAM_ERROR;
-            EC_MASTER_ERR(master, "External datagram %s is too large,"
-                    " size=%zu, max_queue_size=%zu\n",
-                    datagram->name, datagram->data_size,
-                    master->max_queue_size);
-        }
-        else { // datagram does not fit in the current cycle
-#ifdef EC_HAVE_CYCLES
-            cycles_t cycles_now = get_cycles();
+    }
 
-            if (cycles_now - datagram->cycles_sent
-                    > ext_injection_timeout_cycles)
+    if (size > *budget && !timeout) {
+        if (master->inject_deferred[cls] != datagram) {
+            master->inject_deferred[cls] = datagram;
+#ifdef EC_HAVE_CYCLES
+            master->inject_since[cls] = get_cycles();
 #else
-            if (jiffies - datagram->jiffies_sent
-                    > ext_injection_timeout_jiffies)
+            master->inject_since[cls] = jiffies;
 #endif
-            {
-#if defined EC_RT_SYSLOG || DEBUG_INJECT
-                unsigned int time_us;
+            stats->deferred++;
+        }
+#if DEBUG_INJECT
+        EC_MASTER_DBG(master, 1, "Deferred injecting datagram %s"
+                " size=%zu, budget=%zu\n", datagram->name, size, *budget);
 #endif
+        return 0;
+    }
 
-                datagram->state = EC_DATAGRAM_ERROR;
+    master->inject_deferred[cls] = NULL;
 
+    if (size > *budget && cls != EC_INJECT_MASTER_FSM) {
+        stats->dropped++;
+        master->stats.dropped++;
 #if defined EC_RT_SYSLOG || DEBUG_INJECT
+        EC_MASTER_ERR(master, "Timeout %u us: Injecting datagram %s"
+                " size=%zu, budget=%zu\n", delay, datagram->name,
+                size, *budget);
+#endif
+        return -1;
+    }
+
+    *budget = size < *budget ? *budget - size : 0;
+    stats->injected[cls]++;
+    if (delay > stats->max_delay) {
+        stats->max_delay = delay;
+    }
+#if DEBUG_INJECT
+    EC_MASTER_DBG(master, 1, "Injecting datagram %s size=%zu,"
+            " delay=%u us\n", datagram->name, size, delay);
+#endif
+    return 1;
+}
+
+/****************************************************************************/
+
+/** Injects the next datagram of an injection class.
+ *
+ * \return Non-zero, if the class may have further datagrams to inject in
+ * this cycle.
+ */
+static int ec_master_inject_next(
+        ec_master_t *master, /**< EtherCAT master */
+        ec_inject_class_t cls, /**< Injection class. */
+        size_t *budget /**< Remaining budget. */
+        )
+{
+    ec_datagram_t *datagram;
+    int ret;
+
+    /* A deferred datagram, that is no longer pending, is forgotten here.
+     * Otherwise, its deferral time would be applied to the next datagram
+     * in the same memory (e. g. the next one in the same ring slot). */
+    switch (cls) {
+        case EC_INJECT_MASTER_FSM:
+            if (master->injection_seq_rt == master->injection_seq_fsm) {
+                master->inject_deferred[cls] = NULL;
+                return 0;
+            }
+            datagram = &master->fsm_datagram;
+            if (ec_master_inject_check(master, cls, datagram, budget) <= 0) {
+                return 0;
+            }
+            ec_master_queue_datagram(master, datagram);
+            master->injection_seq_rt = master->injection_seq_fsm;
+            return 0;
+
+        case EC_INJECT_SLAVE_FSM:
+            while (master->ext_ring_idx_rt != master->ext_ring_idx_fsm
+                    && master->ext_datagram_ring[
+                    master->ext_ring_idx_rt].state != EC_DATAGRAM_INIT) {
+                // skip datagram
+                datagram =
+                    &master->ext_datagram_ring[master->ext_ring_idx_rt];
+                if (master->inject_deferred[cls] == datagram) {
+                    master->inject_deferred[cls] = NULL;
+                }
+                master->ext_ring_idx_rt =
+                    (master->ext_ring_idx_rt + 1) % EC_EXT_RING_SIZE;
+            }
+            if (master->ext_ring_idx_rt == master->ext_ring_idx_fsm) {
+                master->inject_deferred[cls] = NULL;
+                return 0;
+            }
+            datagram = &master->ext_datagram_ring[master->ext_ring_idx_rt];
+            ret = ec_master_inject_check(master, cls, datagram, budget);
+            if (!ret) {
+                return 0;
+            }
+            if (ret > 0) {
 #ifdef EC_HAVE_CYCLES
-                time_us = (unsigned int)
-                    ((cycles_now - datagram->cycles_sent) * 1000LL)
-                    / cpu_khz;
+                datagram->cycles_sent = 0;
 #else
-                time_us = (unsigned int)
-                    ((jiffies - datagram->jiffies_sent) * 1000000 / HZ);
-#endif
-                EC_MASTER_ERR(master, "Timeout %u us: Injecting"
-                        " external datagram %s size=%zu,"
-                        " max_queue_size=%zu\n", time_us, datagram->name,
-                        datagram->data_size, master->max_queue_size);
+                datagram->ns_sent = 0;
 #endif
+                datagram->jiffies_sent = 0;
+                ec_master_queue_datagram(master, datagram);
             }
             else {
-#if DEBUG_INJECT
-                EC_MASTER_DBG(master, 1, "Deferred injecting"
-                        " external datagram %s size=%u, queue_size=%u\n",
-                        datagram->name, datagram->data_size, queue_size);
-#endif
-                break;
+                datagram->state = EC_DATAGRAM_ERROR;
             }
-        }
+            master->ext_ring_idx_rt =
+                (master->ext_ring_idx_rt + 1) % EC_EXT_RING_SIZE;
+            return 1;
 
-        master->ext_ring_idx_rt =
-            (master->ext_ring_idx_rt + 1) % EC_EXT_RING_SIZE;
+        case EC_INJECT_EXT:
+            if (list_empty(&master->ext_datagram_queue)) {
+                master->inject_deferred[cls] = NULL;
+                return 0;
+            }
+            datagram = list_first_entry(&master->ext_datagram_queue,
+                    ec_datagram_t, ext_queue);
+            ret = ec_master_inject_check(master, cls, datagram, budget);
+            if (!ret) {
+                return 0;
+            }
+            list_del_init(&datagram->ext_queue);
+            if (ret > 0) {
+                ec_master_queue_datagram(master, datagram);
+            }
+            else {
+                datagram->state = EC_DATAGRAM_ERROR;
+            }
+            return 1;
+
+        default:
+            return 0;
     }
+}
 
-#if DEBUG_INJECT
-    EC_MASTER_DBG(master, 1, "Injected %u datagrams.\n", datagram_count);
-#endif
+/****************************************************************************/
+
+/** Injects non-application datagrams that fit into the current cycle.
+ *
+ * The injection classes are served in a round-robin manner, one datagram at
+ * a time, starting with a different class in each cycle.
+ *
+ * Only the cyclic ecrt_master_send() calls are measured for the send
+ * interval. Calls of ecrt_master_send_ext() from the EoE thread happen at
+ * any time and would skew it.
+ */
+void ec_master_inject_datagrams(
+        ec_master_t *master, /**< EtherCAT master */
+        int ext /**< Inject from the \a ext_datagram_queue (the caller holds
+                  \a ext_queue_sem). */
+        )
+{
+    unsigned int pending = 0, first, i;
+    size_t budget;
+
+    if (!ext) {
+        ec_master_measure_send_interval(master);
+    }
+
+    if (master->injection_seq_rt != master->injection_seq_fsm) {
+        pending |= 1 << EC_INJECT_MASTER_FSM;
+    }
+    if (master->ext_ring_idx_rt != master->ext_ring_idx_fsm) {
+        pending |= 1 << EC_INJECT_SLAVE_FSM;
+    }
+    if (ext && !list_empty(&master->ext_datagram_queue)) {
+        pending |= 1 << EC_INJECT_EXT;
+    }
+    if (!pending) {
+        // nothing to inject
+        return;
+    }
+
+    budget = ec_master_inject_budget(master);
+
+    first = master->inject_next;
+    master->inject_next = (first + 1) % EC_INJECT_COUNT;
+
+    while (pending) {
+        for (i = 0; i < EC_INJECT_COUNT; i++) {
+            ec_inject_class_t cls = (first + i) % EC_INJECT_COUNT;
+
+            if ((pending & (1 << cls))
+                    && !ec_master_inject_next(master, cls, &budget)) {
+                pending &= ~(1 << cls);
+            }
+        }
+    }
 }
 
 /****************************************************************************/
 
 /** Sets the expected interval between calls to ecrt_master_send
  * and calculates the maximum amount of data to queue.
+ *
+ * The interval is the initial value for the measurement in
+ * ec_master_inject_datagrams().
  */
 void ec_master_set_send_interval(
         ec_master_t *master, /**< EtherCAT master */
@@ -924,6 +1530,19 @@ void ec_master_set_send_interval(
     master->max_queue_size =
         (send_interval * 1000) / EC_BYTE_TRANSMISSION_TIME_NS;
     master->max_queue_size -= master->max_queue_size / 10;
+
+    master->inject_stats.interval = send_interval;
+    if (master->inject_stats.interval < EC_INJECT_MIN_INTERVAL) {
+        master->inject_stats.interval = EC_INJECT_MIN_INTERVAL;
+    }
+    else if (master->inject_stats.interval > EC_INJECT_MAX_INTERVAL) {
+        master->inject_stats.interval = EC_INJECT_MAX_INTERVAL;
+    }
+#ifdef EC_HAVE_CYCLES
+    master->inject_cycles = get_cycles();
+#else
+    master->inject_jiffies = jiffies;
+#endif
 }
 
 /****************************************************************************/
@@ -991,6 +1610,7 @@ void ec_master_queue_datagram_ext(
 {
     down(&master->ext_queue_sem);
     list_add_tail(&datagram->ext_queue, &master->ext_datagram_queue);
+    datagram->state = EC_DATAGRAM_QUEUED;
     up(&master->ext_queue_sem);
 }
 
@@ -1008,12 +1628,16 @@ void ec_master_send_datagrams(
     size_t datagram_size;
     uint8_t *frame_data, *cur_data = NULL;
     void *follows_word;
+    ec_tx_cache_t *cache = NULL;
 #ifdef EC_HAVE_CYCLES
     cycles_t cycles_start, cycles_sent, cycles_end;
+#else
+    u64 ns_sent;
 #endif
     unsigned long jiffies_sent;
-    unsigned int frame_count, more_datagrams_waiting;
+    unsigned int frame_count, more_datagrams_waiting, pos, cached;
     struct list_head sent_datagrams;
+    int xmit_more;
 
 #ifdef EC_HAVE_CYCLES
     cycles_start = get_cycles();
@@ -1024,10 +1648,21 @@ void ec_master_send_datagrams(
     EC_MASTER_DBG(master, 2, "%s(device_index = %u)\n",
             __func__, device_index);
 
+    /* The deferred doorbell state (netdev_xmit_more()) is per CPU, so all
+     * frames up to the last one have to be sent on the same CPU. Only
+     * drivers, that opted in, get the flag; others (like the generic driver)
+     * may sleep in their start_xmit(). */
+    xmit_more = master->devices[device_index].xmit_more;
+    if (xmit_more) {
+        (void) get_cpu();
+    }
+
     do {
         frame_data = NULL;
         follows_word = NULL;
         more_datagrams_waiting = 0;
+        pos = 0;
+        cached = 1;
 
         // fill current frame with datagrams
         list_for_each_entry(datagram, &master->datagram_queue, queue) {
@@ -1040,6 +1675,7 @@ void ec_master_send_datagrams(
                 // fetch pointer to transmit socket buffer
                 frame_data =
                     ec_device_tx_data(&master->devices[device_index]);
+                cache = ec_device_tx_cache(&master->devices[device_index]);
                 cur_data = frame_data + EC_FRAME_HEADER_SIZE;
             }
 
@@ -1057,20 +1693,38 @@ void ec_master_send_datagrams(
             EC_MASTER_DBG(master, 2, "Adding datagram 0x%02X\n",
                     datagram->index);
 
-            // set "datagram following" flag in previous datagram
-            if (follows_word) {
-                EC_WRITE_U16(follows_word,
-                        EC_READ_U16(follows_word) | 0x8000);
-            }
+            if (cached && pos < cache->count && datagram->frozen
+                    && cache->datagrams[pos] == datagram
+                    && cache->frozen[pos] == datagram->frozen) {
+                // the header from the last use of the socket buffer is
+                // still valid, including the "datagram following" flag of
+                // the previous datagram.
+                EC_WRITE_U8(cur_data + 1, datagram->index);
+            } else {
+                cached = 0;
+
+                // set "datagram following" flag in previous datagram
+                if (follows_word) {
+                    EC_WRITE_U16(follows_word,
+                            EC_READ_U16(follows_word) | 0x8000);
+                }
 
-            // EtherCAT datagram header
-            EC_WRITE_U8 (cur_data, datagram->type);
-            EC_WRITE_U8 (cur_data + 1, datagram->index);
-            memcpy(cur_data + 2, datagram->address, EC_ADDR_LEN);
-            EC_WRITE_U16(cur_data + 6, datagram->data_size & 0x7FF);
-            EC_WRITE_U16(cur_data + 8, 0x0000);
+                // EtherCAT datagram header
+                EC_WRITE_U8 (cur_data, datagram->type);
+                EC_WRITE_U8 (cur_data + 1, datagram->index);
+                memcpy(cur_data + 2, datagram->address, EC_ADDR_LEN);
+                EC_WRITE_U16(cur_data + 6, datagram->data_size & 0x7FF);
+                EC_WRITE_U16(cur_data + 8, 0x0000);
+
+                if (pos < EC_TX_CACHE_DATAGRAMS) {
+                    cache->datagrams[pos] =
+                        datagram->frozen ? datagram : NULL;
+                    cache->frozen[pos] = datagram->frozen;
+                }
+            }
             follows_word = cur_data + 6;
             cur_data += EC_DATAGRAM_HEADER_SIZE;
+            pos++;
 
             // EtherCAT datagram data
             memcpy(cur_data, datagram->data, datagram->data_size);
@@ -1086,21 +1740,40 @@ void ec_master_send_datagrams(
             break;
         }
 
-        // EtherCAT frame header
-        EC_WRITE_U16(frame_data, ((cur_data - frame_data
-                        - EC_FRAME_HEADER_SIZE) & 0x7FF) | 0x1000);
+        if (cached && pos == cache->count) {
+            // frozen frame: frame header and padding are still in place
+            if (cur_data - frame_data < ETH_ZLEN - ETH_HLEN) {
+                cur_data = frame_data + ETH_ZLEN - ETH_HLEN;
+            }
+        } else {
+            if (cached) {
+                // frame is shorter than before: the last datagram was
+                // followed by another one
+                EC_WRITE_U16(follows_word,
+                        EC_READ_U16(follows_word) & 0x7FFF);
+            }
+
+            // frames with more datagrams than recordable are not cached
+            cache->count = pos <= EC_TX_CACHE_DATAGRAMS ? pos : 0;
+
+            // EtherCAT frame header
+            EC_WRITE_U16(frame_data, ((cur_data - frame_data
+                            - EC_FRAME_HEADER_SIZE) & 0x7FF) | 0x1000);
 
-        // pad frame
-        while (cur_data - frame_data < ETH_ZLEN - ETH_HLEN)
-            EC_WRITE_U8(cur_data++, 0x00);
+            // pad frame
+            while (cur_data - frame_data < ETH_ZLEN - ETH_HLEN)
+                EC_WRITE_U8(cur_data++, 0x00);
+        }
 
         EC_MASTER_DBG(master, 2, "frame size: %zu\n", cur_data - frame_data);
 
-        // send frame
+        // send frame, the doorbell may be deferred to the last one
         ec_device_send(&master->devices[device_index],
-                cur_data - frame_data);
+                cur_data - frame_data, more_datagrams_waiting);
 #ifdef EC_HAVE_CYCLES
         cycles_sent = get_cycles();
+#else
+        ns_sent = ktime_to_ns(ktime_get());
 #endif
         jiffies_sent = jiffies;
 
@@ -1109,6 +1782,8 @@ void ec_master_send_datagrams(
             datagram->state = EC_DATAGRAM_SENT;
 #ifdef EC_HAVE_CYCLES
             datagram->cycles_sent = cycles_sent;
+#else
+            datagram->ns_sent = ns_sent;
 #endif
             datagram->jiffies_sent = jiffies_sent;
             list_del_init(&datagram->sent); // empty list of sent datagrams
@@ -1118,6 +1793,10 @@ void ec_master_send_datagrams(
     }
     while (more_datagrams_waiting);
 
+    if (xmit_more) {
+        put_cpu();
+    }
+
 #ifdef EC_HAVE_CYCLES
     if (unlikely(master->debug_level > 1)) {
         cycles_end = get_cycles();
@@ -1145,7 +1824,7 @@ void ec_master_receive_datagrams(
 {
     size_t frame_size, data_size;
     uint8_t datagram_type, datagram_index;
-    unsigned int cmd_follows, matched;
+    unsigned int cmd_follows, matched, dev_idx;
     const uint8_t *cur_data;
     ec_datagram_t *datagram;
 
@@ -1184,6 +1863,15 @@ void ec_master_receive_datagrams(
         return;
     }
 
+    // the transmit socket buffer of the frame can be reused
+    if (likely(size >= EC_FRAME_HEADER_SIZE + 2)) {
+        for (dev_idx = EC_DEVICE_MAIN;
+                dev_idx < ec_master_num_devices(master); dev_idx++) {
+            ec_device_tx_complete(&master->devices[dev_idx],
+                    EC_READ_U8(cur_data + 1));
+        }
+    }
+
     cmd_follows = 1;
     while (cmd_follows) {
         // process datagram header
@@ -1297,6 +1985,12 @@ void ec_master_output_stats(ec_master_t *master /**< EtherCAT master */)
                     master->stats.unmatched == 1 ? "" : "s");
             master->stats.unmatched = 0;
         }
+        if (master->stats.dropped) {
+            EC_MASTER_WARN(master, "%u datagram%s DROPPED before"
+                    " injection!\n", master->stats.dropped,
+                    master->stats.dropped == 1 ? "" : "s");
+            master->stats.dropped = 0;
+        }
     }
 }
 
@@ -1531,6 +2225,7 @@ void ec_master_exec_slave_fsms(
 static int ec_master_idle_thread(void *priv_data)
 {
     ec_master_t *master = (ec_master_t *) priv_data;
+    ec_warm_datagram_t *warm;
     int fsm_exec;
 #ifdef EC_USE_HRTIMER
     size_t sent_bytes;
@@ -1557,6 +2252,8 @@ static int ec_master_idle_thread(void *priv_data)
             break;
         }
 
+        ec_master_warm_expire(master);
+
         fsm_exec = ec_fsm_master_exec(&master->fsm);
 
         ec_master_exec_slave_fsms(master);
@@ -1569,6 +2266,9 @@ static int ec_master_idle_thread(void *priv_data)
         if (fsm_exec) {
             ec_master_queue_datagram(master, &master->fsm_datagram);
         }
+        list_for_each_entry(warm, &master->warm_datagrams, list) {
+            ec_master_queue_datagram(master, &warm->datagram);
+        }
         ecrt_master_send(master);
 #ifdef EC_USE_HRTIMER
         sent_bytes = master->devices[EC_DEVICE_MAIN].tx_skb[
@@ -1723,7 +2423,7 @@ static int ec_master_eoe_thread(void *priv_data)
 {
     ec_master_t *master = (ec_master_t *) priv_data;
     ec_eoe_t *eoe;
-    unsigned int none_open, sth_to_send, all_idle;
+    unsigned int none_open, sth_to_send, all_idle, count;
 
     EC_MASTER_DBG(master, 1, "EoE thread running.\n");
 
@@ -1756,9 +2456,19 @@ static int ec_master_eoe_thread(void *priv_data)
         }
 
         if (sth_to_send) {
+            /* Queue the datagrams in a round-robin order, so that every
+             * handler gets its share of the injection budget. */
+            count = 0;
+            list_for_each_entry(eoe, &master->eoe_handlers, list) {
+                if (count++ >= master->eoe_next) {
+                    ec_eoe_queue(eoe);
+                }
+            }
             list_for_each_entry(eoe, &master->eoe_handlers, list) {
                 ec_eoe_queue(eoe);
             }
+            master->eoe_next = count ? (master->eoe_next + 1) % count : 0;
+
             // (try to) send datagrams
             master->send_cb(master->cb_data);
         }
@@ -1933,6 +2643,38 @@ unsigned int ec_master_domain_count(
 
 /****************************************************************************/
 
+/** Get the NUMA node for process data and datagram memory.
+ *
+ * If no node was configured, the node of the main Ethernet device is used,
+ * so that the frames are assembled close to the NIC. Without an attached
+ * device, the node of the CPU the kernel threads are bound to is used.
+ *
+ * \return NUMA node, or NUMA_NO_NODE if there is no preference.
+ */
+int ec_master_numa_node(
+        const ec_master_t *master /**< EtherCAT master. */
+        )
+{
+    const struct net_device *net_dev = master->devices[EC_DEVICE_MAIN].dev;
+
+    if (master->numa_node != NUMA_NO_NODE) {
+        return master->numa_node;
+    }
+
+    if (net_dev && net_dev->dev.parent
+            && dev_to_node(net_dev->dev.parent) != NUMA_NO_NODE) {
+        return dev_to_node(net_dev->dev.parent);
+    }
+
+    if (master->run_on_cpu != 0xffffffff) {
+        return cpu_to_node(master->run_on_cpu);
+    }
+
+    return NUMA_NO_NODE;
+}
+
+/****************************************************************************/
+
 /** Common implementation for ec_master_find_domain() and
  * ec_master_find_domain_const().
  */
@@ -2107,6 +2849,8 @@ void ec_master_find_dc_ref_clock(
             ref ? ref->station_address : 0xffff, 0x0910, 4);
     ec_datagram_frmw(&master->sync_datagram,
             ref ? ref->station_address : 0xffff, 0x0910, 4);
+    ec_datagram_freeze(&master->ref_sync_datagram);
+    ec_datagram_freeze(&master->sync_datagram);
 }
 
 /****************************************************************************/
@@ -2295,6 +3039,44 @@ ec_domain_t *ecrt_master_create_domain(
 
 /****************************************************************************/
 
+/** Sizes the transmit rings to the frames needed per cycle.
+ *
+ * The ring holds the frames of two cycles, so that no socket buffer is
+ * reused while its frame is still on the way. Has to be called after
+ * finishing the domains, with the master thread stopped.
+ */
+static void ec_master_size_tx_rings(
+        ec_master_t *master /**< EtherCAT master. */
+        )
+{
+    ec_domain_t *domain;
+    ec_datagram_pair_t *pair;
+    unsigned int dev_idx, frames;
+    size_t bytes = 0;
+
+    list_for_each_entry(domain, &master->domains, list) {
+        list_for_each_entry(pair, &domain->datagram_pairs, list) {
+            bytes += EC_DATAGRAM_HEADER_SIZE
+                + pair->datagrams[EC_DEVICE_MAIN].data_size
+                + EC_DATAGRAM_FOOTER_SIZE;
+        }
+    }
+
+    // one more for the last partial frame and one for injected datagrams
+    frames = bytes / (ETH_DATA_LEN - EC_FRAME_HEADER_SIZE) + 2;
+
+    for (dev_idx = EC_DEVICE_MAIN; dev_idx < ec_master_num_devices(master);
+            dev_idx++) {
+        if (ec_device_resize_tx_ring(&master->devices[dev_idx],
+                    max(master->tx_ring_size, 2 * frames)) < 0) {
+            EC_MASTER_WARN(master, "Failed to enlarge the transmit ring"
+                    " to %u frames.\n", 2 * frames);
+        }
+    }
+}
+
+/****************************************************************************/
+
 int ecrt_master_activate(ec_master_t *master)
 {
     uint32_t domain_offset;
@@ -2335,6 +3117,10 @@ int ecrt_master_activate(ec_master_t *master)
     ec_master_eoe_stop(master);
 #endif
 
+    ec_master_warm_adopt(master);
+
+    ec_master_size_tx_rings(master);
+
     EC_MASTER_DBG(master, 1, "FSM datagram is %p.\n", &master->fsm_datagram);
 
     master->injection_seq_fsm = 0;
@@ -2394,12 +3180,21 @@ int ecrt_master_deactivate(ec_master_t *master)
     master->receive_cb = ec_master_internal_receive_cb;
     master->cb_data = master;
 
+    if (master->warm_restart) {
+        ec_master_warm_hold(master);
+    }
+
     ec_master_clear_config(master);
 
     for (slave = master->slaves;
             slave < master->slaves + master->slave_count;
             slave++) {
 
+        if (slave->warm_hold) {
+            // keep the slave in OP, it is adopted by the next application
+            continue;
+        }
+
         // set states for all slaves
         ec_slave_request_state(slave, EC_SLAVE_STATE_PREOP);
 
@@ -2440,18 +3235,28 @@ int ecrt_master_deactivate(ec_master_t *master)
 
 /****************************************************************************/
 
-int ecrt_master_send(ec_master_t *master)
+/** Sends the queued datagrams.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+static int ec_master_send(
+        ec_master_t *master, /**< EtherCAT master */
+        int ext /**< Also inject the \a ext_datagram_queue. */
+        )
 {
     ec_datagram_t *datagram, *n;
     ec_device_index_t dev_idx;
 
-    if (master->injection_seq_rt != master->injection_seq_fsm) {
-        // inject datagram produced by master FSM
-        ec_master_queue_datagram(master, &master->fsm_datagram);
-        master->injection_seq_rt = master->injection_seq_fsm;
+    if (ext) {
+        if (down_trylock(&master->ext_queue_sem)) {
+            return -EAGAIN;
+        }
+        ec_master_inject_datagrams(master, 1);
+        up(&master->ext_queue_sem);
+    }
+    else {
+        ec_master_inject_datagrams(master, 0);
     }
-
-    ec_master_inject_external_datagrams(master);
 
     for (dev_idx = EC_DEVICE_MAIN; dev_idx < ec_master_num_devices(master);
             dev_idx++) {
@@ -2485,6 +3290,143 @@ int ecrt_master_send(ec_master_t *master)
 
 /****************************************************************************/
 
+int ecrt_master_send(ec_master_t *master)
+{
+    return ec_master_send(master, 0);
+}
+
+/****************************************************************************/
+
+/** Counts the unanswered cyclic datagrams.
+ *
+ * \return Number of domain datagrams, that are sent, but not received.
+ */
+static unsigned int ec_master_count_unanswered(
+        ec_master_t *master, /**< EtherCAT master */
+#ifdef EC_HAVE_CYCLES
+        cycles_t since /**< Only count datagrams sent after this time. */
+#else
+        u64 since /**< Only count datagrams sent after this time (ns). */
+#endif
+        )
+{
+    ec_domain_t *domain;
+    ec_datagram_pair_t *pair;
+    unsigned int dev_idx, count = 0;
+
+    list_for_each_entry(domain, &master->domains, list) {
+        list_for_each_entry(pair, &domain->datagram_pairs, list) {
+            for (dev_idx = EC_DEVICE_MAIN;
+                    dev_idx < ec_master_num_devices(master); dev_idx++) {
+                ec_datagram_t *datagram = &pair->datagrams[dev_idx];
+
+                if (datagram->state != EC_DATAGRAM_SENT) {
+                    continue;
+                }
+#ifdef EC_HAVE_CYCLES
+                if ((s64) (datagram->cycles_sent - since) >= 0) {
+#else
+                if (datagram->ns_sent >= since) {
+#endif
+                    count++;
+                }
+            }
+        }
+    }
+
+    return count;
+}
+
+/****************************************************************************/
+
+/** Resends lost cyclic datagrams within the same cycle.
+ *
+ * Domain datagrams, that are not answered after the retransmission delay,
+ * are sent again with fresh indices. The devices are then polled until all
+ * of them are received, or the retransmission budget is exhausted. Only the
+ * idempotent process data datagrams are resent, never the datagrams of the
+ * state machines.
+ */
+static void ec_master_retransmit(
+        ec_master_t *master /**< EtherCAT master */
+        )
+{
+    ec_domain_t *domain;
+    ec_datagram_pair_t *pair;
+    unsigned int dev_idx, resent = 0, pending;
+#ifdef EC_HAVE_CYCLES
+    cycles_t start = get_cycles(), now;
+    cycles_t delay =
+        (cycles_t) master->retransmit_delay * (cpu_khz / 1000);
+    cycles_t budget =
+        (cycles_t) master->retransmit_budget * (cpu_khz / 1000);
+#else
+    u64 start = ktime_to_ns(ktime_get()), now;
+    u64 delay = (u64) master->retransmit_delay * NSEC_PER_USEC;
+    u64 budget = (u64) master->retransmit_budget * NSEC_PER_USEC;
+#endif
+
+    list_for_each_entry(domain, &master->domains, list) {
+        list_for_each_entry(pair, &domain->datagram_pairs, list) {
+            for (dev_idx = EC_DEVICE_MAIN;
+                    dev_idx < ec_master_num_devices(master); dev_idx++) {
+                ec_datagram_t *datagram = &pair->datagrams[dev_idx];
+
+                if (datagram->state != EC_DATAGRAM_SENT) {
+                    continue;
+                }
+#ifdef EC_HAVE_CYCLES
+                if (start - datagram->cycles_sent < delay) {
+#else
+                if (start - datagram->ns_sent < delay) {
+#endif
+                    continue;
+                }
+
+                // still in the queue, gets a fresh index when sent
+                datagram->state = EC_DATAGRAM_QUEUED;
+                resent++;
+            }
+        }
+    }
+
+    if (!resent) {
+        return;
+    }
+
+    for (dev_idx = EC_DEVICE_MAIN; dev_idx < ec_master_num_devices(master);
+            dev_idx++) {
+        if (master->devices[dev_idx].link_state) {
+            ec_master_send_datagrams(master, dev_idx);
+        }
+    }
+
+    do {
+        for (dev_idx = EC_DEVICE_MAIN;
+                dev_idx < ec_master_num_devices(master); dev_idx++) {
+            ec_device_poll(&master->devices[dev_idx]);
+        }
+        pending = ec_master_count_unanswered(master, start);
+#ifdef EC_HAVE_CYCLES
+        now = get_cycles();
+#else
+        now = ktime_to_ns(ktime_get());
+#endif
+    } while (pending && now - start < budget);
+
+    pending = min(resent, pending);
+    master->retransmit_stats.retransmitted += resent;
+    master->retransmit_stats.recovered += resent - pending;
+    master->retransmit_stats.lost += pending;
+
+#ifdef EC_RT_SYSLOG
+    EC_MASTER_DBG(master, 1, "Resent %u cyclic datagram%s, %u lost.\n",
+            resent, resent == 1 ? "" : "s", pending);
+#endif
+}
+
+/****************************************************************************/
+
 int ecrt_master_receive(ec_master_t *master)
 {
     unsigned int dev_idx;
@@ -2495,6 +3437,11 @@ int ecrt_master_receive(ec_master_t *master)
             dev_idx++) {
         ec_device_poll(&master->devices[dev_idx]);
     }
+
+    if (master->retransmit_budget && master->active) {
+        ec_master_retransmit(master);
+    }
+
     ec_master_update_device_stats(master);
 
     // dequeue all datagrams that timed out
@@ -2540,19 +3487,20 @@ int ecrt_master_receive(ec_master_t *master)
 
 int ecrt_master_send_ext(ec_master_t *master)
 {
-    ec_datagram_t *datagram, *next;
+    return ec_master_send(master, 1);
+}
 
-    if (down_trylock(&master->ext_queue_sem))
-        return -EAGAIN;
+/****************************************************************************/
 
-    list_for_each_entry_safe(datagram, next, &master->ext_datagram_queue,
-            ext_queue) {
-        list_del_init(&datagram->ext_queue);
-        ec_master_queue_datagram(master, datagram);
-    }
-    up(&master->ext_queue_sem);
+int ecrt_master_set_retransmission(ec_master_t *master,
+        unsigned int delay_us, unsigned int budget_us)
+{
+    EC_MASTER_DBG(master, 1, "%s(master = 0x%p, delay_us = %u,"
+            " budget_us = %u)\n", __func__, master, delay_us, budget_us);
 
-    return ecrt_master_send(master);
+    master->retransmit_delay = delay_us;
+    master->retransmit_budget = budget_us;
+    return 0;
 }
 
 /****************************************************************************/
@@ -2580,7 +3528,20 @@ ec_slave_config_t *ecrt_master_slave_config_err(ec_master_t *master,
     }
 
     if (found) { // config with same alias/position already existing
-        if (sc->vendor_id != vendor_id || sc->product_code != product_code) {
+        if (sc->released && (sc->vendor_id != vendor_id
+                    || sc->product_code != product_code)) {
+            // replacing a released slave with a different type
+            EC_MASTER_INFO(master, "Reconfiguring %u:%u from 0x%08X/0x%08X"
+                    " to 0x%08X/0x%08X.\n", alias, position,
+                    sc->vendor_id, sc->product_code, vendor_id, product_code);
+
+            down(&master->master_sem);
+            sc->vendor_id = vendor_id;
+            sc->product_code = product_code;
+            ec_slave_config_reload_sync_config(sc);
+            up(&master->master_sem);
+        } else if (sc->vendor_id != vendor_id
+                || sc->product_code != product_code) {
             EC_MASTER_ERR(master, "Slave type mismatch. Slave was"
                     " configured as 0x%08X/0x%08X before. Now configuring"
                     " with 0x%08X/0x%08X.\n", sc->vendor_id, sc->product_code,
@@ -2604,9 +3565,15 @@ ec_slave_config_t *ecrt_master_slave_config_err(ec_master_t *master,
 
         down(&master->master_sem);
 
-        // try to find the addressed slave
-        ec_slave_config_attach(sc);
-        ec_slave_config_load_default_sync_config(sc);
+        if (master->active) {
+            // attached by ecrt_slave_config_apply()
+            sc->released = 1;
+            ec_slave_config_reload_sync_config(sc);
+        } else {
+            // try to find the addressed slave
+            ec_slave_config_attach(sc);
+            ec_slave_config_load_default_sync_config(sc);
+        }
         list_add_tail(&sc->list, &master->configs);
 
         up(&master->master_sem);
@@ -3331,6 +4298,7 @@ EXPORT_SYMBOL(ecrt_master_deactivate);
 EXPORT_SYMBOL(ecrt_master_send);
 EXPORT_SYMBOL(ecrt_master_send_ext);
 EXPORT_SYMBOL(ecrt_master_receive);
+EXPORT_SYMBOL(ecrt_master_set_retransmission);
 EXPORT_SYMBOL(ecrt_master_callbacks);
 EXPORT_SYMBOL(ecrt_master);
 EXPORT_SYMBOL(ecrt_master_scan_progress);
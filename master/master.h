@@ -41,8 +41,10 @@
 #include "device.h"
 #include "domain.h"
 #include "ethernet.h"
+#include "eoe_switch.h"
 #include "fsm_master.h"
 #include "cdev.h"
+#include "esi_db.h"
 
 #ifdef EC_RTDM
 #include "rtdm.h"
@@ -138,11 +140,50 @@ typedef struct {
     unsigned int corrupted; /**< corrupted frames */
     unsigned int unmatched; /**< unmatched datagrams (received, but not
                                queued any longer) */
+    unsigned int dropped; /**< dropped non-application datagrams */
     unsigned long output_jiffies; /**< time of last output */
 } ec_stats_t;
 
 /****************************************************************************/
 
+/** Classes of non-application datagrams.
+ *
+ * The classes are injected into the cyclic frames in a round-robin manner,
+ * so that none of them can starve the others.
+ */
+typedef enum {
+    EC_INJECT_MASTER_FSM, /**< Datagram of the master state machine. */
+    EC_INJECT_SLAVE_FSM, /**< Datagrams of the slave state machines. */
+    EC_INJECT_EXT, /**< Datagrams queued with ec_master_queue_datagram_ext()
+                     (EoE). */
+    EC_INJECT_COUNT /**< Number of classes. */
+} ec_inject_class_t;
+
+/** Injection statistics.
+ */
+typedef struct {
+    u64 injected[EC_INJECT_COUNT]; /**< Injected datagrams per class. */
+    u64 deferred; /**< Injections deferred to a later cycle. */
+    u64 dropped; /**< Datagrams dropped after the injection timeout. */
+    unsigned int max_delay; /**< Maximum injection delay in us. */
+    unsigned int interval; /**< Measured send interval in us. */
+    size_t cyclic_load; /**< Cyclic load of the last cycle in bytes. */
+    size_t budget; /**< Budget of the last cycle in bytes. */
+} ec_inject_stats_t;
+
+/** Retransmission statistics.
+ *
+ * See ecrt_master_set_retransmission().
+ */
+typedef struct {
+    u64 retransmitted; /**< Resent cyclic datagrams. */
+    u64 recovered; /**< Resent datagrams, that were received in time. */
+    u64 lost; /**< Resent datagrams, that were not received within the
+                budget. */
+} ec_retransmit_stats_t;
+
+/****************************************************************************/
+
 /** Device statistics.
  */
 typedef struct {
@@ -212,6 +253,18 @@ struct ec_master {
     ec_master_phase_t phase; /**< Master phase. */
     unsigned int active; /**< Master has been activated. */
     unsigned int config_changed; /**< The configuration changed. */
+    unsigned int warm_restart; /**< Keep the slaves in OP between two
+                                 applications with the same
+                                 configuration. */
+    unsigned int warm_hold_timeout; /**< Time in seconds, after which held
+                                      slaves are released, if no application
+                                      adopted them. Zero means forever. */
+    unsigned long warm_hold_jiffies; /**< Start of the warm hold. */
+    unsigned int tx_ring_size; /**< Minimum number of transmit socket
+                                 buffers per device. */
+    struct list_head warm_datagrams; /**< Process data datagrams, that are
+                                       sent in IDLE phase during a warm
+                                       restart. */
     unsigned int injection_seq_fsm; /**< Datagram injection sequence number
                                       for the FSM side. */
     unsigned int injection_seq_rt; /**< Datagram injection sequence number
@@ -224,6 +277,8 @@ struct ec_master {
     struct list_head configs; /**< List of slave configurations. */
     struct list_head domains; /**< List of domains. */
 
+    ec_esi_db_t esi_db; /**< Device description database. */
+
     u64 app_time; /**< Time of the last ecrt_master_sync() call. */
     u64 dc_ref_time; /**< Common reference timestamp for DC start times. */
     ec_datagram_t ref_sync_datagram; /**< Datagram used for synchronizing the
@@ -267,6 +322,27 @@ struct ec_master {
     unsigned int send_interval; /**< Interval between two calls to
                                   ecrt_master_send(). */
     size_t max_queue_size; /**< Maximum size of datagram queue */
+    unsigned int inject_next; /**< Class to inject first in the next
+                                cycle. */
+    ec_datagram_t *inject_deferred[EC_INJECT_COUNT]; /**< Datagram, that is
+                                                       deferred per class. */
+#ifdef EC_HAVE_CYCLES
+    cycles_t inject_since[EC_INJECT_COUNT]; /**< Start of deferral. */
+    cycles_t inject_cycles; /**< Time of the last ecrt_master_send(). */
+#else
+    unsigned long inject_since[EC_INJECT_COUNT]; /**< Start of deferral. */
+    unsigned long inject_jiffies; /**< Time of the last
+                                    ecrt_master_send(). */
+#endif
+    ec_inject_stats_t inject_stats; /**< Injection statistics. */
+    unsigned int retransmit_delay; /**< Age in us, after which unanswered
+                                     cyclic datagrams are resent. */
+    unsigned int retransmit_budget; /**< Time in us, that
+                                      ecrt_master_receive() may spend on
+                                      retransmissions. Zero disables
+                                      retransmissions. */
+    ec_retransmit_stats_t retransmit_stats; /**< Retransmission
+                                              statistics. */
 
     ec_slave_t *fsm_slave; /**< Slave that is queried next for FSM exec. */
     struct list_head fsm_exec_list; /**< Slave FSM execution list. */
@@ -274,6 +350,8 @@ struct ec_master {
 
     unsigned int debug_level; /**< Master debug level. */
     unsigned int run_on_cpu;  /**< bind kernel threads to this cpu */
+    int numa_node; /**< Preferred NUMA node for process data, or
+                     NUMA_NO_NODE for automatic selection. */
     ec_stats_t stats; /**< Cyclic statistics. */
 
     struct task_struct *thread; /**< Master thread. */
@@ -281,6 +359,9 @@ struct ec_master {
 #ifdef EC_EOE
     struct task_struct *eoe_thread; /**< EoE thread. */
     struct list_head eoe_handlers; /**< Ethernet over EtherCAT handlers. */
+    unsigned int eoe_next; /**< Position of the EoE handler, that queues
+                             its datagram first. */
+    ec_eoe_switch_t *eoe_switch; /**< EoE switch, or NULL. */
 #endif
 
     struct rt_mutex io_mutex;  /**< Mutex used in \a IDLE and \a OP phase. */
@@ -312,7 +393,8 @@ void ec_master_init_static(void);
 
 // master creation/deletion
 int ec_master_init(ec_master_t *, unsigned int, const uint8_t *,
-        const uint8_t *, dev_t, struct class *, unsigned int, unsigned int);
+        const uint8_t *, dev_t, struct class *, unsigned int, unsigned int,
+        int, unsigned int, unsigned int, unsigned int, unsigned int);
 void ec_master_clear(ec_master_t *);
 
 /** Number of Ethernet devices.
@@ -359,6 +441,7 @@ ec_slave_config_t *ec_master_get_config(
 const ec_slave_config_t *ec_master_get_config_const(
         const ec_master_t *, unsigned int);
 unsigned int ec_master_domain_count(const ec_master_t *);
+int ec_master_numa_node(const ec_master_t *);
 ec_domain_t *ec_master_find_domain(ec_master_t *, unsigned int);
 const ec_domain_t *ec_master_find_domain_const(const ec_master_t *,
         unsigned int);
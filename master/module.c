@@ -28,6 +28,7 @@
 #include <linux/module.h>
 #include <linux/device.h>
 #include <linux/err.h>
+#include <linux/numa.h>
 
 #include "globals.h"
 #include "master.h"
@@ -56,6 +57,14 @@ static unsigned int debug_level;  /**< Debug level parameter. */
 static unsigned int run_on_cpu = 0xffffffff; /**< Bind created kernel threads
                                                to a cpu. Default do not bind.
                                               */
+static int numa_nodes[EC_MAX_MASTERS]; /**< NUMA nodes parameter. */
+static unsigned int numa_node_count; /**< Number of NUMA nodes. */
+static unsigned int eoe_switch; /**< EoE switch parameter. */
+static unsigned int warm_restart; /**< Warm restart parameter. */
+static unsigned int warm_hold_timeout = 10; /**< Warm hold timeout
+                                              parameter in seconds. */
+static unsigned int tx_ring_size = EC_TX_RING_SIZE; /**< Transmit ring size
+                                                      parameter. */
 
 static ec_master_t *masters; /**< Array of masters. */
 static struct semaphore master_sem; /**< Master semaphore. */
@@ -84,6 +93,22 @@ module_param_named(debug_level, debug_level, uint, S_IRUGO);
 MODULE_PARM_DESC(debug_level, "Debug level");
 module_param_named(run_on_cpu, run_on_cpu, uint, S_IRUGO);
 MODULE_PARM_DESC(run_on_cpu, "Bind kthreads to a specific cpu");
+module_param_array(numa_nodes, int, &numa_node_count, S_IRUGO);
+MODULE_PARM_DESC(numa_nodes, "NUMA nodes for process data (-1 = auto)");
+#ifdef EC_EOE
+module_param_named(eoe_switch, eoe_switch, uint, S_IRUGO);
+MODULE_PARM_DESC(eoe_switch, "Forward EoE frames in the master and bridge"
+        " the host traffic via one interface per master");
+#endif
+module_param_named(warm_restart, warm_restart, uint, S_IRUGO);
+MODULE_PARM_DESC(warm_restart, "Keep slaves in OP between applications"
+        " with an unchanged configuration");
+module_param_named(warm_hold_timeout, warm_hold_timeout, uint, S_IRUGO);
+MODULE_PARM_DESC(warm_hold_timeout, "Seconds to keep slaves in OP for a warm"
+        " restart (0 = forever)");
+module_param_named(tx_ring_size, tx_ring_size, uint, S_IRUGO);
+MODULE_PARM_DESC(tx_ring_size, "Minimum number of transmit socket buffers"
+        " per device");
 
 /** \endcond */
 
@@ -153,7 +178,10 @@ int __init ec_init_module(void)
 
     for (i = 0; i < master_count; i++) {
         ret = ec_master_init(&masters[i], i, macs[i][0], macs[i][1],
-                    device_number, class, debug_level, run_on_cpu);
+                    device_number, class, debug_level, run_on_cpu,
+                    i < numa_node_count ? numa_nodes[i] : NUMA_NO_NODE,
+                    eoe_switch, warm_restart, warm_hold_timeout,
+                    tx_ring_size);
         if (ret)
             goto out_free_masters;
     }
@@ -144,6 +144,8 @@ static int ec_rtdm_open(
     ctx->ioctl_ctx.requested = 0;
     ctx->ioctl_ctx.process_data = NULL;
     ctx->ioctl_ctx.process_data_size = 0;
+    ctx->ioctl_ctx.cycle = NULL;
+    ctx->ioctl_ctx.cycle_state = NULL;
 
 #if DEBUG
     EC_MASTER_INFO(rtdm_dev->master, "RTDM device %s opened.\n",
@@ -170,6 +172,10 @@ static int ec_rtdm_close(
         ecrt_release_master(rtdm_dev->master);
 	}
 
+    if (ctx->ioctl_ctx.cycle) {
+        kfree(ctx->ioctl_ctx.cycle);
+    }
+
 #if DEBUG
     EC_MASTER_INFO(rtdm_dev->master, "RTDM device %s closed.\n",
             context->device->device_name);
@@ -53,6 +53,8 @@ static int ec_rtdm_open(struct rtdm_fd *fd, int oflags)
 	ctx->ioctl_ctx.requested = 0;
 	ctx->ioctl_ctx.process_data = NULL;
 	ctx->ioctl_ctx.process_data_size = 0;
+	ctx->ioctl_ctx.cycle = NULL;
+	ctx->ioctl_ctx.cycle_state = NULL;
 
 #if DEBUG_RTDM
 	EC_MASTER_INFO(rtdm_dev->master, "RTDM device %s opened.\n",
@@ -76,6 +78,9 @@ static void ec_rtdm_close(struct rtdm_fd *fd)
 	if (ctx->ioctl_ctx.process_data)
 		vfree(ctx->ioctl_ctx.process_data);
 
+	if (ctx->ioctl_ctx.cycle)
+		kfree(ctx->ioctl_ctx.cycle);
+
 #if DEBUG_RTDM
 	EC_MASTER_INFO(rtdm_dev->master, "RTDM device %s closed.\n",
 			dev->name);
@@ -27,7 +27,10 @@
 
 #include <linux/module.h>
 #include <linux/jiffies.h>
+#include <linux/mm.h>
 #include <linux/slab.h>
+#include <linux/vmalloc.h>
+#include <linux/version.h>
 
 #include "sdo_request.h"
 
@@ -53,6 +56,10 @@ void ec_sdo_request_init(
     req->data = NULL;
     req->mem_size = 0;
     req->data_size = 0;
+    req->data_origin = EC_ORIG_INTERNAL;
+    req->user_pages = NULL;
+    req->user_page_count = 0;
+    req->user_mapping = NULL;
     req->issue_timeout = 0; // no timeout
     req->response_timeout = EC_SDO_REQUEST_RESPONSE_TIMEOUT;
     req->dir = EC_DIR_INVALID;
@@ -95,17 +102,51 @@ int ec_sdo_request_copy(
 
 /****************************************************************************/
 
-/** SDO request destructor.
+/** Unpins userspace pages and frees the page array.
+ */
+static void ec_sdo_request_unpin_pages(
+        struct page **pages, /**< Pinned pages. */
+        unsigned int count /**< Number of pages. */
+        )
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+    unpin_user_pages_dirty_lock(pages, count, true);
+#else
+    unsigned int i;
+
+    for (i = 0; i < count; i++) {
+        set_page_dirty_lock(pages[i]);
+        put_page(pages[i]);
+    }
+#endif
+
+    kfree(pages);
+}
+
+/****************************************************************************/
+
+/** Frees the data memory.
+ *
+ * External memory is not freed, but pinned userspace memory is released.
  */
 void ec_sdo_request_clear_data(
         ec_sdo_request_t *req /**< SDO request. */
         )
 {
-    if (req->data) {
+    if (req->data_origin == EC_ORIG_INTERNAL && req->data) {
         kfree(req->data);
-        req->data = NULL;
     }
 
+    if (req->user_pages) {
+        vunmap(req->user_mapping);
+        ec_sdo_request_unpin_pages(req->user_pages, req->user_page_count);
+        req->user_pages = NULL;
+        req->user_page_count = 0;
+        req->user_mapping = NULL;
+    }
+
+    req->data = NULL;
+    req->data_origin = EC_ORIG_INTERNAL;
     req->mem_size = 0;
     req->data_size = 0;
 }
@@ -115,8 +156,11 @@ void ec_sdo_request_clear_data(
 /** Pre-allocates the data memory.
  *
  * If the \a mem_size is already bigger than \a size, nothing is done.
+ * External memory is never replaced.
  *
- * \return 0 on success, otherwise -ENOMEM.
+ * \retval 0 Success.
+ * \retval -ENOMEM Allocation failed.
+ * \retval -ENOBUFS The external memory is too small.
  */
 int ec_sdo_request_alloc(
         ec_sdo_request_t *req, /**< SDO request. */
@@ -126,6 +170,12 @@ int ec_sdo_request_alloc(
     if (size <= req->mem_size)
         return 0;
 
+    if (req->data_origin == EC_ORIG_EXTERNAL) {
+        EC_ERR("SDO data of %zu bytes exceed the external memory"
+                " of %zu bytes.\n", size, req->mem_size);
+        return -ENOBUFS;
+    }
+
     ec_sdo_request_clear_data(req);
 
     if (!(req->data = (uint8_t *) kmalloc(size, GFP_KERNEL))) {
@@ -164,6 +214,85 @@ int ec_sdo_request_copy_data(
 
 /****************************************************************************/
 
+/** Uses memory of the calling userspace process as external memory.
+ *
+ * The pages covering \a size bytes at \a address are pinned and mapped into
+ * the kernel address space, so that SDO data are transferred directly from
+ * and to the application's buffer. They are released together with the
+ * request, or when other memory is set.
+ *
+ * Has to be called in process context while the request is not busy.
+ *
+ * \return Zero on success, otherwise a negative error code.
+ */
+int ec_sdo_request_user_memory(
+        ec_sdo_request_t *req, /**< SDO request. */
+        unsigned long address, /**< Userspace address. */
+        size_t size /**< Size of the memory. */
+        )
+{
+    unsigned long first = address & PAGE_MASK;
+    unsigned int count;
+    struct page **pages;
+    void *mapping;
+    int ret;
+
+    if (!size) {
+        return -EINVAL;
+    }
+
+    if (req->state == EC_INT_REQUEST_QUEUED
+            || req->state == EC_INT_REQUEST_BUSY) {
+        return -EBUSY;
+    }
+
+    count = (PAGE_ALIGN(address + size) - first) >> PAGE_SHIFT;
+
+    pages = kmalloc_array(count, sizeof(struct page *), GFP_KERNEL);
+    if (!pages) {
+        return -ENOMEM;
+    }
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(5, 8, 0)
+    ret = pin_user_pages_fast(first, count, FOLL_WRITE | FOLL_LONGTERM,
+            pages);
+#elif LINUX_VERSION_CODE >= KERNEL_VERSION(5, 2, 0)
+    ret = get_user_pages_fast(first, count, FOLL_WRITE, pages);
+#else
+    ret = get_user_pages_fast(first, count, 1, pages);
+#endif
+    if (ret < 0) {
+        kfree(pages);
+        return ret;
+    }
+
+    if (ret < count) {
+        EC_ERR("Failed to pin userspace memory for SDO 0x%04X:%02X"
+                " (%i of %u pages).\n", req->index, req->subindex,
+                ret, count);
+        ec_sdo_request_unpin_pages(pages, ret);
+        return -EFAULT;
+    }
+
+    mapping = vmap(pages, count, VM_MAP, PAGE_KERNEL);
+    if (!mapping) {
+        ec_sdo_request_unpin_pages(pages, count);
+        return -ENOMEM;
+    }
+
+    ec_sdo_request_clear_data(req);
+    req->user_pages = pages;
+    req->user_page_count = count;
+    req->user_mapping = mapping;
+    req->data = mapping + (address & ~PAGE_MASK);
+    req->data_origin = EC_ORIG_EXTERNAL;
+    req->mem_size = size;
+    req->data_size = size;
+    return 0;
+}
+
+/****************************************************************************/
+
 /** Checks, if the timeout was exceeded.
  *
  * \return non-zero if the timeout was exceeded, else zero.
@@ -196,6 +325,28 @@ int ecrt_sdo_request_timeout(ec_sdo_request_t *req, uint32_t timeout)
 
 /****************************************************************************/
 
+int ecrt_sdo_request_external_memory(ec_sdo_request_t *req, uint8_t *mem,
+        size_t size)
+{
+    if (!mem || !size) {
+        return -EINVAL;
+    }
+
+    if (req->state == EC_INT_REQUEST_QUEUED
+            || req->state == EC_INT_REQUEST_BUSY) {
+        return -EBUSY;
+    }
+
+    ec_sdo_request_clear_data(req);
+    req->data = mem;
+    req->data_origin = EC_ORIG_EXTERNAL;
+    req->mem_size = size;
+    req->data_size = size;
+    return 0;
+}
+
+/****************************************************************************/
+
 uint8_t *ecrt_sdo_request_data(const ec_sdo_request_t *req)
 {
     return req->data;
@@ -245,6 +396,7 @@ int ecrt_sdo_request_write(ec_sdo_request_t *req)
 
 EXPORT_SYMBOL(ecrt_sdo_request_index);
 EXPORT_SYMBOL(ecrt_sdo_request_timeout);
+EXPORT_SYMBOL(ecrt_sdo_request_external_memory);
 EXPORT_SYMBOL(ecrt_sdo_request_data);
 EXPORT_SYMBOL(ecrt_sdo_request_data_size);
 EXPORT_SYMBOL(ecrt_sdo_request_state);
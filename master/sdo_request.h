@@ -44,6 +44,11 @@ struct ec_sdo_request {
     uint8_t *data; /**< Pointer to SDO data. */
     size_t mem_size; /**< Size of SDO data memory. */
     size_t data_size; /**< Size of SDO data. */
+    ec_origin_t data_origin; /**< Origin of the \a data memory. */
+    struct page **user_pages; /**< Pinned pages of userspace memory, that
+                                is used as external memory. */
+    unsigned int user_page_count; /**< Number of \a user_pages. */
+    void *user_mapping; /**< Kernel mapping of \a user_pages. */
     uint8_t complete_access; /**< SDO shall be transferred completely. */
     uint32_t issue_timeout; /**< Maximum time in ms, the processing of the
                               request may take. */
@@ -68,6 +73,7 @@ void ec_sdo_request_clear(ec_sdo_request_t *);
 int ec_sdo_request_copy(ec_sdo_request_t *, const ec_sdo_request_t *);
 int ec_sdo_request_alloc(ec_sdo_request_t *, size_t);
 int ec_sdo_request_copy_data(ec_sdo_request_t *, const uint8_t *, size_t);
+int ec_sdo_request_user_memory(ec_sdo_request_t *, unsigned long, size_t);
 int ec_sdo_request_timed_out(const ec_sdo_request_t *);
 
 /****************************************************************************/
@@ -78,16 +78,25 @@ void ec_slave_init(
     slave->current_state = EC_SLAVE_STATE_UNKNOWN;
     slave->error_flag = 0;
     slave->force_config = 0;
+    slave->warm_hold = 0;
+    slave->warm_fingerprint = 0;
+    slave->warm_config = NULL;
+    slave->warm_config_size = 0;
     slave->configured_rx_mailbox_offset = 0x0000;
     slave->configured_rx_mailbox_size = 0x0000;
     slave->configured_tx_mailbox_offset = 0x0000;
     slave->configured_tx_mailbox_size = 0x0000;
+    slave->mbox_resized = 0;
+    slave->mbox_size_fallback = 0;
+    slave->mbox_repeats = 0;
+    slave->mbox_repeat_failures = 0;
 
     slave->base_type = 0;
     slave->base_revision = 0;
     slave->base_build = 0;
     slave->base_fmmu_count = 0;
     slave->base_sync_count = 0;
+    slave->base_ram_size = 0;
 
     for (i = 0; i < EC_MAX_PORTS; i++) {
         slave->ports[i].desc = EC_PORT_NOT_IMPLEMENTED;
@@ -147,6 +156,9 @@ void ec_slave_init(
     INIT_LIST_HEAD(&slave->sdo_dictionary);
 
     slave->sdo_dictionary_fetched = 0;
+    slave->esi_db_flags = 0;
+    slave->esi_rx_mailbox_max = 0;
+    slave->esi_tx_mailbox_max = 0;
     slave->jiffies_preop = 0;
 
     INIT_LIST_HEAD(&slave->sdo_requests);
@@ -184,6 +184,14 @@ struct ec_slave
     ec_slave_state_t current_state; /**< Current application state. */
     unsigned int error_flag; /**< Stop processing after an error. */
     unsigned int force_config; /**< Force (re-)configuration. */
+    unsigned int warm_hold; /**< The slave is kept in OP between two
+                              applications (warm restart). */
+    uint32_t warm_fingerprint; /**< Hash of \a warm_config, to quickly
+                                 detect a changed configuration. */
+    uint8_t *warm_config; /**< Serialised configuration of the last
+                            application, if \a warm_hold is set (see
+                            ec_slave_config_serialize()). */
+    size_t warm_config_size; /**< Size of \a warm_config in bytes. */
     uint16_t configured_rx_mailbox_offset; /**< Configured receive mailbox
                                              offset. */
     uint16_t configured_rx_mailbox_size; /**< Configured receive mailbox size.
@@ -191,6 +199,14 @@ struct ec_slave
     uint16_t configured_tx_mailbox_offset; /**< Configured send mailbox
                                              offset. */
     uint16_t configured_tx_mailbox_size; /**< Configured send mailbox size. */
+    uint8_t mbox_resized; /**< The configured mailbox sizes differ from the
+                            SII defaults. */
+    uint8_t mbox_size_fallback; /**< The slave refused the resized mailboxes,
+                                  so the SII defaults are used until the
+                                  next scan. */
+    unsigned int mbox_repeats; /**< Mailbox responses requested again. */
+    unsigned int mbox_repeat_failures; /**< Mailbox repeat requests, that
+                                         failed. */
 
     // base data
     uint8_t base_type; /**< Slave type. */
@@ -198,6 +214,7 @@ struct ec_slave
     uint16_t base_build; /**< Build number. */
     uint8_t base_fmmu_count; /**< Number of supported FMMUs. */
     uint8_t base_sync_count; /**< Number of supported sync managers. */
+    uint8_t base_ram_size; /**< Process data RAM size in KiB. */
     uint8_t base_fmmu_bit_operation; /**< FMMU bit operation is supported. */
     uint8_t base_dc_supported; /**< Distributed clocks are supported. */
     ec_slave_dc_range_t base_dc_range; /**< DC range. */
@@ -216,6 +233,12 @@ struct ec_slave
 
     struct list_head sdo_dictionary; /**< SDO dictionary list */
     uint8_t sdo_dictionary_fetched; /**< Dictionary has been fetched. */
+    uint8_t esi_db_flags; /**< Flags of the matching device database record,
+                            or zero. */
+    uint16_t esi_rx_mailbox_max; /**< Maximum receive mailbox size from the
+                                   device database, or zero. */
+    uint16_t esi_tx_mailbox_max; /**< Maximum send mailbox size from the
+                                   device database, or zero. */
     unsigned long jiffies_preop; /**< Time, the slave went to PREOP. */
 
     struct list_head sdo_requests; /**< SDO access requests. */
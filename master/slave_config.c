@@ -88,8 +88,11 @@ void ec_slave_config_init(
     sc->product_code = product_code;
     sc->watchdog_divider = 0; // use default
     sc->watchdog_intervals = 0; // use default
+    sc->mbox_rx_size = 0; // use default
+    sc->mbox_tx_size = 0; // use default
 
     sc->slave = NULL;
+    sc->released = 0;
 
     for (i = 0; i < EC_MAX_SYNC_MANAGERS; i++)
         ec_sync_config_init(&sc->sync_configs[i]);
@@ -208,7 +211,8 @@ void ec_slave_config_clear(
  * is done in a way, that the complete data range of the corresponding sync
  * manager is covered. Seperate FMMUs are configured for each domain. If the
  * FMMU configuration is already prepared, the function does nothing and
- * returns with success.
+ * returns with success. An FMMU, that was released with
+ * ecrt_slave_config_release(), is mapped into the active domain again.
  *
  * \retval >=0 Success, logical offset byte address.
  * \retval  <0 Error code.
@@ -222,26 +226,48 @@ int ec_slave_config_prepare_fmmu(
 {
     unsigned int i;
     ec_fmmu_config_t *fmmu;
+    int ret;
 
     // FMMU configuration already prepared?
     for (i = 0; i < sc->used_fmmus; i++) {
         fmmu = &sc->fmmu_configs[i];
         if (fmmu->domain == domain && fmmu->sync_index == sync_index)
-            return fmmu->logical_start_address;
+            break;
     }
 
-    if (sc->used_fmmus == EC_MAX_FMMUS) {
-        EC_CONFIG_ERR(sc, "FMMU limit reached!\n");
-        return -EOVERFLOW;
-    }
+    if (i < sc->used_fmmus) {
+        if (list_empty(&fmmu->list)) { // released
+            down(&sc->master->master_sem);
+            fmmu->dir = dir;
+            fmmu->data_size = ec_pdo_list_total_size(
+                    &sc->sync_configs[sync_index].pdos);
+            ret = ec_domain_map_fmmu_config(domain, fmmu);
+            up(&sc->master->master_sem);
+            if (ret < 0) {
+                return ret;
+            }
+        }
+    } else {
+        if (sc->used_fmmus == EC_MAX_FMMUS) {
+            EC_CONFIG_ERR(sc, "FMMU limit reached!\n");
+            return -EOVERFLOW;
+        }
 
-    fmmu = &sc->fmmu_configs[sc->used_fmmus++];
+        fmmu = &sc->fmmu_configs[sc->used_fmmus];
 
-    down(&sc->master->master_sem);
-    ec_fmmu_config_init(fmmu, sc, domain, sync_index, dir);
-    up(&sc->master->master_sem);
+        down(&sc->master->master_sem);
+        ret = ec_fmmu_config_init(fmmu, sc, domain, sync_index, dir);
+        up(&sc->master->master_sem);
+        if (ret < 0) {
+            return ret;
+        }
+
+        sc->used_fmmus++;
+    }
 
-    return fmmu->logical_start_address;
+    // offsets are relative to the domain, also after activation
+    return fmmu->logical_start_address -
+        (sc->master->active ? domain->logical_base_address : 0);
 }
 
 /****************************************************************************/
@@ -260,6 +286,11 @@ int ec_slave_config_attach(
     if (sc->slave)
         return 0; // already attached
 
+    if (sc->released) {
+        EC_CONFIG_DBG(sc, 1, "Configuration is released.\n");
+        return -EBUSY;
+    }
+
     if (!(slave = ec_master_find_slave(
                     sc->master, sc->alias, sc->position))) {
         EC_CONFIG_DBG(sc, 1, "Failed to find slave for configuration.\n");
@@ -332,6 +363,176 @@ void ec_slave_config_detach(
 
 /****************************************************************************/
 
+/** Appends data to a configuration serialisation.
+ *
+ * Data exceeding the buffer are only counted.
+ */
+static void ec_slave_config_put(
+        uint8_t *buf, /**< Buffer, or NULL. */
+        size_t size, /**< Buffer size. */
+        size_t *offset, /**< Current offset, is incremented. */
+        const void *data, /**< Data to append. */
+        size_t data_size /**< Size of \a data. */
+        )
+{
+    if (buf && *offset + data_size <= size) {
+        memcpy(buf + *offset, data, data_size);
+    }
+    *offset += data_size;
+}
+
+/****************************************************************************/
+
+/** Appends a 32-bit value to a configuration serialisation.
+ */
+static void ec_slave_config_put_u32(
+        uint8_t *buf, /**< Buffer, or NULL. */
+        size_t size, /**< Buffer size. */
+        size_t *offset, /**< Current offset, is incremented. */
+        uint32_t value /**< Value to append. */
+        )
+{
+    ec_slave_config_put(buf, size, offset, &value, sizeof(value));
+}
+
+/****************************************************************************/
+
+/** Counts the items of a list.
+ *
+ * \return Number of items.
+ */
+static uint32_t ec_slave_config_list_count(
+        const struct list_head *head /**< List head. */
+        )
+{
+    const struct list_head *item;
+    uint32_t count = 0;
+
+    list_for_each(item, head) {
+        count++;
+    }
+
+    return count;
+}
+
+/****************************************************************************/
+
+/** Serialises everything a slave is configured with.
+ *
+ * This covers the identity, the sync manager and PDO configuration, the
+ * FMMUs with their logical addresses, the watchdogs, the mailbox sizes, the
+ * distributed clocks and all startup SDOs, IDNs and feature flags. Every
+ * list is preceded by its length, so that two configurations are equal, if
+ * their serialisations are equal byte for byte. It has to be called after
+ * the domains have been finished.
+ *
+ * Call with \a buf set to NULL to get the required size.
+ *
+ * \return Size of the serialisation in bytes. If this exceeds \a size, the
+ * buffer content is incomplete.
+ */
+size_t ec_slave_config_serialize(
+        const ec_slave_config_t *sc, /**< Slave configuration. */
+        uint8_t *buf, /**< Buffer, or NULL. */
+        size_t size /**< Buffer size. */
+        )
+{
+    const ec_pdo_t *pdo;
+    const ec_pdo_entry_t *entry;
+    const ec_sdo_request_t *sdo;
+    const ec_soe_request_t *soe;
+    const ec_flag_t *flag;
+    const ec_al_timeout_t *timeout;
+    unsigned int i;
+    size_t off = 0;
+
+    ec_slave_config_put_u32(buf, size, &off,
+            sc->alias << 16 | sc->position);
+    ec_slave_config_put_u32(buf, size, &off, sc->vendor_id);
+    ec_slave_config_put_u32(buf, size, &off, sc->product_code);
+    ec_slave_config_put_u32(buf, size, &off,
+            sc->watchdog_divider << 16 | sc->watchdog_intervals);
+    ec_slave_config_put_u32(buf, size, &off,
+            sc->dc_assign_activate << 8 | sc->used_fmmus);
+    ec_slave_config_put_u32(buf, size, &off,
+            sc->mbox_rx_size << 16 | sc->mbox_tx_size);
+
+    for (i = 0; i < EC_SYNC_SIGNAL_COUNT; i++) {
+        ec_slave_config_put_u32(buf, size, &off, sc->dc_sync[i].cycle_time);
+        ec_slave_config_put_u32(buf, size, &off, sc->dc_sync[i].shift_time);
+    }
+
+    for (i = 0; i < EC_MAX_SYNC_MANAGERS; i++) {
+        const ec_sync_config_t *sync = &sc->sync_configs[i];
+
+        ec_slave_config_put_u32(buf, size, &off,
+                i << 16 | sync->dir << 8 | sync->watchdog_mode);
+        ec_slave_config_put_u32(buf, size, &off,
+                ec_pdo_list_count(&sync->pdos));
+
+        list_for_each_entry(pdo, &sync->pdos.list, list) {
+            ec_slave_config_put_u32(buf, size, &off,
+                    pdo->index << 16 | ec_pdo_entry_count(pdo));
+            list_for_each_entry(entry, &pdo->entries, list) {
+                ec_slave_config_put_u32(buf, size, &off,
+                        entry->index << 16 | entry->subindex << 8
+                        | entry->bit_length);
+            }
+        }
+    }
+
+    for (i = 0; i < sc->used_fmmus; i++) {
+        const ec_fmmu_config_t *fmmu = &sc->fmmu_configs[i];
+
+        ec_slave_config_put_u32(buf, size, &off, fmmu->domain->index);
+        ec_slave_config_put_u32(buf, size, &off,
+                fmmu->sync_index << 8 | fmmu->dir);
+        ec_slave_config_put_u32(buf, size, &off,
+                fmmu->logical_start_address);
+        ec_slave_config_put_u32(buf, size, &off, fmmu->data_size);
+    }
+
+    ec_slave_config_put_u32(buf, size, &off,
+            ec_slave_config_list_count(&sc->sdo_configs));
+    list_for_each_entry(sdo, &sc->sdo_configs, list) {
+        ec_slave_config_put_u32(buf, size, &off,
+                sdo->index << 16 | sdo->subindex << 8 | sdo->complete_access);
+        ec_slave_config_put_u32(buf, size, &off, sdo->data_size);
+        ec_slave_config_put(buf, size, &off, sdo->data, sdo->data_size);
+    }
+
+    ec_slave_config_put_u32(buf, size, &off,
+            ec_slave_config_list_count(&sc->soe_configs));
+    list_for_each_entry(soe, &sc->soe_configs, list) {
+        ec_slave_config_put_u32(buf, size, &off,
+                soe->drive_no << 24 | soe->idn << 8 | soe->al_state);
+        ec_slave_config_put_u32(buf, size, &off, soe->data_size);
+        ec_slave_config_put(buf, size, &off, soe->data, soe->data_size);
+    }
+
+    ec_slave_config_put_u32(buf, size, &off,
+            ec_slave_config_list_count(&sc->flags));
+    list_for_each_entry(flag, &sc->flags, list) {
+        size_t key_size = strlen(flag->key);
+
+        ec_slave_config_put_u32(buf, size, &off, flag->value);
+        ec_slave_config_put_u32(buf, size, &off, key_size);
+        ec_slave_config_put(buf, size, &off, flag->key, key_size);
+    }
+
+    ec_slave_config_put_u32(buf, size, &off,
+            ec_slave_config_list_count(&sc->al_timeouts));
+    list_for_each_entry(timeout, &sc->al_timeouts, list) {
+        ec_slave_config_put_u32(buf, size, &off,
+                timeout->from << 8 | timeout->to);
+        ec_slave_config_put_u32(buf, size, &off, timeout->timeout_ms);
+    }
+
+    return off;
+}
+
+/****************************************************************************/
+
 /** Loads the default PDO assignment from the slave object.
  */
 void ec_slave_config_load_default_sync_config(ec_slave_config_t *sc)
@@ -357,6 +558,35 @@ void ec_slave_config_load_default_sync_config(ec_slave_config_t *sc)
 
 /****************************************************************************/
 
+/** Resets the sync manager configurations to the slave's defaults.
+ *
+ * A released configuration is attached temporarily to find the defaults of
+ * the addressed slave. The caller must hold the master semaphore.
+ */
+void ec_slave_config_reload_sync_config(ec_slave_config_t *sc)
+{
+    unsigned int i;
+
+    for (i = 0; i < EC_MAX_SYNC_MANAGERS; i++) {
+        ec_sync_config_clear(&sc->sync_configs[i]);
+        ec_sync_config_init(&sc->sync_configs[i]);
+    }
+
+    if (sc->slave || !sc->released) {
+        ec_slave_config_load_default_sync_config(sc);
+        return;
+    }
+
+    sc->released = 0;
+    if (!ec_slave_config_attach(sc)) {
+        ec_slave_config_load_default_sync_config(sc);
+        ec_slave_config_detach(sc);
+    }
+    sc->released = 1;
+}
+
+/****************************************************************************/
+
 /** Loads the default mapping for a PDO from the slave object.
  */
 void ec_slave_config_load_default_mapping(
@@ -716,6 +946,35 @@ int ecrt_slave_config_watchdog(ec_slave_config_t *sc,
 
 /****************************************************************************/
 
+int ecrt_slave_config_mailbox_size(ec_slave_config_t *sc,
+        uint16_t rx_size, uint16_t tx_size)
+{
+    EC_CONFIG_DBG(sc, 1, "%s(sc = 0x%p, rx_size = %u, tx_size = %u)\n",
+            __func__, sc, rx_size, tx_size);
+
+    if ((rx_size > EC_MAX_DATA_SIZE && rx_size != EC_MAILBOX_SIZE_MAX)
+            || (tx_size > EC_MAX_DATA_SIZE
+                && tx_size != EC_MAILBOX_SIZE_MAX)) {
+        EC_CONFIG_ERR(sc, "Mailbox sizes %u/%u exceed the maximum"
+                " datagram size of %u bytes.\n",
+                rx_size, tx_size, EC_MAX_DATA_SIZE);
+        return -EINVAL;
+    }
+
+    if ((rx_size && rx_size < EC_MAILBOX_SIZE_MIN)
+            || (tx_size && tx_size < EC_MAILBOX_SIZE_MIN)) {
+        EC_CONFIG_ERR(sc, "Mailbox sizes %u/%u are below the minimum"
+                " of %u bytes.\n", rx_size, tx_size, EC_MAILBOX_SIZE_MIN);
+        return -EINVAL;
+    }
+
+    sc->mbox_rx_size = rx_size;
+    sc->mbox_tx_size = tx_size;
+    return 0;
+}
+
+/****************************************************************************/
+
 int ecrt_slave_config_pdo_assign_add(ec_slave_config_t *sc,
         uint8_t sync_index, uint16_t pdo_index)
 {
@@ -1609,10 +1868,153 @@ int ecrt_slave_config_state_timeout(ec_slave_config_t *sc,
 
 /****************************************************************************/
 
+int ecrt_slave_config_release(ec_slave_config_t *sc)
+{
+    ec_master_t *master = sc->master;
+    ec_domain_t *domain;
+    ec_sdo_request_t *req, *next_req;
+    ec_soe_request_t *soe, *next_soe;
+    unsigned int i;
+
+    EC_CONFIG_DBG(sc, 1, "%s(sc = 0x%p)\n", __func__, sc);
+
+    if (!master->active) {
+        EC_CONFIG_ERR(sc, "Only configurations of an active master"
+                " can be released!\n");
+        return -EINVAL;
+    }
+
+    down(&master->master_sem);
+
+    list_for_each_entry(domain, &master->domains, list) {
+        ec_domain_lock_fmmus(domain);
+    }
+
+    /* Remove the FMMUs from their domains. They keep their logical address
+     * range for a later re-registration. */
+    for (i = 0; i < sc->used_fmmus; i++) {
+        ec_fmmu_config_t *fmmu = &sc->fmmu_configs[i];
+
+        if (!list_empty(&fmmu->list)) {
+            list_del_init(&fmmu->list);
+            fmmu->data_size = 0;
+        }
+    }
+
+    list_for_each_entry(domain, &master->domains, list) {
+        ec_domain_update_working_counters(domain);
+        ec_domain_unlock_fmmus(domain);
+    }
+
+    ec_slave_config_reload_sync_config(sc);
+
+    list_for_each_entry_safe(req, next_req, &sc->sdo_configs, list) {
+        list_del(&req->list);
+        ec_sdo_request_clear(req);
+        kfree(req);
+    }
+
+    list_for_each_entry_safe(soe, next_soe, &sc->soe_configs, list) {
+        list_del(&soe->list);
+        ec_soe_request_clear(soe);
+        kfree(soe);
+    }
+
+    if (sc->slave) {
+        ec_slave_t *slave = sc->slave;
+
+        ec_slave_config_detach(sc);
+        ec_slave_request_state(slave, EC_SLAVE_STATE_PREOP);
+        slave->force_config = 1;
+    }
+
+    sc->released = 1;
+
+    up(&master->master_sem);
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Drops the FMMU configurations, that were released and not registered
+ * again.
+ *
+ * The remaining FMMUs are moved to the front of the array. Their domain
+ * list entries are updated accordingly.
+ *
+ * The master_sem has to be held.
+ */
+static void ec_slave_config_drop_released_fmmus(
+        ec_slave_config_t *sc /**< Slave configuration. */
+        )
+{
+    ec_domain_t *domain;
+    unsigned int i, count = 0;
+
+    list_for_each_entry(domain, &sc->master->domains, list) {
+        ec_domain_lock_fmmus(domain);
+    }
+
+    for (i = 0; i < sc->used_fmmus; i++) {
+        ec_fmmu_config_t *fmmu = &sc->fmmu_configs[i];
+
+        if (list_empty(&fmmu->list)) {
+            EC_CONFIG_DBG(sc, 1, "Dropping released FMMU of SM%u.\n",
+                    fmmu->sync_index);
+            continue;
+        }
+
+        if (count != i) {
+            sc->fmmu_configs[count] = *fmmu;
+            list_replace(&fmmu->list, &sc->fmmu_configs[count].list);
+        }
+        count++;
+    }
+
+    sc->used_fmmus = count;
+
+    list_for_each_entry(domain, &sc->master->domains, list) {
+        ec_domain_unlock_fmmus(domain);
+    }
+}
+
+/****************************************************************************/
+
+int ecrt_slave_config_apply(ec_slave_config_t *sc)
+{
+    int ret;
+
+    EC_CONFIG_DBG(sc, 1, "%s(sc = 0x%p)\n", __func__, sc);
+
+    if (!sc->master->active) {
+        return 0; // configured on activation
+    }
+
+    down(&sc->master->master_sem);
+
+    ec_slave_config_drop_released_fmmus(sc);
+    sc->released = 0;
+    ret = ec_slave_config_attach(sc);
+    if (!ret) {
+        sc->slave->force_config = 1;
+        ec_slave_request_state(sc->slave, EC_SLAVE_STATE_OP);
+    }
+
+    up(&sc->master->master_sem);
+
+    if (ret == -ENOENT) {
+        return 0; // attached as soon as the slave appears
+    }
+    return ret;
+}
+
+/****************************************************************************/
+
 /** \cond */
 
 EXPORT_SYMBOL(ecrt_slave_config_sync_manager);
 EXPORT_SYMBOL(ecrt_slave_config_watchdog);
+EXPORT_SYMBOL(ecrt_slave_config_mailbox_size);
 EXPORT_SYMBOL(ecrt_slave_config_pdo_assign_add);
 EXPORT_SYMBOL(ecrt_slave_config_pdo_assign_clear);
 EXPORT_SYMBOL(ecrt_slave_config_pdo_mapping_add);
@@ -1646,6 +2048,8 @@ EXPORT_SYMBOL(ecrt_slave_config_eoe_dns_address);
 EXPORT_SYMBOL(ecrt_slave_config_eoe_hostname);
 #endif
 EXPORT_SYMBOL(ecrt_slave_config_state_timeout);
+EXPORT_SYMBOL(ecrt_slave_config_release);
+EXPORT_SYMBOL(ecrt_slave_config_apply);
 
 /** \endcond */
 
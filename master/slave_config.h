@@ -122,9 +122,16 @@ struct ec_slave_config {
                                  intervals (see spec. reg. 0x0400). */
     uint16_t watchdog_intervals; /**< Process data watchdog intervals (see
                                    spec. reg. 0x0420). */
+    uint16_t mbox_rx_size; /**< Requested receive mailbox size, zero for the
+                             default, or #EC_MAILBOX_SIZE_MAX. */
+    uint16_t mbox_tx_size; /**< Requested send mailbox size, zero for the
+                             default, or #EC_MAILBOX_SIZE_MAX. */
 
     ec_slave_t *slave; /**< Slave pointer. This is \a NULL, if the slave is
                          offline. */
+    uint8_t released; /**< The configuration was released with
+                        ecrt_slave_config_release() and is not attached
+                        until ecrt_slave_config_apply() is called. */
 
     ec_sync_config_t sync_configs[EC_MAX_SYNC_MANAGERS]; /**< Sync manager
                                                    configurations. */
@@ -157,8 +164,11 @@ void ec_slave_config_clear(ec_slave_config_t *);
 
 int ec_slave_config_attach(ec_slave_config_t *);
 void ec_slave_config_detach(ec_slave_config_t *);
+size_t ec_slave_config_serialize(const ec_slave_config_t *, uint8_t *,
+        size_t);
 
 void ec_slave_config_load_default_sync_config(ec_slave_config_t *);
+void ec_slave_config_reload_sync_config(ec_slave_config_t *);
 
 unsigned int ec_slave_config_sdo_count(const ec_slave_config_t *);
 const ec_sdo_request_t *ec_slave_config_get_sdo_by_pos_const(
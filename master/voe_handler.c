@@ -74,6 +74,7 @@ int ec_voe_handler_init(
     voe->dir = EC_DIR_INVALID;
     voe->state = ec_voe_handler_state_error;
     voe->request_state = EC_INT_REQUEST_INIT;
+    ec_mbox_repeat_init(&voe->repeat);
 
     ec_datagram_init(&voe->datagram);
     return ec_datagram_prealloc(&voe->datagram,
@@ -369,7 +370,7 @@ void ec_voe_handler_state_read_response(ec_voe_handler_t *voe)
     uint8_t *data, mbox_prot;
     size_t rec_size;
 
-    if (datagram->state == EC_DATAGRAM_TIMED_OUT && voe->retries--)
+    if (ec_slave_mbox_repeat(slave, &voe->repeat, datagram, datagram))
         return;
 
     if (datagram->state != EC_DATAGRAM_RECEIVED) {
@@ -33,6 +33,7 @@
 
 #include "globals.h"
 #include "datagram.h"
+#include "mailbox.h"
 
 /****************************************************************************/
 
@@ -51,6 +52,7 @@ struct ec_voe_handler {
     void (*state)(ec_voe_handler_t *); /**< State function */
     ec_internal_request_state_t request_state; /**< Handler state. */
     unsigned int retries; /**< retries upon datagram timeout */
+    ec_mbox_repeat_t repeat; /**< Repeat of lost mailbox responses. */
     unsigned long jiffies_start; /**< Timestamp for timeout calculation. */
 };
 
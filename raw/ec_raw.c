@@ -0,0 +1,396 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * Test program for the userspace frame transport.
+ *
+ * In scan mode, a broadcast read datagram is sent cyclically and the number
+ * of responding slaves and the round trip times are reported. In reflect
+ * mode, a number of slaves is emulated on the other end of a link (e.g. a
+ * veth pair), so that the transport can be tested without hardware.
+ */
+
+/****************************************************************************/
+
+#include <errno.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <time.h> /* clock_gettime() */
+
+/****************************************************************************/
+
+#include "transport.h"
+
+/****************************************************************************/
+
+#define NSEC_PER_SEC (1000000000)
+
+/** Size of the EtherCAT frame header.
+ */
+#define EC_FRAME_HEADER_SIZE 2
+
+/** Size of an EtherCAT datagram header.
+ */
+#define EC_DATAGRAM_HEADER_SIZE 10
+
+/** Size of the working counter.
+ */
+#define EC_DATAGRAM_FOOTER_SIZE 2
+
+/** Broadcast read command.
+ */
+#define EC_CMD_BRD 0x07
+
+/****************************************************************************/
+
+static const char *ifname;
+static unsigned int cycles = 1000;
+static unsigned int period_us = 1000;
+static unsigned int slave_count = 1;
+static volatile sig_atomic_t quit;
+
+static ec_raw_t raw;
+
+/****************************************************************************/
+
+static long long timespec_diff_ns(const struct timespec *a,
+        const struct timespec *b)
+{
+    return (b->tv_sec - a->tv_sec) * (long long) NSEC_PER_SEC
+        + b->tv_nsec - a->tv_nsec;
+}
+
+/****************************************************************************/
+
+static void timespec_add_ns(struct timespec *t, long long ns)
+{
+    ns += t->tv_nsec;
+    t->tv_sec += ns / NSEC_PER_SEC;
+    t->tv_nsec = ns % NSEC_PER_SEC;
+}
+
+/****************************************************************************/
+
+static void signal_handler(int signum)
+{
+    (void) signum;
+    quit = 1;
+}
+
+/****************************************************************************/
+
+static uint16_t read_u16(const uint8_t *p)
+{
+    return p[0] | p[1] << 8;
+}
+
+/****************************************************************************/
+
+static void write_u16(uint8_t *p, uint16_t value)
+{
+    p[0] = value & 0xff;
+    p[1] = value >> 8;
+}
+
+/*****************************************************************************
+ * Scan mode.
+ ****************************************************************************/
+
+/** Builds a frame with a single BRD datagram reading the ESC type register.
+ *
+ * \return Frame size.
+ */
+static size_t build_scan_frame(uint8_t *frame, uint8_t index)
+{
+    uint8_t *dgram = frame + EC_FRAME_HEADER_SIZE;
+    size_t data_size = 2,
+           size = EC_DATAGRAM_HEADER_SIZE + data_size
+               + EC_DATAGRAM_FOOTER_SIZE;
+
+    write_u16(frame, (size & 0x7ff) | 0x1000);
+    dgram[0] = EC_CMD_BRD;
+    dgram[1] = index;
+    memset(dgram + 2, 0x00, 4); // address 0x0000:0x0000
+    write_u16(dgram + 6, data_size);
+    write_u16(dgram + 8, 0x0000);
+    memset(dgram + EC_DATAGRAM_HEADER_SIZE, 0x00,
+            data_size + EC_DATAGRAM_FOOTER_SIZE);
+
+    return EC_FRAME_HEADER_SIZE + size;
+}
+
+/****************************************************************************/
+
+static int scan(void)
+{
+    struct timespec wakeup, sent, now;
+    long long rtt, rtt_min = -1, rtt_max = 0, rtt_sum = 0;
+    unsigned int cycle, answered = 0, lost = 0;
+    int slaves = -1;
+
+    clock_gettime(CLOCK_MONOTONIC, &wakeup);
+
+    for (cycle = 0; cycle < cycles && !quit; cycle++) {
+        uint8_t index = cycle & 0xff;
+        uint8_t *data;
+        const uint8_t *frame;
+        size_t size;
+        int ret, found = 0;
+
+        timespec_add_ns(&wakeup, period_us * 1000LL);
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &wakeup, NULL);
+
+        // drop late answers of previous cycles
+        while (ec_raw_receive(&raw, &size)) {
+            ec_raw_release(&raw);
+        }
+
+        if (!(data = ec_raw_tx_data(&raw))) {
+            lost++;
+            continue;
+        }
+        size = build_scan_frame(data, index);
+
+        clock_gettime(CLOCK_MONOTONIC, &sent);
+        if ((ret = ec_raw_send(&raw, size, 0))) {
+            fprintf(stderr, "Failed to send frame: %s\n", strerror(-ret));
+            return ret;
+        }
+
+        // busy poll the RX ring until the end of the cycle
+        do {
+            clock_gettime(CLOCK_MONOTONIC, &now);
+            frame = ec_raw_receive(&raw, &size);
+            if (!frame) {
+                continue;
+            }
+
+            if (size >= EC_FRAME_HEADER_SIZE + EC_DATAGRAM_HEADER_SIZE + 2
+                    + EC_DATAGRAM_FOOTER_SIZE
+                    && frame[EC_FRAME_HEADER_SIZE] == EC_CMD_BRD
+                    && frame[EC_FRAME_HEADER_SIZE + 1] == index) {
+                slaves = read_u16(frame + EC_FRAME_HEADER_SIZE
+                        + EC_DATAGRAM_HEADER_SIZE + 2);
+                found = 1;
+            }
+            ec_raw_release(&raw);
+        } while (!found
+                && timespec_diff_ns(&sent, &now) < period_us * 1000LL);
+
+        if (!found) {
+            lost++;
+            continue;
+        }
+
+        rtt = timespec_diff_ns(&sent, &now);
+        if (rtt_min < 0 || rtt < rtt_min) {
+            rtt_min = rtt;
+        }
+        if (rtt > rtt_max) {
+            rtt_max = rtt;
+        }
+        rtt_sum += rtt;
+        answered++;
+    }
+
+    printf("Slaves:     %d\n", slaves);
+    printf("Frames:     %u sent, %u answered, %u lost\n",
+            cycle, answered, lost);
+    if (answered) {
+        printf("RTT/us:     min %.1f, mean %.1f, max %.1f\n",
+                rtt_min / 1e3, rtt_sum / 1e3 / answered, rtt_max / 1e3);
+    }
+    printf("Ring:       %llu sent, %llu received, %llu busy\n",
+            (unsigned long long) raw.tx_count,
+            (unsigned long long) raw.rx_count,
+            (unsigned long long) raw.tx_busy);
+
+    return answered ? 0 : -ETIMEDOUT;
+}
+
+/*****************************************************************************
+ * Reflect mode.
+ ****************************************************************************/
+
+/** Processes a received frame like a chain of slaves without memory.
+ *
+ * Each datagram's working counter is incremented once per emulated slave.
+ *
+ * \return Non-zero, if the frame is valid.
+ */
+static int reflect_frame(uint8_t *frame, size_t size)
+{
+    size_t frame_size, pos = EC_FRAME_HEADER_SIZE;
+
+    if (size < EC_FRAME_HEADER_SIZE) {
+        return 0;
+    }
+
+    frame_size = read_u16(frame) & 0x7ff;
+    if (frame_size > size - EC_FRAME_HEADER_SIZE) {
+        return 0;
+    }
+
+    while (pos + EC_DATAGRAM_HEADER_SIZE + EC_DATAGRAM_FOOTER_SIZE
+            <= EC_FRAME_HEADER_SIZE + frame_size) {
+        uint16_t len = read_u16(frame + pos + 6);
+        uint8_t *wc = frame + pos + EC_DATAGRAM_HEADER_SIZE + (len & 0x7ff);
+
+        if (wc + EC_DATAGRAM_FOOTER_SIZE
+                > frame + EC_FRAME_HEADER_SIZE + frame_size) {
+            return 0;
+        }
+        write_u16(wc, read_u16(wc) + slave_count);
+
+        if (!(len & 0x8000)) { // no more datagrams
+            break;
+        }
+        pos = wc + EC_DATAGRAM_FOOTER_SIZE - frame;
+    }
+
+    return 1;
+}
+
+/****************************************************************************/
+
+static int reflect(void)
+{
+    unsigned long long reflected = 0;
+
+    printf("Emulating %u slave(s) on %s.\n", slave_count, ifname);
+
+    while (!quit) {
+        const uint8_t *frame;
+        uint8_t *data;
+        size_t size;
+        unsigned int queued = 0;
+
+        // reflect all pending frames and send them at once
+        while ((frame = ec_raw_receive(&raw, &size))) {
+            if (size <= ETH_DATA_LEN && (data = ec_raw_tx_data(&raw))) {
+                memcpy(data, frame, size);
+                if (reflect_frame(data, size)) {
+                    ec_raw_send(&raw, size, 1);
+                    queued++;
+                }
+            }
+            ec_raw_release(&raw);
+        }
+
+        if (queued) {
+            ec_raw_flush(&raw);
+            reflected += queued;
+        } else {
+            struct pollfd pfd = {raw.fd, POLLIN, 0};
+            poll(&pfd, 1, 100);
+        }
+    }
+
+    printf("Reflected %llu frames, %llu busy.\n", reflected,
+            (unsigned long long) raw.tx_busy);
+    return 0;
+}
+
+/****************************************************************************/
+
+static void usage(const char *name)
+{
+    fprintf(stderr,
+            "Usage: %s [OPTIONS] -i <INTERFACE> <scan|reflect>\n"
+            "\n"
+            "Modes:\n"
+            "  scan             Cyclically send a broadcast read and report\n"
+            "                   the slave count and the round trip times.\n"
+            "  reflect          Emulate slaves on the other end of a link.\n"
+            "\n"
+            "Options:\n"
+            "  -i <interface>   Network interface.\n"
+            "  -n <cycles>      Scan cycles (default: %u).\n"
+            "  -p <period>      Cycle period in us (default: %u).\n"
+            "  -s <slaves>      Slaves to emulate (default: %u).\n"
+            "  -h               Show this help.\n",
+            name, cycles, period_us, slave_count);
+}
+
+/****************************************************************************/
+
+int main(int argc, char **argv)
+{
+    const char *mode;
+    int c, ret;
+
+    while ((c = getopt(argc, argv, "i:n:p:s:h")) != -1) {
+        switch (c) {
+            case 'i':
+                ifname = optarg;
+                break;
+            case 'n':
+                cycles = strtoul(optarg, NULL, 0);
+                break;
+            case 'p':
+                period_us = strtoul(optarg, NULL, 0);
+                break;
+            case 's':
+                slave_count = strtoul(optarg, NULL, 0);
+                break;
+            case 'h':
+                usage(argv[0]);
+                return 0;
+            default:
+                usage(argv[0]);
+                return 1;
+        }
+    }
+
+    if (!ifname || optind != argc - 1 || !period_us) {
+        usage(argv[0]);
+        return 1;
+    }
+    mode = argv[optind];
+
+    if (strcmp(mode, "scan") && strcmp(mode, "reflect")) {
+        fprintf(stderr, "Invalid mode '%s'.\n", mode);
+        usage(argv[0]);
+        return 1;
+    }
+
+    if (ec_raw_open(&raw, ifname, 0)) {
+        return 1;
+    }
+
+    signal(SIGINT, signal_handler);
+    signal(SIGTERM, signal_handler);
+
+    if (!strcmp(mode, "scan")) {
+        ret = scan();
+    } else {
+        ret = reflect();
+    }
+
+    ec_raw_close(&raw);
+    return ret ? 1 : 0;
+}
+
+/****************************************************************************/
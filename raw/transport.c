@@ -0,0 +1,356 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * Userspace EtherCAT frame transport via PACKET_MMAP rings.
+ */
+
+/****************************************************************************/
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+#include <arpa/inet.h>
+#include <net/if.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <linux/if_packet.h>
+
+#include "transport.h"
+
+/****************************************************************************/
+
+/** Size of a ring block.
+ */
+#define EC_RAW_BLOCK_SIZE 4096
+
+/** Size of a ring frame. Two frames fit into a block.
+ */
+#define EC_RAW_FRAME_SIZE (EC_RAW_BLOCK_SIZE / 2)
+
+/** Offset of the frame data in a TX ring frame.
+ */
+#define EC_RAW_TX_OFFSET (TPACKET2_HDRLEN - sizeof(struct sockaddr_ll))
+
+/****************************************************************************/
+
+/** Returns a frame header of a ring.
+ */
+static struct tpacket2_hdr *ec_raw_frame(
+        const ec_raw_t *raw, /**< Transport. */
+        unsigned int ring, /**< 0 for RX, 1 for TX. */
+        unsigned int index /**< Frame index. */
+        )
+{
+    return (struct tpacket2_hdr *) (raw->map
+            + (ring * raw->frame_count + index) * raw->frame_size);
+}
+
+/****************************************************************************/
+
+/** Opens the transport on a network interface.
+ *
+ * \retval  0 Success.
+ * \retval <0 Error code.
+ */
+int ec_raw_open(
+        ec_raw_t *raw, /**< Transport. */
+        const char *ifname, /**< Interface name. */
+        unsigned int frame_count /**< Frames per ring (even), or zero for
+                                   the default. */
+        )
+{
+    struct tpacket_req req;
+    struct sockaddr_ll addr;
+    struct ifreq ifr;
+    int version = TPACKET_V2, one = 1, ret;
+    unsigned int i;
+
+    memset(raw, 0, sizeof(*raw));
+    raw->frame_count = frame_count ? (frame_count + 1) & ~1U :
+        EC_RAW_FRAME_COUNT;
+    raw->frame_size = EC_RAW_FRAME_SIZE;
+
+    raw->fd = socket(AF_PACKET, SOCK_RAW, htons(EC_RAW_ETHERTYPE));
+    if (raw->fd < 0) {
+        ret = -errno;
+        fprintf(stderr, "Failed to create packet socket: %s\n",
+                strerror(errno));
+        return ret;
+    }
+
+    memset(&ifr, 0, sizeof(ifr));
+    snprintf(ifr.ifr_name, IFNAMSIZ, "%s", ifname);
+    if (ioctl(raw->fd, SIOCGIFINDEX, &ifr) < 0) {
+        ret = -errno;
+        fprintf(stderr, "Unknown interface %s: %s\n", ifname,
+                strerror(errno));
+        goto out_close;
+    }
+    raw->ifindex = ifr.ifr_ifindex;
+
+    if (ioctl(raw->fd, SIOCGIFHWADDR, &ifr) < 0) {
+        ret = -errno;
+        fprintf(stderr, "Failed to get MAC address of %s: %s\n", ifname,
+                strerror(errno));
+        goto out_close;
+    }
+    memcpy(raw->mac, ifr.ifr_hwaddr.sa_data, ETH_ALEN);
+
+    if (setsockopt(raw->fd, SOL_PACKET, PACKET_VERSION,
+                &version, sizeof(version)) < 0) {
+        ret = -errno;
+        fprintf(stderr, "Failed to select TPACKET_V2: %s\n",
+                strerror(errno));
+        goto out_close;
+    }
+
+#ifdef PACKET_QDISC_BYPASS
+    // hand the frames to the driver directly
+    setsockopt(raw->fd, SOL_PACKET, PACKET_QDISC_BYPASS, &one, sizeof(one));
+#endif
+#ifdef PACKET_IGNORE_OUTGOING
+    setsockopt(raw->fd, SOL_PACKET, PACKET_IGNORE_OUTGOING,
+            &one, sizeof(one));
+#endif
+    (void) one;
+
+    memset(&req, 0, sizeof(req));
+    req.tp_block_size = EC_RAW_BLOCK_SIZE;
+    req.tp_block_nr = raw->frame_count / 2;
+    req.tp_frame_size = raw->frame_size;
+    req.tp_frame_nr = raw->frame_count;
+
+    if (setsockopt(raw->fd, SOL_PACKET, PACKET_RX_RING,
+                &req, sizeof(req)) < 0
+            || setsockopt(raw->fd, SOL_PACKET, PACKET_TX_RING,
+                &req, sizeof(req)) < 0) {
+        ret = -errno;
+        fprintf(stderr, "Failed to set up the packet rings: %s\n",
+                strerror(errno));
+        goto out_close;
+    }
+
+    raw->map_size = 2 * (size_t) req.tp_block_size * req.tp_block_nr;
+    raw->map = mmap(NULL, raw->map_size, PROT_READ | PROT_WRITE,
+            MAP_SHARED | MAP_LOCKED, raw->fd, 0);
+    if (raw->map == MAP_FAILED) {
+        // locking may exceed RLIMIT_MEMLOCK
+        raw->map = mmap(NULL, raw->map_size, PROT_READ | PROT_WRITE,
+                MAP_SHARED, raw->fd, 0);
+    }
+    if (raw->map == MAP_FAILED) {
+        ret = -errno;
+        raw->map = NULL;
+        fprintf(stderr, "Failed to map the packet rings: %s\n",
+                strerror(errno));
+        goto out_close;
+    }
+
+    memset(&addr, 0, sizeof(addr));
+    addr.sll_family = AF_PACKET;
+    addr.sll_protocol = htons(EC_RAW_ETHERTYPE);
+    addr.sll_ifindex = raw->ifindex;
+    if (bind(raw->fd, (struct sockaddr *) &addr, sizeof(addr)) < 0) {
+        ret = -errno;
+        fprintf(stderr, "Failed to bind to %s: %s\n", ifname,
+                strerror(errno));
+        goto out_unmap;
+    }
+
+    // pre-build the Ethernet headers of all TX frames
+    for (i = 0; i < raw->frame_count; i++) {
+        struct ether_header *eth = (struct ether_header *)
+            ((uint8_t *) ec_raw_frame(raw, 1, i) + EC_RAW_TX_OFFSET);
+
+        memset(eth->ether_dhost, 0xff, ETH_ALEN);
+        memcpy(eth->ether_shost, raw->mac, ETH_ALEN);
+        eth->ether_type = htons(EC_RAW_ETHERTYPE);
+    }
+
+    return 0;
+
+out_unmap:
+    munmap(raw->map, raw->map_size);
+    raw->map = NULL;
+out_close:
+    close(raw->fd);
+    raw->fd = -1;
+    return ret;
+}
+
+/****************************************************************************/
+
+/** Closes the transport.
+ */
+void ec_raw_close(
+        ec_raw_t *raw /**< Transport. */
+        )
+{
+    if (raw->map) {
+        munmap(raw->map, raw->map_size);
+        raw->map = NULL;
+    }
+    if (raw->fd >= 0) {
+        close(raw->fd);
+        raw->fd = -1;
+    }
+}
+
+/****************************************************************************/
+
+/** Returns the EtherCAT payload of the next free TX frame.
+ *
+ * The kernel hands a frame back, as soon as it was transmitted, so a frame
+ * is never overwritten while it is still in use.
+ *
+ * \return Pointer behind the Ethernet header, or NULL if the ring is full.
+ */
+uint8_t *ec_raw_tx_data(
+        ec_raw_t *raw /**< Transport. */
+        )
+{
+    struct tpacket2_hdr *hdr = ec_raw_frame(raw, 1, raw->tx_index);
+
+    __sync_synchronize();
+    if (hdr->tp_status == TP_STATUS_WRONG_FORMAT) {
+        hdr->tp_status = TP_STATUS_AVAILABLE;
+    }
+    if (hdr->tp_status != TP_STATUS_AVAILABLE) {
+        raw->tx_busy++;
+        return NULL;
+    }
+
+    return (uint8_t *) hdr + EC_RAW_TX_OFFSET + ETH_HLEN;
+}
+
+/****************************************************************************/
+
+/** Queues the TX frame returned by ec_raw_tx_data().
+ *
+ * If \a more is zero, the transmission of all queued frames is started
+ * with a single system call.
+ *
+ * \retval  0 Success.
+ * \retval <0 Error code.
+ */
+int ec_raw_send(
+        ec_raw_t *raw, /**< Transport. */
+        size_t size, /**< EtherCAT payload size. */
+        int more /**< More frames follow. */
+        )
+{
+    struct tpacket2_hdr *hdr = ec_raw_frame(raw, 1, raw->tx_index);
+
+    if (size < ETH_ZLEN - ETH_HLEN) {
+        memset((uint8_t *) hdr + EC_RAW_TX_OFFSET + ETH_HLEN + size, 0,
+                ETH_ZLEN - ETH_HLEN - size);
+        size = ETH_ZLEN - ETH_HLEN;
+    }
+
+    hdr->tp_len = ETH_HLEN + size;
+    __sync_synchronize();
+    hdr->tp_status = TP_STATUS_SEND_REQUEST;
+    raw->tx_index = (raw->tx_index + 1) % raw->frame_count;
+    raw->tx_count++;
+
+    return more ? 0 : ec_raw_flush(raw);
+}
+
+/****************************************************************************/
+
+/** Starts the transmission of all queued TX frames.
+ *
+ * \retval  0 Success.
+ * \retval <0 Error code.
+ */
+int ec_raw_flush(
+        ec_raw_t *raw /**< Transport. */
+        )
+{
+    if (sendto(raw->fd, NULL, 0, MSG_DONTWAIT, NULL, 0) < 0
+            && errno != EAGAIN) {
+        return -errno;
+    }
+
+    return 0;
+}
+
+/****************************************************************************/
+
+/** Returns the EtherCAT payload of the next received frame.
+ *
+ * No system call is made. The frame has to be released with
+ * ec_raw_release() before the next call.
+ *
+ * \return Pointer behind the Ethernet header, or NULL if no frame was
+ * received.
+ */
+const uint8_t *ec_raw_receive(
+        ec_raw_t *raw, /**< Transport. */
+        size_t *size /**< Size of the EtherCAT payload. */
+        )
+{
+    struct tpacket2_hdr *hdr;
+    const struct sockaddr_ll *sll;
+
+    while (1) {
+        hdr = ec_raw_frame(raw, 0, raw->rx_index);
+
+        __sync_synchronize();
+        if (!(hdr->tp_status & TP_STATUS_USER)) {
+            return NULL;
+        }
+
+        sll = (const struct sockaddr_ll *)
+            ((uint8_t *) hdr + TPACKET_ALIGN(sizeof(*hdr)));
+        if (sll->sll_pkttype != PACKET_OUTGOING
+                && hdr->tp_snaplen > ETH_HLEN) {
+            break;
+        }
+
+        // own frame, if PACKET_IGNORE_OUTGOING is not supported
+        ec_raw_release(raw);
+    }
+
+    raw->rx_count++;
+    *size = hdr->tp_snaplen - ETH_HLEN;
+    return (const uint8_t *) hdr + hdr->tp_mac + ETH_HLEN;
+}
+
+/****************************************************************************/
+
+/** Hands the frame returned by ec_raw_receive() back to the kernel.
+ */
+void ec_raw_release(
+        ec_raw_t *raw /**< Transport. */
+        )
+{
+    struct tpacket2_hdr *hdr = ec_raw_frame(raw, 0, raw->rx_index);
+
+    __sync_synchronize();
+    hdr->tp_status = TP_STATUS_KERNEL;
+    raw->rx_index = (raw->rx_index + 1) % raw->frame_count;
+}
+
+/****************************************************************************/
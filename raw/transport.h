@@ -0,0 +1,83 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+/** \file
+ * Userspace EtherCAT frame transport.
+ *
+ * Sends and receives EtherCAT frames via memory-mapped packet socket rings
+ * (PACKET_MMAP). Received frames are read from the RX ring and transmitted
+ * frames are written to the TX ring without a system call. Only the last
+ * frame of a cycle needs a system call to start the transmission.
+ */
+
+/****************************************************************************/
+
+#ifndef __EC_RAW_TRANSPORT_H__
+#define __EC_RAW_TRANSPORT_H__
+
+#include <stddef.h>
+#include <stdint.h>
+#include <net/ethernet.h>
+
+/****************************************************************************/
+
+/** EtherType of EtherCAT frames.
+ */
+#define EC_RAW_ETHERTYPE 0x88A4
+
+/** Default number of frames per ring.
+ */
+#define EC_RAW_FRAME_COUNT 64
+
+/****************************************************************************/
+
+/** Packet socket transport.
+ */
+typedef struct {
+    int fd; /**< Packet socket. */
+    int ifindex; /**< Interface index. */
+    uint8_t mac[ETH_ALEN]; /**< MAC address of the interface. */
+    uint8_t *map; /**< Mapped RX and TX rings. */
+    size_t map_size; /**< Size of the mapping. */
+    unsigned int frame_count; /**< Number of frames per ring. */
+    unsigned int frame_size; /**< Size of a ring frame. */
+    unsigned int rx_index; /**< Next frame to read from the RX ring. */
+    unsigned int tx_index; /**< Next frame to write to the TX ring. */
+    uint64_t tx_count; /**< Sent frames. */
+    uint64_t rx_count; /**< Received frames. */
+    uint64_t tx_busy; /**< Frames not sent because of a full TX ring. */
+} ec_raw_t;
+
+/****************************************************************************/
+
+int ec_raw_open(ec_raw_t *, const char *, unsigned int);
+void ec_raw_close(ec_raw_t *);
+
+uint8_t *ec_raw_tx_data(ec_raw_t *);
+int ec_raw_send(ec_raw_t *, size_t, int);
+int ec_raw_flush(ec_raw_t *);
+
+const uint8_t *ec_raw_receive(ec_raw_t *, size_t *);
+void ec_raw_release(ec_raw_t *);
+
+/****************************************************************************/
+
+#endif
@@ -283,6 +283,17 @@ void Command::throwCommandException(const stringstream &s) const
 
 /****************************************************************************/
 
+/** Checks, if a slave selection was given via --alias or --position.
+ *
+ * \return True, if not all slaves are selected implicitly.
+ */
+bool Command::slavesSelected() const
+{
+    return aliases != "-" || positions != "-";
+}
+
+/****************************************************************************/
+
 void Command::throwSingleSlaveRequired(unsigned int size) const
 {
     stringstream err;
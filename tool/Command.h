@@ -136,6 +136,7 @@ class Command
         typedef list<ec_ioctl_domain_t> DomainList;
         DomainList selectedDomains(MasterDevice &, const ec_ioctl_master_t &);
         int emergencySlave() const;
+        bool slavesSelected() const;
 
         static string alStateString(uint8_t);
 
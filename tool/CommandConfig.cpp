@@ -190,6 +190,20 @@ void CommandConfig::showDetailedConfigs(
         } else {
             cout << "(Default)";
         }
+        cout << endl << indent
+            << "Mailbox sizes: ";
+        for (j = 0; j < 2; j++) {
+            uint16_t size = j ? configIter->mbox_tx_size
+                : configIter->mbox_rx_size;
+            cout << (j ? ", TX " : "RX ");
+            if (!size) {
+                cout << "(Default)";
+            } else if (size == EC_MAILBOX_SIZE_MAX) {
+                cout << "(Maximum)";
+            } else {
+                cout << dec << size;
+            }
+        }
         cout << endl;
 
         for (j = 0; j < EC_MAX_SYNC_MANAGERS; j++) {
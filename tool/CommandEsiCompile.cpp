@@ -0,0 +1,490 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <cstdlib>
+using namespace std;
+
+#include "CommandEsiCompile.h"
+#include "XmlElement.h"
+#include "esi_db.h"
+
+/****************************************************************************/
+
+static void appendU8(string &s, uint8_t value)
+{
+    s += (char) value;
+}
+
+static void appendU16(string &s, uint16_t value)
+{
+    s += (char) (value & 0xff);
+    s += (char) (value >> 8);
+}
+
+static void appendU32(string &s, uint32_t value)
+{
+    appendU16(s, value & 0xffff);
+    appendU16(s, value >> 16);
+}
+
+static string trim(const string &s)
+{
+    size_t start = s.find_first_not_of(" \t\r\n");
+    size_t end = s.find_last_not_of(" \t\r\n");
+
+    return start == string::npos ? "" : s.substr(start, end - start + 1);
+}
+
+/****************************************************************************/
+
+CommandEsiCompile::CommandEsiCompile():
+    Command("esi_compile", "Compile ESI files into a device database.")
+{
+}
+
+/****************************************************************************/
+
+string CommandEsiCompile::helpString(const string &binaryBaseName) const
+{
+    stringstream str;
+
+    str << binaryBaseName << " " << getName()
+        << " [OPTIONS] <FILENAME> [<FILENAME> ...]" << endl
+        << endl
+        << getBriefDescription() << endl
+        << endl
+        << "EtherCAT Slave Information (ESI) files are parsed and the" << endl
+        << "device descriptions relevant for the master are written to" << endl
+        << "a compact binary image: Default PDO assignment and mapping," << endl
+        << "mailbox sizes, DC operation modes and CoE init commands." << endl
+        << endl
+        << "The image can be loaded into the master with the 'esi_load'" << endl
+        << "command. During the bus scan, the master then takes the PDO" << endl
+        << "configuration of known CoE devices from the database instead" << endl
+        << "of uploading it via CoE. The SDO dictionary of devices," << endl
+        << "whose ESI contains it, is not uploaded either." << endl
+        << endl
+        << "Devices are identified by vendor ID, product code and" << endl
+        << "revision number. If a device is described multiple times," << endl
+        << "the first description is used." << endl
+        << endl
+        << "Arguments:" << endl
+        << "  FILENAME is the path to an ESI file." << endl
+        << endl
+        << "Command-specific options:" << endl
+        << "  --output-file -o <file>  Write the image to the given file"
+        << endl
+        << "                           instead of stdout." << endl
+        << "  --verbose     -v         List the compiled devices on" << endl
+        << "                           stderr." << endl
+        << endl;
+
+    return str.str();
+}
+
+/****************************************************************************/
+
+void CommandEsiCompile::execute(const StringVector &args)
+{
+    stringstream err;
+    StringVector::const_iterator arg;
+    vector<string> records;
+    vector<string>::const_iterator rec;
+    KeySet keys;
+    string image;
+
+    if (args.empty()) {
+        err << "'" << getName() << "' needs at least one argument!";
+        throwInvalidUsageException(err);
+    }
+
+    for (arg = args.begin(); arg != args.end(); arg++) {
+        compileFile(*arg, records, keys);
+    }
+
+    if (records.size() > 0xffff) {
+        err << "Too many devices (" << records.size() << ")!";
+        throwCommandException(err);
+    }
+
+    appendU32(image, EC_ESI_DB_MAGIC);
+    appendU16(image, EC_ESI_DB_VERSION);
+    appendU16(image, records.size());
+    for (rec = records.begin(); rec != records.end(); rec++) {
+        image += *rec;
+    }
+
+    if (image.size() > EC_ESI_DB_MAX_SIZE) {
+        err << "Database image too large (" << image.size() << " bytes)!";
+        throwCommandException(err);
+    }
+
+    if (getOutputFile().empty()) {
+        cout.write(image.data(), image.size());
+    } else {
+        ofstream file(getOutputFile().c_str(),
+                ofstream::out | ofstream::binary);
+        if (file.fail()) {
+            err << "Failed to open '" << getOutputFile() << "'!";
+            throwCommandException(err);
+        }
+        file.write(image.data(), image.size());
+        file.close();
+        if (file.fail()) {
+            err << "Failed to write '" << getOutputFile() << "'!";
+            throwCommandException(err);
+        }
+    }
+
+    if (getVerbosity() == Verbose) {
+        cerr << records.size() << " devices, " << image.size()
+            << " bytes." << endl;
+    }
+}
+
+/****************************************************************************/
+
+void CommandEsiCompile::compileFile(
+        const string &path,
+        vector<string> &records,
+        KeySet &keys
+        )
+{
+    stringstream err;
+    ifstream file(path.c_str(), ifstream::in | ifstream::binary);
+    ostringstream contents;
+    XmlElement root;
+    const XmlElement *vendor, *descriptions, *devices;
+    XmlElement::ElementList deviceList;
+    XmlElement::ElementList::const_iterator dev;
+    uint32_t vendorId;
+
+    if (file.fail()) {
+        err << "Failed to open '" << path << "'!";
+        throwCommandException(err);
+    }
+    contents << file.rdbuf();
+
+    try {
+        XmlElement::parse(root, contents.str());
+    } catch (XmlException &e) {
+        err << path << ": " << e.what();
+        throwCommandException(err);
+    }
+
+    if (root.getName() != "EtherCATInfo") {
+        err << path << ": Not an ESI file!";
+        throwCommandException(err);
+    }
+
+    vendor = root.findChild("Vendor");
+    descriptions = root.findChild("Descriptions");
+    devices = descriptions ? descriptions->findChild("Devices") : NULL;
+    if (!vendor || !devices) {
+        err << path << ": Vendor or device descriptions missing!";
+        throwCommandException(err);
+    }
+
+    vendorId = parseNumber(vendor->findChild("Id"), "Vendor Id");
+
+    deviceList = devices->findChildren("Device");
+    for (dev = deviceList.begin(); dev != deviceList.end(); dev++) {
+        string record = compileDevice(**dev, vendorId);
+        string key = record.substr(4, 12);
+
+        if (keys.find(key) != keys.end()) {
+            if (getVerbosity() == Verbose) {
+                cerr << path << ": Skipping duplicate device." << endl;
+            }
+            continue;
+        }
+
+        keys.insert(key);
+        records.push_back(record);
+    }
+}
+
+/****************************************************************************/
+
+/** Serializes a single device description.
+ *
+ * \return Record data.
+ */
+string CommandEsiCompile::compileDevice(
+        const XmlElement &device,
+        uint32_t vendorId
+        )
+{
+    stringstream err;
+    const XmlElement *type = device.findChild("Type"),
+          *mailbox = device.findChild("Mailbox"),
+          *dc = device.findChild("Dc"),
+          *profile = device.findChild("Profile"),
+          *coe = NULL;
+    XmlElement::ElementList list, initCmds, opModes;
+    XmlElement::ElementList::const_iterator it;
+    uint32_t productCode, revisionNumber;
+    uint16_t rxMailboxSize = 0, txMailboxSize = 0,
+             rxMailboxMax = 0, txMailboxMax = 0;
+    uint8_t flags = 0;
+    unsigned int pdoCount = 0;
+    string header, body;
+
+    if (!type) {
+        err << "Device without type!";
+        throwCommandException(err);
+    }
+
+    productCode = parseNumber(type->getAttribute("ProductCode"),
+            "ProductCode");
+    revisionNumber = parseNumber(type->getAttribute("RevisionNo", "0"),
+            "RevisionNo");
+
+    // mailbox sizes
+    list = device.findChildren("Sm");
+    for (it = list.begin(); it != list.end(); it++) {
+        string smType = trim((*it)->getText());
+        string maxSize = (*it)->getAttribute("MaxSize", "0");
+        string size = (*it)->getAttribute("DefaultSize", maxSize);
+        if (smType == "MBoxOut") {
+            rxMailboxSize = parseNumber(size, "Sm DefaultSize");
+            rxMailboxMax = parseNumber(maxSize, "Sm MaxSize");
+        } else if (smType == "MBoxIn") {
+            txMailboxSize = parseNumber(size, "Sm DefaultSize");
+            txMailboxMax = parseNumber(maxSize, "Sm MaxSize");
+        }
+    }
+
+    // PDOs
+    list = device.findChildren("RxPdo");
+    XmlElement::ElementList txPdos = device.findChildren("TxPdo");
+    list.insert(list.end(), txPdos.begin(), txPdos.end());
+    for (it = list.begin(); it != list.end(); it++) {
+        compilePdo(**it, body);
+        pdoCount++;
+    }
+
+    // DC operation modes
+    if (dc) {
+        opModes = dc->findChildren("OpMode");
+        for (it = opModes.begin(); it != opModes.end(); it++) {
+            const XmlElement *sync0 = (*it)->findChild("CycleTimeSync0"),
+                  *sync1 = (*it)->findChild("CycleTimeSync1");
+            appendU16(body, parseNumber((*it)->findChild("AssignActivate"),
+                        "AssignActivate"));
+            appendU16(body, sync0 ? parseNumber(
+                        sync0->getAttribute("Factor", "0"), "Factor") : 0);
+            appendU16(body, sync1 ? parseNumber(
+                        sync1->getAttribute("Factor", "0"), "Factor") : 0);
+            appendU16(body, 0);
+        }
+    }
+
+    // CoE init commands
+    if (mailbox) {
+        coe = mailbox->findChild("CoE");
+    }
+    if (coe) {
+        initCmds = coe->findChildren("InitCmd");
+        for (it = initCmds.begin(); it != initCmds.end(); it++) {
+            compileInitCmd(**it, body);
+        }
+
+        // The fixed PDOs of modular devices are not the actual mapping.
+        if (!device.findChild("Slots")) {
+            flags |= EC_ESI_DB_FLAG_PDOS;
+        }
+        if (profile && profile->findChild("Dictionary")) {
+            flags |= EC_ESI_DB_FLAG_NO_DICT;
+        }
+    }
+
+    if (pdoCount > 0xff || opModes.size() > 0xff || initCmds.size() > 0xff) {
+        err << "Device 0x" << hex << setfill('0') << setw(8) << productCode
+            << " has too many PDOs, DC modes or init commands!";
+        throwCommandException(err);
+    }
+
+    appendU32(header, EC_ESI_DB_RECORD_SIZE + body.size());
+    appendU32(header, vendorId);
+    appendU32(header, productCode);
+    appendU32(header, revisionNumber);
+    appendU16(header, rxMailboxSize);
+    appendU16(header, txMailboxSize);
+    appendU8(header, flags);
+    appendU8(header, pdoCount);
+    appendU8(header, opModes.size());
+    appendU8(header, initCmds.size());
+    appendU16(header, rxMailboxMax);
+    appendU16(header, txMailboxMax);
+
+    if (getVerbosity() == Verbose) {
+        cerr << hex << setfill('0')
+            << "0x" << setw(8) << vendorId
+            << " 0x" << setw(8) << productCode
+            << " 0x" << setw(8) << revisionNumber
+            << dec << " " << trim(type->getText())
+            << ": " << pdoCount << " PDOs, "
+            << opModes.size() << " DC modes, "
+            << initCmds.size() << " init commands." << endl;
+    }
+
+    return header + body;
+}
+
+/****************************************************************************/
+
+void CommandEsiCompile::compilePdo(const XmlElement &pdo, string &body)
+{
+    stringstream err;
+    XmlElement::ElementList entries = pdo.findChildren("Entry");
+    XmlElement::ElementList::const_iterator it;
+    uint8_t syncIndex = EC_ESI_DB_NO_SYNC;
+
+    if (entries.size() > 0xff) {
+        err << "PDO with too many entries!";
+        throwCommandException(err);
+    }
+
+    if (pdo.hasAttribute("Sm")) {
+        syncIndex = parseNumber(pdo.getAttribute("Sm"), "Sm");
+    }
+
+    appendU16(body, parseNumber(pdo.findChild("Index"), "PDO Index"));
+    appendU8(body, syncIndex);
+    appendU8(body, entries.size());
+
+    for (it = entries.begin(); it != entries.end(); it++) {
+        const XmlElement *subIndex = (*it)->findChild("SubIndex");
+        appendU16(body, parseNumber((*it)->findChild("Index"),
+                    "Entry Index"));
+        appendU8(body, subIndex ? parseNumber(subIndex, "SubIndex") : 0);
+        appendU8(body, parseNumber((*it)->findChild("BitLen"), "BitLen"));
+    }
+}
+
+/****************************************************************************/
+
+void CommandEsiCompile::compileInitCmd(const XmlElement &cmd, string &body)
+{
+    stringstream err;
+    XmlElement::ElementList transitions = cmd.findChildren("Transition");
+    XmlElement::ElementList::const_iterator it;
+    const XmlElement *subIndex = cmd.findChild("SubIndex"),
+          *dataElement = cmd.findChild("Data");
+    string hexData, data;
+    uint8_t mask = 0;
+
+    for (it = transitions.begin(); it != transitions.end(); it++) {
+        string t = trim((*it)->getText());
+        if (t == "IP") {
+            mask |= EC_ESI_DB_TRANSITION_IP;
+        } else if (t == "PS") {
+            mask |= EC_ESI_DB_TRANSITION_PS;
+        } else if (t == "SO") {
+            mask |= EC_ESI_DB_TRANSITION_SO;
+        } else if (t == "SP") {
+            mask |= EC_ESI_DB_TRANSITION_SP;
+        } else if (t == "OS") {
+            mask |= EC_ESI_DB_TRANSITION_OS;
+        }
+    }
+
+    if (dataElement) {
+        hexData = trim(dataElement->getText());
+    }
+    if (hexData.size() % 2) {
+        err << "Invalid init command data '" << hexData << "'!";
+        throwCommandException(err);
+    }
+    for (size_t i = 0; i < hexData.size(); i += 2) {
+        data += (char) parseNumber("#x" + hexData.substr(i, 2),
+                "init command data");
+    }
+    if (data.size() > 0xffff) {
+        err << "Init command data too large!";
+        throwCommandException(err);
+    }
+
+    appendU16(body, parseNumber(cmd.findChild("Index"), "InitCmd Index"));
+    appendU8(body, subIndex ? parseNumber(subIndex, "SubIndex") : 0);
+    appendU8(body, mask);
+    appendU16(body, data.size());
+    body += data;
+}
+
+/****************************************************************************/
+
+int32_t CommandEsiCompile::parseNumber(
+        const XmlElement *element,
+        const string &what
+        )
+{
+    stringstream err;
+
+    if (!element) {
+        err << what << " missing!";
+        throwCommandException(err);
+    }
+
+    return parseNumber(element->getText(), what);
+}
+
+/****************************************************************************/
+
+/** Parses an ESI number.
+ *
+ * ESI files use the '#x' prefix for hexadecimal numbers.
+ *
+ * \return Parsed value.
+ */
+int32_t CommandEsiCompile::parseNumber(
+        const string &input,
+        const string &what
+        )
+{
+    stringstream err;
+    string str = trim(input);
+    const char *start;
+    char *end;
+    long long value;
+
+    if (str.size() > 2 && (str.compare(0, 2, "#x") == 0
+                || str.compare(0, 2, "0x") == 0)) {
+        start = str.c_str() + 2;
+        value = strtoll(start, &end, 16);
+    } else {
+        start = str.c_str();
+        value = strtoll(start, &end, 10);
+    }
+
+    if (end == start || *end) {
+        err << "Invalid " << what << " '" << input << "'!";
+        throwCommandException(err);
+    }
+
+    return (int32_t) value;
+}
+
+/****************************************************************************/
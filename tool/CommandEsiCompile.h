@@ -0,0 +1,55 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+#ifndef __COMMANDESICOMPILE_H__
+#define __COMMANDESICOMPILE_H__
+
+#include <set>
+
+#include "Command.h"
+
+class XmlElement;
+
+/****************************************************************************/
+
+class CommandEsiCompile:
+    public Command
+{
+    public:
+        CommandEsiCompile();
+
+        string helpString(const string &) const;
+        void execute(const StringVector &);
+
+    protected:
+        typedef set<string> KeySet;
+
+        void compileFile(const string &, vector<string> &, KeySet &);
+        string compileDevice(const XmlElement &, uint32_t);
+        void compilePdo(const XmlElement &, string &);
+        void compileInitCmd(const XmlElement &, string &);
+        int32_t parseNumber(const XmlElement *, const string &);
+        int32_t parseNumber(const string &, const string &);
+};
+
+/****************************************************************************/
+
+#endif
@@ -0,0 +1,114 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+#include <iostream>
+#include <fstream>
+using namespace std;
+
+#include "CommandEsiLoad.h"
+#include "MasterDevice.h"
+#include "esi_db.h"
+
+/****************************************************************************/
+
+CommandEsiLoad::CommandEsiLoad():
+    Command("esi_load", "Load a device database into the master.")
+{
+}
+
+/****************************************************************************/
+
+string CommandEsiLoad::helpString(const string &binaryBaseName) const
+{
+    stringstream str;
+
+    str << binaryBaseName << " " << getName()
+        << " [OPTIONS] <FILENAME>" << endl
+        << endl
+        << getBriefDescription() << endl
+        << endl
+        << "The database image has to be created with the 'esi_compile'"
+        << endl
+        << "command. It replaces any previously loaded database and is" << endl
+        << "consulted on the next bus scan. Use the 'rescan' command to" << endl
+        << "apply it to the slaves already present." << endl
+        << endl
+        << "Arguments:" << endl
+        << "  FILENAME is the path to a database image. If it is '-'," << endl
+        << "           data are read from stdin. An empty image clears" << endl
+        << "           the database." << endl
+        << endl;
+
+    return str.str();
+}
+
+/****************************************************************************/
+
+void CommandEsiLoad::execute(const StringVector &args)
+{
+    stringstream err;
+    ostringstream tmp;
+    ifstream file;
+    ec_ioctl_esi_db_t data;
+    MasterIndexList masterIndices;
+    MasterIndexList::const_iterator mi;
+
+    if (args.size() != 1) {
+        err << "'" << getName() << "' takes exactly one argument!";
+        throwInvalidUsageException(err);
+    }
+
+    if (args[0] == "-") {
+        tmp << cin.rdbuf();
+    } else {
+        file.open(args[0].c_str(), ifstream::in | ifstream::binary);
+        if (file.fail()) {
+            err << "Failed to open '" << args[0] << "'!";
+            throwCommandException(err);
+        }
+        tmp << file.rdbuf();
+        file.close();
+    }
+
+    string const &contents = tmp.str();
+
+    if (contents.size() && (contents.size() < EC_ESI_DB_HEADER_SIZE
+                || le32_to_cpup(contents.data()) != EC_ESI_DB_MAGIC)) {
+        err << "'" << args[0] << "' is not a device database image!";
+        throwCommandException(err);
+    }
+
+    data.size = contents.size();
+    data.data = (const uint8_t *) contents.data();
+
+    masterIndices = getMasterIndices();
+    for (mi = masterIndices.begin(); mi != masterIndices.end(); mi++) {
+        MasterDevice m(*mi);
+        m.open(MasterDevice::ReadWrite);
+        m.loadEsiDb(&data);
+    }
+
+    if (getVerbosity() == Verbose) {
+        cerr << "Loaded " << contents.size() << " bytes." << endl;
+    }
+}
+
+/****************************************************************************/
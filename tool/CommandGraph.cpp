@@ -20,6 +20,7 @@
  ****************************************************************************/
 
 #include <iostream>
+#include <iomanip>
 #include <map>
 #include <algorithm>
 using namespace std;
@@ -29,6 +30,17 @@ using namespace std;
 
 /****************************************************************************/
 
+/** Horizontal distance between slaves in points for precomputed layouts. */
+#define LAYOUT_DX 150
+
+/** Vertical distance between branch lanes in points. */
+#define LAYOUT_DY 80
+
+/** Port processing order. The ring positions of the slaves follow it. */
+static const unsigned int portOrder[] = {3, 1, 2};
+
+/****************************************************************************/
+
 CommandGraph::CommandGraph():
     Command("graph", "Output the bus topology as a graph.")
 {
@@ -42,7 +54,8 @@ string CommandGraph::helpString(const string &binaryBaseName) const
 
     str
         << binaryBaseName << " " << getName() << " [OPTIONS]" << endl
-        << binaryBaseName << " " << getName() << " [OPTIONS] <INFO>" << endl
+        << binaryBaseName << " " << getName()
+        << " [OPTIONS] <KEYWORD> [<KEYWORD> ...]" << endl
         << endl
         << getBriefDescription() << endl
         << endl
@@ -55,10 +68,34 @@ string CommandGraph::helpString(const string &binaryBaseName) const
         << endl
         << "See 'man dot' for more information." << endl
         << endl
-        << "Additional information at edges and nodes is selected via" << endl
-        << "the first argument:" << endl
-        << "  DC  - DC timing" << endl
-        << "  CRC - CRC error register information" << endl
+        << "The topology of all slaves is read from the master in a" << endl
+        << "single, consistent snapshot. The following keywords can be"
+        << endl
+        << "combined:" << endl
+        << "  DC       - Show DC timing at edges and nodes." << endl
+        << "  CRC      - Show CRC error register information at edges."
+        << endl
+        << "  SEGMENTS - Group slaves by segment. A segment is a line" << endl
+        << "             of slaves between two junctions." << endl
+        << "  LAYOUT   - Add precomputed node positions. Large lines" << endl
+        << "             can then be rendered quickly with" << endl
+        << "             'neato -n -Tsvg'." << endl
+        << "  JSON     - Output nodes with precomputed coordinates," << endl
+        << "             parent links and segments in JSON format" << endl
+        << "             instead of DOT, e. g. for web frontends." << endl
+        << endl
+        << "Coordinates are derived from the topology only, so they stay"
+        << endl
+        << "the same as long as the bus does not change. Column x is the"
+        << endl
+        << "number of hops from the master, row y is the branch lane." << endl
+        << endl
+        << "Command-specific options:" << endl
+        << "  --alias    -a <alias>" << endl
+        << "  --position -p <pos>    Output only the subtrees" << endl
+        << "                         starting at the selected slaves." << endl
+        << "                         See the help of the 'slaves'" << endl
+        << "                         command." << endl
         << endl;
 
     return str.str();
@@ -66,73 +103,54 @@ string CommandGraph::helpString(const string &binaryBaseName) const
 
 /****************************************************************************/
 
-enum Info {
-    None,
-    DC,
-    CRC
-};
-
 #define REG_SIZE (20)
 
-struct CrcInfo {
-    unsigned int crc[EC_MAX_PORTS];
-    unsigned int phy[EC_MAX_PORTS];
-    unsigned int fwd[EC_MAX_PORTS];
-    unsigned int lnk[EC_MAX_PORTS];
-};
-
 void CommandGraph::execute(const StringVector &args)
 {
     Info info = None;
-    ec_ioctl_master_t master;
-    typedef vector<ec_ioctl_slave_t> SlaveVector;
+    bool segments = false, positions = false, json = false;
     SlaveVector slaves;
-    typedef vector<CrcInfo> CrcInfoVector;
-    CrcInfoVector crcInfos;
-    ec_ioctl_slave_t slave;
-    SlaveVector::const_iterator si;
-    map<int, string> portMedia;
-    map<int, string>::const_iterator mi;
-    map<int, int> mediaWeights;
-    map<int, int>::const_iterator wi;
-
-    portMedia[EC_PORT_MII] = "MII";
-    mediaWeights[EC_PORT_MII] = 1;
-
-    portMedia[EC_PORT_EBUS] = "EBUS";
-    mediaWeights[EC_PORT_EBUS] = 5;
-
-    if (args.size() > 1) {
-        stringstream err;
-        err << "'" << getName() << "' takes either one or no arguments!";
-        throwInvalidUsageException(err);
-    }
-
-    if (args.size() == 1) {
-        string arg = args[0];
+    NodeVector nodes;
+    vector<CrcInfo> crcInfos;
+    StringVector::const_iterator ai;
+    unsigned int segmentCount;
+    uint32_t scanIndex;
+    stringstream out;
+
+    for (ai = args.begin(); ai != args.end(); ai++) {
+        string arg = *ai;
         transform(arg.begin(), arg.end(),
                 arg.begin(), (int (*) (int)) std::toupper);
-        if (arg == "DC") {
+        if (arg == "DC" && info == None) {
             info = DC;
         }
-        else if (arg == "CRC") {
+        else if (arg == "CRC" && info == None) {
             info = CRC;
         }
+        else if (arg == "SEGMENTS") {
+            segments = true;
+        }
+        else if (arg == "LAYOUT") {
+            positions = true;
+        }
+        else if (arg == "JSON") {
+            json = true;
+        }
         else {
             stringstream err;
-            err << "Unknown argument \"" << args[0] << "\"!";
+            err << "Invalid argument \"" << *ai << "\"!";
             throwInvalidUsageException(err);
         }
     }
 
     MasterDevice m(getSingleMasterIndex());
-    m.open(MasterDevice::ReadWrite);
-    m.getMaster(&master);
+    m.open(info == CRC ? MasterDevice::ReadWrite : MasterDevice::Read);
+    m.getTopology(slaves, &scanIndex);
 
-    for (unsigned int i = 0; i < master.slave_count; i++) {
-        m.getSlave(&slave, i);
-        slaves.push_back(slave);
+    layout(slaves, nodes, &segmentCount);
 
+    if (slavesSelected()) {
+        filter(m, slaves, nodes);
     }
 
     if (info == CRC) {
@@ -143,26 +161,162 @@ void CommandGraph::execute(const StringVector &args)
         io.size = REG_SIZE;
         io.data = data;
 
-        for (unsigned int i = 0; i < master.slave_count; i++) {
-            io.slave_position = i;
-            try {
-                m.readReg(&io);
-            } catch (MasterDeviceException &e) {
-                throw e;
+        crcInfos.resize(slaves.size());
+        for (unsigned int i = 0; i < slaves.size(); i++) {
+            if (!nodes[i].visible) {
+                continue;
             }
 
-            CrcInfo crcInfo;
+            io.slave_position = i;
+            m.readReg(&io);
+
+            CrcInfo &crcInfo = crcInfos[i];
             for (int port = 0; port < EC_MAX_PORTS; port++) {
                 crcInfo.crc[port] = io.data[ 0 + port * 2];
                 crcInfo.phy[port] = io.data[ 1 + port * 2];
                 crcInfo.fwd[port] = io.data[ 8 + port];
                 crcInfo.lnk[port] = io.data[16 + port];
             }
-            crcInfos.push_back(crcInfo);
         }
     }
 
-    cout << "/* EtherCAT bus graph. Generated by 'ethercat graph'. */" << endl
+    if (json) {
+        outputJson(out, slaves, nodes, segmentCount, scanIndex);
+    } else {
+        outputDot(out, slaves, nodes, crcInfos, info, segments, positions);
+    }
+
+    cout << out.str();
+}
+
+/****************************************************************************/
+
+/** Calculates parents, segments and coordinates of all slaves.
+ *
+ * The ring positions are a depth-first traversal of the bus tree in port
+ * processing order, so a single pass is sufficient. Port 1 continues the
+ * row and segment of a slave, all other ports start a new branch lane.
+ */
+void CommandGraph::layout(
+        const SlaveVector &slaves,
+        NodeVector &nodes,
+        unsigned int *segmentCount
+        )
+{
+    unsigned int i, j, maxRow = 0, segment = 0;
+
+    nodes.resize(slaves.size());
+    for (i = 0; i < nodes.size(); i++) {
+        nodes[i].parent = -1;
+        nodes[i].parentPort = 0;
+        nodes[i].childCount = 0;
+        nodes[i].visible = true;
+    }
+
+    for (i = 0; i < slaves.size(); i++) {
+        for (j = 0; j < sizeof(portOrder) / sizeof(portOrder[0]); j++) {
+            unsigned int port = portOrder[j];
+            uint16_t next = slaves[i].ports[port].next_slave;
+            if (next == 0xffff || next <= i || next >= slaves.size()) {
+                continue;
+            }
+            nodes[next].parent = i;
+            nodes[next].parentPort = port;
+            nodes[i].childCount++;
+        }
+    }
+
+    for (i = 0; i < nodes.size(); i++) {
+        Node &node = nodes[i];
+
+        if (node.parent < 0) {
+            node.x = 1;
+            node.y = i ? ++maxRow : 0;
+            node.segment = i ? ++segment : 0;
+            continue;
+        }
+
+        const Node &parent = nodes[node.parent];
+        node.x = parent.x + 1;
+        if (node.parentPort == 1 || parent.childCount == 1) {
+            node.y = parent.y;
+            node.segment = parent.childCount == 1
+                ? parent.segment : ++segment;
+        } else {
+            node.y = ++maxRow;
+            node.segment = ++segment;
+        }
+    }
+
+    *segmentCount = nodes.size() ? segment + 1 : 0;
+}
+
+/****************************************************************************/
+
+/** Restricts the output to the subtrees of the selected slaves.
+ */
+void CommandGraph::filter(
+        MasterDevice &m,
+        const SlaveVector &slaves,
+        NodeVector &nodes
+        )
+{
+    SlaveList selected = selectedSlaves(m);
+    SlaveList::const_iterator si;
+    vector<bool> root(nodes.size(), false);
+    unsigned int i;
+
+    for (si = selected.begin(); si != selected.end(); si++) {
+        if (si->position < root.size()) {
+            root[si->position] = true;
+        }
+    }
+
+    // parents always have lower positions than their children
+    for (i = 0; i < nodes.size(); i++) {
+        nodes[i].visible = root[i]
+            || (nodes[i].parent >= 0 && nodes[nodes[i].parent].visible);
+    }
+}
+
+/****************************************************************************/
+
+void CommandGraph::outputDot(
+        ostream &out,
+        const SlaveVector &slaves,
+        const NodeVector &nodes,
+        const vector<CrcInfo> &crcInfos,
+        Info info,
+        bool segments,
+        bool positions
+        ) const
+{
+    map<int, string> portMedia;
+    map<int, string>::const_iterator mi;
+    map<int, int> mediaWeights;
+    map<int, int>::const_iterator wi;
+    vector<uint16_t> aliases(slaves.size()), aliasPositions(slaves.size());
+    unsigned int i, segment = (unsigned int) -1;
+
+    portMedia[EC_PORT_MII] = "MII";
+    mediaWeights[EC_PORT_MII] = 1;
+
+    portMedia[EC_PORT_EBUS] = "EBUS";
+    mediaWeights[EC_PORT_EBUS] = 5;
+
+    uint16_t alias = 0x0000;
+    uint16_t pos = 0;
+
+    for (i = 0; i < slaves.size(); i++) {
+        if (slaves[i].alias) {
+            alias = slaves[i].alias;
+            pos = 0;
+        }
+        aliases[i] = alias;
+        aliasPositions[i] = pos++;
+    }
+
+    out << "/* EtherCAT bus graph. Generated by 'ethercat graph'. */" << endl
         << endl
         << "strict graph bus {" << endl
         << "    rankdir=\"LR\"" << endl
@@ -171,52 +325,82 @@ void CommandGraph::execute(const StringVector &args)
         << "    node [fontname=\"Helvetica\"]" << endl
         << "    edge [fontname=\"Helvetica\",fontsize=\"10\"]" << endl
         << endl
-        << "    master [label=\"EtherCAT\\nMaster\"]" << endl;
+        << "    master [label=\"EtherCAT\\nMaster\"";
+    if (positions) {
+        out << ",pos=\"0,0!\"";
+    }
+    out << "]" << endl;
 
-    if (slaves.size()) {
-        cout << "    master -- slave0";
+    if (slaves.size() && nodes.front().visible) {
+        out << "    master -- slave0";
         mi = portMedia.find(slaves.front().ports[0].desc);
         if (mi != portMedia.end())
-            cout << "[label=\"" << mi->second << "\"]";
+            out << "[label=\"" << mi->second << "\"]";
 
-        cout << endl;
+        out << endl;
     }
-    cout << endl;
+    out << endl;
 
-    uint16_t alias = 0x0000;
-    uint16_t pos = 0;
+    for (i = 0; i < slaves.size(); i++) {
+        const ec_ioctl_topology_slave_t *si = &slaves[i];
 
-    for (si = slaves.begin(); si != slaves.end(); si++) {
-        if (si->alias) {
-            alias = si->alias;
-            pos = 0;
+        if (!nodes[i].visible) {
+            continue;
         }
 
-        cout << "    slave" << si->position << " [shape=\"box\""
+        if (segments && nodes[i].segment != segment) {
+            if (segment != (unsigned int) -1) {
+                out << "    }" << endl;
+            }
+            segment = nodes[i].segment;
+            out << "    subgraph cluster_segment" << segment << " {" << endl
+                << "        label=\"Segment " << segment << "\"" << endl
+                << "        style=\"dashed\"" << endl;
+        }
+
+        out << (segments ? "        " : "    ")
+            << "slave" << si->position << " [shape=\"box\""
             << ",label=\"" << si->position
-            << " / " << alias << ":" << pos;
+            << " / " << aliases[i] << ":" << aliasPositions[i];
         if (string(si->order).size())
-            cout << "\\n" << si->order;
+            out << "\\n" << si->order;
         if (info == DC && si->dc_supported) {
-            cout << "\\nDC: ";
+            out << "\\nDC: ";
             if (si->has_dc_system_time) {
                 switch (si->dc_range) {
                     case EC_DC_32:
-                        cout << "32 bit";
+                        out << "32 bit";
                         break;
                     case EC_DC_64:
-                        cout << "64 bit";
+                        out << "64 bit";
                         break;
                     default:
                         break;
                 }
             } else {
-                cout << "Delay meas.";
+                out << "Delay meas.";
             }
-            cout << "\\nDelay: " << si->transmission_delay << " ns";
+            out << "\\nDelay: " << si->transmission_delay << " ns";
+        }
+        out << "\"";
+        if (positions) {
+            out << ",pos=\"" << nodes[i].x * LAYOUT_DX << ","
+                << -(int) (nodes[i].y * LAYOUT_DY) << "!\"";
         }
-        cout << "\"]" << endl;
+        out << "]" << endl;
+    }
+
+    if (segments && segment != (unsigned int) -1) {
+        out << "    }" << endl;
+    }
+    out << endl;
+
+    for (i = 0; i < slaves.size(); i++) {
+        const ec_ioctl_topology_slave_t *si = &slaves[i];
 
+        if (!nodes[i].visible) {
+            continue;
+        }
 
         for (int port = 1; port < EC_MAX_PORTS; port++) {
             uint16_t next_pos = si->ports[port].next_slave;
@@ -230,53 +414,153 @@ void CommandGraph::execute(const StringVector &args)
                 continue;
             }
 
-            ec_ioctl_slave_t *next = &slaves[next_pos];
+            const ec_ioctl_topology_slave_t *next = &slaves[next_pos];
 
-            cout << "    slave" << si->position << " -- "
+            out << "    slave" << si->position << " -- "
                 << "slave" << next_pos << " [taillabel=\"" << port;
 
             if (info == DC && si->dc_supported) {
-                cout << " [" << si->ports[port].delay_to_next_dc << "]";
+                out << " [" << si->ports[port].delay_to_next_dc << "]";
             }
             if (info == CRC) {
-                CrcInfo *crcInfo = &crcInfos[si->position];
-                cout << " [" << crcInfo->crc[port] << "/"
+                const CrcInfo *crcInfo = &crcInfos[si->position];
+                out << " [" << crcInfo->crc[port] << "/"
                     << crcInfo->fwd[port] << "]";
             }
 
-            cout << "\",headlabel=\"0";
+            out << "\",headlabel=\"0";
 
             if (info == DC && next->dc_supported) {
-                cout << " [" << next->ports[0].delay_to_next_dc << "]";
+                out << " [" << next->ports[0].delay_to_next_dc << "]";
             }
             if (info == CRC) {
-                CrcInfo *crcInfo = &crcInfos[next_pos];
-                cout << " [" << crcInfo->crc[0] << "/"
+                const CrcInfo *crcInfo = &crcInfos[next_pos];
+                out << " [" << crcInfo->crc[0] << "/"
                     << crcInfo->fwd[0] << "]";
             }
-            cout << "\"";
+            out << "\"";
 
             mi = portMedia.find(si->ports[port].desc);
-            if (mi == portMedia.end() && next) {
+            if (mi == portMedia.end()) {
                 /* Try medium of next-hop slave. */
                 mi = portMedia.find(next->ports[0].desc);
             }
 
             if (mi != portMedia.end())
-                cout << ",label=\"" << mi->second << "\"";
+                out << ",label=\"" << mi->second << "\"";
 
             wi = mediaWeights.find(si->ports[port].desc);
             if (wi != mediaWeights.end())
-                cout << ",weight=\"" << wi->second << "\"";
+                out << ",weight=\"" << wi->second << "\"";
+
+            out << "]" << endl;
+        }
+    }
+
+    out << "}" << endl;
+}
+
+/****************************************************************************/
+
+/** Writes a string as a JSON string literal.
+ */
+static void outputJsonString(ostream &out, const char *str)
+{
+    out << '"';
+    for (; *str; str++) {
+        unsigned char c = *str;
+        if (c == '"' || c == '\\') {
+            out << '\\' << c;
+        } else if (c < 0x20) {
+            out << "\\u" << hex << setfill('0') << setw(4)
+                << (unsigned int) c << dec;
+        } else {
+            out << c;
+        }
+    }
+    out << '"';
+}
+
+/****************************************************************************/
+
+void CommandGraph::outputJson(
+        ostream &out,
+        const SlaveVector &slaves,
+        const NodeVector &nodes,
+        unsigned int segmentCount,
+        uint32_t scanIndex
+        ) const
+{
+    vector<unsigned int> segmentFirst(segmentCount, 0),
+        segmentSize(segmentCount, 0), segmentRow(segmentCount, 0);
+    unsigned int i;
+    bool first = true;
+
+    out << "{" << endl
+        << "  \"scan_index\": " << scanIndex << "," << endl
+        << "  \"nodes\": [";
+
+    for (i = 0; i < slaves.size(); i++) {
+        const ec_ioctl_topology_slave_t *si = &slaves[i];
+        const Node &node = nodes[i];
+
+        if (!node.visible) {
+            continue;
+        }
+
+        if (!segmentSize[node.segment]++) {
+            segmentFirst[node.segment] = i;
+            segmentRow[node.segment] = node.y;
+        }
+
+        out << (first ? "" : ",") << endl
+            << "    {\"position\": " << si->position
+            << ", \"alias\": " << si->alias
+            << ", \"order\": ";
+        outputJsonString(out, si->order);
+        out << ", \"parent\": " << node.parent
+            << ", \"parent_port\": " << node.parentPort
+            << ", \"medium\": ";
+        switch (si->ports[0].desc) {
+            case EC_PORT_EBUS:
+                out << "\"EBUS\"";
+                break;
+            case EC_PORT_MII:
+                out << "\"MII\"";
+                break;
+            default:
+                out << "null";
+                break;
+        }
+        out << ", \"x\": " << node.x
+            << ", \"y\": " << node.y
+            << ", \"segment\": " << node.segment
+            << ", \"junction\": "
+            << (node.childCount > 1 ? "true" : "false")
+            << ", \"al_state\": " << (unsigned int) si->al_state
+            << "}";
+        first = false;
+    }
+
+    out << endl << "  ]," << endl
+        << "  \"segments\": [";
 
-            cout << "]" << endl;
+    first = true;
+    for (i = 0; i < segmentCount; i++) {
+        if (!segmentSize[i]) {
+            continue;
         }
 
-        cout << endl;
-        pos++;
+        out << (first ? "" : ",") << endl
+            << "    {\"segment\": " << i
+            << ", \"first\": " << segmentFirst[i]
+            << ", \"count\": " << segmentSize[i]
+            << ", \"y\": " << segmentRow[i] << "}";
+        first = false;
     }
 
-    cout << "}" << endl;
+    out << endl << "  ]" << endl
+        << "}" << endl;
 }
 
 /****************************************************************************/
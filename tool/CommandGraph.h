@@ -34,6 +34,41 @@ class CommandGraph:
 
         string helpString(const string &) const;
         void execute(const StringVector &);
+
+    protected:
+        enum Info {
+            None,
+            DC,
+            CRC
+        };
+
+        struct CrcInfo {
+            unsigned int crc[EC_MAX_PORTS];
+            unsigned int phy[EC_MAX_PORTS];
+            unsigned int fwd[EC_MAX_PORTS];
+            unsigned int lnk[EC_MAX_PORTS];
+        };
+
+        /** Layout information of a slave. */
+        struct Node {
+            int parent; /**< Upstream slave, or -1 for the master. */
+            unsigned int parentPort; /**< Port of the upstream slave. */
+            unsigned int childCount; /**< Number of downstream slaves. */
+            unsigned int x; /**< Column (hops from the master). */
+            unsigned int y; /**< Row (branch lane). */
+            unsigned int segment; /**< Segment index. */
+            bool visible; /**< Slave matches the subtree filter. */
+        };
+
+        typedef vector<ec_ioctl_topology_slave_t> SlaveVector;
+        typedef vector<Node> NodeVector;
+
+        void layout(const SlaveVector &, NodeVector &, unsigned int *);
+        void filter(MasterDevice &, const SlaveVector &, NodeVector &);
+        void outputDot(ostream &, const SlaveVector &, const NodeVector &,
+                const vector<CrcInfo> &, Info, bool, bool) const;
+        void outputJson(ostream &, const SlaveVector &, const NodeVector &,
+                unsigned int, uint32_t) const;
 };
 
 /****************************************************************************/
@@ -94,6 +94,14 @@ void CommandMaster::execute(const StringVector &args)
         cout << endl
             << "  Active: " << (data.active ? "yes" : "no") << endl
             << "  Slaves: " << data.slave_count << endl
+            << "  NUMA node: ";
+        if (data.numa_node >= 0) {
+            cout << data.numa_node
+                << (data.numa_node_configured ? "" : " (auto)");
+        } else {
+            cout << "None";
+        }
+        cout << endl
             << "  Ethernet devices:" << endl;
 
         for (dev_idx = EC_DEVICE_MAIN; dev_idx < data.num_devices;
@@ -128,6 +136,10 @@ void CommandMaster::execute(const StringVector &args)
                 << data.devices[dev_idx].rx_bytes << endl
                 << "      Tx errors:   "
                 << data.devices[dev_idx].tx_errors << endl
+                << "      Tx ring:     "
+                << data.devices[dev_idx].tx_ring_size << " buffers, "
+                << data.devices[dev_idx].tx_ring_overruns << " overruns"
+                << endl
                 << "      Tx frame rate [1/s]: "
                 << setfill(' ') << setprecision(0) << fixed;
             for (j = 0; j < EC_RATE_COUNT; j++) {
@@ -248,6 +260,33 @@ void CommandMaster::execute(const StringVector &args)
         }
         cout << setprecision(0) << endl;
 
+        cout << "  Datagram injection:" << endl
+            << "    Send interval:     " << data.send_interval
+            << " us (measured " << data.inject_interval << " us)" << endl
+            << "    Cyclic load:       " << data.inject_cyclic_load
+            << " byte" << endl
+            << "    Budget:            " << data.inject_budget
+            << " byte" << endl
+            << "    Injected:          " << data.injected_master_fsm
+            << " master FSM, " << data.injected_slave_fsm
+            << " slave FSM, " << data.injected_ext << " EoE" << endl
+            << "    Deferred:          " << data.inject_deferred << endl
+            << "    Dropped:           " << data.inject_dropped << endl
+            << "    Max. delay:        " << data.inject_max_delay
+            << " us" << endl;
+
+        cout << "  Retransmission:" << endl
+            << "    Delay / budget:    ";
+        if (data.retransmit_budget) {
+            cout << data.retransmit_delay << " us / "
+                << data.retransmit_budget << " us" << endl;
+        } else {
+            cout << "disabled" << endl;
+        }
+        cout << "    Resent:            " << data.retransmitted << endl
+            << "    Recovered:         " << data.retransmit_recovered << endl
+            << "    Lost:              " << data.retransmit_lost << endl;
+
         cout << "  Distributed clocks:" << endl
             << "    Reference clock:   ";
         if (data.ref_clock != 0xffff) {
@@ -363,8 +363,37 @@ void CommandSlaves::showSlaves(
                 << dec << si->std_rx_mailbox_size
                 << ", TX: 0x"
                 << hex << setw(4) << si->std_tx_mailbox_offset << "/"
-                << dec << si->std_tx_mailbox_size << endl
-                << "  Supported protocols: ";
+                << dec << si->std_tx_mailbox_size << endl;
+
+            if (si->configured_rx_mailbox_size
+                    && si->configured_tx_mailbox_size) {
+                cout << "  Active    RX: 0x"
+                    << hex << setw(4) << si->configured_rx_mailbox_offset
+                    << "/" << dec << si->configured_rx_mailbox_size
+                    << ", TX: 0x"
+                    << hex << setw(4) << si->configured_tx_mailbox_offset
+                    << "/" << dec << si->configured_tx_mailbox_size;
+                if (si->mbox_size_fallback) {
+                    cout << " (resizing refused)";
+                }
+                cout << endl
+                    << "  Payload per exchange (write/read):"
+                    << " SDO segment "
+                    << mailboxPayload(si->configured_rx_mailbox_size, 9)
+                    << "/"
+                    << mailboxPayload(si->configured_tx_mailbox_size, 9)
+                    << ", FoE "
+                    << mailboxPayload(si->configured_rx_mailbox_size, 12)
+                    << "/"
+                    << mailboxPayload(si->configured_tx_mailbox_size, 12)
+                    << ", EoE "
+                    << mailboxPayload(si->configured_rx_mailbox_size, 10)
+                    << "/"
+                    << mailboxPayload(si->configured_tx_mailbox_size, 10)
+                    << " byte" << endl;
+            }
+
+            cout << "  Supported protocols: ";
 
             if (si->mailbox_protocols & EC_MBOX_AOE) {
                 protoList.push_back("AoE");
@@ -391,7 +420,9 @@ void CommandSlaves::showSlaves(
                     cout << ", ";
                 cout << *protoIter;
             }
-            cout << endl;
+            cout << endl
+                << "  Repeated responses: " << dec << si->mbox_repeats
+                << " (" << si->mbox_repeat_failures << " failed)" << endl;
         }
 
         if (si->has_general_category) {
@@ -452,3 +483,17 @@ bool CommandSlaves::slaveInList(
 }
 
 /****************************************************************************/
+
+/** Payload per mailbox exchange.
+ *
+ * \return Mailbox size minus the mailbox and protocol headers.
+ */
+unsigned int CommandSlaves::mailboxPayload(
+        uint16_t size,
+        unsigned int headerSize /**< Mailbox and protocol header size. */
+        )
+{
+    return size > headerSize ? size - headerSize : 0;
+}
+
+/****************************************************************************/
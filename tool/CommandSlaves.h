@@ -50,6 +50,7 @@ class CommandSlaves:
         void showSlaves(MasterDevice &, const SlaveList &);
 
         static bool slaveInList( const ec_ioctl_slave_t &, const SlaveList &);
+        static unsigned int mailboxPayload(uint16_t, unsigned int);
 };
 
 /****************************************************************************/
@@ -284,6 +284,42 @@ void MasterDevice::getSlave(ec_ioctl_slave_t *slave, uint16_t slaveIndex)
 
 /****************************************************************************/
 
+/** Reads the topology of all slaves at once.
+ *
+ * Retries until the buffer fits, in case the bus is rescanned meanwhile.
+ */
+void MasterDevice::getTopology(
+        vector<ec_ioctl_topology_slave_t> &slaves,
+        uint32_t *scanIndex
+        )
+{
+    ec_ioctl_topology_t data;
+
+    data.max_slaves = 0;
+    data.slaves = NULL;
+
+    while (true) {
+        if (ioctl(fd, EC_IOCTL_TOPOLOGY, &data)) {
+            stringstream err;
+            err << "Failed to get topology: " << strerror(errno);
+            throw MasterDeviceException(err);
+        }
+
+        if (data.slave_count <= data.max_slaves) {
+            break;
+        }
+
+        slaves.resize(data.slave_count);
+        data.max_slaves = slaves.size();
+        data.slaves = &slaves.front();
+    }
+
+    slaves.resize(data.slave_count);
+    *scanIndex = data.scan_index;
+}
+
+/****************************************************************************/
+
 void MasterDevice::getFmmu(
         ec_ioctl_domain_fmmu_t *fmmu,
         unsigned int domainIndex,
@@ -500,6 +536,17 @@ void MasterDevice::rescan()
 
 /****************************************************************************/
 
+void MasterDevice::loadEsiDb(const ec_ioctl_esi_db_t *data)
+{
+    if (ioctl(fd, EC_IOCTL_ESI_DB, data) < 0) {
+        stringstream err;
+        err << "Failed to load device database: " << strerror(errno);
+        throw MasterDeviceException(err);
+    }
+}
+
+/****************************************************************************/
+
 void MasterDevice::sdoDownload(ec_ioctl_slave_sdo_download_t *data)
 {
     if (ioctl(fd, EC_IOCTL_SLAVE_SDO_DOWNLOAD, data) < 0) {
@@ -24,6 +24,7 @@
 
 #include <stdexcept>
 #include <sstream>
+#include <vector>
 using namespace std;
 
 #include "ecrt.h"
@@ -135,6 +136,7 @@ class MasterDevice
         void getData(ec_ioctl_domain_data_t *, unsigned int, unsigned int,
                 unsigned char *);
         void getSlave(ec_ioctl_slave_t *, uint16_t);
+        void getTopology(vector<ec_ioctl_topology_slave_t> &, uint32_t *);
         void getSync(ec_ioctl_slave_sync_t *, uint16_t, uint8_t);
         void getPdo(ec_ioctl_slave_sync_pdo_t *, uint16_t, uint8_t, uint8_t);
         void getPdoEntry(ec_ioctl_slave_sync_pdo_entry_t *, uint16_t, uint8_t,
@@ -147,6 +149,7 @@ class MasterDevice
         void writeReg(ec_ioctl_slave_reg_t *);
         void setDebug(unsigned int);
         void rescan();
+        void loadEsiDb(const ec_ioctl_esi_db_t *);
         void sdoDownload(ec_ioctl_slave_sdo_download_t *);
         void sdoUpload(ec_ioctl_slave_sdo_upload_t *);
         void requestState(uint16_t, uint8_t);
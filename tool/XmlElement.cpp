@@ -0,0 +1,367 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+#include <sstream>
+#include <cstdlib>
+#include <cctype>
+using namespace std;
+
+#include "XmlElement.h"
+
+/****************************************************************************/
+
+class XmlElement::Parser
+{
+    public:
+        Parser(const string &d): doc(d), pos(0) {}
+
+        void parseDocument(XmlElement &);
+
+    private:
+        const string &doc;
+        size_t pos;
+
+        void error(const string &) const;
+        bool startsWith(const char *) const;
+        void skipSpace();
+        void skipPast(const char *);
+        void skipMisc();
+        string parseName();
+        string decode(const string &) const;
+        void parseElement(XmlElement &);
+};
+
+/****************************************************************************/
+
+void XmlElement::Parser::error(const string &msg) const
+{
+    stringstream err;
+    unsigned int line = 1;
+
+    for (size_t i = 0; i < pos && i < doc.size(); i++) {
+        if (doc[i] == '\n') {
+            line++;
+        }
+    }
+
+    err << "XML error in line " << line << ": " << msg;
+    throw XmlException(err.str());
+}
+
+/****************************************************************************/
+
+bool XmlElement::Parser::startsWith(const char *s) const
+{
+    return doc.compare(pos, string(s).size(), s) == 0;
+}
+
+/****************************************************************************/
+
+void XmlElement::Parser::skipSpace()
+{
+    while (pos < doc.size() && isspace((unsigned char) doc[pos])) {
+        pos++;
+    }
+}
+
+/****************************************************************************/
+
+void XmlElement::Parser::skipPast(const char *s)
+{
+    size_t end = doc.find(s, pos);
+
+    if (end == string::npos) {
+        stringstream err;
+        err << "Missing '" << s << "'.";
+        error(err.str());
+    }
+
+    pos = end + string(s).size();
+}
+
+/****************************************************************************/
+
+/** Skips comments, processing instructions and declarations.
+ */
+void XmlElement::Parser::skipMisc()
+{
+    while (true) {
+        skipSpace();
+        if (startsWith("<!--")) {
+            skipPast("-->");
+        } else if (startsWith("<?")) {
+            skipPast("?>");
+        } else if (startsWith("<!")) {
+            skipPast(">");
+        } else {
+            return;
+        }
+    }
+}
+
+/****************************************************************************/
+
+string XmlElement::Parser::parseName()
+{
+    size_t start = pos;
+
+    while (pos < doc.size()) {
+        char c = doc[pos];
+        if (isalnum((unsigned char) c) || c == '_' || c == ':' || c == '-'
+                || c == '.' || (unsigned char) c >= 0x80) {
+            pos++;
+        } else {
+            break;
+        }
+    }
+
+    if (pos == start) {
+        error("Name expected.");
+    }
+
+    return doc.substr(start, pos - start);
+}
+
+/****************************************************************************/
+
+/** Replaces entity and character references.
+ */
+string XmlElement::Parser::decode(const string &raw) const
+{
+    string out;
+    size_t i = 0;
+
+    while (i < raw.size()) {
+        if (raw[i] != '&') {
+            out += raw[i++];
+            continue;
+        }
+
+        size_t end = raw.find(';', i);
+        if (end == string::npos) {
+            out += raw[i++];
+            continue;
+        }
+
+        string ref = raw.substr(i + 1, end - i - 1);
+        if (ref == "lt") {
+            out += '<';
+        } else if (ref == "gt") {
+            out += '>';
+        } else if (ref == "amp") {
+            out += '&';
+        } else if (ref == "quot") {
+            out += '"';
+        } else if (ref == "apos") {
+            out += '\'';
+        } else if (ref.size() > 1 && ref[0] == '#') {
+            unsigned long c = ref[1] == 'x'
+                ? strtoul(ref.c_str() + 2, NULL, 16)
+                : strtoul(ref.c_str() + 1, NULL, 10);
+            // encode as UTF-8
+            if (c < 0x80) {
+                out += (char) c;
+            } else if (c < 0x800) {
+                out += (char) (0xc0 | (c >> 6));
+                out += (char) (0x80 | (c & 0x3f));
+            } else {
+                out += (char) (0xe0 | ((c >> 12) & 0x0f));
+                out += (char) (0x80 | ((c >> 6) & 0x3f));
+                out += (char) (0x80 | (c & 0x3f));
+            }
+        } else {
+            out += raw.substr(i, end - i + 1);
+        }
+        i = end + 1;
+    }
+
+    return out;
+}
+
+/****************************************************************************/
+
+void XmlElement::Parser::parseElement(XmlElement &element)
+{
+    if (!startsWith("<")) {
+        error("Element expected.");
+    }
+    pos++;
+    element.name = parseName();
+
+    // attributes
+    while (true) {
+        skipSpace();
+        if (pos >= doc.size()) {
+            error("Unexpected end of document.");
+        }
+        if (startsWith("/>")) {
+            pos += 2;
+            return;
+        }
+        if (doc[pos] == '>') {
+            pos++;
+            break;
+        }
+
+        string attrName = parseName();
+        skipSpace();
+        if (!startsWith("=")) {
+            error("'=' expected after attribute name.");
+        }
+        pos++;
+        skipSpace();
+        if (pos >= doc.size() || (doc[pos] != '"' && doc[pos] != '\'')) {
+            error("Quoted attribute value expected.");
+        }
+        char quote = doc[pos++];
+        size_t end = doc.find(quote, pos);
+        if (end == string::npos) {
+            error("Unterminated attribute value.");
+        }
+        element.attributes[attrName] = decode(doc.substr(pos, end - pos));
+        pos = end + 1;
+    }
+
+    // content
+    while (true) {
+        size_t next = doc.find('<', pos);
+        if (next == string::npos) {
+            error("Unexpected end of document.");
+        }
+        element.text += decode(doc.substr(pos, next - pos));
+        pos = next;
+
+        if (startsWith("</")) {
+            pos += 2;
+            if (parseName() != element.name) {
+                error("Mismatched end tag for <" + element.name + ">.");
+            }
+            skipSpace();
+            if (!startsWith(">")) {
+                error("'>' expected.");
+            }
+            pos++;
+            return;
+        } else if (startsWith("<!--")) {
+            skipPast("-->");
+        } else if (startsWith("<![CDATA[")) {
+            size_t start = pos + 9;
+            skipPast("]]>");
+            element.text += doc.substr(start, pos - 3 - start);
+        } else if (startsWith("<?")) {
+            skipPast("?>");
+        } else {
+            element.children.push_back(XmlElement());
+            parseElement(element.children.back());
+        }
+    }
+}
+
+/****************************************************************************/
+
+void XmlElement::Parser::parseDocument(XmlElement &root)
+{
+    // skip byte order mark
+    if (startsWith("\xef\xbb\xbf")) {
+        pos += 3;
+    }
+
+    skipMisc();
+    parseElement(root);
+    skipMisc();
+
+    if (pos < doc.size()) {
+        error("Trailing content after root element.");
+    }
+}
+
+/*****************************************************************************
+ * XmlElement
+ ****************************************************************************/
+
+XmlElement::XmlElement()
+{
+}
+
+/****************************************************************************/
+
+bool XmlElement::hasAttribute(const string &attrName) const
+{
+    return attributes.find(attrName) != attributes.end();
+}
+
+/****************************************************************************/
+
+string XmlElement::getAttribute(
+        const string &attrName,
+        const string &defaultValue
+        ) const
+{
+    map<string, string>::const_iterator it = attributes.find(attrName);
+    return it == attributes.end() ? defaultValue : it->second;
+}
+
+/****************************************************************************/
+
+const XmlElement *XmlElement::findChild(const string &childName) const
+{
+    vector<XmlElement>::const_iterator it;
+
+    for (it = children.begin(); it != children.end(); it++) {
+        if (it->name == childName) {
+            return &*it;
+        }
+    }
+
+    return NULL;
+}
+
+/****************************************************************************/
+
+XmlElement::ElementList XmlElement::findChildren(
+        const string &childName
+        ) const
+{
+    ElementList list;
+    vector<XmlElement>::const_iterator it;
+
+    for (it = children.begin(); it != children.end(); it++) {
+        if (it->name == childName) {
+            list.push_back(&*it);
+        }
+    }
+
+    return list;
+}
+
+/****************************************************************************/
+
+/** Parses a complete document into \a root.
+ *
+ * Throws an XmlException on syntax errors.
+ */
+void XmlElement::parse(XmlElement &root, const string &doc)
+{
+    Parser parser(doc);
+    parser.parseDocument(root);
+}
+
+/****************************************************************************/
@@ -0,0 +1,80 @@
+/*****************************************************************************
+ *
+ *  Copyright (C) 2024  Florian Pose, Ingenieurgemeinschaft IgH
+ *
+ *  This file is part of the IgH EtherCAT Master.
+ *
+ *  The IgH EtherCAT Master is free software; you can redistribute it and/or
+ *  modify it under the terms of the GNU General Public License version 2, as
+ *  published by the Free Software Foundation.
+ *
+ *  The IgH EtherCAT Master is distributed in the hope that it will be useful,
+ *  but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *  MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU General
+ *  Public License for more details.
+ *
+ *  You should have received a copy of the GNU General Public License along
+ *  with the IgH EtherCAT Master; if not, write to the Free Software
+ *  Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA  02110-1301  USA
+ *
+ ****************************************************************************/
+
+#ifndef __XMLELEMENT_H__
+#define __XMLELEMENT_H__
+
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <map>
+using namespace std;
+
+/****************************************************************************/
+
+class XmlException:
+    public runtime_error
+{
+    public:
+        /** Constructor with string parameter. */
+        XmlException(
+                const string &msg /**< Message. */
+                ): runtime_error(msg) {}
+};
+
+/****************************************************************************/
+
+/** Minimal XML element tree.
+ *
+ * Supports elements, attributes, character data, CDATA sections and the
+ * predefined and numeric entities. Comments, processing instructions and
+ * document type declarations are skipped. This is sufficient for reading
+ * EtherCAT Slave Information (ESI) files without an external library.
+ */
+class XmlElement
+{
+    public:
+        XmlElement();
+
+        typedef vector<const XmlElement *> ElementList;
+
+        const string &getName() const { return name; }
+        const string &getText() const { return text; }
+        bool hasAttribute(const string &) const;
+        string getAttribute(const string &, const string & = "") const;
+
+        const XmlElement *findChild(const string &) const;
+        ElementList findChildren(const string &) const;
+
+        static void parse(XmlElement &, const string &);
+
+    private:
+        string name;
+        string text;
+        map<string, string> attributes;
+        vector<XmlElement> children;
+
+        class Parser;
+};
+
+/****************************************************************************/
+
+#endif
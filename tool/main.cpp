@@ -38,6 +38,8 @@ using namespace std;
 #ifdef EC_EOE
 # include "CommandEoe.h"
 #endif
+#include "CommandEsiCompile.h"
+#include "CommandEsiLoad.h"
 #include "CommandFoeRead.h"
 #include "CommandFoeWrite.h"
 #include "CommandGraph.h"
@@ -282,6 +284,8 @@ int main(int argc, char **argv)
 #ifdef EC_EOE
     commandList.push_back(new CommandEoe());
 #endif
+    commandList.push_back(new CommandEsiCompile());
+    commandList.push_back(new CommandEsiLoad());
     commandList.push_back(new CommandFoeRead());
     commandList.push_back(new CommandFoeWrite());
     commandList.push_back(new CommandGraph());
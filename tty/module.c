@@ -32,6 +32,9 @@
 #include <linux/tty_flip.h>
 #include <linux/termios.h>
 #include <linux/timer.h>
+#include <linux/irq_work.h>
+#include <linux/log2.h>
+#include <linux/seq_file.h>
 #include <linux/version.h>
 #include <linux/serial.h>
 #include <linux/uaccess.h>
@@ -49,8 +52,8 @@
 #define PFX "ec_tty: "
 
 #define EC_TTY_MAX_DEVICES 32
-#define EC_TTY_TX_BUFFER_SIZE 100
-#define EC_TTY_RX_BUFFER_SIZE 100
+#define EC_TTY_MIN_BUFFER_SIZE 64
+#define EC_TTY_MAX_BUFFER_SIZE (1 << 20)
 
 #define EC_TTY_DEBUG 0
 
@@ -58,6 +61,8 @@
 
 char *ec_master_version_str = EC_MASTER_VERSION; /**< Version string. */
 unsigned int debug_level = 0;
+static unsigned int tx_buffer_size = 4096; /**< Default TX ring size. */
+static unsigned int rx_buffer_size = 4096; /**< Default RX ring size. */
 
 static struct tty_driver *tty_driver = NULL;
 ec_tty_t *ttys[EC_TTY_MAX_DEVICES];
@@ -68,6 +73,7 @@ void ec_tty_wakeup(struct timer_list *);
 #else
 void ec_tty_wakeup(unsigned long);
 #endif
+void ec_tty_work(struct irq_work *);
 
 /****************************************************************************/
 
@@ -80,6 +86,10 @@ MODULE_VERSION(EC_MASTER_VERSION);
 
 module_param_named(debug_level, debug_level, uint, S_IRUGO);
 MODULE_PARM_DESC(debug_level, "Debug level");
+module_param_named(tx_buffer_size, tx_buffer_size, uint, S_IRUGO);
+MODULE_PARM_DESC(tx_buffer_size, "Default size of the transmit buffers");
+module_param_named(rx_buffer_size, rx_buffer_size, uint, S_IRUGO);
+MODULE_PARM_DESC(rx_buffer_size, "Default size of the receive buffers");
 
 /** \endcond */
 
@@ -95,20 +105,50 @@ static struct ktermios ec_tty_std_termios = {
     .c_cc = INIT_C_CC,
 };
 
+/** Lock-free ring buffer for one producer and one consumer.
+ *
+ * The size is a power of two. The indices run freely and are masked on
+ * access, so that the whole buffer can be used.
+ */
+typedef struct {
+    uint8_t *data; /**< Buffer memory. */
+    unsigned int mask; /**< Size of the buffer minus one. */
+    unsigned int head; /**< Write index, only changed by the producer. */
+    unsigned int tail; /**< Read index, only changed by the consumer. */
+} ec_tty_ring_t;
+
+/** Counters of a TTY interface.
+ */
+typedef struct {
+    unsigned long tx_bytes; /**< Bytes fetched via ectty_tx_data(). */
+    unsigned long rx_bytes; /**< Bytes pushed via ectty_rx_data(). */
+    unsigned long rx_dropped; /**< Bytes dropped because the receive ring
+                                was full. */
+    unsigned long rx_throttled; /**< Pushes, that were limited by the space
+                                  of the TTY flip buffer. */
+    u64 tx_stamp; /**< Time, when the transmit ring became non-empty. */
+    u64 rx_stamp; /**< Time, when the receive ring became non-empty. */
+    unsigned int tx_latency; /**< Last transmit latency in us. */
+    unsigned int tx_latency_max; /**< Maximum transmit latency in us. */
+    unsigned int rx_latency; /**< Last receive latency in us. */
+    unsigned int rx_latency_max; /**< Maximum receive latency in us. */
+} ec_tty_stats_t;
+
 struct ec_tty {
     int minor;
     struct device *dev;
 
-    uint8_t tx_buffer[EC_TTY_TX_BUFFER_SIZE];
-    unsigned int tx_read_idx;
-    unsigned int tx_write_idx;
+    ec_tty_ring_t tx_ring;
     unsigned int wakeup;
 
-    uint8_t rx_buffer[EC_TTY_RX_BUFFER_SIZE];
-    unsigned int rx_read_idx;
-    unsigned int rx_write_idx;
+    ec_tty_ring_t rx_ring;
+    spinlock_t rx_lock; /**< Serializes the consumers of the RX ring. */
 
-    struct timer_list timer;
+    struct irq_work work; /**< Kicked by ectty_tx_data() and
+                            ectty_rx_data(). */
+    struct timer_list timer; /**< Retries pushing, if the TTY layer was
+                               out of space. */
+    ec_tty_stats_t stats;
     struct tty_struct *tty;
     unsigned int open_count;
     struct semaphore sem;
@@ -209,12 +249,110 @@ void __exit ec_tty_cleanup_module(void)
     printk(KERN_INFO PFX "Module unloading.\n");
 }
 
+/*****************************************************************************
+ * ec_tty_ring_t methods.
+ ****************************************************************************/
+
+/** Allocates the ring memory.
+ *
+ * The size is rounded up to the next power of two.
+ *
+ * \return 0 on success, else < 0
+ */
+static int ec_tty_ring_init(ec_tty_ring_t *r, unsigned int size)
+{
+    size = clamp_t(unsigned int, size,
+            EC_TTY_MIN_BUFFER_SIZE, EC_TTY_MAX_BUFFER_SIZE);
+    size = roundup_pow_of_two(size);
+
+    r->data = kmalloc(size, GFP_KERNEL);
+    if (!r->data) {
+        return -ENOMEM;
+    }
+
+    r->mask = size - 1;
+    r->head = 0;
+    r->tail = 0;
+    return 0;
+}
+
+/****************************************************************************/
+
+static void ec_tty_ring_clear(ec_tty_ring_t *r)
+{
+    kfree(r->data);
+    r->data = NULL;
+}
+
+/****************************************************************************/
+
+/** Number of bytes in the ring.
+ */
+static inline unsigned int ec_tty_ring_size(const ec_tty_ring_t *r)
+{
+    return smp_load_acquire(&r->head) - smp_load_acquire(&r->tail);
+}
+
+/****************************************************************************/
+
+/** Number of bytes, that can still be written.
+ */
+static inline unsigned int ec_tty_ring_space(const ec_tty_ring_t *r)
+{
+    return r->mask + 1 - ec_tty_ring_size(r);
+}
+
+/****************************************************************************/
+
+/** Appends data to the ring (producer side).
+ *
+ * \return Number of bytes written.
+ */
+static unsigned int ec_tty_ring_write(ec_tty_ring_t *r,
+        const uint8_t *buffer, unsigned int count)
+{
+    unsigned int head = r->head, tail = smp_load_acquire(&r->tail);
+    unsigned int offset = head & r->mask, chunk;
+
+    count = min(count, r->mask + 1 - (head - tail));
+    chunk = min(count, r->mask + 1 - offset);
+
+    memcpy(r->data + offset, buffer, chunk);
+    memcpy(r->data, buffer + chunk, count - chunk);
+
+    smp_store_release(&r->head, head + count);
+    return count;
+}
+
+/****************************************************************************/
+
+/** Removes data from the ring (consumer side).
+ *
+ * \return Number of bytes read.
+ */
+static unsigned int ec_tty_ring_read(ec_tty_ring_t *r,
+        uint8_t *buffer, unsigned int count)
+{
+    unsigned int tail = r->tail, head = smp_load_acquire(&r->head);
+    unsigned int offset = tail & r->mask, chunk;
+
+    count = min(count, head - tail);
+    chunk = min(count, r->mask + 1 - offset);
+
+    memcpy(buffer, r->data + offset, chunk);
+    memcpy(buffer + chunk, r->data, count - chunk);
+
+    smp_store_release(&r->tail, tail + count);
+    return count;
+}
+
 /*****************************************************************************
  * ec_tty_t methods.
  ****************************************************************************/
 
 int ec_tty_init(ec_tty_t *t, int minor,
-        const ec_tty_operations_t *ops, void *cb_data)
+        const ec_tty_operations_t *ops, void *cb_data,
+        unsigned int tx_size, unsigned int rx_size)
 {
     int ret;
     tcflag_t cflag;
@@ -222,11 +360,9 @@ int ec_tty_init(ec_tty_t *t, int minor,
     struct ktermios *termios;
 
     t->minor = minor;
-    t->tx_read_idx = 0;
-    t->tx_write_idx = 0;
     t->wakeup = 0;
-    t->rx_read_idx = 0;
-    t->rx_write_idx = 0;
+    spin_lock_init(&t->rx_lock);
+    init_irq_work(&t->work, ec_tty_work);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
     timer_setup(&t->timer, ec_tty_wakeup, 0);
 #else
@@ -234,16 +370,28 @@ int ec_tty_init(ec_tty_t *t, int minor,
     t->timer.function = ec_tty_wakeup;
     t->timer.data = (unsigned long) t;
 #endif
+    memset(&t->stats, 0, sizeof(t->stats));
     t->tty = NULL;
     t->open_count = 0;
     sema_init(&t->sem, 1);
     t->ops = *ops;
     t->cb_data = cb_data;
 
+    ret = ec_tty_ring_init(&t->tx_ring, tx_size ? tx_size : tx_buffer_size);
+    if (ret) {
+        goto out_return;
+    }
+
+    ret = ec_tty_ring_init(&t->rx_ring, rx_size ? rx_size : rx_buffer_size);
+    if (ret) {
+        goto out_tx_ring;
+    }
+
     t->dev = tty_register_device(tty_driver, t->minor, NULL);
     if (IS_ERR(t->dev)) {
         printk(KERN_ERR PFX "Failed to register tty device.\n");
-        return PTR_ERR(t->dev);
+        ret = PTR_ERR(t->dev);
+        goto out_rx_ring;
     }
 
     // Tell the device-specific implementation about the initial cflags
@@ -276,68 +424,47 @@ int ec_tty_init(ec_tty_t *t, int minor,
         printk(KERN_ERR PFX "ERROR: Initial cflag 0x%x not accepted.\n",
                 cflag);
         tty_unregister_device(tty_driver, t->minor);
-        return ret;
+        goto out_rx_ring;
     }
 
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 7, 0)
     tty_port_init(tty_driver->ports[minor]);
 #endif
 
-    t->timer.expires = jiffies + 10;
-    add_timer(&t->timer);
     return 0;
+
+out_rx_ring:
+    ec_tty_ring_clear(&t->rx_ring);
+out_tx_ring:
+    ec_tty_ring_clear(&t->tx_ring);
+out_return:
+    return ret;
 }
 
 /****************************************************************************/
 
 void ec_tty_clear(ec_tty_t *tty)
 {
+    irq_work_sync(&tty->work);
     del_timer_sync(&tty->timer);
     tty_unregister_device(tty_driver, tty->minor);
+    ec_tty_ring_clear(&tty->rx_ring);
+    ec_tty_ring_clear(&tty->tx_ring);
 }
 
 /****************************************************************************/
 
-unsigned int ec_tty_tx_size(ec_tty_t *tty)
-{
-    unsigned int ret;
-
-    if (tty->tx_write_idx >= tty->tx_read_idx) {
-        ret = tty->tx_write_idx - tty->tx_read_idx;
-    } else {
-        ret = EC_TTY_TX_BUFFER_SIZE + tty->tx_write_idx - tty->tx_read_idx;
-    }
-
-    return ret;
-}
-
-/****************************************************************************/
-
-unsigned int ec_tty_tx_space(ec_tty_t *tty)
-{
-    return EC_TTY_TX_BUFFER_SIZE - 1 - ec_tty_tx_size(tty);
-}
-
-/****************************************************************************/
-
-unsigned int ec_tty_rx_size(ec_tty_t *tty)
+/** Updates a latency counter pair.
+ */
+static void ec_tty_latency(u64 stamp, unsigned int *last, unsigned int *max)
 {
-    unsigned int ret;
+    u64 diff = ktime_to_ns(ktime_get()) - stamp;
 
-    if (tty->rx_write_idx >= tty->rx_read_idx) {
-        ret = tty->rx_write_idx - tty->rx_read_idx;
-    } else {
-        ret = EC_TTY_RX_BUFFER_SIZE + tty->rx_write_idx - tty->rx_read_idx;
+    do_div(diff, 1000);
+    *last = (unsigned int) diff;
+    if (*last > *max) {
+        *max = *last;
     }
-
-    return ret;
-}
-
-/****************************************************************************/
-
-unsigned int ec_tty_rx_space(ec_tty_t *tty)
-{
-    return EC_TTY_RX_BUFFER_SIZE - 1 - ec_tty_rx_size(tty);
 }
 
 /****************************************************************************/
@@ -359,20 +486,17 @@ int ec_tty_get_serial_info(ec_tty_t *tty, struct serial_struct *data)
 
 /****************************************************************************/
 
-/** Timer function.
+/** Wakes up writers and pushes received data into the TTY core.
+ *
+ * Called from the irq_work kicked by ectty_tx_data() and ectty_rx_data(),
+ * and from the retry timer.
  */
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
-void ec_tty_wakeup(struct timer_list *t)
-#else
-void ec_tty_wakeup(unsigned long data)
-#endif
+static void ec_tty_push(ec_tty_t *tty)
 {
-#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
-    ec_tty_t *tty = from_timer(tty, t, timer);
-#else
-    ec_tty_t *tty = (ec_tty_t *) data;
-#endif
-    size_t to_recv;
+    unsigned long flags;
+    unsigned int to_recv;
+
+    spin_lock_irqsave(&tty->rx_lock, flags);
 
     /* Wake up any process waiting to send data */
     if (tty->wakeup) {
@@ -386,48 +510,66 @@ void ec_tty_wakeup(unsigned long data)
     }
 
     /* Push received data into TTY core. */
-    to_recv = ec_tty_rx_size(tty);
+    to_recv = ec_tty_ring_size(&tty->rx_ring);
     if (to_recv && tty->tty) {
         unsigned char *cbuf;
+        u64 stamp = READ_ONCE(tty->stats.rx_stamp);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 9, 0)
         int space = tty_prepare_flip_string(tty->tty->port, &cbuf, to_recv);
 #else
         int space = tty_prepare_flip_string(tty->tty, &cbuf, to_recv);
 #endif
 
-        if (space < to_recv) {
-            printk(KERN_WARNING PFX "Insufficient space to_recv=%zu"
-                    " space=%d\n", to_recv, space);
-        }
-
-        if (space < 0) {
-            to_recv = 0;
-        } else {
-            to_recv = space;
-        }
-
-        if (to_recv) {
-            unsigned int i;
-
+        if (space > 0) {
 #if EC_TTY_DEBUG >= 1
-            printk(KERN_INFO PFX "Pushing %u bytes to TTY core.\n", to_recv);
+            printk(KERN_INFO PFX "Pushing %i bytes to TTY core.\n", space);
 #endif
-
-            for (i = 0; i < to_recv; i++) {
-                cbuf[i] = tty->rx_buffer[tty->rx_read_idx];
-                tty->rx_read_idx =
-                    (tty->rx_read_idx + 1) % EC_TTY_RX_BUFFER_SIZE;
-            }
+            ec_tty_ring_read(&tty->rx_ring, cbuf, space);
 #if LINUX_VERSION_CODE >= KERNEL_VERSION(3, 9, 0)
             tty_flip_buffer_push(tty->tty->port);
 #else
             tty_flip_buffer_push(tty->tty);
 #endif
+            ec_tty_latency(stamp, &tty->stats.rx_latency,
+                    &tty->stats.rx_latency_max);
+        }
+
+        if (space < (int) to_recv) {
+            /* The TTY layer is out of space. Retry with the next tick. */
+            tty->stats.rx_throttled++;
+            mod_timer(&tty->timer, jiffies + 1);
         }
     }
 
-    tty->timer.expires += 1;
-    add_timer(&tty->timer);
+    spin_unlock_irqrestore(&tty->rx_lock, flags);
+}
+
+/****************************************************************************/
+
+/** Work function, kicked from realtime context.
+ */
+void ec_tty_work(struct irq_work *work)
+{
+    ec_tty_push(container_of(work, ec_tty_t, work));
+}
+
+/****************************************************************************/
+
+/** Timer function.
+ */
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+void ec_tty_wakeup(struct timer_list *t)
+#else
+void ec_tty_wakeup(unsigned long data)
+#endif
+{
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 15, 0)
+    ec_tty_t *tty = from_timer(tty, t, timer);
+#else
+    ec_tty_t *tty = (ec_tty_t *) data;
+#endif
+
+    ec_tty_push(tty);
 }
 
 /*****************************************************************************
@@ -495,7 +637,7 @@ static int ec_tty_write(
         )
 {
     ec_tty_t *t = (ec_tty_t *) tty->driver_data;
-    unsigned int data_size, i;
+    unsigned int data_size;
 
 #if EC_TTY_DEBUG >= 1
     printk(KERN_INFO PFX "%s(count=%i)\n", __func__, count);
@@ -505,11 +647,10 @@ static int ec_tty_write(
         return 0;
     }
 
-    data_size = min(ec_tty_tx_space(t), (unsigned int) count);
-    for (i = 0; i < data_size; i++) {
-        t->tx_buffer[t->tx_write_idx] = buffer[i];
-        t->tx_write_idx = (t->tx_write_idx + 1) % EC_TTY_TX_BUFFER_SIZE;
+    if (!ec_tty_ring_size(&t->tx_ring)) {
+        WRITE_ONCE(t->stats.tx_stamp, ktime_to_ns(ktime_get()));
     }
+    data_size = ec_tty_ring_write(&t->tx_ring, buffer, count);
 
 #if EC_TTY_DEBUG >= 1
     printk(KERN_INFO PFX "%s(): %u bytes written.\n", __func__, data_size);
@@ -527,9 +668,10 @@ static int ec_tty_put_char(struct tty_struct *tty, unsigned char ch)
     printk(KERN_INFO PFX "%s(): c=%02x.\n", __func__, (unsigned int) ch);
 #endif
 
-    if (ec_tty_tx_space(t)) {
-        t->tx_buffer[t->tx_write_idx] = ch;
-        t->tx_write_idx = (t->tx_write_idx + 1) % EC_TTY_TX_BUFFER_SIZE;
+    if (!ec_tty_ring_size(&t->tx_ring)) {
+        WRITE_ONCE(t->stats.tx_stamp, ktime_to_ns(ktime_get()));
+    }
+    if (ec_tty_ring_write(&t->tx_ring, &ch, 1)) {
         return 1;
     } else {
         printk(KERN_WARNING PFX "%s(): Dropped a byte!\n", __func__);
@@ -546,7 +688,7 @@ static int ec_tty_write_room(struct tty_struct *tty)
 #endif
 {
     ec_tty_t *t = (ec_tty_t *) tty->driver_data;
-    int ret = ec_tty_tx_space(t);
+    int ret = ec_tty_ring_space(&t->tx_ring);
 
 #if EC_TTY_DEBUG >= 2
     printk(KERN_INFO PFX "%s() = %i.\n", __func__, ret);
@@ -570,7 +712,7 @@ static int ec_tty_chars_in_buffer(struct tty_struct *tty)
     printk(KERN_INFO PFX "%s().\n", __func__);
 #endif
 
-    ret = ec_tty_tx_size(t);
+    ret = ec_tty_ring_size(&t->tx_ring);
 
 #if EC_TTY_DEBUG >= 2
     printk(KERN_INFO PFX "%s() = %i.\n", __func__, ret);
@@ -734,6 +876,52 @@ static void ec_tty_wait_until_sent(struct tty_struct *tty, int timeout)
 
 /****************************************************************************/
 
+static int ec_tty_get_icount(struct tty_struct *tty,
+        struct serial_icounter_struct *icount)
+{
+    ec_tty_t *t = (ec_tty_t *) tty->driver_data;
+
+    icount->tx = t->stats.tx_bytes;
+    icount->rx = t->stats.rx_bytes;
+    icount->overrun = t->stats.rx_throttled;
+    icount->buf_overrun = t->stats.rx_dropped;
+    return 0;
+}
+
+/****************************************************************************/
+
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+static int ec_tty_proc_show(struct seq_file *m, void *v)
+{
+    int i;
+
+    seq_printf(m, "serinfo:1.0 driver:%s\n", EC_MASTER_VERSION);
+
+    down(&tty_sem);
+    for (i = 0; i < EC_TTY_MAX_DEVICES; i++) {
+        const ec_tty_t *t = ttys[i];
+
+        if (!t) {
+            continue;
+        }
+
+        seq_printf(m, "%i: txbuf:%u rxbuf:%u tx:%lu rx:%lu"
+                " rxdrop:%lu rxthrottle:%lu"
+                " txlat:%u/%u rxlat:%u/%u\n",
+                i, t->tx_ring.mask + 1, t->rx_ring.mask + 1,
+                t->stats.tx_bytes, t->stats.rx_bytes,
+                t->stats.rx_dropped, t->stats.rx_throttled,
+                t->stats.tx_latency, t->stats.tx_latency_max,
+                t->stats.rx_latency, t->stats.rx_latency_max);
+    }
+    up(&tty_sem);
+
+    return 0;
+}
+#endif
+
+/****************************************************************************/
+
 static const struct tty_operations ec_tty_ops = {
     .open = ec_tty_open,
     .close = ec_tty_close,
@@ -750,13 +938,18 @@ static const struct tty_operations ec_tty_ops = {
     .break_ctl = ec_tty_break,
     .send_xchar = ec_tty_send_xchar,
     .wait_until_sent = ec_tty_wait_until_sent,
+    .get_icount = ec_tty_get_icount,
+#if LINUX_VERSION_CODE >= KERNEL_VERSION(4, 18, 0)
+    .proc_show = ec_tty_proc_show,
+#endif
 };
 
 /*****************************************************************************
  * Public functions and methods
  ****************************************************************************/
 
-ec_tty_t *ectty_create(const ec_tty_operations_t *ops, void *cb_data)
+ec_tty_t *ectty_create_sized(const ec_tty_operations_t *ops, void *cb_data,
+        unsigned int tx_size, unsigned int rx_size)
 {
     ec_tty_t *tty;
     int minor, ret;
@@ -776,7 +969,7 @@ ec_tty_t *ectty_create(const ec_tty_operations_t *ops, void *cb_data)
                 return ERR_PTR(-ENOMEM);
             }
 
-            ret = ec_tty_init(tty, minor, ops, cb_data);
+            ret = ec_tty_init(tty, minor, ops, cb_data, tx_size, rx_size);
             if (ret) {
                 up(&tty_sem);
                 kfree(tty);
@@ -796,6 +989,13 @@ ec_tty_t *ectty_create(const ec_tty_operations_t *ops, void *cb_data)
 
 /****************************************************************************/
 
+ec_tty_t *ectty_create(const ec_tty_operations_t *ops, void *cb_data)
+{
+    return ectty_create_sized(ops, cb_data, 0, 0);
+}
+
+/****************************************************************************/
+
 void ectty_free(ec_tty_t *tty)
 {
     int minor = tty->minor;
@@ -817,21 +1017,19 @@ void ectty_free(ec_tty_t *tty)
 
 unsigned int ectty_tx_data(ec_tty_t *tty, uint8_t *buffer, size_t size)
 {
-    unsigned int data_size = min(ec_tty_tx_size(tty), (unsigned int) size), i;
+    u64 stamp = READ_ONCE(tty->stats.tx_stamp);
+    unsigned int data_size = ec_tty_ring_read(&tty->tx_ring, buffer,
+            min_t(size_t, size, UINT_MAX));
 
-    if (data_size)  {
+    if (data_size) {
 #if EC_TTY_DEBUG >= 1
         printk(KERN_INFO PFX "Fetching %u bytes to send.\n", data_size);
 #endif
-    }
-
-    for (i = 0; i < data_size; i++) {
-        buffer[i] = tty->tx_buffer[tty->tx_read_idx];
-        tty->tx_read_idx = (tty->tx_read_idx + 1) % EC_TTY_TX_BUFFER_SIZE;
-    }
-
-    if (data_size) {
+        tty->stats.tx_bytes += data_size;
+        ec_tty_latency(stamp, &tty->stats.tx_latency,
+                &tty->stats.tx_latency_max);
         tty->wakeup = 1;
+        irq_work_queue(&tty->work);
     }
 
     return data_size;
@@ -841,27 +1039,33 @@ unsigned int ectty_tx_data(ec_tty_t *tty, uint8_t *buffer, size_t size)
 
 void ectty_rx_data(ec_tty_t *tty, const uint8_t *buffer, size_t size)
 {
-    size_t to_recv;
+    unsigned int to_recv;
 
-    if (size)  {
-        unsigned int i;
+    if (!size) {
+        return;
+    }
 
 #if EC_TTY_DEBUG >= 1
-        printk(KERN_INFO PFX "Received %u bytes.\n", size);
+    printk(KERN_INFO PFX "Received %zu bytes.\n", size);
 #endif
 
-        to_recv = min(ec_tty_rx_space(tty), (unsigned int) size);
+    if (!ec_tty_ring_size(&tty->rx_ring)) {
+        WRITE_ONCE(tty->stats.rx_stamp, ktime_to_ns(ktime_get()));
+    }
 
-        if (to_recv < size) {
-            printk(KERN_WARNING PFX "Dropping %zu bytes.\n", size - to_recv);
-        }
+    to_recv = ec_tty_ring_write(&tty->rx_ring, buffer,
+            min_t(size_t, size, UINT_MAX));
+    tty->stats.rx_bytes += to_recv;
 
-        for (i = 0; i < size; i++) {
-            tty->rx_buffer[tty->rx_write_idx] = buffer[i];
-            tty->rx_write_idx =
-                (tty->rx_write_idx + 1) % EC_TTY_RX_BUFFER_SIZE;
+    if (to_recv < size) {
+        tty->stats.rx_dropped += size - to_recv;
+        if (printk_ratelimit()) {
+            printk(KERN_WARNING PFX "Dropping %zu bytes.\n",
+                    size - to_recv);
         }
     }
+
+    irq_work_queue(&tty->work);
 }
 
 /****************************************************************************/
@@ -872,6 +1076,7 @@ module_init(ec_tty_init_module);
 module_exit(ec_tty_cleanup_module);
 
 EXPORT_SYMBOL(ectty_create);
+EXPORT_SYMBOL(ectty_create_sized);
 EXPORT_SYMBOL(ectty_free);
 EXPORT_SYMBOL(ectty_tx_data);
 EXPORT_SYMBOL(ectty_rx_data);